@@ -0,0 +1,886 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PTK_POLYBIN_HPP
+#define PTK_POLYBIN_HPP
+
+// STL
+#include <string>
+#include <vector>
+#include <fstream>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+// POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// OGR
+#include <ogrsf_frmts.h>
+
+// pbin
+// * a binary polygon container the ptk_ tools can read and
+//   write instead of wkt, so chaining them doesn't parse and
+//   format text at every step
+// * the file is a header, the features back to back and then
+//   an index of where each feature starts, so a reader can map
+//   the file and get at any feature without parsing anything
+// * a feature is one or more polygons (parts), each an outer
+//   ring followed by its holes. Rings are kept closed (last
+//   point == first point) the same as wkt
+// * coordinates are doubles, or int32s that are scaled and
+//   offset (x = offsetX + q*scale)
+// * little endian, everything is 8 byte aligned
+//
+// header (64 bytes)
+//   char[8]   magic "PTKPBIN1"
+//   uint32    version
+//   uint32    coordType (PBIN_COORDS_F64 or PBIN_COORDS_I32)
+//   uint64    featureCount
+//   uint64    indexOffset
+//   double    scale, offsetX, offsetY
+//   uint64    reserved
+//
+// feature
+//   double    minX,minY,maxX,maxY
+//   uint32    numParts,numRings,numPoints
+//   uint32    size of the feature in bytes
+//   uint32    partRings[numParts+1]    first ring of each part
+//   uint32    ringPts[numRings+1]      first point of each ring
+//   (pad to 8)
+//   coords    x,y for each point
+//   (pad to 8)
+//
+// index
+//   uint64    offset of each feature
+
+#define PBIN_MAGIC "PTKPBIN1"
+#define PBIN_VERSION 1
+#define PBIN_HEADER_SIZE 64
+#define PBIN_FEATURE_HEADER_SIZE 48
+
+enum PolyFormat
+{
+    POLY_FORMAT_WKT = 0,
+    POLY_FORMAT_PBIN = 1
+};
+
+enum PBinCoordType
+{
+    PBIN_COORDS_F64 = 0,
+    PBIN_COORDS_I32 = 1
+};
+
+// ============================================================= //
+
+struct PolyFeature
+{
+    PolyFeature()
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        listPartRings.assign(1,0);
+        listRingPts.assign(1,0);
+        listXY.clear();
+        minX = std::numeric_limits<double>::max();
+        minY = std::numeric_limits<double>::max();
+        maxX = -std::numeric_limits<double>::max();
+        maxY = -std::numeric_limits<double>::max();
+    }
+
+    size_t GetNumParts() const
+    {   return listPartRings.size()-1;   }
+
+    size_t GetNumRings() const
+    {   return listRingPts.size()-1;   }
+
+    size_t GetNumPoints() const
+    {   return listXY.size()/2;   }
+
+    // build a feature with AddPoint, ending each ring
+    // with EndRing and each polygon with EndPart
+    void AddPoint(double x, double y)
+    {
+        listXY.push_back(x);
+        listXY.push_back(y);
+    }
+
+    void EndRing()
+    {   listRingPts.push_back(GetNumPoints());   }
+
+    void EndPart()
+    {   listPartRings.push_back(GetNumRings());   }
+
+    void CalcBounds()
+    {
+        minX = std::numeric_limits<double>::max();
+        minY = std::numeric_limits<double>::max();
+        maxX = -std::numeric_limits<double>::max();
+        maxY = -std::numeric_limits<double>::max();
+        for(size_t i=0; i < listXY.size(); i+=2)   {
+            minX = std::min(minX,listXY[i]);
+            minY = std::min(minY,listXY[i+1]);
+            maxX = std::max(maxX,listXY[i]);
+            maxY = std::max(maxY,listXY[i+1]);
+        }
+    }
+
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+    std::vector<uint32_t> listPartRings;    // numParts+1
+    std::vector<uint32_t> listRingPts;      // numRings+1
+    std::vector<double> listXY;             // x,y interleaved
+};
+
+// copies one part of feature into a single part feature
+inline void CopyPolyFeaturePart(PolyFeature const &feature,
+                                size_t part,
+                                PolyFeature &output)
+{
+    output.Clear();
+    for(uint32_t r=feature.listPartRings[part]; r < feature.listPartRings[part+1]; r++)   {
+        for(uint32_t i=feature.listRingPts[r]; i < feature.listRingPts[r+1]; i++)   {
+            output.AddPoint(feature.listXY[i*2],feature.listXY[i*2+1]);
+        }
+        output.EndRing();
+    }
+    output.EndPart();
+    output.CalcBounds();
+}
+
+// ============================================================= //
+
+// wkt bridge
+// * POLYGON()s become single part features and
+//   MULTIPOLYGON()s multi part ones; a single part
+//   feature goes back out as a POLYGON()
+
+inline void AddOGRRing(OGRLinearRing *ring, PolyFeature &feature)
+{
+    for(int i=0; i < ring->getNumPoints(); i++)   {
+        feature.AddPoint(ring->getX(i),ring->getY(i));
+    }
+    feature.EndRing();
+}
+
+inline void AddOGRPolygon(OGRPolygon *polygon, PolyFeature &feature)
+{
+    AddOGRRing(polygon->getExteriorRing(),feature);
+    for(int i=0; i < polygon->getNumInteriorRings(); i++)   {
+        AddOGRRing(polygon->getInteriorRing(i),feature);
+    }
+    feature.EndPart();
+}
+
+inline bool PolyFeatureFromOGR(OGRGeometry *geometry, PolyFeature &feature)
+{
+    feature.Clear();
+    if(geometry->getGeometryType() == wkbPolygon)   {
+        AddOGRPolygon((OGRPolygon*)geometry,feature);
+    }
+    else if(geometry->getGeometryType() == wkbMultiPolygon)   {
+        OGRMultiPolygon *multiPoly = (OGRMultiPolygon*)geometry;
+        for(int i=0; i < multiPoly->getNumGeometries(); i++)   {
+            AddOGRPolygon((OGRPolygon*)(multiPoly->getGeometryRef(i)),feature);
+        }
+    }
+    else   {
+        return false;
+    }
+    feature.CalcBounds();
+    return true;
+}
+
+inline OGRPolygon * PolyFeaturePartToOGR(PolyFeature const &feature, size_t part)
+{
+    OGRPolygon *polygon = new OGRPolygon;
+    for(uint32_t r=feature.listPartRings[part]; r < feature.listPartRings[part+1]; r++)   {
+        uint32_t const ptBegin = feature.listRingPts[r];
+        uint32_t const ptEnd = feature.listRingPts[r+1];
+
+        OGRLinearRing *ring = new OGRLinearRing;
+        ring->setNumPoints(ptEnd-ptBegin);
+        for(uint32_t i=ptBegin; i < ptEnd; i++)   {
+            ring->setPoint(i-ptBegin,feature.listXY[i*2],feature.listXY[i*2+1]);
+        }
+        polygon->addRingDirectly(ring);
+    }
+    return polygon;
+}
+
+// returns NULL for a feature without any parts
+inline OGRGeometry * PolyFeatureToOGR(PolyFeature const &feature)
+{
+    if(feature.GetNumParts() == 0)   {
+        return NULL;
+    }
+    if(feature.GetNumParts() == 1)   {
+        return PolyFeaturePartToOGR(feature,0);
+    }
+    OGRMultiPolygon *multiPoly = new OGRMultiPolygon;
+    for(size_t i=0; i < feature.GetNumParts(); i++)   {
+        multiPoly->addGeometryDirectly(PolyFeaturePartToOGR(feature,i));
+    }
+    return multiPoly;
+}
+
+// * an empty line gives false with no error
+inline bool PolyFeatureFromWkt(std::string wktLine,
+                               PolyFeature &feature,
+                               std::string &error)
+{
+    error.clear();
+
+    // remove any quotes around wktLine
+    if(wktLine.empty())   {
+        return false;
+    }
+    if(wktLine[0] == '\"' || wktLine[0] == '\'')
+    {   wktLine.erase(0,1);   }
+
+    if(!wktLine.empty() &&
+       (wktLine[wktLine.size()-1] == '\"' || wktLine[wktLine.size()-1] == '\''))
+    {   wktLine.erase(wktLine.size()-1,1);   }
+
+    std::vector<char> inputWKTBuffer(wktLine.begin(),wktLine.end());
+    inputWKTBuffer.push_back('\0');
+    char *inputWKT = inputWKTBuffer.data();
+
+    OGRGeometry *inputGeometry = NULL;
+    OGRGeometryFactory::createFromWkt(&inputWKT, NULL, &inputGeometry);
+    if(inputGeometry == NULL)   {
+        error = "Error: WKT is not valid (ignoring)\n-> "+wktLine;
+        return false;
+    }
+
+    bool ok = PolyFeatureFromOGR(inputGeometry,feature);
+    delete inputGeometry;
+
+    if(!ok)   {
+        error = "Error: WKT is not POLYGON/MULTIPOLYGON (ignoring)\n-> "+wktLine;
+    }
+    return ok;
+}
+
+inline std::string PolyFeatureToWkt(PolyFeature const &feature)
+{
+    std::string wkt;
+    OGRGeometry *geometry = PolyFeatureToOGR(feature);
+    if(geometry)   {
+        char *outputWKT;
+        geometry->exportToWkt(&outputWKT);
+        wkt = outputWKT;
+        delete[] outputWKT;
+        delete geometry;
+    }
+    return wkt;
+}
+
+// ============================================================= //
+
+inline size_t PBinAlign8(size_t size)
+{
+    return (size+7) & ~size_t(7);
+}
+
+inline bool PBinHasExtension(std::string const &path)
+{
+    std::string const ext(".pbin");
+    return (path.size() >= ext.size()) &&
+           (path.compare(path.size()-ext.size(),ext.size(),ext) == 0);
+}
+
+// output files are pbin if they end in .pbin
+inline PolyFormat GetPolyFormatForPath(std::string const &path)
+{
+    return PBinHasExtension(path) ? POLY_FORMAT_PBIN : POLY_FORMAT_WKT;
+}
+
+// ============================================================= //
+
+// PolyWriter
+// * writes features as wkt lines or as pbin
+// * Encode is thread safe, so features can be encoded in
+//   parallel and then written out in order with WriteRecord
+// * Suspend closes the file without finishing it and Resume
+//   reopens it to append more, so a caller writing many files
+//   at once doesn't need a file handle for each of them
+class PolyWriter
+{
+public:
+    PolyWriter() :
+        m_format(POLY_FORMAT_WKT),
+        m_coordType(PBIN_COORDS_F64),
+        m_scale(1.0),
+        m_offsetX(0.0),
+        m_offsetY(0.0),
+        m_offset(0),
+        m_count(0),
+        m_suspended(false),
+        m_failed(false)
+    {}
+
+    ~PolyWriter()
+    {
+        Close();
+    }
+
+    // the format is picked from the extension (.pbin or
+    // anything else for wkt); wkt files start with a
+    // "WKT" line unless wktHeader is false
+    bool Open(std::string const &path, bool wktHeader=true)
+    {
+        return Open(path,GetPolyFormatForPath(path),wktHeader);
+    }
+
+    bool Open(std::string const &path, PolyFormat format, bool wktHeader=true)
+    {
+        Close();
+        m_suspended = false;
+        m_failed = false;
+        m_path = path;
+        m_format = format;
+        m_file.open(path.c_str(),std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!m_file.is_open())   {
+            return false;
+        }
+
+        m_listOffsets.clear();
+        m_count = 0;
+        if(m_format == POLY_FORMAT_PBIN)   {
+            // the header is filled in on Close
+            char header[PBIN_HEADER_SIZE] = {0};
+            m_file.write(header,PBIN_HEADER_SIZE);
+            m_offset = PBIN_HEADER_SIZE;
+        }
+        else if(wktHeader)   {
+            m_file << "WKT\n";
+        }
+        return true;
+    }
+
+    // store pbin coordinates as x = offsetX + q*scale; has
+    // to be set before anything is written
+    void SetInt32Coords(double scale, double offsetX, double offsetY)
+    {
+        m_coordType = PBIN_COORDS_I32;
+        m_scale = scale;
+        m_offsetX = offsetX;
+        m_offsetY = offsetY;
+    }
+
+    PolyFormat GetFormat() const
+    {
+        return m_format;
+    }
+
+    // false if the feature has no parts or (int32 coords)
+    // doesn't fit in the quantized range
+    bool Encode(PolyFeature const &feature, std::string &record) const
+    {
+        record.clear();
+        if(feature.GetNumParts() == 0)   {
+            return false;
+        }
+
+        if(m_format == POLY_FORMAT_WKT)   {
+            record = PolyFeatureToWkt(feature);
+            record.push_back('\n');
+            return true;
+        }
+
+        uint32_t const numParts = feature.GetNumParts();
+        uint32_t const numRings = feature.GetNumRings();
+        uint32_t const numPoints = feature.GetNumPoints();
+        size_t const coordSize = (m_coordType == PBIN_COORDS_I32) ? 4 : 8;
+
+        size_t const ringsEnd = PBIN_FEATURE_HEADER_SIZE+
+                (numParts+1+numRings+1)*sizeof(uint32_t);
+        size_t const coordsBegin = PBinAlign8(ringsEnd);
+        size_t const size = PBinAlign8(coordsBegin+numPoints*2*coordSize);
+        if(size > std::numeric_limits<uint32_t>::max())   {
+            return false;
+        }
+        record.assign(size,'\0');
+        char *data = &record[0];
+
+        // coords first so the bounds match what's stored
+        double bounds[4] = {
+            std::numeric_limits<double>::max(),
+            std::numeric_limits<double>::max(),
+            -std::numeric_limits<double>::max(),
+            -std::numeric_limits<double>::max()
+        };
+
+        for(uint32_t i=0; i < numPoints; i++)   {
+            double x = feature.listXY[i*2];
+            double y = feature.listXY[i*2+1];
+            if(m_coordType == PBIN_COORDS_I32)   {
+                double qx = std::floor((x-m_offsetX)/m_scale+0.5);
+                double qy = std::floor((y-m_offsetY)/m_scale+0.5);
+                if(!(std::fabs(qx) <= std::numeric_limits<int32_t>::max() &&
+                     std::fabs(qy) <= std::numeric_limits<int32_t>::max()))   {
+                    record.clear();
+                    return false;
+                }
+                int32_t q[2] = { int32_t(qx), int32_t(qy) };
+                memcpy(data+coordsBegin+i*8,q,8);
+                x = m_offsetX+q[0]*m_scale;
+                y = m_offsetY+q[1]*m_scale;
+            }
+            else   {
+                memcpy(data+coordsBegin+i*16,&feature.listXY[i*2],16);
+            }
+            bounds[0] = std::min(bounds[0],x);
+            bounds[1] = std::min(bounds[1],y);
+            bounds[2] = std::max(bounds[2],x);
+            bounds[3] = std::max(bounds[3],y);
+        }
+
+        uint32_t const counts[4] = { numParts, numRings, numPoints, uint32_t(size) };
+        memcpy(data,bounds,32);
+        memcpy(data+32,counts,16);
+        memcpy(data+PBIN_FEATURE_HEADER_SIZE,
+               feature.listPartRings.data(),(numParts+1)*sizeof(uint32_t));
+        memcpy(data+PBIN_FEATURE_HEADER_SIZE+(numParts+1)*sizeof(uint32_t),
+               feature.listRingPts.data(),(numRings+1)*sizeof(uint32_t));
+        return true;
+    }
+
+    void WriteRecord(std::string const &record)
+    {
+        if(record.empty())   {
+            return;
+        }
+        if(m_format == POLY_FORMAT_PBIN)   {
+            m_listOffsets.push_back(m_offset);
+            m_offset += record.size();
+        }
+        m_file.write(record.data(),record.size());
+        m_count++;
+    }
+
+    // false if the feature couldn't be encoded (see
+    // Encode) or the file couldn't be written
+    bool Write(PolyFeature const &feature)
+    {
+        if(!Encode(feature,m_record))   {
+            return false;
+        }
+        WriteRecord(m_record);
+        return m_file.good();
+    }
+
+    size_t GetFeatureCount() const
+    {
+        return m_count;
+    }
+
+    std::string const & GetPath() const
+    {
+        return m_path;
+    }
+
+    void Suspend()
+    {
+        if(!m_file.is_open())   {
+            return;
+        }
+        m_failed = m_failed || !m_file.good();
+        m_file.close();
+        m_suspended = true;
+        std::string().swap(m_record);
+    }
+
+    // the pbin index and header aren't written until
+    // Close, so the end of the file is still the end
+    // of the last feature
+    bool Resume()
+    {
+        if(!m_suspended)   {
+            return m_file.is_open();
+        }
+        m_file.clear();
+        m_file.open(m_path.c_str(),std::ios::in | std::ios::out | std::ios::binary);
+        if(!m_file.is_open())   {
+            return false;
+        }
+        m_suspended = false;
+        m_file.seekp(0,std::ios::end);
+        return m_file.good();
+    }
+
+    // false if the file couldn't be finished
+    bool Close()
+    {
+        if(m_suspended && !Resume())   {
+            return false;
+        }
+        if(!m_file.is_open())   {
+            return true;
+        }
+
+        if(m_format == POLY_FORMAT_PBIN)   {
+            // index
+            uint64_t const indexOffset = m_offset;
+            for(size_t i=0; i < m_listOffsets.size(); i++)   {
+                uint64_t const offset = m_listOffsets[i];
+                m_file.write(reinterpret_cast<char const*>(&offset),8);
+            }
+
+            // header
+            char header[PBIN_HEADER_SIZE] = {0};
+            uint32_t const version = PBIN_VERSION;
+            uint32_t const coordType = m_coordType;
+            uint64_t const featureCount = m_listOffsets.size();
+            double const xform[3] = { m_scale, m_offsetX, m_offsetY };
+            memcpy(header,PBIN_MAGIC,8);
+            memcpy(header+8,&version,4);
+            memcpy(header+12,&coordType,4);
+            memcpy(header+16,&featureCount,8);
+            memcpy(header+24,&indexOffset,8);
+            memcpy(header+32,xform,24);
+            m_file.seekp(0);
+            m_file.write(header,PBIN_HEADER_SIZE);
+        }
+        bool const good = m_file.good() && !m_failed;
+        m_file.close();
+        return good;
+    }
+
+private:
+    PolyFormat m_format;
+    PBinCoordType m_coordType;
+    double m_scale;
+    double m_offsetX;
+    double m_offsetY;
+
+    std::string m_path;
+    std::fstream m_file;
+    uint64_t m_offset;
+    std::vector<uint64_t> m_listOffsets;
+    size_t m_count;
+    bool m_suspended;
+    bool m_failed;
+    std::string m_record;
+};
+
+// ============================================================= //
+
+// PolyReader
+// * reads pbin (if the file starts with the pbin magic)
+//   or wkt, one line per feature
+// * records are read a batch at a time with ReadBatch;
+//   GetFeature decodes one and is thread safe, so a batch
+//   can be decoded in parallel
+// * pbin files are memory mapped and can also be read in
+//   any order with ReadFeature
+class PolyReader
+{
+public:
+    PolyReader() :
+        m_format(POLY_FORMAT_WKT),
+        m_data(NULL),
+        m_size(0),
+        m_featureCount(0),
+        m_nextFeature(0),
+        m_batchBegin(0),
+        m_batchSize(0)
+    {}
+
+    ~PolyReader()
+    {
+        Close();
+    }
+
+    bool Open(std::string const &path)
+    {
+        Close();
+
+        char magic[8] = {0};
+        std::ifstream file(path.c_str(),std::ios::in | std::ios::binary);
+        if(!file.is_open())   {
+            return false;
+        }
+        file.read(magic,8);
+        file.close();
+
+        if(memcmp(magic,PBIN_MAGIC,8) == 0)   {
+            m_format = POLY_FORMAT_PBIN;
+            return openPBin(path);
+        }
+
+        m_format = POLY_FORMAT_WKT;
+        m_wktFile.open(path.c_str());
+        if(!m_wktFile.is_open())   {
+            return false;
+        }
+
+        // skip the csv header
+        std::string wktLine;
+        if(std::getline(m_wktFile,wktLine) && (wktLine != "WKT"))   {
+            m_listPendingLines.push_back(wktLine);
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if(m_data)   {
+            munmap(const_cast<char*>(m_data),m_size);
+            m_data = NULL;
+        }
+        if(m_wktFile.is_open())   {
+            m_wktFile.close();
+        }
+        m_size = 0;
+        m_featureCount = 0;
+        m_nextFeature = 0;
+        m_batchBegin = 0;
+        m_batchSize = 0;
+        m_listLines.clear();
+        m_listPendingLines.clear();
+    }
+
+    PolyFormat GetFormat() const
+    {
+        return m_format;
+    }
+
+    // only known up front for pbin, 0 for wkt
+    size_t GetFeatureCount() const
+    {
+        return m_featureCount;
+    }
+
+    // reads up to maxCount records, false once
+    // there's nothing left
+    bool ReadBatch(size_t maxCount)
+    {
+        if(m_format == POLY_FORMAT_PBIN)   {
+            m_batchBegin = m_nextFeature;
+            m_batchSize = std::min<size_t>(maxCount,m_featureCount-m_nextFeature);
+            m_nextFeature += m_batchSize;
+            return (m_batchSize > 0);
+        }
+
+        m_listLines.clear();
+        m_listLines.swap(m_listPendingLines);
+        std::string wktLine;
+        while(m_listLines.size() < maxCount &&
+              std::getline(m_wktFile,wktLine))   {
+            m_listLines.push_back(std::move(wktLine));
+        }
+        m_batchSize = m_listLines.size();
+        return (m_batchSize > 0);
+    }
+
+    size_t GetBatchSize() const
+    {
+        return m_batchSize;
+    }
+
+    // a feature of the current batch; empty lines give
+    // false without an error
+    bool GetFeature(size_t i, PolyFeature &feature, std::string &error) const
+    {
+        if(m_format == POLY_FORMAT_PBIN)   {
+            error.clear();
+            if(!ReadFeature(m_batchBegin+i,feature))   {
+                error = "Error: pbin feature "+std::to_string(m_batchBegin+i)+
+                        " is not valid (ignoring)";
+                return false;
+            }
+            return true;
+        }
+        return PolyFeatureFromWkt(m_listLines[i],feature,error);
+    }
+
+    // pbin only, any feature by index
+    bool ReadFeature(size_t index, PolyFeature &feature) const
+    {
+        feature.Clear();
+
+        char const *data;
+        uint32_t counts[4];
+        if(!getFeatureData(index,data,counts))   {
+            return false;
+        }
+        uint32_t const numParts = counts[0];
+        uint32_t const numRings = counts[1];
+        uint32_t const numPoints = counts[2];
+
+        memcpy(&feature.minX,data,8);
+        memcpy(&feature.minY,data+8,8);
+        memcpy(&feature.maxX,data+16,8);
+        memcpy(&feature.maxY,data+24,8);
+
+        char const *rings = data+PBIN_FEATURE_HEADER_SIZE;
+        feature.listPartRings.resize(numParts+1);
+        feature.listRingPts.resize(numRings+1);
+        memcpy(feature.listPartRings.data(),rings,(numParts+1)*4);
+        memcpy(feature.listRingPts.data(),rings+(numParts+1)*4,(numRings+1)*4);
+
+        // the offsets have to be in order and in range
+        // for the feature to be used safely
+        if(feature.listPartRings[0] != 0 || feature.listPartRings[numParts] != numRings ||
+           feature.listRingPts[0] != 0 || feature.listRingPts[numRings] != numPoints ||
+           !std::is_sorted(feature.listPartRings.begin(),feature.listPartRings.end()) ||
+           !std::is_sorted(feature.listRingPts.begin(),feature.listRingPts.end()))   {
+            feature.Clear();
+            return false;
+        }
+
+        char const *coords = data+PBinAlign8(PBIN_FEATURE_HEADER_SIZE+(numParts+numRings+2)*4);
+        feature.listXY.resize(size_t(numPoints)*2);
+        if(m_coordType == PBIN_COORDS_I32)   {
+            for(size_t i=0; i < feature.listXY.size(); i+=2)   {
+                int32_t q[2];
+                memcpy(q,coords+i*4,8);
+                feature.listXY[i] = m_offsetX+q[0]*m_scale;
+                feature.listXY[i+1] = m_offsetY+q[1]*m_scale;
+            }
+        }
+        else   {
+            memcpy(feature.listXY.data(),coords,feature.listXY.size()*8);
+        }
+        return true;
+    }
+
+    // pbin only, reads just the bounds (minX,minY,maxX,maxY)
+    bool ReadFeatureBounds(size_t index, double *bounds) const
+    {
+        char const *data;
+        uint32_t counts[4];
+        if(!getFeatureData(index,data,counts))   {
+            return false;
+        }
+        memcpy(bounds,data,32);
+        return true;
+    }
+
+    // the wkt line of a batch record or a short description
+    std::string GetRecordDesc(size_t i) const
+    {
+        if(m_format == POLY_FORMAT_PBIN)   {
+            return "pbin feature "+std::to_string(m_batchBegin+i);
+        }
+        return m_listLines[i];
+    }
+
+private:
+    bool openPBin(std::string const &path)
+    {
+        int fd = open(path.c_str(),O_RDONLY);
+        if(fd < 0)   {
+            return false;
+        }
+        struct stat fileStat;
+        if(fstat(fd,&fileStat) != 0 || fileStat.st_size < PBIN_HEADER_SIZE)   {
+            close(fd);
+            return false;
+        }
+        m_size = fileStat.st_size;
+        void *data = mmap(NULL,m_size,PROT_READ,MAP_PRIVATE,fd,0);
+        close(fd);
+        if(data == MAP_FAILED)   {
+            m_size = 0;
+            return false;
+        }
+        m_data = static_cast<char const*>(data);
+        madvise(data,m_size,MADV_SEQUENTIAL);
+
+        uint32_t version;
+        uint32_t coordType;
+        uint64_t featureCount;
+        double xform[3];
+        memcpy(&version,m_data+8,4);
+        memcpy(&coordType,m_data+12,4);
+        memcpy(&featureCount,m_data+16,8);
+        memcpy(&m_indexOffset,m_data+24,8);
+        memcpy(xform,m_data+32,24);
+
+        if(version != PBIN_VERSION || coordType > PBIN_COORDS_I32 ||
+           m_indexOffset < PBIN_HEADER_SIZE || m_indexOffset > m_size ||
+           featureCount > (m_size-m_indexOffset)/8)   {
+            Close();
+            return false;
+        }
+        m_coordType = PBinCoordType(coordType);
+        m_featureCount = featureCount;
+        m_scale = xform[0];
+        m_offsetX = xform[1];
+        m_offsetY = xform[2];
+        return true;
+    }
+
+    bool getFeatureData(size_t index, char const *&data, uint32_t *counts) const
+    {
+        if(m_format != POLY_FORMAT_PBIN || index >= m_featureCount)   {
+            return false;
+        }
+        uint64_t offset;
+        memcpy(&offset,m_data+m_indexOffset+index*8,8);
+        if(offset < PBIN_HEADER_SIZE || offset % 8 != 0 ||
+           offset+PBIN_FEATURE_HEADER_SIZE > m_indexOffset)   {
+            return false;
+        }
+        data = m_data+offset;
+        memcpy(counts,data+32,16);
+
+        // everything the counts say is there has
+        // to fit in the record
+        uint64_t const numParts = counts[0];
+        uint64_t const numRings = counts[1];
+        uint64_t const numPoints = counts[2];
+        uint64_t const coordSize = (m_coordType == PBIN_COORDS_I32) ? 4 : 8;
+        uint64_t const needed = PBinAlign8(PBIN_FEATURE_HEADER_SIZE+(numParts+numRings+2)*4)+
+                numPoints*2*coordSize;
+        return (needed <= counts[3]) && (offset+counts[3] <= m_indexOffset);
+    }
+
+    PolyFormat m_format;
+
+    // pbin
+    char const *m_data;
+    size_t m_size;
+    uint64_t m_indexOffset;
+    PBinCoordType m_coordType;
+    double m_scale;
+    double m_offsetX;
+    double m_offsetY;
+    size_t m_featureCount;
+    size_t m_nextFeature;
+    size_t m_batchBegin;
+    size_t m_batchSize;
+
+    // wkt
+    std::ifstream m_wktFile;
+    std::vector<std::string> m_listLines;
+    std::vector<std::string> m_listPendingLines;
+};
+
+#endif // PTK_POLYBIN_HPP
@@ -1,3 +1,6 @@
+#ifndef VEC2_HPP
+#define VEC2_HPP
+
 #include <math.h>
 
     class Vec2
@@ -56,3 +59,5 @@
         double x;
         double y;
     };
+
+#endif // VEC2_HPP
@@ -1,3 +1,6 @@
+#ifndef VEC3_HPP
+#define VEC3_HPP
+
 #include <math.h>
 
     class Vec3
@@ -97,3 +100,5 @@
         double y;
         double z;
     };
+
+#endif // VEC3_HPP
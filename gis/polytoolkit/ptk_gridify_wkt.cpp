@@ -2,10 +2,15 @@
 #include <iostream>
 #include <iomanip>
 #include <cstring>
+#include <cstdlib>
 #include <sstream>
 #include <fstream>
-#include <stack>
-#include <set>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
 #include <sys/time.h>
 
 // OGR
@@ -14,41 +19,17 @@
 // clipper
 #include "clipper/clipper.hpp"
 
-// defs
-// AUS_NZ
-//#define MINLON 110
-//#define MAXLON 180
-//#define MINLAT -56
-//#define MAXLAT -8
-//#define LONSTEP 2
-//#define LATSTEP 2
-//#define DBLMT 1E10
-
-// AMERICAS
-//#define MINLON -180
-//#define MAXLON -26
-//#define MINLAT -58
-//#define MAXLAT 84
-//#define LONSTEP 2
-//#define LATSTEP 2
-//#define DBLMT 1E10
-
-// split AMERICAS into 4 [expanded, should cull to above bbox later]
-//#define MINLON -180
-//#define MAXLON -20
-//#define MINLAT -58
-//#define MAXLAT 86
-//#define LONSTEP 40
-//#define LATSTEP 36
-//#define DBLMT 1E10
-
-#define MINLON -180
-#define MAXLON 180
-#define MINLAT -90
-#define MAXLAT 90
-#define LONSTEP 180
-#define LATSTEP 180
-#define DBLMT 1E10
+// threadpool
+#include <ThreadPool.h>
+#include <Parallel.h>
+
+// rtree
+#include <PackedRTree.h>
+
+#include "PolyBin.hpp"
+#include "ptk_quadify.hpp"
+
+using ptk::DBLMT;
 
 // timing vars
 timeval t1,t2;
@@ -85,254 +66,249 @@ double StringToNumber ( const std::string &Text )
     return ss >> result ? result : 0;
 }
 
-bool calcAreaRectOverlap(double r1_bl_x, double r1_bl_y,
-                         double r1_tr_x, double r1_tr_y,
-                         double r2_bl_x, double r2_bl_y,
-                         double r2_tr_x, double r2_tr_y)
+// features are read and parsed in parallel
+// this many at a time
+size_t const k_batch_lines = 65536;
+
+// ============================================================= //
+
+// Gridification
+// * the input is parsed once into clipper polygons (see
+//   ptk_quadify.hpp) and an STR packed R-tree is built
+//   over their bounding boxes
+// * every grid cell queries the R-tree and only clips
+//   the polygons whose bounding boxes overlap it; cells
+//   are independent so they're clipped and written in
+//   parallel on a thread pool
+// * polygons are written to a cell in input order, so
+//   the output is the same from run to run
+
+typedef scratch::PackedRTree<ClipperLib::long64> ShapeRTree;
+
+struct GridCell
+{
+    unsigned int row;   // from MINLAT
+    unsigned int col;   // from MINLON
+    BoundingBox extents;
+};
+
+std::vector<GridCell> BuildGrid(BoundingBox const &gridExtents,
+                                double lonStep,
+                                double latStep)
 {
-    // check if rectangles intersect
-    if((r1_tr_x < r2_bl_x) || (r1_bl_x > r2_tr_x) ||
-            (r1_tr_y < r2_bl_y) || (r1_bl_y > r2_tr_y))
-    {   return false;   }
+    // the last row and column are cut short if the
+    // extents aren't a multiple of the step
+    unsigned int const numRows = (unsigned int)
+            std::ceil((gridExtents.maxLat-gridExtents.minLat)/latStep);
+    unsigned int const numCols = (unsigned int)
+            std::ceil((gridExtents.maxLon-gridExtents.minLon)/lonStep);
+
+    std::vector<GridCell> listCells;
+    listCells.reserve(size_t(numRows)*numCols);
+    for(unsigned int i=0; i < numRows; i++)   {
+        for(unsigned int j=0; j < numCols; j++)   {
+            GridCell cell;
+            cell.row = i;
+            cell.col = j;
+            cell.extents.minLat = gridExtents.minLat + i*latStep;
+            cell.extents.maxLat = std::min(gridExtents.maxLat,cell.extents.minLat+latStep);
+            cell.extents.minLon = gridExtents.minLon + j*lonStep;
+            cell.extents.maxLon = std::min(gridExtents.maxLon,cell.extents.minLon+lonStep);
+            listCells.push_back(cell);
+        }
+    }
+    return listCells;
+}
 
+// numPolys is set to the number of polygons written
+// to the cell; false if the cell file couldn't be written
+bool GridifyCell(GridCell const &cell,
+                 std::vector<QuadShape> const &listShapes,
+                 ShapeRTree const &rtree,
+                 std::string const &outputPrefix,
+                 PolyFormat outputFormat,
+                 std::string &cellPath,
+                 size_t &numPolys)
+{
+    numPolys = 0;
+
+    ShapeRTree::Box query;
+    query.min_x = ClipperLib::long64(cell.extents.minLon*DBLMT);
+    query.min_y = ClipperLib::long64(cell.extents.minLat*DBLMT);
+    query.max_x = ClipperLib::long64(cell.extents.maxLon*DBLMT);
+    query.max_y = ClipperLib::long64(cell.extents.maxLat*DBLMT);
+
+    std::vector<size_t> listCandidates;
+    rtree.Query(query,listCandidates);
+
+    std::vector<QuadShape> listCellShapes;
+    for(size_t i=0; i < listCandidates.size(); i++)   {
+        ClipQuadShape(listShapes[listCandidates[i]],cell.extents,listCellShapes);
+    }
+    if(listCellShapes.empty())   {
+        return true;
+    }
+
+    cellPath = outputPrefix +
+            NumberToString(cell.row) + "_" + NumberToString(cell.col);
+    if(outputFormat == POLY_FORMAT_PBIN)   {
+        cellPath += ".pbin";
+    }
+
+    PolyWriter cellWriter;
+    if(!cellWriter.Open(cellPath,outputFormat))   {
+        return false;
+    }
+
+    PolyFeature feature;
+    for(size_t i=0; i < listCellShapes.size(); i++)   {
+        QuadShapeToPolyFeature(listCellShapes[i],feature);
+        cellWriter.Write(feature);
+    }
+    if(!cellWriter.Close())   {
+        return false;
+    }
+    numPolys = listCellShapes.size();
     return true;
 }
 
+// ============================================================= //
+
 int main(int argc, const char *argv[])
 {
-    if(argc != 3) {
-        std::cout << "Usage: #> ./ptk_gridify_wkt myinputfile.dat myoutputfile.ply\n";
-        std::cout << "* Expect each line of the input file to contain a single WKT def\n";
-        std::cout << "* The output file is in the same format as the input file\n";
+    if(argc != 9) {
+        std::cout << "Usage: #> ./ptk_gridify_wkt MINLON MAXLON MINLAT MAXLAT LONSTEP LATSTEP inputfile.dat outputdir\n";
+        std::cout << "* Expect each line of the input file to contain a single WKT def,\n";
+        std::cout << "  or the input to be pbin (see ptk_polybin)\n";
+        std::cout << "* Each grid cell with any polygons in it is written to\n";
+        std::cout << "  outputdir/CELL_ROW_COL in the same format as the input file,\n";
+        std::cout << "  where ROW counts up from MINLAT and COL from MINLON\n";
         return 0;
     }
 
-    std::cout << "Was GDAL built against GEOS?\n ";
-    if(OGRGeometryFactory::haveGEOS())   {
-        std::cout << "-> Yeah, WOOOOO!" << std::endl;
-    }
-    else   {
-        std::cout << "-> Naw :(" << std::endl;
-        std::cout << "-> GDAL needs to be built against GEOS to use this tool" << std::endl;
+    StartTiming("[Gridification]");
+
+    BoundingBox gridExtents;
+    gridExtents.minLon = StringToNumber(argv[1]);
+    gridExtents.maxLon = StringToNumber(argv[2]);
+    gridExtents.minLat = StringToNumber(argv[3]);
+    gridExtents.maxLat = StringToNumber(argv[4]);
+    double const lonStep = StringToNumber(argv[5]);
+    double const latStep = StringToNumber(argv[6]);
+
+    if(!(gridExtents.maxLon > gridExtents.minLon) ||
+       !(gridExtents.maxLat > gridExtents.minLat) ||
+       !(lonStep > 0) || !(latStep > 0))   {
+        std::cout << "ptk_gridify_wkt: Grid extents and steps should be positive\n";
         return -1;
     }
 
-    StartTiming("[Gridification]");
-
-    std::ifstream inputWktFile;
-    inputWktFile.open(argv[1]);
+    // create output dir
+    std::string makeDir("mkdir -p ");
+    makeDir.append(argv[8]);
+    system(makeDir.c_str());
 
-    std::ofstream outputWktFileWEST;
-    outputWktFileWEST.open("OUTPUT_WEST.csv");
-    outputWktFileWEST << "WKT\n";
+    std::string outputPrefix = std::string(argv[8]);
+    outputPrefix.append("/CELL_");
 
-    std::ofstream outputWktFileEAST;
-    outputWktFileEAST.open("OUTPUT_EAST.csv");
-    outputWktFileEAST << "WKT\n";
+    scratch::ThreadPool threadPool(
+                std::max(1u,std::thread::hardware_concurrency()));
+    size_t const numThreads = threadPool.GetThreadCount();
 
-    // get number of input lines
-    unsigned int numInputLines=0;
-    if(inputWktFile.is_open())   {
-        while(!inputWktFile.eof())   {
-            std::string wktLine;
-            std::getline(inputWktFile,wktLine);
-            numInputLines++;
-        }
+    // parse the input once
+    PolyReader reader;
+    if(!reader.Open(argv[7]))   {
+        std::cout << "ptk_gridify_wkt: Could not open " << argv[7] << "\n";
+        return -1;
     }
-    inputWktFile.close();
-    inputWktFile.open(argv[1]);
 
-    // do stuff
-    unsigned int latExtents = MAXLAT-MINLAT;
-    unsigned int lonExtents = MAXLON-MINLON;
-    if(inputWktFile.is_open())
+    // cells are written in the same format as the input
+    PolyFormat const outputFormat = reader.GetFormat();
+
+    // a batch of records at a time, so the raw input
+    // is never in memory all at once
+    size_t numSkipped = 0;
+    std::vector<QuadShape> listShapes;
+    std::vector<QuadShape> listParsed;
+    std::vector<char> listParsedOk;
+    while(reader.ReadBatch(k_batch_lines))
     {
-        int linesProcessed = 0;
-//        outputWktFile << "WKT\n";
-
-        while(!inputWktFile.eof())
-        {
-            std::string wktLine;
-            std::getline(inputWktFile,wktLine);
-
-            // remove any quotes around wktLine
-            if(wktLine[0] == '\"' || wktLine[0] == '\'')
-            {   wktLine.erase(0,1);   }
-
-            if(wktLine[wktLine.size()-1] == '\"' || wktLine[wktLine.size()-1] == '\'')
-            {   wktLine.erase(wktLine.size()-1,1);   }
-
-            // create geometry from wkt
-            char *inputWKT = new char[wktLine.size()+1];
-            char *inputWKTRef = inputWKT;
-            strcpy(inputWKT,wktLine.c_str());
-
-            OGRGeometry *inputGeometry;
-            OGRGeometryFactory::createFromWkt(&inputWKT, NULL, &inputGeometry);
-
-            if (inputGeometry == NULL)   {
-                std::cout << "Error: WKT is not valid (ignoring)" << std::endl;
-                std::cout << "-> " << wktLine << std::endl;
-                delete[] inputWKTRef;
-                continue;
-            }
-            delete[] inputWKTRef;
-
-            unsigned int numOuterRingPts = 0;
-
-            // get bounding box
-            OGREnvelope boundingBox;
-            inputGeometry->getEnvelope(&boundingBox);
-
-            ClipperLib::Polygons inputPolys;
-            if(inputGeometry->getGeometryType() == wkbPolygon)   {
-                // outer ring
-                OGRPolygon *singlePoly = (OGRPolygon*)inputGeometry;
-                OGRLinearRing* outerRing = singlePoly->getExteriorRing();
-                ClipperLib::Polygon outerPoly;
-                numOuterRingPts = outerRing->getNumPoints();
-                for(int j=0; j < outerRing->getNumPoints()-1; j++)   {
-                    ClipperLib::IntPoint intPt;
-                    intPt.X = ClipperLib::long64(outerRing->getX(j)*DBLMT);
-                    intPt.Y = ClipperLib::long64(outerRing->getY(j)*DBLMT);
-                    outerPoly.push_back(intPt);
-                }
-                inputPolys.push_back(outerPoly);
-
-                // inner rings
-                for(int j=0; j < singlePoly->getNumInteriorRings(); j++)   {
-                    OGRLinearRing *innerRing = singlePoly->getInteriorRing(j);
-                    ClipperLib::Polygon innerPoly;
-                    for(int k=0; k < innerRing->getNumPoints()-1; k++)   {
-                        ClipperLib::IntPoint intPt;
-                        intPt.X = ClipperLib::long64(innerRing->getX(k)*DBLMT);
-                        intPt.Y = ClipperLib::long64(innerRing->getY(k)*DBLMT);
-                        innerPoly.push_back(intPt);
-                    }
-                    inputPolys.push_back(innerPoly);
-                }
-            }
-            else   {
-                std::cout << "Error: Could not clip geometry, "
-                             "WKT type is not a POLYGON()\n";
-                std::cout << "-> WKT: " << wktLine << "\n";
-                linesProcessed++;
-                delete inputGeometry;
-                continue;
+        listParsed.assign(reader.GetBatchSize(),QuadShape());
+        listParsedOk.assign(reader.GetBatchSize(),0);
+        scratch::ParallelForRange(threadPool,0,listParsed.size(),
+                                  [&](size_t rangeBegin, size_t rangeEnd) {
+            PolyFeature feature;
+            std::string error;
+            for(size_t i=rangeBegin; i < rangeEnd; i++)   {
+                listParsedOk[i] = reader.GetFeature(i,feature,error) &&
+                                  ParseQuadShape(feature,listParsed[i]);
             }
+        },std::max<size_t>(1,listParsed.size()/(numThreads*8)));
 
-            // only do a full intersection if the bounding boxes of
-            // the grid extents and geometry in question overlap
-            if(!calcAreaRectOverlap(MINLON,MINLAT,MAXLON,MAXLAT,
-                                    boundingBox.MinX,boundingBox.MinY,
-                                    boundingBox.MaxX,boundingBox.MaxY))   {
-                std::cout << "Info: Failed Bounding Box Test,ignoring poly" << std::endl;
-                linesProcessed++;
-                delete inputGeometry;
-                continue;
+        for(size_t i=0; i < listParsed.size(); i++)   {
+            if(listParsedOk[i])   {
+                listShapes.push_back(std::move(listParsed[i]));
             }
-
-            delete inputGeometry;
-
-            // gridify geometry (ClipperLib)
-            unsigned int cellCount = 1;
-            unsigned int numCells = ((MAXLAT-MINLAT)/LATSTEP) * ((MAXLON-MINLON)/LONSTEP);
-            for(int i=0; i < (MAXLAT-MINLAT)/LATSTEP; i++)   {
-                for(int j=0; j < (MAXLON-MINLON)/LONSTEP; j++)   {
-
-                    int btm = i*LATSTEP + MINLAT;
-                    int top = btm + LATSTEP;
-                    int left = j*LONSTEP + MINLON;
-                    int right = left+LONSTEP;
-
-                    std::cout << "Line: " << linesProcessed << "/" << numInputLines
-                              << "   Current Grid Cell: " << cellCount
-                              << "/" << numCells << ", (" << numOuterRingPts
-                              << " outer ring points)\n";
-                    cellCount++;
-
-                    // only do a full intersection if the bounding boxes of
-                    // the grid extents and geometry in question overlap
-//                    if(!calcAreaRectOverlap(left,btm,right,top,
-//                                            boundingBox.MinX,boundingBox.MinY,
-//                                            boundingBox.MaxX,boundingBox.MaxY))   {
-////                        std::cout << "-> Failed Bounding Box Test,ignoring cell" << std::endl;
-//                        continue;
-//                    }
-
-                    ClipperLib::Polygon gridCell;
-                    gridCell.push_back(ClipperLib::IntPoint(ClipperLib::long64(left*DBLMT),
-                                                            ClipperLib::long64(top*DBLMT)));
-
-                    gridCell.push_back(ClipperLib::IntPoint(ClipperLib::long64(left*DBLMT),
-                                                            ClipperLib::long64(btm*DBLMT)));
-
-                    gridCell.push_back(ClipperLib::IntPoint(ClipperLib::long64(right*DBLMT),
-                                                            ClipperLib::long64(btm*DBLMT)));
-
-                    gridCell.push_back(ClipperLib::IntPoint(ClipperLib::long64(right*DBLMT),
-                                                            ClipperLib::long64(top*DBLMT)));
-
-                    ClipperLib::Clipper clipperObj;
-                    clipperObj.AddPolygons(inputPolys,ClipperLib::ptSubject);
-                    clipperObj.AddPolygon(gridCell,ClipperLib::ptClip);
-
-                    ClipperLib::ExPolygons xsecPolys;
-                    if(clipperObj.Execute(ClipperLib::ctIntersection,xsecPolys) && (xsecPolys.size() > 0))   {
-                        // save
-//                        std::cout << "      Num Intersecting Polys w/ Cell: " << xsecPolys.size() << "\n";
-                        for(int x=0; x < xsecPolys.size(); x++)   {
-                            OGRPolygon savePolygon;
-                            ClipperLib::ExPolygon const &xsecPoly = xsecPolys[x];
-
-                            // outer
-                            OGRLinearRing outerRing;
-                            for(int y=0; y < xsecPoly.outer.size(); y++)   {
-                                outerRing.addPoint(double(xsecPoly.outer[y].X)/DBLMT,
-                                                   double(xsecPoly.outer[y].Y)/DBLMT);
-                            }
-                            outerRing.addPoint(double(xsecPoly.outer[0].X)/DBLMT,
-                                               double(xsecPoly.outer[0].Y)/DBLMT);
-                            savePolygon.addRing(&outerRing);
-
-                            // inner
-                            for(int y=0; y < xsecPoly.holes.size(); y++)   {
-                                OGRLinearRing innerRing;
-                                for(int z=0; z < xsecPoly.holes[y].size(); z++)   {
-                                    innerRing.addPoint(double(xsecPoly.holes[y][z].X)/DBLMT,
-                                                       double(xsecPoly.holes[y][z].Y)/DBLMT);
-                                }
-                                innerRing.addPoint(double(xsecPoly.holes[y][0].X)/DBLMT,
-                                                   double(xsecPoly.holes[y][0].Y)/DBLMT);
-                                savePolygon.addRing(&innerRing);
-                            }
-
-                            // save as wkt
-                            char *outputWKT;
-                            savePolygon.exportToWkt(&outputWKT);
-
-                            if(j==0)   {
-                                outputWktFileWEST << outputWKT << std::endl;
-                            }
-                            else   {
-                                outputWktFileEAST << outputWKT << std::endl;
-                            }
-
-                            delete[] outputWKT;
-
-                        }
-                    }
-                }
+            else   {
+                numSkipped++;
             }
-
-            linesProcessed++;
-            std::cout << "ptk_gridify_wkt: Lines Processed: "
-                      << linesProcessed << "/" << numInputLines <<std::endl;
         }
-        inputWktFile.close();
-        outputWktFileWEST.close();
-        outputWktFileEAST.close();
     }
+    reader.Close();
+    std::vector<QuadShape>().swap(listParsed);
+    std::vector<char>().swap(listParsedOk);
+    listShapes.shrink_to_fit();
+
+    std::cout << "ptk_gridify_wkt: Parsed " << listShapes.size()
+              << " polygons (skipped " << numSkipped << ")\n";
+
+    // index the polygon bounding boxes
+    std::vector<ShapeRTree::Box> listBoxes(listShapes.size());
+    for(size_t i=0; i < listShapes.size(); i++)   {
+        listBoxes[i].min_x = listShapes[i].minX;
+        listBoxes[i].min_y = listShapes[i].minY;
+        listBoxes[i].max_x = listShapes[i].maxX;
+        listBoxes[i].max_y = listShapes[i].maxY;
+    }
+    ShapeRTree rtree;
+    rtree.Build(listBoxes);
+    std::vector<ShapeRTree::Box>().swap(listBoxes);
+
+    // clip and write every cell
+    std::vector<GridCell> const listCells =
+            BuildGrid(gridExtents,lonStep,latStep);
+
+    std::cout << "ptk_gridify_wkt: Gridifying " << listCells.size()
+              << " cells\n";
+
+    std::atomic<size_t> numCellsWritten(0);
+    std::atomic<size_t> numPolysWritten(0);
+    std::atomic<size_t> numCellsFailed(0);
+    std::mutex coutMutex;
+    scratch::ParallelFor(threadPool,0,listCells.size(),[&](size_t i) {
+        std::string cellPath;
+        size_t numPolys;
+        if(!GridifyCell(listCells[i],listShapes,rtree,
+                        outputPrefix,outputFormat,
+                        cellPath,numPolys))   {
+            numCellsFailed++;
+            std::lock_guard<std::mutex> lock(coutMutex);
+            std::cout << "ptk_gridify_wkt: Could not write " << cellPath << "\n";
+        }
+        else if(numPolys > 0)   {
+            numCellsWritten++;
+            numPolysWritten += numPolys;
+        }
+    },1);
+
+    std::cout << "ptk_gridify_wkt: Wrote " << numPolysWritten
+              << " polygons to " << numCellsWritten << " cells\n";
+    if(numCellsFailed > 0)   {
+        std::cout << "ptk_gridify_wkt: " << numCellsFailed
+                  << " cells could not be written\n";
+        return -1;
+    }
+
     EndTiming();
 
     return 0;
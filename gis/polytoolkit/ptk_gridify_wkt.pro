@@ -1,12 +1,33 @@
 TEMPLATE = app
 CONFIG += console debug
 CONFIG -= qt
-HEADERS += clipper/clipper.hpp
+HEADERS += clipper/clipper.hpp \
+           PolyBin.hpp \
+           ptk_quadify.hpp
 SOURCES += ptk_gridify_wkt.cpp \
            clipper/clipper.cpp
 TARGET = ptk_gridify_wkt
 
+# threadpool
+PATH_THREADPOOL = $$PWD/../../utils/threadpool
+INCLUDEPATH += $${PATH_THREADPOOL}
+HEADERS += \
+    $${PATH_THREADPOOL}/ThreadPool.h \
+    $${PATH_THREADPOOL}/Parallel.h
+SOURCES += \
+    $${PATH_THREADPOOL}/Job.cpp \
+    $${PATH_THREADPOOL}/ThreadPool.cpp \
+    $${PATH_THREADPOOL}/ThreadPoolStats.cpp
+
+# rtree
+PATH_RTREE = $$PWD/../../utils/rtree
+INCLUDEPATH += $${PATH_RTREE}
+HEADERS += $${PATH_RTREE}/PackedRTree.h
+
 # required libs
 LIBS += -lgdal -lCGAL_Core -lCGAL -lmpfr -lgmp -lboost_thread
 
-QMAKE_CXXFLAGS += -std=c++0x
+# need these flags for gcc 4.8.x bug for threads
+QMAKE_LFLAGS += -Wl,--no-as-needed
+LIBS += -lpthread
+QMAKE_CXXFLAGS += -std=c++11
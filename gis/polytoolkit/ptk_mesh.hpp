@@ -0,0 +1,274 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PTK_MESH_HPP
+#define PTK_MESH_HPP
+
+// Triangulation of PolyFeatures into a mesh and saving
+// it as OpenCTM, shared by ptk_wkt_to_ctm and ptk_pipeline
+
+// STL
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+
+// OGR
+#include <ogrsf_frmts.h>
+
+// openctm
+#include "openctm/openctm.h"
+
+#include "Vec2.hpp"
+#include "Vec3.hpp"
+#include "PolyBin.hpp"
+#include "ptk_prepair.hpp"
+
+struct Tri
+{
+    Vec2 A;
+    Vec2 B;
+    Vec2 C;
+
+    double len_a;
+    double len_b;
+    double len_c;
+};
+
+struct TriangleMesh
+{
+    std::vector<Vec3> listVertices;
+    std::vector<unsigned int> listIdxs;
+};
+
+inline int calcCrossingNumber(Vec2 P,std::vector<Vec2> V)
+{
+    // Copyright 2001, softSurfer (www.softsurfer.com)
+    // This code may be freely used and modified for any purpose
+    // providing that this copyright notice is included with it.
+    // SoftSurfer makes no warranty for this code, and cannot be held
+    // liable for any real or imagined damage resulting from its use.
+    // Users of this code must verify correctness for their application.
+    int    cn = 0;    // the crossing number counter
+
+    // loop through all edges of the polygon
+    for (int i=0; i<V.size()-1; i++) {    // edge from V[i] to V[i+1]
+       if (((V[i].y <= P.y) && (V[i+1].y > P.y))    // an upward crossing
+        || ((V[i].y > P.y) && (V[i+1].y <= P.y))) { // a downward crossing
+            // compute the actual edge-ray intersect x-coordinate
+            float vt = (float)(P.y - V[i].y) / (V[i+1].y - V[i].y);
+            if (P.x < V[i].x + vt * (V[i+1].x - V[i].x)) // P.x < intersect
+                ++cn;   // a valid crossing of y=P.y right of P.x
+        }
+    }
+    return (cn&1);    // 0 if even (out), and 1 if odd (in)
+}
+
+inline bool TriangulatePolyFeature(PolyFeature const &feature,
+                                   TriangleMesh &triMesh)
+{
+    // * the feature is repaired with a constrained delaunay
+    //   triangulation, and the triangles whose incenters are
+    //   inside the repaired polygons are appended to triMesh
+    // * vertices aren't shared between triangles, see
+    //   VertexWelder to clean them up
+    OGRGeometry *inputGeometry = PolyFeatureToOGR(feature);
+
+    // process / fix geometry
+    Triangulation myTriangulation;
+    OGRMultiPolygon* outputPolygons = repair(inputGeometry,myTriangulation);
+
+    // get list of cdt triangles
+    std::vector<Tri> listCDTTriangles;
+    std::vector<bool> listTrisToKeep;
+    Triangulation::Finite_faces_iterator fIt;
+    for(fIt = myTriangulation.finite_faces_begin();
+        fIt != myTriangulation.finite_faces_end(); ++fIt)
+    {
+        Triangulation::Triangle cdtTri = myTriangulation.triangle(fIt);
+
+        Tri myTri;
+        myTri.A.x = cdtTri[0].x();
+        myTri.A.y = cdtTri[0].y();
+
+        myTri.B.x = cdtTri[1].x();
+        myTri.B.y = cdtTri[1].y();
+
+        myTri.C.x = cdtTri[2].x();
+        myTri.C.y = cdtTri[2].y();
+
+        myTri.len_a = sqrt( pow(myTri.C.x-myTri.B.x,2) + pow(myTri.C.y-myTri.B.y,2));
+        myTri.len_b = sqrt( pow(myTri.C.x-myTri.A.x,2) + pow(myTri.C.y-myTri.A.y,2));
+        myTri.len_c = sqrt( pow(myTri.A.x-myTri.B.x,2) + pow(myTri.A.y-myTri.B.y,2));
+
+        listCDTTriangles.push_back(myTri);
+        listTrisToKeep.push_back(false);
+    }
+
+    if(outputPolygons == NULL)
+    {
+        delete inputGeometry;
+        return false;
+    }
+
+    // discard triangles using the repaired multipolygon as a ref
+    for(int i=0; i < outputPolygons->getNumGeometries(); i++)
+    {
+        OGRGeometry *polyGeometry = outputPolygons->getGeometryRef(i);
+        OGRPolygon *singlePoly = (OGRPolygon*)polyGeometry;
+
+        // filter triangles outside of outer ring
+        OGRLinearRing* outerRing = singlePoly->getExteriorRing();
+        std::vector<Vec2> listOuterRingPts(outerRing->getNumPoints());
+        for(int j=0; j < listOuterRingPts.size(); j++)   {
+            OGRPoint *myPt = new OGRPoint; outerRing->getPoint(j,myPt);
+            listOuterRingPts[j] = Vec2(myPt->getX(),myPt->getY());
+            delete myPt;
+        }
+
+        std::vector<Tri>::iterator triIt;
+        for(triIt = listCDTTriangles.begin();
+            triIt != listCDTTriangles.end(); ++triIt)
+        {
+            // create triangle incenter
+            Vec2 inCenter;
+            inCenter.x = ((triIt->len_a*triIt->A.x + triIt->len_b*triIt->B.x + triIt->len_c*triIt->C.x) /
+                          (triIt->len_a+triIt->len_b+triIt->len_c));
+
+            inCenter.y = ((triIt->len_a*triIt->A.y + triIt->len_b*triIt->B.y + triIt->len_c*triIt->C.y) /
+                          (triIt->len_a+triIt->len_b+triIt->len_c));
+
+            int crossingNum = calcCrossingNumber(inCenter,listOuterRingPts);
+
+            // we want to keep all triangles within outer rings
+            if(crossingNum != 0)    // if cross num != 0, point is in poly
+            {   listTrisToKeep[triIt-listCDTTriangles.begin()] = true;   }
+        }
+
+        // filter triangles inside inner rings
+        for(int j=0; j < singlePoly->getNumInteriorRings(); j++)
+        {
+            OGRLinearRing* innerRing = singlePoly->getInteriorRing(j);
+            std::vector<Vec2> listInnerRingPts(innerRing->getNumPoints());
+            for(int k=0; k < listInnerRingPts.size(); k++)   {
+                OGRPoint *myPt = new OGRPoint; innerRing->getPoint(k,myPt);
+                listInnerRingPts[k] = Vec2(myPt->getX(),myPt->getY());
+                delete myPt;
+            }
+
+            for(triIt = listCDTTriangles.begin();
+                triIt != listCDTTriangles.end(); ++triIt)
+            {
+                if(listTrisToKeep[triIt-listCDTTriangles.begin()] == true)
+                {
+                    // create triangle incenter
+                    Vec2 inCenter;
+                    inCenter.x = ((triIt->len_a*triIt->A.x + triIt->len_b*triIt->B.x + triIt->len_c*triIt->C.x) /
+                                  (triIt->len_a+triIt->len_b+triIt->len_c));
+
+                    inCenter.y = ((triIt->len_a*triIt->A.y + triIt->len_b*triIt->B.y + triIt->len_c*triIt->C.y) /
+                                  (triIt->len_a+triIt->len_b+triIt->len_c));
+
+                    int crossingNum = calcCrossingNumber(inCenter,listInnerRingPts);
+
+                    // we want to remove all triangles within inner rings
+                    if(crossingNum != 0)    // if cross num != 0, point is in poly
+                    {   listTrisToKeep[triIt-listCDTTriangles.begin()] = false;   }
+                }
+            }
+        }
+
+        // save triangles
+        for(triIt = listCDTTriangles.begin();
+            triIt != listCDTTriangles.end(); ++triIt)
+        {
+            if(listTrisToKeep[triIt-listCDTTriangles.begin()])
+            {
+                Vec3 pt0(triIt->A.x,triIt->A.y,0);
+                Vec3 pt1(triIt->B.x,triIt->B.y,0);
+                Vec3 pt2(triIt->C.x,triIt->C.y,0);
+
+                triMesh.listVertices.push_back(pt0);
+                triMesh.listIdxs.push_back(triMesh.listVertices.size()-1);
+
+                triMesh.listVertices.push_back(pt1);
+                triMesh.listIdxs.push_back(triMesh.listVertices.size()-1);
+
+                triMesh.listVertices.push_back(pt2);
+                triMesh.listIdxs.push_back(triMesh.listVertices.size()-1);
+            }
+        }
+    }
+
+    delete inputGeometry;
+    delete outputPolygons;
+    return true;
+}
+
+// returns false if OpenCTM reported an error
+inline bool SaveMeshCTM(TriangleMesh const &triMesh,
+                        std::string const &path)
+{
+    // write CTM file
+    CTMcontext context;
+    CTMuint vertCount, triCount, *indices;
+    CTMfloat *vertices;
+
+    // create context
+    context = ctmNewContext(CTM_EXPORT);
+    if(context == NULL)   {
+        return false;
+    }
+    ctmCompressionMethod(context,CTM_METHOD_MG1);
+    ctmCompressionLevel(context,5);
+
+    // create mesh in memory
+    vertCount = triMesh.listVertices.size();
+    triCount = triMesh.listIdxs.size()/3;
+    vertices = (CTMfloat *) malloc(3 * sizeof(CTMfloat) * vertCount);
+    indices = (CTMuint *) malloc(3 * sizeof(CTMuint) * triCount);
+
+    // build mesh
+    unsigned int vIdx=0;
+    for(int i=0; i < vertCount; i++)   {
+        vertices[vIdx] = triMesh.listVertices[i].x; vIdx++;
+        vertices[vIdx] = triMesh.listVertices[i].y; vIdx++;
+        vertices[vIdx] = triMesh.listVertices[i].z; vIdx++;
+    }
+
+    for(int i=0; i < triCount*3; i++)   {
+        indices[i] = triMesh.listIdxs[i];
+    }
+
+    // define mesh
+    ctmDefineMesh(context,vertices,vertCount,indices,triCount,NULL);
+    bool ok = (ctmGetError(context) == CTM_NONE);
+
+    // save
+    if(ok)   {
+        ctmSave(context,path.c_str());
+        ok = (ctmGetError(context) == CTM_NONE);
+    }
+
+    // free context/mesh
+    ctmFreeContext(context);
+    free(indices);
+    free(vertices);
+
+    return ok;
+}
+
+#endif // PTK_MESH_HPP
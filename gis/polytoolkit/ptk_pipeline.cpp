@@ -0,0 +1,1081 @@
+// STL
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <sys/time.h>
+
+// OGR
+#include <ogrsf_frmts.h>
+#include <ogr_spatialref.h>
+
+// threadpool
+#include <ThreadPool.h>
+#include <Parallel.h>
+
+// vertexweld
+#include <VertexWelder.h>
+
+// geodesy
+#include <Geodesy.h>
+
+#include "PolyBin.hpp"
+#include "ptk_prepair.hpp"
+#include "ptk_simplify.hpp"
+#include "ptk_quadify.hpp"
+#include "ptk_mesh.hpp"
+
+// vertices closer than this (on every axis) are welded
+#define WELD_EPS 1E-9
+
+// tile files kept open at once while writing
+#define MAX_OPEN_TILES 64
+
+// timing vars
+timeval t1,t2;
+std::string timingDesc;
+
+void StartTiming(std::string const &desc)
+{
+    timingDesc = desc;
+    gettimeofday(&t1,NULL);
+}
+
+void EndTiming()
+{
+    gettimeofday(&t2,NULL);
+    double timeTaken = 0;
+    timeTaken += (t2.tv_sec - t1.tv_sec) * 1000.0 * 1000.0;
+    timeTaken += (t2.tv_usec - t1.tv_usec);
+    std::cout << "INFO: " << timingDesc << ": \t\t"
+              << timeTaken/1000 << " milliseconds" << std::endl;
+}
+
+double StringToNumber ( const std::string &Text )
+{
+    std::stringstream ss(Text);
+    double result;
+    return ss >> result ? result : 0;
+}
+
+// ============================================================= //
+
+// The pipeline runs the repair, simplify, xform, quadify
+// and mesh steps of a build in one process
+// * each enabled stage runs on its own thread, and takes
+//   batches of features from the stage before it through
+//   a bounded queue, so the whole input never has to be
+//   in memory or on disk between stages
+// * a stage processes each batch in parallel on a shared
+//   thread pool; results are kept in input order so the
+//   output is the same from run to run
+// * the stages do the same thing as the standalone tools
+//   with the settings from the config file
+
+struct PipelineConfig
+{
+    PipelineConfig() :
+        format(POLY_FORMAT_PBIN),
+        repair(true),
+        simplify(true),
+        simplifyArea(4000),
+        xform(true),
+        xformSourceEPSG(3785),
+        xformTargetEPSG(4326),
+        tile(false),
+        tileLevels(0),
+        mesh(false),
+        batchSize(4096),
+        queueSize(4)
+    {
+        tileExtents.minLon = -180;
+        tileExtents.maxLon = 180;
+        tileExtents.minLat = -90;
+        tileExtents.maxLat = 90;
+    }
+
+    std::string input;
+    std::string output;         // path prefix for output files
+    PolyFormat format;
+
+    bool repair;
+
+    bool simplify;
+    double simplifyArea;
+
+    bool xform;
+    int xformSourceEPSG;
+    int xformTargetEPSG;
+
+    bool tile;
+    unsigned int tileLevels;
+    BoundingBox tileExtents;
+
+    bool mesh;
+
+    size_t batchSize;           // features per batch
+    size_t queueSize;           // batches between stages
+};
+
+bool ReadPipelineConfig(std::string const &path,
+                        PipelineConfig &config)
+{
+    // 'key = value' per line, # starts a comment
+    std::ifstream configFile(path.c_str());
+    if(!configFile.is_open())   {
+        std::cout << "ptk_pipeline: Could not open config " << path << "\n";
+        return false;
+    }
+
+    size_t lineNumber = 0;
+    std::string line;
+    while(std::getline(configFile,line))
+    {
+        lineNumber++;
+        line = line.substr(0,line.find('#'));
+        size_t eqPos = line.find('=');
+        if(eqPos == std::string::npos)   {
+            if(line.find_first_not_of(" \t\r") != std::string::npos)   {
+                std::cout << "ptk_pipeline: Config line "
+                          << lineNumber << " has no '='\n";
+                return false;
+            }
+            continue;
+        }
+
+        std::string key,value;
+        std::stringstream(line.substr(0,eqPos)) >> key;
+        value = line.substr(eqPos+1);
+        size_t const valueBegin = value.find_first_not_of(" \t");
+        size_t const valueEnd = value.find_last_not_of(" \t\r");
+        value = (valueBegin == std::string::npos) ? "" :
+                value.substr(valueBegin,valueEnd-valueBegin+1);
+
+        if(key == "input")   {
+            config.input = value;
+        }
+        else if(key == "output")   {
+            config.output = value;
+        }
+        else if(key == "format")   {
+            if(value == "pbin")   {
+                config.format = POLY_FORMAT_PBIN;
+            }
+            else if(value == "wkt")   {
+                config.format = POLY_FORMAT_WKT;
+            }
+            else   {
+                std::cout << "ptk_pipeline: format should be pbin or wkt\n";
+                return false;
+            }
+        }
+        else if(key == "repair")   {
+            config.repair = (StringToNumber(value) != 0);
+        }
+        else if(key == "simplify")   {
+            config.simplify = (StringToNumber(value) != 0);
+        }
+        else if(key == "simplify_area")   {
+            config.simplifyArea = StringToNumber(value);
+        }
+        else if(key == "xform")   {
+            config.xform = (StringToNumber(value) != 0);
+        }
+        else if(key == "xform_source_epsg")   {
+            config.xformSourceEPSG = int(StringToNumber(value));
+        }
+        else if(key == "xform_target_epsg")   {
+            config.xformTargetEPSG = int(StringToNumber(value));
+        }
+        else if(key == "tile")   {
+            config.tile = (StringToNumber(value) != 0);
+        }
+        else if(key == "tile_levels")   {
+            config.tileLevels = (unsigned int)(StringToNumber(value));
+        }
+        else if(key == "tile_extents")   {
+            // MINLON MAXLON MINLAT MAXLAT
+            std::stringstream ss(value);
+            BoundingBox &extents = config.tileExtents;
+            if(!(ss >> extents.minLon >> extents.maxLon >>
+                 extents.minLat >> extents.maxLat))   {
+                std::cout << "ptk_pipeline: tile_extents should be "
+                             "MINLON MAXLON MINLAT MAXLAT\n";
+                return false;
+            }
+        }
+        else if(key == "mesh")   {
+            config.mesh = (StringToNumber(value) != 0);
+        }
+        else if(key == "batch_size")   {
+            config.batchSize = std::max<size_t>(1,size_t(StringToNumber(value)));
+        }
+        else if(key == "queue_size")   {
+            config.queueSize = std::max<size_t>(1,size_t(StringToNumber(value)));
+        }
+        else   {
+            std::cout << "ptk_pipeline: Unknown config key " << key << "\n";
+            return false;
+        }
+    }
+
+    if(config.input.empty() || config.output.empty())   {
+        std::cout << "ptk_pipeline: Config needs an input and an output\n";
+        return false;
+    }
+    return true;
+}
+
+// ============================================================= //
+
+// BoundedQueue
+// * Push blocks while the queue is full and Pop blocks
+//   while it's empty, so a fast stage can only get
+//   queueSize batches ahead of the one after it
+// * Close is called by the producer when it's done;
+//   Pop returns false once the queue is closed and empty
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) :
+        m_capacity(std::max<size_t>(1,capacity)),
+        m_closed(false)
+    {}
+
+    void Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock,[this]() {
+            return (m_queue.size() < m_capacity);
+        });
+        m_queue.push_back(std::move(item));
+        m_notEmpty.notify_one();
+    }
+
+    bool Pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock,[this]() {
+            return (m_closed || !m_queue.empty());
+        });
+        if(m_queue.empty())   {
+            return false;
+        }
+        item = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+    }
+
+private:
+    size_t const m_capacity;
+    bool m_closed;
+    std::deque<T> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
+
+struct PipelineItem
+{
+    std::string quadKey;        // empty until tiled
+    PolyFeature feature;
+    TriangleMesh mesh;          // set by the mesh stage
+};
+
+typedef std::vector<PipelineItem> PipelineBatch;
+typedef BoundedQueue<PipelineBatch> PipelineQueue;
+
+// What a stage makes of one item: any number of
+// items for the next stage, or an error
+struct StageResult
+{
+    std::vector<PipelineItem> listItems;
+    std::string error;
+};
+
+// A stage's process function is given a range of items
+// of a batch, and fills in the result for each of them
+typedef std::function<void(PipelineItem *listItems,
+                           StageResult *listResults,
+                           size_t count)> StageFn;
+
+struct PipelineStage
+{
+    std::string name;
+    StageFn process;
+    PipelineQueue *input;
+    PipelineQueue *output;
+
+    size_t countIn;
+    size_t countOut;
+    size_t countErrors;
+};
+
+std::mutex coutMutex;
+
+void RunStage(PipelineStage &stage, scratch::ThreadPool &threadPool)
+{
+    size_t const numThreads = threadPool.GetThreadCount();
+
+    PipelineBatch batch;
+    std::vector<StageResult> listResults;
+    while(stage.input->Pop(batch))
+    {
+        listResults.resize(batch.size());
+        scratch::ParallelForRange(
+                    threadPool,0,batch.size(),
+                    [&](size_t rangeBegin, size_t rangeEnd) {
+            for(size_t i=rangeBegin; i < rangeEnd; i++)   {
+                listResults[i].listItems.clear();
+                listResults[i].error.clear();
+            }
+            stage.process(&batch[rangeBegin],&listResults[rangeBegin],
+                          rangeEnd-rangeBegin);
+        },std::max<size_t>(1,batch.size()/(numThreads*8)));
+
+        // pass results on in input order
+        PipelineBatch outputBatch;
+        for(size_t i=0; i < listResults.size(); i++)   {
+            StageResult &result = listResults[i];
+            for(size_t j=0; j < result.listItems.size(); j++)   {
+                outputBatch.push_back(std::move(result.listItems[j]));
+            }
+            if(!result.error.empty())   {
+                std::lock_guard<std::mutex> lock(coutMutex);
+                std::cout << stage.name << ": " << result.error << std::endl;
+                stage.countErrors++;
+            }
+        }
+
+        stage.countIn += batch.size();
+        stage.countOut += outputBatch.size();
+        if(!outputBatch.empty())   {
+            stage.output->Push(std::move(outputBatch));
+        }
+    }
+    stage.output->Close();
+}
+
+// ============================================================= //
+
+void RepairItems(PipelineItem *listItems,
+                 StageResult *listResults,
+                 size_t count)
+{
+    // same as ptk_repair_wkt: every repaired
+    // polygon becomes its own POLYGON()
+    static thread_local RepairScratch repairScratch;
+    static thread_local PolyFeature repairedFeature;
+    for(size_t i=0; i < count; i++)   {
+        PolyFeature const &feature = listItems[i].feature;
+        if(feature.GetNumParts() != 1)   {
+            listResults[i].error = "Could not repair geometry, "
+                                   "WKT type is not a POLYGON()";
+            continue;
+        }
+
+        if(!repairPolyFeature(feature,repairedFeature,repairScratch))   {
+            listResults[i].error = "Could not repair geometry, "
+                                   "input points are collinear (no area)";
+            continue;
+        }
+
+        size_t const numDroppedRings = repairScratch.buffers.numDroppedRings;
+        if(numDroppedRings > 0)   {
+            listResults[i].error = "Dropped " + std::to_string(numDroppedRings) +
+                                   " ring(s) with no enclosing outer ring";
+        }
+
+        std::vector<PipelineItem> &listOutput = listResults[i].listItems;
+        listOutput.resize(repairedFeature.GetNumParts());
+        for(size_t j=0; j < repairedFeature.GetNumParts(); j++)   {
+            CopyPolyFeaturePart(repairedFeature,j,listOutput[j].feature);
+        }
+    }
+}
+
+void SimplifyItems(double vwArea,
+                   PipelineItem *listItems,
+                   StageResult *listResults,
+                   size_t count)
+{
+    static thread_local VWScratch vwScratch;
+    for(size_t i=0; i < count; i++)   {
+        listResults[i].listItems.resize(1);
+        PipelineItem &output = listResults[i].listItems[0];
+        output.quadKey.swap(listItems[i].quadKey);
+        simplifyFeatureWithVW(listItems[i].feature,vwArea,
+                              output.feature,vwScratch);
+    }
+}
+
+// spherical (web) mercator to WGS84 lon/lat is closed
+// form (see Geodesy.h) and doesn't need OGR
+bool IsMercatorToWGS84(int sourceEPSG, int targetEPSG)
+{
+    return (sourceEPSG == 3785 || sourceEPSG == 3857 || sourceEPSG == 900913) &&
+           (targetEPSG == 4326);
+}
+
+// coordXform is NULL for mercator -> WGS84
+void XformItems(OGRCoordinateTransformation * coordXform,
+                PipelineItem *listItems,
+                StageResult *listResults,
+                size_t count)
+{
+    // transform every point of a feature in one call
+    std::vector<double> listX;
+    std::vector<double> listY;
+    for(size_t i=0; i < count; i++)   {
+        PolyFeature &feature = listItems[i].feature;
+        size_t const numPoints = feature.GetNumPoints();
+        listX.resize(numPoints);
+        listY.resize(numPoints);
+        for(size_t j=0; j < numPoints; j++)   {
+            listX[j] = feature.listXY[j*2];
+            listY[j] = feature.listXY[j*2+1];
+        }
+
+        if(coordXform == NULL)   {
+            scratch::geodesy::ConvMercatorToLLA(numPoints,listX.data(),listY.data(),
+                                                listX.data(),listY.data());
+        }
+        else if(numPoints > 0 && !coordXform->Transform(numPoints,listX.data(),listY.data()))   {
+            listResults[i].error = "Could not xform geometry";
+            continue;
+        }
+
+        for(size_t j=0; j < numPoints; j++)   {
+            feature.listXY[j*2] = listX[j];
+            feature.listXY[j*2+1] = listY[j];
+        }
+        feature.CalcBounds();
+        listResults[i].listItems.push_back(std::move(listItems[i]));
+    }
+}
+
+void TileItems(BoundingBox const &rootExtents,
+               unsigned int numLevels,
+               PipelineItem *listItems,
+               StageResult *listResults,
+               size_t count)
+{
+    // each feature is split on its own, which gives
+    // the same tiles as ptk_quadify_wkt --mem since
+    // shapes are clipped one at a time there too
+    std::vector<QuadTile> listLeaves;
+    for(size_t i=0; i < count; i++)   {
+        QuadTile root;
+        root.extents = rootExtents;
+        root.listShapes.resize(1);
+        if(!ParseQuadShape(listItems[i].feature,root.listShapes[0]))   {
+            listResults[i].error = "Could not clip geometry, "
+                                   "WKT type is not a POLYGON()";
+            continue;
+        }
+
+        listLeaves.clear();
+        SplitQuadTileToLeaves(root,numLevels,listLeaves);
+
+        std::vector<PipelineItem> &listOutput = listResults[i].listItems;
+        for(size_t j=0; j < listLeaves.size(); j++)   {
+            QuadTile const &leaf = listLeaves[j];
+            for(size_t k=0; k < leaf.listShapes.size(); k++)   {
+                listOutput.push_back(PipelineItem());
+                listOutput.back().quadKey = leaf.quadKey;
+                QuadShapeToPolyFeature(leaf.listShapes[k],listOutput.back().feature);
+            }
+        }
+    }
+}
+
+void MeshItems(PipelineItem *listItems,
+               StageResult *listResults,
+               size_t count)
+{
+    for(size_t i=0; i < count; i++)   {
+        PipelineItem &item = listItems[i];
+        item.mesh.listVertices.clear();
+        item.mesh.listIdxs.clear();
+        if(!TriangulatePolyFeature(item.feature,item.mesh))   {
+            listResults[i].error = "Could not triangulate geometry, "
+                                   "input points are collinear (no area)";
+            continue;
+        }
+        item.feature.Clear();
+        listResults[i].listItems.push_back(std::move(item));
+    }
+}
+
+// ============================================================= //
+
+// Mesh output for one tile, built by MeshSpill::Load
+// once the input is done; triangles are welded a chunk
+// at a time as they're read back from the spill file
+struct MeshTile
+{
+    MeshTile() :
+        vxWelder(WELD_EPS)
+    {}
+
+    scratch::VertexWelder vxWelder;
+    TriangleMesh triMesh;
+};
+
+void AddToMeshTile(TriangleMesh const &mesh, MeshTile &meshTile)
+{
+    TriangleMesh &triMesh = meshTile.triMesh;
+    for(size_t i=0; i < mesh.listIdxs.size(); i++)   {
+        Vec3 const &vx = mesh.listVertices[mesh.listIdxs[i]];
+        bool isNew;
+        triMesh.listIdxs.push_back(meshTile.vxWelder.Weld(vx.x,vx.y,vx.z,&isNew));
+        if(isNew)   {
+            triMesh.listVertices.push_back(vx);
+        }
+    }
+}
+
+// MeshSpill
+// * a mesh tile can't be saved until every feature in it
+//   has been meshed, so its triangles go to a temp file as
+//   they arrive (three vertices each, unwelded) and the
+//   tile is only built with Load once the input is done
+// * has the same Suspend/Resume as PolyWriter so it can
+//   be kept in a TileOutputCache
+class MeshSpill
+{
+public:
+    MeshSpill() :
+        m_suspended(false),
+        m_failed(false)
+    {}
+
+    ~MeshSpill()
+    {
+        m_file.close();
+        if(!m_path.empty())   {
+            std::remove(m_path.c_str());
+        }
+    }
+
+    bool Open(std::string const &path)
+    {
+        m_path = path;
+        m_file.open(path.c_str(),std::ios::out | std::ios::binary | std::ios::trunc);
+        return m_file.is_open();
+    }
+
+    std::string const & GetPath() const
+    {
+        return m_path;
+    }
+
+    // false if the triangles couldn't be written
+    bool Write(TriangleMesh const &mesh)
+    {
+        for(size_t i=0; i < mesh.listIdxs.size(); i++)   {
+            Vec3 const &vx = mesh.listVertices[mesh.listIdxs[i]];
+            double const xyz[3] = { vx.x, vx.y, vx.z };
+            m_file.write(reinterpret_cast<char const*>(xyz),sizeof(xyz));
+        }
+        return m_file.good();
+    }
+
+    void Suspend()
+    {
+        if(!m_file.is_open())   {
+            return;
+        }
+        m_failed = m_failed || !m_file.good();
+        m_file.close();
+        m_suspended = true;
+    }
+
+    bool Resume()
+    {
+        if(!m_suspended)   {
+            return m_file.is_open();
+        }
+        m_file.clear();
+        m_file.open(m_path.c_str(),std::ios::out | std::ios::binary | std::ios::app);
+        if(!m_file.is_open())   {
+            return false;
+        }
+        m_suspended = false;
+        return true;
+    }
+
+    // false if the triangles couldn't all be
+    // written or read back
+    bool Load(MeshTile &meshTile)
+    {
+        m_failed = m_failed || (m_file.is_open() && !m_file.good());
+        m_file.close();
+        m_suspended = false;
+
+        std::ifstream file(m_path.c_str(),std::ios::in | std::ios::binary);
+        if(m_failed || !file.is_open())   {
+            return false;
+        }
+
+        // a chunk of triangles at a time
+        size_t const k_chunk_vertices = 3*4096;
+        std::vector<double> listXYZ(k_chunk_vertices*3);
+        TriangleMesh chunk;
+        while(file)   {
+            file.read(reinterpret_cast<char*>(listXYZ.data()),
+                      listXYZ.size()*sizeof(double));
+            size_t const numVertices = file.gcount()/(3*sizeof(double));
+            chunk.listVertices.resize(numVertices);
+            chunk.listIdxs.resize(numVertices);
+            for(size_t i=0; i < numVertices; i++)   {
+                chunk.listVertices[i] = Vec3(listXYZ[i*3],listXYZ[i*3+1],listXYZ[i*3+2]);
+                chunk.listIdxs[i] = i;
+            }
+            AddToMeshTile(chunk,meshTile);
+        }
+        return !file.bad();
+    }
+
+private:
+    std::string m_path;
+    std::ofstream m_file;
+    bool m_suspended;
+    bool m_failed;
+};
+
+// TileOutputCache
+// * an output (PolyWriter or MeshSpill) per tile, with at
+//   most maxOpen of their files open at once; the least
+//   recently used one is suspended to make room when a
+//   suspended or new one is needed
+template<typename Output>
+class TileOutputCache
+{
+public:
+    typedef std::function<bool(Output &output,
+                               std::string const &quadKey)> OpenFn;
+
+    TileOutputCache(size_t maxOpen, OpenFn openFn) :
+        m_maxOpen(std::max<size_t>(1,maxOpen)),
+        m_openFn(openFn)
+    {}
+
+    // NULL if the tile's file couldn't be opened
+    Output * Get(std::string const &quadKey)
+    {
+        auto it = m_listOutputs.find(quadKey);
+        if(it != m_listOutputs.end())   {
+            Entry &entry = it->second;
+            if(entry.isOpen)   {
+                m_listOpen.splice(m_listOpen.begin(),m_listOpen,entry.openIt);
+                return entry.output.get();
+            }
+            makeRoom();
+            if(!entry.output->Resume())   {
+                return NULL;
+            }
+            setOpen(quadKey,entry);
+            return entry.output.get();
+        }
+
+        makeRoom();
+        Entry &entry = m_listOutputs[quadKey];
+        entry.output.reset(new Output);
+        entry.isOpen = false;
+        if(!m_openFn(*(entry.output),quadKey))   {
+            return NULL;
+        }
+        setOpen(quadKey,entry);
+        return entry.output.get();
+    }
+
+    // every tile's output, suspended or not, by quadKey
+    std::map<std::string,Output*> GetAll()
+    {
+        std::map<std::string,Output*> listOutputs;
+        for(auto &output : m_listOutputs)   {
+            listOutputs[output.first] = output.second.output.get();
+        }
+        return listOutputs;
+    }
+
+    size_t GetCount() const
+    {
+        return m_listOutputs.size();
+    }
+
+private:
+    struct Entry
+    {
+        std::unique_ptr<Output> output;
+        bool isOpen;
+        std::list<std::string>::iterator openIt;
+    };
+
+    void makeRoom()
+    {
+        while(m_listOpen.size() >= m_maxOpen)   {
+            Entry &entry = m_listOutputs[m_listOpen.back()];
+            entry.output->Suspend();
+            entry.isOpen = false;
+            m_listOpen.pop_back();
+        }
+    }
+
+    void setOpen(std::string const &quadKey, Entry &entry)
+    {
+        m_listOpen.push_front(quadKey);
+        entry.openIt = m_listOpen.begin();
+        entry.isOpen = true;
+    }
+
+    size_t const m_maxOpen;
+    OpenFn m_openFn;
+    std::map<std::string,Entry> m_listOutputs;
+    std::list<std::string> m_listOpen;  // most recently used first
+};
+
+std::string GetOutputPath(PipelineConfig const &config,
+                          std::string const &quadKey)
+{
+    // <output>.ext, or <output>_<quadkey>.ext when tiled
+    std::string path = config.output;
+    if(config.tile)   {
+        path += "_"+quadKey;
+    }
+
+    if(config.mesh)   {
+        path += ".ctm";
+    }
+    else if(config.format == POLY_FORMAT_PBIN)   {
+        path += ".pbin";
+    }
+    else   {
+        path += ".wkt";
+    }
+    return path;
+}
+
+// ============================================================= //
+
+int main(int argc, const char *argv[])
+{
+    if(argc != 2) {
+        std::cout << "Usage: #> ./ptk_pipeline pipeline.conf\n";
+        std::cout << "* Runs repair -> simplify -> xform -> tile -> mesh in a single\n";
+        std::cout << "  process, streaming batches of features between the stages\n";
+        std::cout << "* The config has a 'key = value' per line:\n";
+        std::cout << "  input               input file (wkt or pbin)\n";
+        std::cout << "  output              output path prefix\n";
+        std::cout << "  format              pbin (default) or wkt, for polygon output\n";
+        std::cout << "  repair              1 (default) or 0\n";
+        std::cout << "  simplify            1 (default) or 0\n";
+        std::cout << "  simplify_area       Visvalingam-Whyatt area (default 4000)\n";
+        std::cout << "  xform               1 (default) or 0\n";
+        std::cout << "  xform_source_epsg   default 3785\n";
+        std::cout << "  xform_target_epsg   default 4326\n";
+        std::cout << "  tile                0 (default) or 1\n";
+        std::cout << "  tile_levels         quadtree levels to split\n";
+        std::cout << "  tile_extents        MINLON MAXLON MINLAT MAXLAT\n";
+        std::cout << "  mesh                0 (default) or 1, writes OpenCTM meshes\n";
+        std::cout << "  batch_size          features per batch (default 4096)\n";
+        std::cout << "  queue_size          batches queued between stages (default 4)\n";
+        return 0;
+    }
+
+    PipelineConfig config;
+    if(!ReadPipelineConfig(argv[1],config))   {
+        return -1;
+    }
+
+    PolyReader reader;
+    if(!reader.Open(config.input))   {
+        std::cout << "ptk_pipeline: Could not open " << config.input << "\n";
+        return -1;
+    }
+
+    PolyWriter writer;
+    if(!config.mesh && !config.tile)   {
+        std::string const outputPath = GetOutputPath(config,"");
+        if(!writer.Open(outputPath,config.format))   {
+            std::cout << "ptk_pipeline: Could not open " << outputPath << "\n";
+            return -1;
+        }
+    }
+
+    StartTiming("[Pipeline]");
+
+    scratch::ThreadPool threadPool(
+                std::max(1u,std::thread::hardware_concurrency()));
+    size_t const numThreads = threadPool.GetThreadCount();
+
+    // xform
+    OGRSpatialReference sourceSRS, targetSRS;
+    std::mutex xformMutex;
+    bool const xformMercator =
+            IsMercatorToWGS84(config.xformSourceEPSG,config.xformTargetEPSG);
+    if(config.xform && !xformMercator)   {
+        sourceSRS.importFromEPSG(config.xformSourceEPSG);
+        targetSRS.importFromEPSG(config.xformTargetEPSG);
+    }
+
+    // stages
+    std::vector<PipelineStage> listStages;
+    if(config.repair)   {
+        PipelineStage stage;
+        stage.name = "repair";
+        stage.process = RepairItems;
+        listStages.push_back(stage);
+    }
+    if(config.simplify)   {
+        double const vwArea = config.simplifyArea;
+        PipelineStage stage;
+        stage.name = "simplify";
+        stage.process = [vwArea](PipelineItem *listItems,
+                                 StageResult *listResults,
+                                 size_t count) {
+            SimplifyItems(vwArea,listItems,listResults,count);
+        };
+        listStages.push_back(stage);
+    }
+    if(config.xform)   {
+        PipelineStage stage;
+        stage.name = "xform";
+        stage.process = [&](PipelineItem *listItems,
+                            StageResult *listResults,
+                            size_t count) {
+            if(xformMercator)   {
+                XformItems(NULL,listItems,listResults,count);
+                return;
+            }
+
+            // OGRCoordinateTransformation isn't thread
+            // safe so each range gets its own
+            OGRCoordinateTransformation * coordXform;
+            {
+                std::lock_guard<std::mutex> lock(xformMutex);
+                coordXform = OGRCreateCoordinateTransformation(&sourceSRS,&targetSRS);
+            }
+            if(coordXform == NULL)   {
+                for(size_t i=0; i < count; i++)   {
+                    listResults[i].error = "Could not create coordinate transform";
+                }
+                return;
+            }
+            XformItems(coordXform,listItems,listResults,count);
+            OCTDestroyCoordinateTransformation(coordXform);
+        };
+        listStages.push_back(stage);
+    }
+    if(config.tile)   {
+        BoundingBox const rootExtents = config.tileExtents;
+        unsigned int const numLevels = config.tileLevels;
+        PipelineStage stage;
+        stage.name = "tile";
+        stage.process = [rootExtents,numLevels](PipelineItem *listItems,
+                                                StageResult *listResults,
+                                                size_t count) {
+            TileItems(rootExtents,numLevels,listItems,listResults,count);
+        };
+        listStages.push_back(stage);
+    }
+    if(config.mesh)   {
+        PipelineStage stage;
+        stage.name = "mesh";
+        stage.process = MeshItems;
+        listStages.push_back(stage);
+    }
+
+    // queues; queue 0 is fed by the reader and
+    // the last queue is drained by the writer
+    std::vector<std::unique_ptr<PipelineQueue>> listQueues;
+    for(size_t i=0; i <= listStages.size(); i++)   {
+        listQueues.emplace_back(new PipelineQueue(config.queueSize));
+    }
+    for(size_t i=0; i < listStages.size(); i++)   {
+        listStages[i].input = listQueues[i].get();
+        listStages[i].output = listQueues[i+1].get();
+        listStages[i].countIn = 0;
+        listStages[i].countOut = 0;
+        listStages[i].countErrors = 0;
+    }
+
+    // reader
+    size_t countRead = 0;
+    std::thread readerThread([&]() {
+        while(reader.ReadBatch(config.batchSize))
+        {
+            std::vector<std::string> listErrors(reader.GetBatchSize());
+            std::vector<char> listOk(reader.GetBatchSize(),0);
+            PipelineBatch batch(reader.GetBatchSize());
+            scratch::ParallelForRange(
+                        threadPool,0,batch.size(),
+                        [&](size_t rangeBegin, size_t rangeEnd) {
+                for(size_t i=rangeBegin; i < rangeEnd; i++)   {
+                    listOk[i] = reader.GetFeature(i,batch[i].feature,listErrors[i]);
+                }
+            },std::max<size_t>(1,batch.size()/(numThreads*8)));
+
+            PipelineBatch outputBatch;
+            outputBatch.reserve(batch.size());
+            for(size_t i=0; i < batch.size(); i++)   {
+                if(listOk[i])   {
+                    outputBatch.push_back(std::move(batch[i]));
+                }
+                else if(!listErrors[i].empty())   {
+                    std::lock_guard<std::mutex> lock(coutMutex);
+                    std::cout << listErrors[i] << std::endl;
+                }
+            }
+
+            countRead += batch.size();
+            {
+                std::lock_guard<std::mutex> lock(coutMutex);
+                std::cout << "ptk_pipeline: Lines Read: " << countRead;
+                if(reader.GetFeatureCount() > 0)   {
+                    std::cout << "/" << reader.GetFeatureCount();
+                }
+                std::cout << std::endl;
+            }
+            listQueues[0]->Push(std::move(outputBatch));
+        }
+        listQueues[0]->Close();
+    });
+
+    std::vector<std::thread> listStageThreads;
+    for(size_t i=0; i < listStages.size(); i++)   {
+        PipelineStage &stage = listStages[i];
+        listStageThreads.emplace_back([&stage,&threadPool]() {
+            RunStage(stage,threadPool);
+        });
+    }
+
+    // writer
+    // * tiles are written as their features arrive, with a
+    //   bounded number of tile files open at once
+    // * mesh tiles are spilled to a temp file per tile and
+    //   each is built and saved once everything is meshed
+    size_t countWritten = 0;
+    std::string writeError;
+    TileOutputCache<PolyWriter> listPolyTiles(
+                MAX_OPEN_TILES,
+                [&config](PolyWriter &tileWriter, std::string const &quadKey) {
+        return tileWriter.Open(GetOutputPath(config,quadKey),config.format,false);
+    });
+    TileOutputCache<MeshSpill> listMeshTiles(
+                MAX_OPEN_TILES,
+                [&config](MeshSpill &meshSpill, std::string const &quadKey) {
+        return meshSpill.Open(GetOutputPath(config,quadKey)+".tmp");
+    });
+
+    PipelineBatch batch;
+    while(listQueues.back()->Pop(batch))
+    {
+        // keep draining the queue after an error so
+        // the other threads can finish
+        if(!writeError.empty())   {
+            continue;
+        }
+        for(size_t i=0; i < batch.size(); i++)   {
+            PipelineItem &item = batch[i];
+            if(config.mesh)   {
+                MeshSpill * meshSpill = listMeshTiles.Get(item.quadKey);
+                if(meshSpill == NULL || !meshSpill->Write(item.mesh))   {
+                    writeError = GetOutputPath(config,item.quadKey)+".tmp";
+                    break;
+                }
+            }
+            else if(config.tile)   {
+                PolyWriter * tileWriter = listPolyTiles.Get(item.quadKey);
+                if(tileWriter == NULL || !tileWriter->Write(item.feature))   {
+                    writeError = GetOutputPath(config,item.quadKey);
+                    break;
+                }
+            }
+            else if(!writer.Write(item.feature))   {
+                writeError = writer.GetPath();
+                break;
+            }
+            countWritten++;
+        }
+    }
+
+    readerThread.join();
+    for(size_t i=0; i < listStageThreads.size(); i++)   {
+        listStageThreads[i].join();
+    }
+    reader.Close();
+    if(!writer.Close() && writeError.empty())   {
+        writeError = writer.GetPath();
+    }
+
+    if(writeError.empty())   {
+        for(auto &meshSpill : listMeshTiles.GetAll())   {
+            MeshTile meshTile;
+            if(!meshSpill.second->Load(meshTile))   {
+                writeError = meshSpill.second->GetPath();
+                break;
+            }
+            std::string const outputPath = GetOutputPath(config,meshSpill.first);
+            if(!SaveMeshCTM(meshTile.triMesh,outputPath))   {
+                writeError = outputPath;
+                break;
+            }
+        }
+    }
+    for(auto &tileWriter : listPolyTiles.GetAll())   {
+        if(!tileWriter.second->Close() && writeError.empty())   {
+            writeError = tileWriter.second->GetPath();
+        }
+    }
+
+    if(!writeError.empty())   {
+        std::cout << "ptk_pipeline: Could not write " << writeError << "\n";
+        return -1;
+    }
+
+    std::cout << "ptk_pipeline: read " << countRead << "\n";
+    for(size_t i=0; i < listStages.size(); i++)   {
+        PipelineStage const &stage = listStages[i];
+        std::cout << "ptk_pipeline: " << stage.name << ": in " << stage.countIn
+                  << ", out " << stage.countOut
+                  << ", errors " << stage.countErrors << "\n";
+    }
+    std::cout << "ptk_pipeline: wrote " << countWritten;
+    if(config.mesh)   {
+        std::cout << " meshes to " << listMeshTiles.GetCount() << " file(s)\n";
+    }
+    else if(config.tile)   {
+        std::cout << " polygons to " << listPolyTiles.GetCount() << " file(s)\n";
+    }
+    else   {
+        std::cout << " polygons\n";
+    }
+    EndTiming();
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+TEMPLATE = app
+CONFIG += console debug
+CONFIG -= qt
+TARGET = ptk_pipeline
+
+#liblzma
+HEADERS +=  openctm/liblzma/Alloc.h \
+            openctm/liblzma/LzFind.h \
+            openctm/liblzma/LzHash.h \
+            openctm/liblzma/LzmaEnc.h \
+            openctm/liblzma/LzmaLib.h \
+            openctm/liblzma/NameMangle.h \
+            openctm/liblzma/Types.h
+
+SOURCES +=  openctm/liblzma/Alloc.c \
+            openctm/liblzma/LzFind.c \
+            openctm/liblzma/LzmaDec.c \
+            openctm/liblzma/LzmaEnc.c \
+            openctm/liblzma/LzmaLib.c
+
+# openctm
+HEADERS += openctm/openctmpp.h \
+           openctm/openctm.h \
+           openctm/internal.h
+
+SOURCES += openctm/stream.c \
+           openctm/openctm.c \
+           openctm/compressRAW.c \
+           openctm/compressMG2.c \
+           openctm/compressMG1.c
+
+# clipper
+HEADERS += clipper/clipper.hpp
+SOURCES += clipper/clipper.cpp
+
+# ptk_pipeline
+HEADERS += PolyBin.hpp \
+           ptk_prepair.hpp \
+           ptk_simplify.hpp \
+           ptk_quadify.hpp \
+           ptk_mesh.hpp
+SOURCES += ptk_pipeline.cpp
+
+# threadpool
+PATH_THREADPOOL = $$PWD/../../utils/threadpool
+INCLUDEPATH += $${PATH_THREADPOOL}
+HEADERS += \
+    $${PATH_THREADPOOL}/ThreadPool.h \
+    $${PATH_THREADPOOL}/Parallel.h
+SOURCES += \
+    $${PATH_THREADPOOL}/Job.cpp \
+    $${PATH_THREADPOOL}/ThreadPool.cpp \
+    $${PATH_THREADPOOL}/ThreadPoolStats.cpp
+
+# vertexweld
+PATH_VERTEXWELD = $$PWD/../../utils/vertexweld
+INCLUDEPATH += $${PATH_VERTEXWELD}
+HEADERS += $${PATH_VERTEXWELD}/VertexWelder.h
+
+# geodesy
+PATH_GEODESY = $$PWD/../../utils/geodesy
+INCLUDEPATH += $${PATH_GEODESY}
+HEADERS += $${PATH_GEODESY}/Geodesy.h
+
+# vwheap
+PATH_VWHEAP = $$PWD/../../utils/vwheap
+INCLUDEPATH += $${PATH_VWHEAP}
+HEADERS += $${PATH_VWHEAP}/VWHeap.h
+
+# required libs
+LIBS += -lgdal -lCGAL_Core -lCGAL -lmpfr -lgmp -lboost_thread
+
+# need these flags for gcc 4.8.x bug for threads
+QMAKE_LFLAGS += -Wl,--no-as-needed
+LIBS += -lpthread
+QMAKE_CXXFLAGS += -std=c++11
@@ -0,0 +1,145 @@
+// STL
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <sys/time.h>
+
+// OGR
+#include <ogrsf_frmts.h>
+
+// threadpool
+#include <ThreadPool.h>
+#include <Parallel.h>
+
+#include "PolyBin.hpp"
+
+// timing vars
+timeval t1,t2;
+std::string timingDesc;
+
+void StartTiming(std::string const &desc)
+{
+    timingDesc = desc;
+    gettimeofday(&t1,NULL);
+}
+
+void EndTiming()
+{
+    gettimeofday(&t2,NULL);
+    double timeTaken = 0;
+    timeTaken += (t2.tv_sec - t1.tv_sec) * 1000.0 * 1000.0;
+    timeTaken += (t2.tv_usec - t1.tv_usec);
+    std::cout << "INFO: " << timingDesc << ": \t\t"
+              << timeTaken/1000 << " milliseconds" << std::endl;
+}
+
+// records are read, converted in parallel and
+// written out (in order) this many at a time
+size_t const k_batch_lines = 65536;
+
+struct ConvertResult
+{
+    bool ok;
+    std::string record;
+    std::string error;
+};
+
+int main(int argc, const char *argv[])
+{
+    // --i32 SCALE: store pbin coords as int32s
+    double i32Scale = 0;
+    if(argc == 5 && std::string(argv[1]) == "--i32")   {
+        i32Scale = atof(argv[2]);
+        argv += 2;
+        argc -= 2;
+    }
+
+    if(argc != 3 || i32Scale < 0) {
+        std::cout << "Usage: #> ./ptk_polybin [--i32 SCALE] myinputfile myoutputfile\n";
+        std::cout << "* Converts between wkt (one POLYGON() or MULTIPOLYGON() per line) and pbin\n";
+        std::cout << "* The input format is detected, the output format is pbin if\n";
+        std::cout << "  myoutputfile ends in .pbin and wkt otherwise\n";
+        std::cout << "* --i32 stores pbin coordinates as int32 multiples of SCALE,\n";
+        std::cout << "  (ie. 1E-7 for lon/lat or 0.01 for mercator meters)\n";
+        return 0;
+    }
+
+    StartTiming("[Convert]");
+
+    PolyReader reader;
+    if(!reader.Open(argv[1]))   {
+        std::cout << "ERROR: Could not open " << argv[1] << std::endl;
+        return -1;
+    }
+
+    PolyWriter writer;
+    if(i32Scale > 0)   {
+        writer.SetInt32Coords(i32Scale,0,0);
+    }
+    if(!writer.Open(argv[2]))   {
+        std::cout << "ERROR: Could not open " << argv[2] << std::endl;
+        return -1;
+    }
+
+    std::cout << "ptk_polybin: "
+              << ((reader.GetFormat() == POLY_FORMAT_PBIN) ? "pbin" : "wkt") << " to "
+              << ((writer.GetFormat() == POLY_FORMAT_PBIN) ? "pbin" : "wkt") << std::endl;
+
+    scratch::ThreadPool threadPool(
+                std::max(1u,std::thread::hardware_concurrency()));
+    size_t const numThreads = threadPool.GetThreadCount();
+
+    size_t recordsProcessed = 0;
+    std::vector<ConvertResult> listResults;
+
+    while(reader.ReadBatch(k_batch_lines))
+    {
+        listResults.resize(reader.GetBatchSize());
+        scratch::ParallelForRange(
+                    threadPool,0,listResults.size(),
+                    [&](size_t rangeBegin, size_t rangeEnd) {
+            PolyFeature feature;
+            for(size_t i=rangeBegin; i < rangeEnd; i++) {
+                ConvertResult &result = listResults[i];
+                result.ok = false;
+                if(!reader.GetFeature(i,feature,result.error)) {
+                    continue;
+                }
+                result.ok = writer.Encode(feature,result.record);
+                if(!result.ok) {
+                    result.error = "Error: Could not encode (out of range?)\n-> "+
+                            reader.GetRecordDesc(i);
+                }
+            }
+        },(listResults.size()+numThreads-1)/numThreads);
+
+        // write output in input order
+        for(auto const &result : listResults)
+        {
+            if(result.ok) {
+                writer.WriteRecord(result.record);
+            }
+            else if(!result.error.empty()) {
+                std::cout << result.error << std::endl;
+            }
+        }
+
+        recordsProcessed += listResults.size();
+        std::cout << "ptk_polybin: Records Processed: " << recordsProcessed;
+        if(reader.GetFeatureCount() > 0) {
+            std::cout << "/" << reader.GetFeatureCount();
+        }
+        std::cout << std::endl;
+    }
+    writer.Close();
+
+    std::cout << "ptk_polybin: Wrote " << writer.GetFeatureCount()
+              << " features" << std::endl;
+
+    EndTiming();
+    return 0;
+}
@@ -0,0 +1,25 @@
+TEMPLATE = app
+CONFIG += console debug
+CONFIG -= qt
+HEADERS += PolyBin.hpp
+SOURCES += ptk_polybin.cpp
+TARGET = ptk_polybin
+
+# threadpool
+PATH_THREADPOOL = $$PWD/../../utils/threadpool
+INCLUDEPATH += $${PATH_THREADPOOL}
+HEADERS += \
+    $${PATH_THREADPOOL}/ThreadPool.h \
+    $${PATH_THREADPOOL}/Parallel.h
+SOURCES += \
+    $${PATH_THREADPOOL}/Job.cpp \
+    $${PATH_THREADPOOL}/ThreadPool.cpp \
+    $${PATH_THREADPOOL}/ThreadPoolStats.cpp
+
+# required libs
+LIBS += -lgdal
+
+# need these flags for gcc 4.8.x bug for threads
+QMAKE_LFLAGS += -Wl,--no-as-needed
+LIBS += -lpthread
+QMAKE_CXXFLAGS += -std=c++11
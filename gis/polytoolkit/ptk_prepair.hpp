@@ -0,0 +1,546 @@
+/*
+ Copyright (c) 2009-2012, 
+ Gustavo Adolfo Ken Arroyo Ohori    g.a.k.arroyoohori@tudelft.nl
+ Hugo Ledoux                        h.ledoux@tudelft.nl
+ Martijn Meijers                    b.m.meijers@tudelft.nl
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met: 
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer. 
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+  Minor additions to incorporate import of multiple polygons in a single
+  file, and export to a file by
+
+  Preet Desai       prismatic.project@gmail.com
+
+  This file, including all changes from the original (available at
+  https://github.com/tudelft-gist/prepair) is made available under the
+  same terms as the original license, shown above
+
+  (shared by the ptk_ tools that repair or triangulate polygons)
+*/
+
+#ifndef PTK_PREPAIR_HPP
+#define PTK_PREPAIR_HPP
+
+// STL
+#include <iostream>
+#include <cstdlib>
+#include <stack>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+// OGR
+#include <ogrsf_frmts.h>
+
+#include "PolyBin.hpp"
+
+// CGAL
+#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
+#include <CGAL/Triangulation_face_base_with_info_2.h>
+#include <CGAL/Constrained_Delaunay_triangulation_2.h>
+#include <CGAL/Constrained_triangulation_plus_2.h>
+#include <CGAL/Triangle_2.h>
+
+// The CGAL typedefs (K, Point, ...) and repair helpers are
+// kept in namespace prepair so they can't collide with names
+// in the tools; the repair API is brought into the global
+// namespace at the end
+namespace prepair
+{
+
+typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
+typedef CGAL::Triangulation_vertex_base_2<K> VB;
+typedef CGAL::Constrained_triangulation_face_base_2<K> FB;
+typedef CGAL::Triangulation_face_base_with_info_2<void *, K, FB> FBWI;
+typedef CGAL::Triangulation_data_structure_2<VB, FBWI> TDS;
+typedef CGAL::Exact_predicates_tag PT;
+typedef CGAL::Exact_intersections_tag IT;
+typedef CGAL::Constrained_Delaunay_triangulation_2<K, TDS, PT> CDT;
+
+typedef CGAL::Constrained_triangulation_plus_2<CDT> Triangulation;
+typedef Triangulation::Point Point;
+
+
+inline void tag(Triangulation &triangulation, void *interiorHandle, void *exteriorHandle) {
+	
+    // Clean tags
+    for (Triangulation::Face_handle currentFace = triangulation.all_faces_begin(); currentFace != triangulation.all_faces_end(); ++currentFace)
+        currentFace->info() = NULL;
+    
+    // Initialise tagging
+    std::stack<Triangulation::Face_handle> interiorStack, exteriorStack;
+    exteriorStack.push(triangulation.infinite_face());
+    std::stack<Triangulation::Face_handle> *currentStack = &exteriorStack;
+    std::stack<Triangulation::Face_handle> *dualStack = &interiorStack;
+    void *currentHandle = exteriorHandle;
+    void *dualHandle = interiorHandle;
+    
+    // Until we finish
+    while (!interiorStack.empty() || !exteriorStack.empty()) {
+        
+        // Give preference to whatever we're already doing
+        while (!currentStack->empty()) {
+            Triangulation::Face_handle currentFace = currentStack->top();
+			currentStack->pop();
+            if (currentFace->info() != NULL) continue;
+			currentFace->info() = currentHandle;
+            for (int currentEdge = 0; currentEdge < 3; ++currentEdge) {
+                if (currentFace->neighbor(currentEdge)->info() == NULL)
+                    if (currentFace->is_constrained(currentEdge)) dualStack->push(currentFace->neighbor(currentEdge));
+                else currentStack->push(currentFace->neighbor(currentEdge));
+            }
+        }
+			
+        // Flip
+        if (currentHandle == exteriorHandle) {
+            currentHandle = interiorHandle;
+            dualHandle = exteriorHandle;
+            currentStack = &interiorStack;
+            dualStack = &exteriorStack;
+        } else {
+            currentHandle = exteriorHandle;
+            dualHandle = interiorHandle;
+            currentStack = &exteriorStack;
+            dualStack = &interiorStack;
+        }
+	}
+}
+
+
+
+
+// ============================================================= //
+
+// Repair with reusable buffers
+// * the same algorithm as the original prepair, except that
+//   the boundary walk is iterative and appends to a vector
+//   instead of splicing a std::list per face, and rings are
+//   cut from the walk with vectors too
+// * repairPolyFeature reads and writes PolyFeatures so the
+//   rings never go through OGR; each repaired polygon is a
+//   part of the output feature, in the order the seeding
+//   faces are found, so the output is deterministic
+// * a RepairScratch holds the triangulation and every
+//   buffer, and is cleared at the start of each repair;
+//   keep one per thread (they're not thread safe) and
+//   reuse it across polygons
+// * a repaired polygon keeps its first counterclockwise
+//   ring as the outer ring, like the original; any other
+//   counterclockwise rings have no enclosing outer ring
+//   and are dropped, and numDroppedRings counts them
+
+typedef Triangulation::Vertex_handle VertexHandle;
+typedef std::vector<VertexHandle> VertexChain;
+
+struct BoundaryFrame
+{
+    Triangulation::Face_handle face;
+    int edge;
+    int state;      // 0: cw side, 1: vertex and ccw side, 2: done
+};
+
+struct RepairBuffers
+{
+    // tag() only compares these by address
+    char interiorTag;
+    char exteriorTag;
+
+    std::vector<BoundaryFrame> listFrames;
+    VertexChain listBoundary;
+    VertexChain listRepeated;                   // sorted
+
+    std::vector<VertexChain> listChains;        // stack of open chains
+    std::vector<size_t> listChainIds;
+    std::map<VertexHandle,size_t> vertexChainMap;
+    size_t nextChainId;
+
+    std::vector<VertexChain> listRings;
+    size_t numRings;
+    size_t numDroppedRings;                     // in the last repair
+
+    std::vector<double> listRingXY;
+    std::vector<size_t> listRingBegin;
+};
+
+struct RepairScratch
+{
+    Triangulation triangulation;
+    RepairBuffers buffers;
+};
+
+inline void getBoundary(Triangulation::Face_handle face, int edge,
+                        RepairBuffers &buffers)
+{
+    // walks the interior faces across unconstrained edges,
+    // appending the boundary vertices in the same order as
+    // the recursive version did
+    std::vector<BoundaryFrame> &listFrames = buffers.listFrames;
+    listFrames.clear();
+
+    BoundaryFrame root;
+    root.face = face;
+    root.edge = edge;
+    root.state = 0;
+    listFrames.push_back(root);
+
+    while(!listFrames.empty())
+    {
+        BoundaryFrame &frame = listFrames.back();
+        Triangulation::Face_handle const currFace = frame.face;
+        int const currEdge = frame.edge;
+
+        int sideEdge;
+        if(frame.state == 0)   {
+            frame.state = 1;
+            sideEdge = currFace->cw(currEdge);
+        }
+        else if(frame.state == 1)   {
+            frame.state = 2;
+            buffers.listBoundary.push_back(currFace->vertex(currEdge));
+            sideEdge = currFace->ccw(currEdge);
+        }
+        else   {
+            listFrames.pop_back();
+            continue;
+        }
+
+        Triangulation::Face_handle const neighbor = currFace->neighbor(sideEdge);
+        if(!currFace->is_constrained(sideEdge) && neighbor->info() != NULL)   {
+            neighbor->info() = NULL;
+            BoundaryFrame next;     // frame is invalid after push_back
+            next.face = neighbor;
+            next.edge = neighbor->index(currFace);
+            next.state = 0;
+            listFrames.push_back(next);
+        }
+    }
+}
+
+inline void addRepairedRing(VertexChain &chain, RepairBuffers &buffers)
+{
+    // Degenerate (insufficient vertices to be valid)
+    if(chain.size() < 3)   {
+        return;
+    }
+    // Degenerate (zero area)
+    if(chain.back() == chain[1])   {
+        return;
+    }
+    // Valid
+    if(buffers.numRings == buffers.listRings.size())   {
+        buffers.listRings.emplace_back();
+    }
+    buffers.listRings[buffers.numRings].swap(chain);
+    buffers.numRings++;
+}
+
+inline void closeChainsFrom(size_t firstChain, VertexChain &newChain, RepairBuffers &buffers)
+{
+    // newChain becomes the chains on the stack from firstChain
+    // up, followed by newChain, and those chains are popped
+    size_t numVertices = newChain.size();
+    for(size_t i=firstChain; i < buffers.listChains.size(); i++)   {
+        numVertices += buffers.listChains[i].size();
+    }
+
+    VertexChain joined;
+    joined.reserve(numVertices);
+    for(size_t i=firstChain; i < buffers.listChains.size(); i++)   {
+        joined.insert(joined.end(),buffers.listChains[i].begin(),buffers.listChains[i].end());
+    }
+    joined.insert(joined.end(),newChain.begin(),newChain.end());
+    newChain.swap(joined);
+
+    buffers.listChains.resize(firstChain);
+    buffers.listChainIds.resize(firstChain);
+}
+
+inline bool isRepeatedVertex(VertexHandle const &vertex, RepairBuffers const &buffers)
+{
+    return std::binary_search(buffers.listRepeated.begin(),
+                              buffers.listRepeated.end(),vertex);
+}
+
+inline void cutBoundaryIntoRings(RepairBuffers &buffers)
+{
+    VertexChain const &listBoundary = buffers.listBoundary;
+    buffers.numRings = 0;
+
+    // Find cutting vertices
+    VertexChain &listRepeated = buffers.listRepeated;
+    listRepeated = listBoundary;
+    std::sort(listRepeated.begin(),listRepeated.end());
+    size_t numRepeated = 0;
+    for(size_t i=1; i < listRepeated.size(); i++)   {
+        if(listRepeated[i] == listRepeated[i-1] &&
+           (numRepeated == 0 || listRepeated[numRepeated-1] != listRepeated[i]))   {
+            listRepeated[numRepeated++] = listRepeated[i];
+        }
+    }
+    listRepeated.resize(numRepeated);
+
+    // Cut and join rings in the correct order
+    buffers.listChains.clear();
+    buffers.listChainIds.clear();
+    buffers.vertexChainMap.clear();
+    buffers.nextChainId = 0;
+
+    VertexChain newChain;
+    for(size_t v=0; v < listBoundary.size(); v++)
+    {
+        VertexHandle const &currentVertex = listBoundary[v];
+
+        // New chain
+        if(isRepeatedVertex(currentVertex,buffers))
+        {
+            // Closed by itself
+            if(!newChain.empty() && newChain.front() == currentVertex)   {
+                addRepairedRing(newChain,buffers);
+            }
+            // Open by itself
+            else   {
+                std::map<VertexHandle,size_t>::iterator mapIt =
+                        buffers.vertexChainMap.find(currentVertex);
+
+                // Closed with others in stack
+                if(mapIt != buffers.vertexChainMap.end())   {
+                    size_t firstChain = buffers.listChainIds.size();
+                    while(firstChain > 0 && buffers.listChainIds[firstChain-1] != mapIt->second)   {
+                        firstChain--;
+                    }
+                    firstChain = (firstChain > 0) ? firstChain-1 : 0;
+
+                    closeChainsFrom(firstChain,newChain,buffers);
+                    buffers.vertexChainMap.erase(mapIt);
+                    addRepairedRing(newChain,buffers);
+                }
+                // Open
+                else   {
+                    size_t const chainId = buffers.nextChainId++;
+                    // Not first chain
+                    if(!newChain.empty() && isRepeatedVertex(newChain.front(),buffers))   {
+                        buffers.vertexChainMap[newChain.front()] = chainId;
+                    }
+                    buffers.listChains.emplace_back();
+                    buffers.listChains.back().swap(newChain);
+                    buffers.listChainIds.push_back(chainId);
+                }
+            }
+            newChain.clear();
+        }
+        newChain.push_back(currentVertex);
+    }
+
+    // Final ring
+    closeChainsFrom(0,newChain,buffers);
+    addRepairedRing(newChain,buffers);
+}
+
+inline double calcRingSignedArea(double const *ringXY, size_t numPts)
+{
+    // positive for counterclockwise rings
+    double area = 0;
+    for(size_t i=0; i+1 < numPts; i++)   {
+        area += ringXY[i*2]*ringXY[i*2+3] - ringXY[i*2+2]*ringXY[i*2+1];
+    }
+    return area/2;
+}
+
+inline void addRepairedPolygon(RepairBuffers &buffers, PolyFeature &output)
+{
+    // rings are written reversed and closed
+    std::vector<double> &listRingXY = buffers.listRingXY;
+    std::vector<size_t> &listRingBegin = buffers.listRingBegin;
+    listRingXY.clear();
+    listRingBegin.clear();
+    for(size_t r=0; r < buffers.numRings; r++)   {
+        VertexChain const &ring = buffers.listRings[r];
+        listRingBegin.push_back(listRingXY.size()/2);
+        for(VertexChain::const_reverse_iterator it = ring.rbegin(); it != ring.rend(); ++it)   {
+            listRingXY.push_back((*it)->point().x());
+            listRingXY.push_back((*it)->point().y());
+        }
+        listRingXY.push_back(ring.back()->point().x());
+        listRingXY.push_back(ring.back()->point().y());
+    }
+    listRingBegin.push_back(listRingXY.size()/2);
+
+    // the first counterclockwise ring is the outer ring and
+    // every clockwise one is a hole; other counterclockwise
+    // rings are counted as dropped. A polygon that's left
+    // without any rings is dropped
+    size_t numOutputRings = 0;
+    size_t numOuterRings = 0;
+    for(int pass=0; pass < 2; pass++)   {
+        bool const isOuter = (pass == 0);
+        for(size_t r=0; r < buffers.numRings; r++)   {
+            size_t const ptBegin = listRingBegin[r];
+            size_t const ptEnd = listRingBegin[r+1];
+            bool const isClockwise =
+                    (calcRingSignedArea(&listRingXY[ptBegin*2],ptEnd-ptBegin) < 0);
+            if(isClockwise == isOuter)   {
+                continue;
+            }
+            if(isOuter && numOuterRings++ > 0)   {
+                buffers.numDroppedRings++;
+                continue;
+            }
+            for(size_t i=ptBegin; i < ptEnd; i++)   {
+                output.AddPoint(listRingXY[i*2],listRingXY[i*2+1]);
+            }
+            output.EndRing();
+            numOutputRings++;
+        }
+    }
+
+    if(numOutputRings > 0)   {
+        output.EndPart();
+    }
+}
+
+inline void reconstructPolygons(Triangulation &triangulation,
+                                RepairBuffers &buffers,
+                                PolyFeature &output)
+{
+    void *interior = &buffers.interiorTag;
+    buffers.numDroppedRings = 0;
+    output.Clear();
+
+    for (Triangulation::Finite_faces_iterator seedingFace = triangulation.finite_faces_begin(); seedingFace != triangulation.finite_faces_end(); ++seedingFace) {
+
+        if (seedingFace->info() != interior) continue;
+
+        // Get boundary
+        buffers.listBoundary.clear();
+        seedingFace->info() = NULL;
+        if (seedingFace->neighbor(2)->info() == interior) {
+            seedingFace->neighbor(2)->info() = NULL;
+            getBoundary(seedingFace->neighbor(2), seedingFace->neighbor(2)->index(seedingFace), buffers);
+        } buffers.listBoundary.push_back(seedingFace->vertex(0));
+        if (seedingFace->neighbor(1)->info() == interior) {
+            seedingFace->neighbor(1)->info() = NULL;
+            getBoundary(seedingFace->neighbor(1), seedingFace->neighbor(1)->index(seedingFace), buffers);
+        } buffers.listBoundary.push_back(seedingFace->vertex(2));
+        if (seedingFace->neighbor(0)->info() == interior) {
+            seedingFace->neighbor(0)->info() = NULL;
+            getBoundary(seedingFace->neighbor(0), seedingFace->neighbor(0)->index(seedingFace), buffers);
+        } buffers.listBoundary.push_back(seedingFace->vertex(1));
+
+        cutBoundaryIntoRings(buffers);
+        addRepairedPolygon(buffers,output);
+    }
+    output.CalcBounds();
+}
+
+inline void insertRingConstraints(Triangulation &triangulation,
+                                  double const *ringXY,
+                                  size_t numPts)
+{
+    for (size_t currentPoint = 0; currentPoint < numPts; ++currentPoint) {
+        size_t const nextPoint = (currentPoint+1)%numPts;
+        triangulation.insert_constraint(Point(ringXY[currentPoint*2], ringXY[currentPoint*2+1]),
+                                        Point(ringXY[nextPoint*2], ringXY[nextPoint*2+1]));
+    }
+}
+
+// Repairs a single part (ie. POLYGON()) feature; returns
+// false if the input has no area. Each repaired polygon
+// is a part of output. Check scratch.buffers.numDroppedRings
+// afterwards for rings that were left out
+inline bool repairPolyFeature(PolyFeature const &input,
+                              PolyFeature &output,
+                              RepairScratch &scratch)
+{
+    Triangulation &triangulation = scratch.triangulation;
+    triangulation.clear();
+
+    for(size_t r=0; r < input.GetNumRings(); r++)   {
+        uint32_t const ptBegin = input.listRingPts[r];
+        uint32_t const ptEnd = input.listRingPts[r+1];
+        insertRingConstraints(triangulation,input.listXY.data()+ptBegin*2,ptEnd-ptBegin);
+    }
+
+    if (triangulation.number_of_faces() < 1) {
+        output.Clear();
+        return false;
+    }
+
+    tag(triangulation, &scratch.buffers.interiorTag, &scratch.buffers.exteriorTag);
+    reconstructPolygons(triangulation,scratch.buffers,output);
+    return true;
+}
+
+// The original OGR interface, still used by the mesh tools
+// which need the triangulation afterwards
+inline OGRMultiPolygon* repair(OGRGeometry* geometry, Triangulation &triangulation) {
+
+  // Triangulation
+  PolyFeature input;
+  switch (geometry->getGeometryType()) {
+
+    case wkbPolygon: {
+      PolyFeatureFromOGR(geometry,input);
+      for(size_t r=0; r < input.GetNumRings(); r++)   {
+        uint32_t const ptBegin = input.listRingPts[r];
+        uint32_t const ptEnd = input.listRingPts[r+1];
+        insertRingConstraints(triangulation,input.listXY.data()+ptBegin*2,ptEnd-ptBegin);
+      } break;
+
+    } default:
+      std::cout << "Error: Cannot understand input. Only polygons are supported." << std::endl;
+      break;
+  }
+
+//  std::cout << "Triangulation: " << triangulation.number_of_faces() << " faces, " << triangulation.number_of_vertices() << " vertices." << std::endl;
+  if (triangulation.number_of_faces() < 1) {
+    return NULL;
+  }
+
+  // Tag
+  RepairBuffers buffers;
+  tag(triangulation, &buffers.interiorTag, &buffers.exteriorTag);
+
+  // Reconstruct
+  PolyFeature output;
+  reconstructPolygons(triangulation,buffers,output);
+
+  if (buffers.numDroppedRings > 0) {
+    std::cout << "Warning: Dropped " << buffers.numDroppedRings
+              << " ring(s) with no enclosing outer ring." << std::endl;
+  }
+
+  OGRMultiPolygon* outputPolygons = new OGRMultiPolygon();
+  for (size_t i = 0; i < output.GetNumParts(); ++i)
+    outputPolygons->addGeometryDirectly(PolyFeaturePartToOGR(output,i));
+  return outputPolygons;
+}
+
+} // prepair
+
+using prepair::Triangulation;
+using prepair::RepairScratch;
+using prepair::repairPolyFeature;
+using prepair::repair;
+
+#endif // PTK_PREPAIR_HPP
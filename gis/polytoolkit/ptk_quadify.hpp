@@ -0,0 +1,253 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PTK_QUADIFY_HPP
+#define PTK_QUADIFY_HPP
+
+// Quadtree tiling of polygons with clipper, shared
+// by ptk_quadify_wkt (--mem), ptk_gridify_wkt and ptk_pipeline
+
+// STL
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <utility>
+
+// clipper
+#include "clipper/clipper.hpp"
+
+#include "PolyBin.hpp"
+
+namespace ptk
+{
+    // clipper works in integers, so coordinates are
+    // scaled by this before clipping
+    double const DBLMT = 1E10;
+}
+
+struct BoundingBox
+{
+    double minLat;
+    double minLon;
+    double maxLat;
+    double maxLon;
+};
+
+
+inline bool calcAreaRectOverlap(double r1_bl_x, double r1_bl_y,
+                                double r1_tr_x, double r1_tr_y,
+                                double r2_bl_x, double r2_bl_y,
+                                double r2_tr_x, double r2_tr_y)
+{
+    // check if rectangles intersect
+    if((r1_tr_x < r2_bl_x) || (r1_bl_x > r2_tr_x) ||
+            (r1_tr_y < r2_bl_y) || (r1_bl_y > r2_tr_y))
+    {   return false;   }
+
+    return true;
+}
+
+struct QuadShape
+{
+    // outer ring followed by any holes, not closed
+    ClipperLib::Polygons rings;
+    ClipperLib::long64 minX;
+    ClipperLib::long64 minY;
+    ClipperLib::long64 maxX;
+    ClipperLib::long64 maxY;
+
+    // true once the shape has been through clipper, which
+    // cleans up self intersections and overlapping rings
+    bool clipped;
+};
+
+struct QuadTile
+{
+    std::string quadKey;
+    BoundingBox extents;
+    std::vector<QuadShape> listShapes;
+};
+
+inline void CalcShapeBounds(QuadShape &shape)
+{
+    shape.minX = std::numeric_limits<ClipperLib::long64>::max();
+    shape.minY = std::numeric_limits<ClipperLib::long64>::max();
+    shape.maxX = std::numeric_limits<ClipperLib::long64>::min();
+    shape.maxY = std::numeric_limits<ClipperLib::long64>::min();
+
+    // holes are inside the outer ring
+    ClipperLib::Polygon const &outer = shape.rings[0];
+    for(size_t i=0; i < outer.size(); i++)   {
+        shape.minX = std::min(shape.minX,outer[i].X);
+        shape.minY = std::min(shape.minY,outer[i].Y);
+        shape.maxX = std::max(shape.maxX,outer[i].X);
+        shape.maxY = std::max(shape.maxY,outer[i].Y);
+    }
+}
+
+inline bool ParseQuadShape(PolyFeature const &feature, QuadShape &shape)
+{
+    // only POLYGON()s are clipped
+    if(feature.GetNumParts() != 1)   {
+        return false;
+    }
+
+    shape.rings.resize(feature.GetNumRings());
+    for(size_t j=0; j < shape.rings.size(); j++)   {
+        uint32_t ptBegin = feature.listRingPts[j];
+        uint32_t ptEnd = feature.listRingPts[j+1];
+
+        // wkt rings are closed, clipper's aren't
+        ClipperLib::Polygon &poly = shape.rings[j];
+        poly.clear();
+        if(ptEnd-ptBegin < 2)   {
+            continue;
+        }
+        poly.reserve(ptEnd-ptBegin-1);
+        for(uint32_t k=ptBegin; k < ptEnd-1; k++)   {
+            poly.push_back(ClipperLib::IntPoint(
+                               ClipperLib::long64(feature.listXY[k*2]*ptk::DBLMT),
+                               ClipperLib::long64(feature.listXY[k*2+1]*ptk::DBLMT)));
+        }
+    }
+
+    if(shape.rings[0].empty())   {
+        return false;
+    }
+    CalcShapeBounds(shape);
+    shape.clipped = false;
+    return true;
+}
+
+inline void ClipQuadShape(QuadShape const &shape,
+                          BoundingBox const &cellExtents,
+                          std::vector<QuadShape> &listShapes)
+{
+    // appends the parts of shape inside the cell to listShapes
+    ClipperLib::long64 left  = ClipperLib::long64(cellExtents.minLon*ptk::DBLMT);
+    ClipperLib::long64 right = ClipperLib::long64(cellExtents.maxLon*ptk::DBLMT);
+    ClipperLib::long64 btm   = ClipperLib::long64(cellExtents.minLat*ptk::DBLMT);
+    ClipperLib::long64 top   = ClipperLib::long64(cellExtents.maxLat*ptk::DBLMT);
+
+    if(!calcAreaRectOverlap(left,btm,right,top,
+                            shape.minX,shape.minY,
+                            shape.maxX,shape.maxY))
+    {   return;   }
+
+    // clipped shapes that are completely inside
+    // the cell don't need to be clipped again
+    if(shape.clipped &&
+       shape.minX >= left && shape.maxX <= right &&
+       shape.minY >= btm && shape.maxY <= top)
+    {
+        listShapes.push_back(shape);
+        return;
+    }
+
+    ClipperLib::Polygon gridCell;
+    gridCell.push_back(ClipperLib::IntPoint(left,top));
+    gridCell.push_back(ClipperLib::IntPoint(left,btm));
+    gridCell.push_back(ClipperLib::IntPoint(right,btm));
+    gridCell.push_back(ClipperLib::IntPoint(right,top));
+
+    ClipperLib::Clipper clipperObj;
+    ClipperLib::ExPolygons xsecPolys;
+    clipperObj.AddPolygons(shape.rings,ClipperLib::ptSubject);
+    clipperObj.AddPolygon(gridCell,ClipperLib::ptClip);
+
+    if(clipperObj.Execute(ClipperLib::ctIntersection,xsecPolys))   {
+        for(size_t x=0; x < xsecPolys.size(); x++)   {
+            if(xsecPolys[x].outer.empty())   {
+                continue;
+            }
+            QuadShape xsecShape;
+            xsecShape.rings.reserve(1+xsecPolys[x].holes.size());
+            xsecShape.rings.push_back(std::move(xsecPolys[x].outer));
+            for(size_t y=0; y < xsecPolys[x].holes.size(); y++)   {
+                xsecShape.rings.push_back(std::move(xsecPolys[x].holes[y]));
+            }
+            CalcShapeBounds(xsecShape);
+            xsecShape.clipped = true;
+            listShapes.push_back(std::move(xsecShape));
+        }
+    }
+}
+
+inline void SplitQuadTile(QuadTile const &tile, QuadTile *children)
+{
+    BoundingBox const &pExtents = tile.extents;
+    double halfLonStep = (pExtents.maxLon-pExtents.minLon)/2;
+    double halfLatStep = (pExtents.maxLat-pExtents.minLat)/2;
+
+    char const * quadrants[4] = { "00","01","10","11" };
+    for(int q=0; q < 4; q++)   {
+        QuadTile &child = children[q];
+        child.quadKey = tile.quadKey+quadrants[q];
+        child.extents = pExtents;
+
+        // 00 top left, 01 top right, 10 bottom left, 11 bottom right
+        if(q & 1)   { child.extents.minLon += halfLonStep; }
+        else        { child.extents.maxLon -= halfLonStep; }
+        if(q & 2)   { child.extents.maxLat -= halfLatStep; }
+        else        { child.extents.minLat += halfLatStep; }
+
+        for(size_t i=0; i < tile.listShapes.size(); i++)   {
+            ClipQuadShape(tile.listShapes[i],child.extents,child.listShapes);
+        }
+    }
+}
+
+inline void SplitQuadTileToLeaves(QuadTile &tile,
+                                  unsigned int levelsLeft,
+                                  std::vector<QuadTile> &listLeaves)
+{
+    // splits tile depth first and moves the leaf tiles
+    // that have any shapes into listLeaves, in the same
+    // order (00,01,10,11 at every level) as their keys
+    if(tile.listShapes.empty())   {
+        return;
+    }
+    if(levelsLeft == 0)   {
+        listLeaves.push_back(std::move(tile));
+        return;
+    }
+
+    QuadTile children[4];
+    SplitQuadTile(tile,children);
+    std::vector<QuadShape>().swap(tile.listShapes);
+
+    for(int q=0; q < 4; q++)   {
+        SplitQuadTileToLeaves(children[q],levelsLeft-1,listLeaves);
+    }
+}
+
+inline void QuadShapeToPolyFeature(QuadShape const &shape, PolyFeature &feature)
+{
+    // clipper rings aren't closed, wkt rings are
+    feature.Clear();
+    ClipperLib::Polygons const &rings = shape.rings;
+    for(size_t j=0; j < rings.size(); j++)   {
+        for(size_t k=0; k < rings[j].size(); k++)
+        {   feature.AddPoint(double(rings[j][k].X)/ptk::DBLMT,double(rings[j][k].Y)/ptk::DBLMT);   }
+        feature.AddPoint(double(rings[j][0].X)/ptk::DBLMT,double(rings[j][0].Y)/ptk::DBLMT);
+        feature.EndRing();
+    }
+    feature.EndPart();
+    feature.CalcBounds();
+}
+
+#endif // PTK_QUADIFY_HPP
@@ -6,6 +6,10 @@
 #include <fstream>
 #include <stack>
 #include <set>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <limits>
 #include <dirent.h>
 #include <sys/time.h>
 
@@ -15,13 +19,21 @@
 // clipper
 #include "clipper/clipper.hpp"
 
+// threadpool
+#include <ThreadPool.h>
+#include <Parallel.h>
+
+#include "PolyBin.hpp"
+#include "ptk_quadify.hpp"
+
+using ptk::DBLMT;
+
 #define MINLON -180
 #define MAXLON -20
 #define MINLAT -58
 #define MAXLAT 86
 #define LONSTEP 20
 #define LATSTEP 18
-#define DBLMT 1E10
 
 // timing vars
 timeval t1,t2;
@@ -58,28 +70,6 @@ double StringToNumber ( const std::string &Text )
     return ss >> result ? result : 0;
 }
 
-struct BoundingBox
-{
-    double minLat;
-    double minLon;
-    double maxLat;
-    double maxLon;
-};
-
-
-bool calcAreaRectOverlap(double r1_bl_x, double r1_bl_y,
-                         double r1_tr_x, double r1_tr_y,
-                         double r2_bl_x, double r2_bl_y,
-                         double r2_tr_x, double r2_tr_y)
-{
-    // check if rectangles intersect
-    if((r1_tr_x < r2_bl_x) || (r1_bl_x > r2_tr_x) ||
-            (r1_tr_y < r2_bl_y) || (r1_bl_y > r2_tr_y))
-    {   return false;   }
-
-    return true;
-}
-
 BoundingBox getQuadKeyExtents(BoundingBox const &rootExtents,
                               std::string const &quadKey)
 {
@@ -131,12 +121,149 @@ BoundingBox getQuadKeyExtents(BoundingBox const &rootExtents,
     return myExtents;
 }
 
+// ============================================================= //
+
+// In memory mode (--mem)
+// * the input is parsed once and kept as clipper polygons
+//   (fixed point, DBLMT scale) with a bounding box, instead
+//   of being written out and re-parsed as wkt every level
+// * tiles are split breadth first until there are enough
+//   of them to keep every thread busy, then each subtree
+//   is split depth first on the thread pool so only one
+//   path of tiles per thread is held at a time
+// * only the leaf tiles are written, once each, with the
+//   same names and wkt as the level by level mode
+
+void WriteQuadTile(QuadTile const &tile,
+                   std::string const &outputPrefix,
+                   PolyFormat outputFormat)
+{
+    std::string tilePath = outputPrefix+tile.quadKey;
+    if(outputFormat == POLY_FORMAT_PBIN)   {
+        tilePath += ".pbin";
+    }
+
+    PolyWriter tileWriter;
+    tileWriter.Open(tilePath,outputFormat,false);
+
+    PolyFeature feature;
+    for(size_t i=0; i < tile.listShapes.size(); i++)   {
+        QuadShapeToPolyFeature(tile.listShapes[i],feature);
+        tileWriter.Write(feature);
+    }
+}
+
+void QuadifyTileDepthFirst(QuadTile &tile,
+                           unsigned int levelsLeft,
+                           std::string const &outputPrefix,
+                           PolyFormat outputFormat)
+{
+    if(levelsLeft == 0)   {
+        WriteQuadTile(tile,outputPrefix,outputFormat);
+        return;
+    }
+
+    QuadTile children[4];
+    SplitQuadTile(tile,children);
+    std::vector<QuadShape>().swap(tile.listShapes);
+
+    for(int q=0; q < 4; q++)   {
+        QuadifyTileDepthFirst(children[q],levelsLeft-1,outputPrefix,outputFormat);
+    }
+}
+
+void QuadifyInMemory(BoundingBox const &rootExtents,
+                     unsigned int numLevels,
+                     std::string const &inputFile,
+                     std::string const &outputPrefix)
+{
+    if(numLevels == 0)   {
+        return;
+    }
+
+    scratch::ThreadPool threadPool(
+                std::max(1u,std::thread::hardware_concurrency()));
+    size_t const numThreads = threadPool.GetThreadCount();
+
+    // parse the input once
+    PolyReader reader;
+    if(!reader.Open(inputFile))   {
+        std::cout << "ptk_quadify_wkt: Could not open " << inputFile << "\n";
+        return;
+    }
+    reader.ReadBatch(std::numeric_limits<size_t>::max());
+
+    // tiles are written in the same format as the input
+    PolyFormat const outputFormat = reader.GetFormat();
+
+    std::vector<QuadShape> listShapes(reader.GetBatchSize());
+    std::vector<char> listShapeOk(reader.GetBatchSize(),0);
+    scratch::ParallelForRange(threadPool,0,listShapes.size(),
+                              [&](size_t rangeBegin, size_t rangeEnd) {
+        PolyFeature feature;
+        std::string error;
+        for(size_t i=rangeBegin; i < rangeEnd; i++)   {
+            listShapeOk[i] = reader.GetFeature(i,feature,error) &&
+                             ParseQuadShape(feature,listShapes[i]);
+        }
+    },std::max<size_t>(1,listShapes.size()/(numThreads*8)));
+    reader.Close();
+
+    std::vector<QuadTile> listTiles(1);
+    listTiles[0].extents = rootExtents;
+    for(size_t i=0; i < listShapes.size(); i++)   {
+        if(listShapeOk[i])   {
+            listTiles[0].listShapes.push_back(std::move(listShapes[i]));
+        }
+    }
+    std::vector<QuadShape>().swap(listShapes);
+
+    std::cout << "ptk_quadify_wkt: Parsed "
+              << listTiles[0].listShapes.size() << " polygons\n";
+
+    // breadth first until there's a few tiles per thread
+    unsigned int level = 0;
+    while(level < numLevels && listTiles.size() < numThreads*4)   {
+        std::cout << "ptk_quadify_wkt: Level " << level << "\n";
+
+        std::vector<QuadTile> listChildren(listTiles.size()*4);
+        scratch::ParallelFor(threadPool,0,listTiles.size(),[&](size_t i) {
+            SplitQuadTile(listTiles[i],&listChildren[i*4]);
+        },1);
+        listTiles.swap(listChildren);
+        level++;
+    }
+
+    // then each subtree depth first
+    if(level < numLevels)   {
+        std::cout << "ptk_quadify_wkt: Levels " << level << "-" << numLevels-1
+                  << " for " << listTiles.size() << " tiles\n";
+    }
+
+    scratch::ParallelFor(threadPool,0,listTiles.size(),[&](size_t i) {
+        QuadifyTileDepthFirst(listTiles[i],numLevels-level,outputPrefix,outputFormat);
+    },1);
+}
+
+// ============================================================= //
+
 int main(int argc, const char *argv[])
 {
+    // --mem: split in memory, see QuadifyInMemory
+    bool inMemory = (argc == 9) && (std::string(argv[1]) == "--mem");
+    if(inMemory)   {
+        argv++;
+        argc--;
+    }
+
     if(argc != 8) {
-        std::cout << "Usage: #> ./ptk_quadify_wkt MINLON MAXLON MINLAT MAXLAT LEVELS inputfile.dat outputdir\n";
+        std::cout << "Usage: #> ./ptk_quadify_wkt [--mem] MINLON MAXLON MINLAT MAXLAT LEVELS inputfile.dat outputdir\n";
         std::cout << "* Expect each line of the input file to contain a single WKT def\n";
         std::cout << "* The output file is in the same format as the input file\n";
+        std::cout << "* --mem parses the input once and splits every level in memory,\n";
+        std::cout << "  writing only the final level of tiles\n";
+        std::cout << "* --mem also reads pbin input (see ptk_polybin), and writes\n";
+        std::cout << "  pbin tiles (TILE_xxx.pbin) for it\n";
         return 0;
     }
 
@@ -180,6 +307,21 @@ int main(int argc, const char *argv[])
     std::string outputPrefix = std::string(argv[7]);
     outputPrefix.append("/TILE_");
 
+    if(inMemory)   {
+        QuadifyInMemory(rootExtents,numLevels,argv[6],outputPrefix);
+        EndTiming();
+        return 0;
+    }
+
+    // the level by level mode only reads wkt
+    {
+        PolyReader reader;
+        if(reader.Open(argv[6]) && reader.GetFormat() == POLY_FORMAT_PBIN)   {
+            std::cout << "ptk_quadify_wkt: pbin input needs --mem\n";
+            return -1;
+        }
+    }
+
     std::string str00("00");
     std::string str01("01");
     std::string str10("10");
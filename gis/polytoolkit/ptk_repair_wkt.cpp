@@ -44,35 +44,25 @@
 #include <cstring>
 #include <fstream>
 #include <stack>
-#include <set>
+#include <vector>
+#include <thread>
+#include <algorithm>
 #include <sys/time.h>
 
 // OGR
 #include <ogrsf_frmts.h>
 
-// CGAL
-#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
-#include <CGAL/Triangulation_face_base_with_info_2.h>
-#include <CGAL/Constrained_Delaunay_triangulation_2.h>
-#include <CGAL/Constrained_triangulation_plus_2.h>
-#include <CGAL/Triangle_2.h>
+// threadpool
+#include <ThreadPool.h>
+#include <Parallel.h>
 
-typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
-typedef CGAL::Triangulation_vertex_base_2<K> VB;
-typedef CGAL::Constrained_triangulation_face_base_2<K> FB;
-typedef CGAL::Triangulation_face_base_with_info_2<void *, K, FB> FBWI;
-typedef CGAL::Triangulation_data_structure_2<VB, FBWI> TDS;
-typedef CGAL::Exact_predicates_tag PT;
-typedef CGAL::Exact_intersections_tag IT;
-typedef CGAL::Constrained_Delaunay_triangulation_2<K, TDS, PT> CDT;
+#include "PolyBin.hpp"
 
-typedef CGAL::Constrained_triangulation_plus_2<CDT> Triangulation;
-typedef Triangulation::Point Point;
+// prepair
+#include "ptk_prepair.hpp"
 
-
-OGRMultiPolygon* repair(OGRGeometry* geometry, Triangulation &triangulation);
-void tag(Triangulation &triangulation, void *interiorHandle, void *exteriorHandle);
-std::list<Triangulation::Vertex_handle> *getBoundary(Triangulation::Face_handle face, int edge);
+// features per batch, repaired in parallel
+size_t const k_batch_lines = 1024;
 
 // timing var
 timeval t1,t2;
@@ -94,346 +84,136 @@ void EndTiming()
               << timeTaken/1000 << " milliseconds" << std::endl;
 }
 
+// Each thread keeps a RepairScratch (the triangulation
+// and ring buffers) and reuses it for every feature it
+// repairs; the repaired polygons of a feature are encoded
+// on the thread and written out in input order
+struct RepairResult
+{
+    std::vector<std::string> listRecords;
+    std::string error;
+    size_t numDroppedRings;
+};
+
+struct RepairWorker
+{
+    RepairScratch repairScratch;
+    PolyFeature inputFeature;
+    PolyFeature outputFeature;
+    PolyFeature partFeature;
+};
+
+void RepairFeature(PolyReader const &reader,
+                   PolyWriter const &writer,
+                   size_t batchIdx,
+                   RepairWorker &worker,
+                   RepairResult &result)
+{
+    result.listRecords.clear();
+    result.numDroppedRings = 0;
+    if(!reader.GetFeature(batchIdx,worker.inputFeature,result.error))   {
+        return;     // ie. the trailing newline
+    }
+
+    if(worker.inputFeature.GetNumParts() != 1)   {
+        result.error = "Error: Could not repair geometry, "
+                       "WKT type is not a POLYGON()\n";
+        result.error += "-> WKT: " + reader.GetRecordDesc(batchIdx);
+        return;
+    }
+
+    if(!repairPolyFeature(worker.inputFeature,worker.outputFeature,
+                          worker.repairScratch))   {
+        result.error = "Error: Could not repair geometry,: "
+                       "input points are collinear (no area)\n ";
+        result.error += "-> WKT: " + reader.GetRecordDesc(batchIdx);
+        return;
+    }
+
+    // rings the repair couldn't place in a polygon
+    // are reported, the rest is still written
+    result.numDroppedRings = worker.repairScratch.buffers.numDroppedRings;
+    if(result.numDroppedRings > 0)   {
+        result.error = "Warning: Dropped " + std::to_string(result.numDroppedRings) +
+                       " ring(s) with no enclosing outer ring\n";
+        result.error += "-> WKT: " + reader.GetRecordDesc(batchIdx);
+    }
+
+    // output everything as POLYGONS()
+    PolyFeature const &outputFeature = worker.outputFeature;
+    result.listRecords.resize(outputFeature.GetNumParts());
+    for(size_t i=0; i < outputFeature.GetNumParts(); i++)   {
+        CopyPolyFeaturePart(outputFeature,i,worker.partFeature);
+        writer.Encode(worker.partFeature,result.listRecords[i]);
+    }
+}
 
 int main(int argc, const char *argv[])
 {
     if(argc != 3) {
         std::cout << "Usage: #> ./ptk_repair_wkt myinputfile myoutputfile\n";
         std::cout << "* Expect each line of the input file to contain a single WKT POLYGON() def\n";
-        std::cout << "* The output file is in the same format as the input file\n";
+        std::cout << "  or the input file to be pbin (see ptk_polybin)\n";
+        std::cout << "* The output file is pbin if it ends in .pbin and wkt otherwise\n";
         return 0;
     }
 
     StartTiming("[Repair Polygons]");
 
-    std::ifstream inputWktFile;
-    inputWktFile.open(argv[1]);
+    PolyReader reader;
+    PolyWriter writer;
 
-    std::ofstream outputWktFile;
-    outputWktFile.open(argv[2]);
-
-    // get number of input lines
-    unsigned int numInputLines=0;
-    if(inputWktFile.is_open())   {
-        while(!inputWktFile.eof())   {
-            std::string wktLine;
-            std::getline(inputWktFile,wktLine);
-            numInputLines++;
-        }
-    }
-    inputWktFile.close();
-    inputWktFile.open(argv[1]);
-
-    if(inputWktFile.is_open() && outputWktFile.is_open())
+    if(reader.Open(argv[1]) && writer.Open(argv[2]))
     {
-        int linesProcessed = 0;
-        outputWktFile << "WKT\n";
+        size_t linesProcessed = 0;
+        size_t numDroppedRings = 0;
 
-        while(!inputWktFile.eof())
-        {
-            std::string wktLine;
-            std::getline(inputWktFile,wktLine);
+        scratch::ThreadPool threadPool(
+                    std::max(1u,std::thread::hardware_concurrency()));
 
-            // remove any quotes around wktLine
-            if(wktLine[0] == '\"' || wktLine[0] == '\'')
-            {   wktLine.erase(0,1);   }
+        std::vector<RepairResult> listResults;
 
-            if(wktLine[wktLine.size()-1] == '\"' || wktLine[wktLine.size()-1] == '\'')
-            {   wktLine.erase(wktLine.size()-1,1);   }
-
-            // create geometry from wkt
-            char *inputWKT = new char[wktLine.size()+1];
-            char *inputWKTRef = inputWKT;
-            strcpy(inputWKT,wktLine.c_str());
-
-            OGRGeometry *inputGeometry;
-            OGRGeometryFactory::createFromWkt(&inputWKT, NULL, &inputGeometry);
-
-            if (inputGeometry == NULL)   {
-                std::cout << "Error: WKT is not valid (ignoring)" << std::endl;
-                std::cout << "-> WKT: " << wktLine << std::endl;
-                delete[] inputWKTRef;
-                continue;
-            }
-            delete[] inputWKTRef;
-
-            if(inputGeometry->getGeometryType() == wkbPolygon)   {
-                Triangulation cTri;
-                OGRMultiPolygon* outputPolygons = repair(inputGeometry,cTri);
+        while(reader.ReadBatch(k_batch_lines))
+        {
+            // polygons vary a lot in size, so they're
+            // handed out to the threads one at a time
+            listResults.resize(reader.GetBatchSize());
+            scratch::ParallelForRange(
+                        threadPool,0,listResults.size(),
+                        [&](size_t rangeBegin, size_t rangeEnd) {
+                static thread_local RepairWorker worker;
+                for(size_t i=rangeBegin; i < rangeEnd; i++) {
+                    RepairFeature(reader,writer,i,worker,listResults[i]);
+                }
+            },1);
 
-                if(!(outputPolygons == NULL))   {
-                    // output everything as POLYGONS()
-                    for(int i=0; i < outputPolygons->getNumGeometries(); i++)   {
-                        char *outputWKT;
-                        outputPolygons->getGeometryRef(i)->exportToWkt(&outputWKT);
-                        outputWktFile << outputWKT << std::endl;
-                        delete[] outputWKT;
-                    }
+            // write output in input order
+            for(auto const &result : listResults)
+            {
+                for(auto const &record : result.listRecords) {
+                    writer.WriteRecord(record);
                 }
-                else   {
-                    std::cout << "Error: Could not repair geometry,: "
-                                 "input points are collinear (no area)\n ";
-                    std::cout << "-> WKT: " << wktLine << "\n";
+                if(!result.error.empty()) {
+                    std::cout << result.error << std::endl;
                 }
-            }
-            else   {
-                std::cout << "Error: Could not repair geometry, "
-                             "WKT type is not a POLYGON()\n";
-                std::cout << "-> WKT: " << wktLine << "\n";
+                numDroppedRings += result.numDroppedRings;
             }
 
-            linesProcessed++;
-            std::cout << "Lines Processed: "
-                      << linesProcessed << "/"
-                      << numInputLines << std::endl;
+            linesProcessed += listResults.size();
+            std::cout << "Lines Processed: " << linesProcessed;
+            if(reader.GetFeatureCount() > 0)   {
+                std::cout << "/" << reader.GetFeatureCount();
+            }
+            std::cout << std::endl;
+        }
+        writer.Close();
 
-            // clean up
-            delete inputGeometry;
+        if(numDroppedRings > 0)   {
+            std::cout << "Warning: Dropped " << numDroppedRings
+                      << " ring(s) with no enclosing outer ring in total" << std::endl;
         }
-        inputWktFile.close();
-        outputWktFile.close();
     }
     EndTiming();
 
     return 0;
 }
-
-void tag(Triangulation &triangulation, void *interiorHandle, void *exteriorHandle) {
-	
-    // Clean tags
-    for (Triangulation::Face_handle currentFace = triangulation.all_faces_begin(); currentFace != triangulation.all_faces_end(); ++currentFace)
-        currentFace->info() = NULL;
-    
-    // Initialise tagging
-    std::stack<Triangulation::Face_handle> interiorStack, exteriorStack;
-    exteriorStack.push(triangulation.infinite_face());
-    std::stack<Triangulation::Face_handle> *currentStack = &exteriorStack;
-    std::stack<Triangulation::Face_handle> *dualStack = &interiorStack;
-    void *currentHandle = exteriorHandle;
-    void *dualHandle = interiorHandle;
-    
-    // Until we finish
-    while (!interiorStack.empty() || !exteriorStack.empty()) {
-        
-        // Give preference to whatever we're already doing
-        while (!currentStack->empty()) {
-            Triangulation::Face_handle currentFace = currentStack->top();
-			currentStack->pop();
-            if (currentFace->info() != NULL) continue;
-			currentFace->info() = currentHandle;
-            for (int currentEdge = 0; currentEdge < 3; ++currentEdge) {
-                if (currentFace->neighbor(currentEdge)->info() == NULL)
-                    if (currentFace->is_constrained(currentEdge)) dualStack->push(currentFace->neighbor(currentEdge));
-                else currentStack->push(currentFace->neighbor(currentEdge));
-            }
-        }
-			
-        // Flip
-        if (currentHandle == exteriorHandle) {
-            currentHandle = interiorHandle;
-            dualHandle = exteriorHandle;
-            currentStack = &interiorStack;
-            dualStack = &exteriorStack;
-        } else {
-            currentHandle = exteriorHandle;
-            dualHandle = interiorHandle;
-            currentStack = &exteriorStack;
-            dualStack = &interiorStack;
-        }
-	}
-}
-
-
-
-
-std::list<Triangulation::Vertex_handle> *getBoundary(Triangulation::Face_handle face, int edge) {
-    
-    std::list<Triangulation::Vertex_handle> *vertices = new std::list<Triangulation::Vertex_handle>();
-    
-    // Check clockwise edge
-    if (!face->is_constrained(face->cw(edge)) && face->neighbor(face->cw(edge))->info() != NULL) {
-		face->neighbor(face->cw(edge))->info() = NULL;
-		std::list<Triangulation::Vertex_handle> *v1 = getBoundary(face->neighbor(face->cw(edge)), face->neighbor(face->cw(edge))->index(face));
-		vertices->splice(vertices->end(), *v1);
-		delete v1;
-	}
-	
-	// Add central vertex
-	vertices->push_back(face->vertex(edge));
-	
-	// Check counterclockwise edge
-    if (!face->is_constrained(face->ccw(edge)) && face->neighbor(face->ccw(edge))->info() != NULL) {
-		face->neighbor(face->ccw(edge))->info() = NULL;
-		std::list<Triangulation::Vertex_handle> *v2 = getBoundary(face->neighbor(face->ccw(edge)), face->neighbor(face->ccw(edge))->index(face));
-		vertices->splice(vertices->end(), *v2);
-		delete v2;
-	}
-	
-    return vertices;
-}
-
-
-
-
-OGRMultiPolygon* repair(OGRGeometry* geometry, Triangulation &triangulation) {
-  
-  // Triangulation
-//  Triangulation triangulation;
-  switch (geometry->getGeometryType()) {
-      
-    case wkbPolygon: {
-      
-      OGRPolygon *polygon = (OGRPolygon *)geometry;
-      for (int currentPoint = 0; currentPoint < polygon->getExteriorRing()->getNumPoints(); ++currentPoint) {
-        triangulation.insert_constraint(Point(polygon->getExteriorRing()->getX(currentPoint), 
-                                              polygon->getExteriorRing()->getY(currentPoint)),
-                                        Point(polygon->getExteriorRing()->getX((currentPoint+1)%polygon->getExteriorRing()->getNumPoints()), 
-                                              polygon->getExteriorRing()->getY((currentPoint+1)%polygon->getExteriorRing()->getNumPoints())));
-      } for (int currentRing = 0; currentRing < polygon->getNumInteriorRings(); ++currentRing) {
-        for (int currentPoint = 0; currentPoint < polygon->getInteriorRing(currentRing)->getNumPoints(); ++currentPoint)
-          triangulation.insert_constraint(Point(polygon->getInteriorRing(currentRing)->getX(currentPoint), 
-                                                polygon->getInteriorRing(currentRing)->getY(currentPoint)),
-                                          Point(polygon->getInteriorRing(currentRing)->getX((currentPoint+1)%polygon->getInteriorRing(currentRing)->getNumPoints()), 
-                                                polygon->getInteriorRing(currentRing)->getY((currentPoint+1)%polygon->getInteriorRing(currentRing)->getNumPoints())));
-      } break;
-      
-    } default:
-      std::cout << "Error: Cannot understand input. Only polygons are supported." << std::endl;
-      break;
-  } 
-  
-//  std::cout << "Triangulation: " << triangulation.number_of_faces() << " faces, " << triangulation.number_of_vertices() << " vertices." << std::endl;
-  if (triangulation.number_of_faces() < 1) {
-    return NULL;
-  }
-  
-  // Tag
-  void *interior = malloc(sizeof(void *));
-  void *exterior = malloc(sizeof(void *));
-  tag(triangulation, interior, exterior);
-  
-  // Reconstruct
-  //    OGRMultiPolygon outputPolygons;
-  OGRMultiPolygon* outputPolygons = new OGRMultiPolygon();
-  for (Triangulation::Finite_faces_iterator seedingFace = triangulation.finite_faces_begin(); seedingFace != triangulation.finite_faces_end(); ++seedingFace) {
-    
-    if (seedingFace->info() != interior) continue;
-    
-    // Get boundary
-    std::list<Triangulation::Vertex_handle> *vertices = new std::list<Triangulation::Vertex_handle>();
-    seedingFace->info() = NULL;
-    if (seedingFace->neighbor(2)->info() == interior) {
-      seedingFace->neighbor(2)->info() = NULL;
-      std::list<Triangulation::Vertex_handle> *l2 = getBoundary(seedingFace->neighbor(2), seedingFace->neighbor(2)->index(seedingFace));
-      vertices->splice(vertices->end(), *l2);
-      delete l2;
-    } vertices->push_back(seedingFace->vertex(0));
-    if (seedingFace->neighbor(1)->info() == interior) {
-      seedingFace->neighbor(1)->info() = NULL;
-      std::list<Triangulation::Vertex_handle> *l1 = getBoundary(seedingFace->neighbor(1), seedingFace->neighbor(1)->index(seedingFace));
-      vertices->splice(vertices->end(), *l1);
-      delete l1;
-    } vertices->push_back(seedingFace->vertex(2));
-    if (seedingFace->neighbor(0)->info() == interior) {
-      seedingFace->neighbor(0)->info() = NULL;
-      std::list<Triangulation::Vertex_handle> *l0 = getBoundary(seedingFace->neighbor(0), seedingFace->neighbor(0)->index(seedingFace));
-      vertices->splice(vertices->end(), *l0);
-      delete l0;
-    } vertices->push_back(seedingFace->vertex(1));
-    
-    // Find cutting vertices
-    std::set<Triangulation::Vertex_handle> visitedVertices;
-    std::set<Triangulation::Vertex_handle> repeatedVertices;
-    for (std::list<Triangulation::Vertex_handle>::iterator currentVertex = vertices->begin(); currentVertex != vertices->end(); ++currentVertex) {
-      if (!visitedVertices.insert(*currentVertex).second) repeatedVertices.insert(*currentVertex);
-    } visitedVertices.clear();
-    
-    // Cut and join rings in the correct order
-    std::list<std::list<Triangulation::Vertex_handle> *> rings;
-    std::stack<std::list<Triangulation::Vertex_handle> *> chainsStack;
-    std::map<Triangulation::Vertex_handle, std::list<Triangulation::Vertex_handle> *> vertexChainMap;
-    std::list<Triangulation::Vertex_handle> *newChain = new std::list<Triangulation::Vertex_handle>();
-    for (std::list<Triangulation::Vertex_handle>::iterator currentVertex = vertices->begin(); currentVertex != vertices->end(); ++currentVertex) {
-      
-      // New chain
-      if (repeatedVertices.count(*currentVertex) > 0) {
-        // Closed by itself
-        if (newChain->front() == *currentVertex) {
-          // Degenerate (insufficient vertices to be valid)
-          if (newChain->size() < 3) delete newChain;
-          else {
-            std::list<Triangulation::Vertex_handle>::iterator secondElement = newChain->begin();
-            ++secondElement;
-            // Degenerate (zero area)
-            if (newChain->back() == *secondElement) delete newChain;
-            // Valid
-            else rings.push_back(newChain);
-          }
-        }
-        // Open by itself
-        else {
-          // Closed with others in stack
-          if (vertexChainMap.count(*currentVertex)) {
-            
-            while (chainsStack.top() != vertexChainMap[*currentVertex]) {
-              newChain->splice(newChain->begin(), *chainsStack.top());
-              chainsStack.pop();
-            } newChain->splice(newChain->begin(), *chainsStack.top());
-            chainsStack.pop();
-            vertexChainMap.erase(*currentVertex);
-            // Degenerate (insufficient vertices to be valid)
-            if (newChain->size() < 3) delete newChain;
-            else {
-              std::list<Triangulation::Vertex_handle>::iterator secondElement = newChain->begin();
-              ++secondElement;
-              // Degenerate (zero area)
-              if (newChain->back() == *secondElement) delete newChain;
-              // Valid
-              else rings.push_back(newChain);
-            }
-          }
-          // Open
-          else {
-            // Not first chain
-            if (repeatedVertices.count(newChain->front()) > 0) vertexChainMap[newChain->front()] = newChain;
-            chainsStack.push(newChain);
-          }
-        } newChain = new std::list<Triangulation::Vertex_handle>();
-      } newChain->push_back(*currentVertex);
-    }
-    // Final ring
-    while (chainsStack.size() > 0) {
-      newChain->splice(newChain->begin(), *chainsStack.top());
-      chainsStack.pop();
-    }
-    // Degenerate (insufficient vertices to be valid)
-    if (newChain->size() < 3) delete newChain;
-    else {
-      std::list<Triangulation::Vertex_handle>::iterator secondElement = newChain->begin();
-      ++secondElement;
-      // Degenerate (zero area)
-      if (newChain->back() == *secondElement) delete newChain;
-      // Valid
-      else rings.push_back(newChain);
-    }
-    // Make rings
-    std::list<OGRLinearRing *> ringsForPolygon;
-    for (std::list<std::list<Triangulation::Vertex_handle> *>::iterator currentRing = rings.begin(); currentRing != rings.end(); ++currentRing) {
-      OGRLinearRing *newRing = new OGRLinearRing();
-      for (std::list<Triangulation::Vertex_handle>::reverse_iterator currentVertex = (*currentRing)->rbegin(); currentVertex != (*currentRing)->rend(); ++currentVertex) {
-        newRing->addPoint((*currentVertex)->point().x(), (*currentVertex)->point().y());
-      } newRing->addPoint((*currentRing)->back()->point().x(), (*currentRing)->back()->point().y());
-      ringsForPolygon.push_back(newRing);
-    } OGRPolygon *newPolygon = new OGRPolygon();
-    for (std::list<OGRLinearRing *>::iterator currentRing = ringsForPolygon.begin(); currentRing != ringsForPolygon.end(); ++currentRing) {
-      if (!(*currentRing)->isClockwise()) {
-        newPolygon->addRingDirectly(*currentRing);
-        break;
-      }
-    } for (std::list<OGRLinearRing *>::iterator currentRing = ringsForPolygon.begin(); currentRing != ringsForPolygon.end(); ++currentRing)
-      if ((*currentRing)->isClockwise()) newPolygon->addRingDirectly(*currentRing);
-    outputPolygons->addGeometryDirectly(newPolygon);
-  }
-  return outputPolygons;
-}
-
@@ -1,10 +1,25 @@
 TEMPLATE = app
 CONFIG += console debug
 CONFIG -= qt
+HEADERS += PolyBin.hpp ptk_prepair.hpp
 SOURCES += ptk_repair_wkt.cpp
 TARGET = ptk_repair_wkt
 
+# threadpool
+PATH_THREADPOOL = $$PWD/../../utils/threadpool
+INCLUDEPATH += $${PATH_THREADPOOL}
+HEADERS += \
+    $${PATH_THREADPOOL}/ThreadPool.h \
+    $${PATH_THREADPOOL}/Parallel.h
+SOURCES += \
+    $${PATH_THREADPOOL}/Job.cpp \
+    $${PATH_THREADPOOL}/ThreadPool.cpp \
+    $${PATH_THREADPOOL}/ThreadPoolStats.cpp
+
 # required libs
 LIBS += -lgdal -lCGAL_Core -lCGAL -lmpfr -lgmp -lboost_thread
 
-QMAKE_CXXFLAGS += -std=c++0x
+# need these flags for gcc 4.8.x bug for threads
+QMAKE_LFLAGS += -Wl,--no-as-needed
+LIBS += -lpthread
+QMAKE_CXXFLAGS += -std=c++11
@@ -0,0 +1,173 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef PTK_SIMPLIFY_HPP
+#define PTK_SIMPLIFY_HPP
+
+// Visvalingam-Whyatt simplification of PolyFeatures,
+// shared by ptk_simplify_wkt and ptk_pipeline
+
+// STL
+#include <vector>
+#include <cmath>
+
+#include "Vec2.hpp"
+#include "PolyBin.hpp"
+
+#include <VWHeap.h>
+
+inline double calcAreaTriangle(double a_x, double a_y,
+                               double b_x, double b_y,
+                               double c_x, double c_y)
+{   // http://www.mathopenref.com/coordtrianglearea.html
+    return fabs((a_x*(b_y-c_y) + b_x*(c_y-a_y) + c_x*(a_y-b_y))/2);
+}
+
+// Scratch space for simplifyWithVW, kept per thread so
+// simplifying a ring doesn't allocate once it's warmed up
+struct VWScratch
+{
+    std::vector<Vec2> listPts;
+    std::vector<unsigned int> listPrev;
+    std::vector<unsigned int> listNext;
+    scratch::VWHeap<unsigned int> heap;
+
+    PolyFeature inputFeature;
+    PolyFeature outputFeature;
+};
+
+inline void simplifyWithVW(double const *ringXY,
+                           unsigned int numRingPts,
+                           double vwArea,
+                           PolyFeature &output,
+                           VWScratch &vwScratch)
+{
+    // http://www2.dcs.hull.ac.uk/CISRG/publications/DPs/DP10/DP10.html
+    // * points are kept in a doubly linked list over arrays
+    //   and ordered by effective area in an indexed heap, so
+    //   removing a point and updating its neighbours is
+    //   O(log n) with no allocation
+    // * the first and last points don't have an eff. area
+    //   and are always kept
+    // * points with an effective area less than vwArea
+    //   are removed
+    if(numRingPts < 4)   {
+        for(unsigned int i=0; i < numRingPts; i++)   {
+            output.AddPoint(ringXY[i*2],ringXY[i*2+1]);
+        }
+        output.EndRing();
+        return;
+    }
+
+    unsigned int numPts = numRingPts-1;     // ignore the last point since
+                                            // the last point == first point
+    std::vector<Vec2> &listPts = vwScratch.listPts;
+    listPts.resize(numPts);
+    for(unsigned int i=0; i < numPts; i++)   {
+        listPts[i] = Vec2(ringXY[i*2],ringXY[i*2+1]);
+    }
+
+    unsigned int sIdx = 0;
+    unsigned int eIdx = numPts-1;
+
+    std::vector<unsigned int> &listPrev = vwScratch.listPrev;
+    std::vector<unsigned int> &listNext = vwScratch.listNext;
+    listPrev.assign(numPts,sIdx);
+    listNext.assign(numPts,eIdx);
+
+    scratch::VWHeap<unsigned int> &heap = vwScratch.heap;
+    heap.Reset(numPts);
+
+    // * compute the effective area of each point, and
+    //   drop points with an effective area of zero
+    //   (this indicates a colinear set of pts)
+    unsigned int lastIdx = sIdx;
+    for(unsigned int i=1; i < numPts-1; i++)   {
+        double triArea = calcAreaTriangle(listPts[i-1].x,listPts[i-1].y,
+                                          listPts[i+0].x,listPts[i+0].y,
+                                          listPts[i+1].x,listPts[i+1].y);
+        if(triArea > 0)   {
+            heap.Push(i,triArea);
+            listPrev[i] = lastIdx;
+            listNext[lastIdx] = i;
+            lastIdx = i;
+        }
+    }
+    listNext[lastIdx] = eIdx;
+    listPrev[eIdx] = lastIdx;
+
+    // * remove the point with the least effective area
+    //   until it's above the threshold
+    while(heap.GetSize() >= 3)   {
+        unsigned int cIdx = heap.GetTop();
+        if(!(heap.GetArea(cIdx) < vwArea))   {
+            break;
+        }
+        heap.Pop();
+
+        unsigned int pIdx = listPrev[cIdx];
+        unsigned int nIdx = listNext[cIdx];
+        listNext[pIdx] = nIdx;
+        listPrev[nIdx] = pIdx;
+
+        if(nIdx != eIdx)   {
+            // recalculate the adjacent triangle
+            // area for the next index (pIdx,nIdx,nIdx_next)
+            unsigned int nIdx_next = listNext[nIdx];
+            heap.Update(nIdx,calcAreaTriangle(listPts[pIdx].x,listPts[pIdx].y,
+                                              listPts[nIdx].x,listPts[nIdx].y,
+                                              listPts[nIdx_next].x,listPts[nIdx_next].y));
+        }
+
+        if(pIdx != sIdx)   {
+            // recalculate the adjacent triangle
+            // area for the prev index (nIdx,pIdx,pIdx_prev)
+            unsigned int pIdx_prev = listPrev[pIdx];
+            heap.Update(pIdx,calcAreaTriangle(listPts[nIdx].x,listPts[nIdx].y,
+                                              listPts[pIdx].x,listPts[pIdx].y,
+                                              listPts[pIdx_prev].x,listPts[pIdx_prev].y));
+        }
+    }
+
+    // save
+    for(unsigned int i=sIdx; i != eIdx; i=listNext[i])   {
+        output.AddPoint(listPts[i].x,listPts[i].y);
+    }
+    output.AddPoint(listPts[eIdx].x,listPts[eIdx].y);       // last
+    output.AddPoint(listPts[sIdx].x,listPts[sIdx].y);       // wrap == first
+    output.EndRing();
+}
+
+inline void simplifyFeatureWithVW(PolyFeature const &input,
+                                  double vwArea,
+                                  PolyFeature &output,
+                                  VWScratch &vwScratch)
+{
+    // this algorithm works on polylines -- so we operate
+    // on the constituent rings of the polygons
+    output.Clear();
+    for(size_t p=0; p < input.GetNumParts(); p++)   {
+        for(uint32_t r=input.listPartRings[p]; r < input.listPartRings[p+1]; r++)   {
+            uint32_t ptBegin = input.listRingPts[r];
+            uint32_t ptEnd = input.listRingPts[r+1];
+            simplifyWithVW(input.listXY.data()+ptBegin*2,ptEnd-ptBegin,vwArea,output,vwScratch);
+        }
+        output.EndPart();
+    }
+    output.CalcBounds();
+}
+
+#endif // PTK_SIMPLIFY_HPP
@@ -30,8 +30,19 @@ SOURCES += openctm/stream.c \
            openctm/compressMG1.c
 
 # ptk_wkt_to_ctm
+HEADERS += PolyBin.hpp ptk_prepair.hpp ptk_mesh.hpp
 SOURCES += ptk_wkt_to_ctm.cpp
 
+# vertexweld
+PATH_VERTEXWELD = $$PWD/../../utils/vertexweld
+INCLUDEPATH += $${PATH_VERTEXWELD}
+HEADERS += $${PATH_VERTEXWELD}/VertexWelder.h
+
+# geodesy
+PATH_GEODESY = $$PWD/../../utils/geodesy
+INCLUDEPATH += $${PATH_GEODESY}
+HEADERS += $${PATH_GEODESY}/Geodesy.h
+
 # required libs
 LIBS += -lgdal -lCGAL_Core -lCGAL -lmpfr -lgmp -lboost_thread
 
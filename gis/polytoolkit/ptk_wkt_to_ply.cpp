@@ -50,56 +50,29 @@
 // OGR
 #include <ogrsf_frmts.h>
 
-// CGAL
-#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
-#include <CGAL/Triangulation_face_base_with_info_2.h>
-#include <CGAL/Constrained_Delaunay_triangulation_2.h>
-#include <CGAL/Constrained_triangulation_plus_2.h>
-#include <CGAL/Triangle_2.h>
+// prepair
+#include "ptk_prepair.hpp"
 
 // rply
 #include "rply/rply.h"
 
+// vertexweld
+#include <VertexWelder.h>
+
+// geodesy
+#include <Geodesy.h>
+
 // geom defs
 #include "Vec2.hpp"
 #include "Vec3.hpp"
 
-// PI!
-#define K_PI 3.141592653589
-
 // epsilon
 #define K_EPS 1E-11
 
-// WGS84 ellipsoid parameters
-// (http://en.wikipedia.org/wiki/WGS_84)
-#define ELL_SEMI_MAJOR 6378137.0            // meters
-#define ELL_SEMI_MAJOR_EXP2 40680631590769
-
-#define ELL_SEMI_MINOR 6356752.3142         // meters
-#define ELL_SEMI_MINOR_EXP2 40408299984087.1
-
-#define ELL_F 1/298.257223563
-#define ELL_ECC_EXP2 6.69437999014e-3
-#define ELL_ECC2_EXP2 6.73949674228e-3
-
 #define USE_ECEF false
 
-typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
-typedef CGAL::Triangulation_vertex_base_2<K> VB;
-typedef CGAL::Constrained_triangulation_face_base_2<K> FB;
-typedef CGAL::Triangulation_face_base_with_info_2<void *, K, FB> FBWI;
-typedef CGAL::Triangulation_data_structure_2<VB, FBWI> TDS;
-typedef CGAL::Exact_predicates_tag PT;
-typedef CGAL::Exact_intersections_tag IT;
-typedef CGAL::Constrained_Delaunay_triangulation_2<K, TDS, PT> CDT;
-
-typedef CGAL::Constrained_triangulation_plus_2<CDT> Triangulation;
-typedef Triangulation::Point Point;
-
-
-OGRMultiPolygon* repair(OGRGeometry* geometry, Triangulation &triangulation);
-void tag(Triangulation &triangulation, void *interiorHandle, void *exteriorHandle);
-std::list<Triangulation::Vertex_handle> *getBoundary(Triangulation::Face_handle face, int edge);
+// vertices closer than this (on every axis) are welded
+#define WELD_EPS 1E-9
 
 // timing var
 timeval t1,t2;
@@ -136,69 +109,23 @@ bool compareVec3(Vec3 const &first, Vec3 const &second)
     return false;
 }
 
-std::string Vec3ToString (Vec3 const &myVec)
-{
-    std::stringstream ss;
-    ss.precision(12);
-    ss << myVec.x << "," << myVec.y << "," << myVec.z << std::endl;
-    return ss.str();
-}
-
-Vec3 StringToVec3(const std::string &myText)
-{
-    unsigned int xEnd = myText.find(",");
-    unsigned int yEnd = myText.find_last_of(",");
-    std::string xStr = myText.substr(0,xEnd);
-    std::string yStr = myText.substr(xEnd+1,yEnd-xEnd-1);
-    std::string zStr = myText.substr(yEnd+1);
-
-    Vec3 myVec;
-    std::stringstream ssX(xStr);
-    ssX >> myVec.x;
-
-    std::stringstream ssY(yStr);
-    ssY >> myVec.y;
-
-    std::stringstream ssZ(zStr);
-    ssZ >> myVec.z;
-
-    return myVec;
-}
-
-class PointLLA
+// converts (lon,lat) vertices to WGS84 ECEF in place
+void ConvVerticesLLAToECEF(std::vector<Vec3> &listVertices)
 {
-public:
-    PointLLA() :
-        lon(0),lat(0),alt(0) {}
-
-    PointLLA(double myLat, double myLon) :
-        lat(myLat),lon(myLon),alt(0) {}
-
-    PointLLA(double myLat, double myLon, double myAlt) :
-        lon(myLon),lat(myLat),alt(myAlt) {}
-
-    double lon;
-    double lat;
-    double alt;
-};
-
-Vec3 convLLAToECEF(const PointLLA &pointLLA)
-{
-    Vec3 pointECEF;
-
-    // remember to convert deg->rad
-    double sinLat = sin(pointLLA.lat * K_PI/180.0f);
-    double sinLon = sin(pointLLA.lon * K_PI/180.0f);
-    double cosLat = cos(pointLLA.lat * K_PI/180.0f);
-    double cosLon = cos(pointLLA.lon * K_PI/180.0f);
+    size_t const numVertices = listVertices.size();
+    std::vector<double> listLon(numVertices),listLat(numVertices);
+    for(size_t i=0; i < numVertices; i++)   {
+        listLon[i] = listVertices[i].x;
+        listLat[i] = listVertices[i].y;
+    }
 
-    // v = radius of curvature (meters)
-    double v = ELL_SEMI_MAJOR / (sqrt(1-(ELL_ECC_EXP2*sinLat*sinLat)));
-    pointECEF.x = (v + pointLLA.alt) * cosLat * cosLon;
-    pointECEF.y = (v + pointLLA.alt) * cosLat * sinLon;
-    pointECEF.z = ((1-ELL_ECC_EXP2)*v + pointLLA.alt)*sinLat;
+    std::vector<double> listX(numVertices),listY(numVertices),listZ(numVertices);
+    scratch::geodesy::ConvLLAToECEF(numVertices,listLon.data(),listLat.data(),NULL,
+                                    listX.data(),listY.data(),listZ.data());
 
-    return pointECEF;
+    for(size_t i=0; i < numVertices; i++)   {
+        listVertices[i] = Vec3(listX[i],listY[i],listZ[i]);
+    }
 }
 
 inline int isLeft( Vec2 P0, Vec2 P1, Vec2 P2 )
@@ -502,10 +429,6 @@ int main(int argc, const char *argv[])
                     {
                         if(listTrisToKeep[triIt-listCDTTriangles.begin()])
                         {
-//                            Vec3 pt0 = convLLAToECEF(PointLLA(triIt->A.y,triIt->A.x));
-//                            Vec3 pt1 = convLLAToECEF(PointLLA(triIt->B.y,triIt->B.x));
-//                            Vec3 pt2 = convLLAToECEF(PointLLA(triIt->C.y,triIt->C.x));
-
                             Vec3 pt0(triIt->A.x,triIt->A.y,0);
                             Vec3 pt1(triIt->B.x,triIt->B.y,0);
                             Vec3 pt2(triIt->C.x,triIt->C.y,0);
@@ -532,36 +455,32 @@ int main(int argc, const char *argv[])
         }
         wktFile.close();
 
-        // clean mesh to remove duplicate verts
-        std::vector<std::string>::iterator vecStrIt;
-        std::vector<std::string> listUniqueVertexStrings(triMesh.listVertices.size());
-        for(int i=0; i < triMesh.listVertices.size(); i++)   {
-            listUniqueVertexStrings[i] = Vec3ToString(triMesh.listVertices[i]);
-        }
-        std::sort(listUniqueVertexStrings.begin(),listUniqueVertexStrings.end());
-        vecStrIt = std::unique(listUniqueVertexStrings.begin(),listUniqueVertexStrings.end());
-        listUniqueVertexStrings.resize(vecStrIt-listUniqueVertexStrings.begin());
-
-        std::vector<unsigned int> idxMap;
-        for(int i=0; i < triMesh.listVertices.size(); i++)   {
-            vecStrIt = std::lower_bound(listUniqueVertexStrings.begin(),
-                                        listUniqueVertexStrings.end(),
-                                        Vec3ToString(triMesh.listVertices[i]));
-            idxMap.push_back(vecStrIt-listUniqueVertexStrings.begin());
-        }
-
-        triMesh.listVertices.clear();
-        for(int i=0; i < listUniqueVertexStrings.size(); i++)   {
-            triMesh.listVertices.push_back(StringToVec3(listUniqueVertexStrings[i]));
+        // clean mesh to remove duplicate verts; the
+        // welded verts keep the order they're first used in
+        scratch::VertexWelder vxWelder(WELD_EPS,triMesh.listVertices.size()/4);
+        std::vector<Vec3> listUniqueVertices;
+        std::vector<unsigned int> idxMap(triMesh.listVertices.size());
+        for(size_t i=0; i < triMesh.listVertices.size(); i++)   {
+            Vec3 const &vx = triMesh.listVertices[i];
+            bool isNew;
+            idxMap[i] = vxWelder.Weld(vx.x,vx.y,vx.z,&isNew);
+            if(isNew)   {
+                listUniqueVertices.push_back(vx);
+            }
         }
+        triMesh.listVertices.swap(listUniqueVertices);
 
         for(int i=0; i < triMesh.listIdxs.size(); i++)   {
             unsigned int oldIdx = triMesh.listIdxs[i];
             triMesh.listIdxs[i] = idxMap[oldIdx];
         }
 
-        std::cout << "# Num Unique Verts: " << listUniqueVertexStrings.size() << "\n";
+        std::cout << "# Num Unique Verts: " << triMesh.listVertices.size() << "\n";
         EndTiming();
+
+        if(USE_ECEF)   {
+            ConvVerticesLLAToECEF(triMesh.listVertices);
+        }
 //        return 0;
 
 
@@ -598,243 +517,3 @@ int main(int argc, const char *argv[])
 
     return 0;
 }
-
-void tag(Triangulation &triangulation, void *interiorHandle, void *exteriorHandle) {
-
-    // Clean tags
-    for (Triangulation::Face_handle currentFace = triangulation.all_faces_begin(); currentFace != triangulation.all_faces_end(); ++currentFace)
-        currentFace->info() = NULL;
-
-    // Initialise tagging
-    std::stack<Triangulation::Face_handle> interiorStack, exteriorStack;
-    exteriorStack.push(triangulation.infinite_face());
-    std::stack<Triangulation::Face_handle> *currentStack = &exteriorStack;
-    std::stack<Triangulation::Face_handle> *dualStack = &interiorStack;
-    void *currentHandle = exteriorHandle;
-    void *dualHandle = interiorHandle;
-
-    // Until we finish
-    while (!interiorStack.empty() || !exteriorStack.empty()) {
-
-        // Give preference to whatever we're already doing
-        while (!currentStack->empty()) {
-            Triangulation::Face_handle currentFace = currentStack->top();
-            currentStack->pop();
-            if (currentFace->info() != NULL) continue;
-            currentFace->info() = currentHandle;
-            for (int currentEdge = 0; currentEdge < 3; ++currentEdge) {
-                if (currentFace->neighbor(currentEdge)->info() == NULL)
-                    if (currentFace->is_constrained(currentEdge)) dualStack->push(currentFace->neighbor(currentEdge));
-                else currentStack->push(currentFace->neighbor(currentEdge));
-            }
-        }
-
-        // Flip
-        if (currentHandle == exteriorHandle) {
-            currentHandle = interiorHandle;
-            dualHandle = exteriorHandle;
-            currentStack = &interiorStack;
-            dualStack = &exteriorStack;
-        } else {
-            currentHandle = exteriorHandle;
-            dualHandle = interiorHandle;
-            currentStack = &exteriorStack;
-            dualStack = &interiorStack;
-        }
-    }
-}
-
-
-
-
-std::list<Triangulation::Vertex_handle> *getBoundary(Triangulation::Face_handle face, int edge) {
-
-    std::list<Triangulation::Vertex_handle> *vertices = new std::list<Triangulation::Vertex_handle>();
-
-    // Check clockwise edge
-    if (!face->is_constrained(face->cw(edge)) && face->neighbor(face->cw(edge))->info() != NULL) {
-        face->neighbor(face->cw(edge))->info() = NULL;
-        std::list<Triangulation::Vertex_handle> *v1 = getBoundary(face->neighbor(face->cw(edge)), face->neighbor(face->cw(edge))->index(face));
-        vertices->splice(vertices->end(), *v1);
-        delete v1;
-    }
-
-    // Add central vertex
-    vertices->push_back(face->vertex(edge));
-
-    // Check counterclockwise edge
-    if (!face->is_constrained(face->ccw(edge)) && face->neighbor(face->ccw(edge))->info() != NULL) {
-        face->neighbor(face->ccw(edge))->info() = NULL;
-        std::list<Triangulation::Vertex_handle> *v2 = getBoundary(face->neighbor(face->ccw(edge)), face->neighbor(face->ccw(edge))->index(face));
-        vertices->splice(vertices->end(), *v2);
-        delete v2;
-    }
-
-    return vertices;
-}
-
-
-
-
-OGRMultiPolygon* repair(OGRGeometry* geometry, Triangulation &triangulation) {
-
-  // Triangulation
-//  Triangulation triangulation;
-  switch (geometry->getGeometryType()) {
-
-    case wkbPolygon: {
-
-      OGRPolygon *polygon = (OGRPolygon *)geometry;
-      for (int currentPoint = 0; currentPoint < polygon->getExteriorRing()->getNumPoints(); ++currentPoint) {
-        triangulation.insert_constraint(Point(polygon->getExteriorRing()->getX(currentPoint),
-                                              polygon->getExteriorRing()->getY(currentPoint)),
-                                        Point(polygon->getExteriorRing()->getX((currentPoint+1)%polygon->getExteriorRing()->getNumPoints()),
-                                              polygon->getExteriorRing()->getY((currentPoint+1)%polygon->getExteriorRing()->getNumPoints())));
-      } for (int currentRing = 0; currentRing < polygon->getNumInteriorRings(); ++currentRing) {
-        for (int currentPoint = 0; currentPoint < polygon->getInteriorRing(currentRing)->getNumPoints(); ++currentPoint)
-          triangulation.insert_constraint(Point(polygon->getInteriorRing(currentRing)->getX(currentPoint),
-                                                polygon->getInteriorRing(currentRing)->getY(currentPoint)),
-                                          Point(polygon->getInteriorRing(currentRing)->getX((currentPoint+1)%polygon->getInteriorRing(currentRing)->getNumPoints()),
-                                                polygon->getInteriorRing(currentRing)->getY((currentPoint+1)%polygon->getInteriorRing(currentRing)->getNumPoints())));
-      } break;
-
-    } default:
-      std::cout << "Error: Cannot understand input. Only polygons are supported." << std::endl;
-      break;
-  }
-
-//  std::cout << "Triangulation: " << triangulation.number_of_faces() << " faces, " << triangulation.number_of_vertices() << " vertices." << std::endl;
-  if (triangulation.number_of_faces() < 1) {
-    return NULL;
-  }
-
-  // Tag
-  void *interior = malloc(sizeof(void *));
-  void *exterior = malloc(sizeof(void *));
-  tag(triangulation, interior, exterior);
-
-  // Reconstruct
-  //    OGRMultiPolygon outputPolygons;
-  OGRMultiPolygon* outputPolygons = new OGRMultiPolygon();
-  for (Triangulation::Finite_faces_iterator seedingFace = triangulation.finite_faces_begin(); seedingFace != triangulation.finite_faces_end(); ++seedingFace) {
-
-    if (seedingFace->info() != interior) continue;
-
-    // Get boundary
-    std::list<Triangulation::Vertex_handle> *vertices = new std::list<Triangulation::Vertex_handle>();
-    seedingFace->info() = NULL;
-    if (seedingFace->neighbor(2)->info() == interior) {
-      seedingFace->neighbor(2)->info() = NULL;
-      std::list<Triangulation::Vertex_handle> *l2 = getBoundary(seedingFace->neighbor(2), seedingFace->neighbor(2)->index(seedingFace));
-      vertices->splice(vertices->end(), *l2);
-      delete l2;
-    } vertices->push_back(seedingFace->vertex(0));
-    if (seedingFace->neighbor(1)->info() == interior) {
-      seedingFace->neighbor(1)->info() = NULL;
-      std::list<Triangulation::Vertex_handle> *l1 = getBoundary(seedingFace->neighbor(1), seedingFace->neighbor(1)->index(seedingFace));
-      vertices->splice(vertices->end(), *l1);
-      delete l1;
-    } vertices->push_back(seedingFace->vertex(2));
-    if (seedingFace->neighbor(0)->info() == interior) {
-      seedingFace->neighbor(0)->info() = NULL;
-      std::list<Triangulation::Vertex_handle> *l0 = getBoundary(seedingFace->neighbor(0), seedingFace->neighbor(0)->index(seedingFace));
-      vertices->splice(vertices->end(), *l0);
-      delete l0;
-    } vertices->push_back(seedingFace->vertex(1));
-
-    // Find cutting vertices
-    std::set<Triangulation::Vertex_handle> visitedVertices;
-    std::set<Triangulation::Vertex_handle> repeatedVertices;
-    for (std::list<Triangulation::Vertex_handle>::iterator currentVertex = vertices->begin(); currentVertex != vertices->end(); ++currentVertex) {
-      if (!visitedVertices.insert(*currentVertex).second) repeatedVertices.insert(*currentVertex);
-    } visitedVertices.clear();
-
-    // Cut and join rings in the correct order
-    std::list<std::list<Triangulation::Vertex_handle> *> rings;
-    std::stack<std::list<Triangulation::Vertex_handle> *> chainsStack;
-    std::map<Triangulation::Vertex_handle, std::list<Triangulation::Vertex_handle> *> vertexChainMap;
-    std::list<Triangulation::Vertex_handle> *newChain = new std::list<Triangulation::Vertex_handle>();
-    for (std::list<Triangulation::Vertex_handle>::iterator currentVertex = vertices->begin(); currentVertex != vertices->end(); ++currentVertex) {
-
-      // New chain
-      if (repeatedVertices.count(*currentVertex) > 0) {
-        // Closed by itself
-        if (newChain->front() == *currentVertex) {
-          // Degenerate (insufficient vertices to be valid)
-          if (newChain->size() < 3) delete newChain;
-          else {
-            std::list<Triangulation::Vertex_handle>::iterator secondElement = newChain->begin();
-            ++secondElement;
-            // Degenerate (zero area)
-            if (newChain->back() == *secondElement) delete newChain;
-            // Valid
-            else rings.push_back(newChain);
-          }
-        }
-        // Open by itself
-        else {
-          // Closed with others in stack
-          if (vertexChainMap.count(*currentVertex)) {
-
-            while (chainsStack.top() != vertexChainMap[*currentVertex]) {
-              newChain->splice(newChain->begin(), *chainsStack.top());
-              chainsStack.pop();
-            } newChain->splice(newChain->begin(), *chainsStack.top());
-            chainsStack.pop();
-            vertexChainMap.erase(*currentVertex);
-            // Degenerate (insufficient vertices to be valid)
-            if (newChain->size() < 3) delete newChain;
-            else {
-              std::list<Triangulation::Vertex_handle>::iterator secondElement = newChain->begin();
-              ++secondElement;
-              // Degenerate (zero area)
-              if (newChain->back() == *secondElement) delete newChain;
-              // Valid
-              else rings.push_back(newChain);
-            }
-          }
-          // Open
-          else {
-            // Not first chain
-            if (repeatedVertices.count(newChain->front()) > 0) vertexChainMap[newChain->front()] = newChain;
-            chainsStack.push(newChain);
-          }
-        } newChain = new std::list<Triangulation::Vertex_handle>();
-      } newChain->push_back(*currentVertex);
-    }
-    // Final ring
-    while (chainsStack.size() > 0) {
-      newChain->splice(newChain->begin(), *chainsStack.top());
-      chainsStack.pop();
-    }
-    // Degenerate (insufficient vertices to be valid)
-    if (newChain->size() < 3) delete newChain;
-    else {
-      std::list<Triangulation::Vertex_handle>::iterator secondElement = newChain->begin();
-      ++secondElement;
-      // Degenerate (zero area)
-      if (newChain->back() == *secondElement) delete newChain;
-      // Valid
-      else rings.push_back(newChain);
-    }
-    // Make rings
-    std::list<OGRLinearRing *> ringsForPolygon;
-    for (std::list<std::list<Triangulation::Vertex_handle> *>::iterator currentRing = rings.begin(); currentRing != rings.end(); ++currentRing) {
-      OGRLinearRing *newRing = new OGRLinearRing();
-      for (std::list<Triangulation::Vertex_handle>::reverse_iterator currentVertex = (*currentRing)->rbegin(); currentVertex != (*currentRing)->rend(); ++currentVertex) {
-        newRing->addPoint((*currentVertex)->point().x(), (*currentVertex)->point().y());
-      } newRing->addPoint((*currentRing)->back()->point().x(), (*currentRing)->back()->point().y());
-      ringsForPolygon.push_back(newRing);
-    } OGRPolygon *newPolygon = new OGRPolygon();
-    for (std::list<OGRLinearRing *>::iterator currentRing = ringsForPolygon.begin(); currentRing != ringsForPolygon.end(); ++currentRing) {
-      if (!(*currentRing)->isClockwise()) {
-        newPolygon->addRingDirectly(*currentRing);
-        break;
-      }
-    } for (std::list<OGRLinearRing *>::iterator currentRing = ringsForPolygon.begin(); currentRing != ringsForPolygon.end(); ++currentRing)
-      if ((*currentRing)->isClockwise()) newPolygon->addRingDirectly(*currentRing);
-    outputPolygons->addGeometryDirectly(newPolygon);
-  }
-  return outputPolygons;
-}
-
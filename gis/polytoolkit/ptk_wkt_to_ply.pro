@@ -1,9 +1,20 @@
 TEMPLATE = app
 CONFIG += console debug
 CONFIG -= qt
+HEADERS += ptk_prepair.hpp
 SOURCES += ptk_wkt_to_ply.cpp
 TARGET = ptk_wkt_to_ply
 
+# vertexweld
+PATH_VERTEXWELD = $$PWD/../../utils/vertexweld
+INCLUDEPATH += $${PATH_VERTEXWELD}
+HEADERS += $${PATH_VERTEXWELD}/VertexWelder.h
+
+# geodesy
+PATH_GEODESY = $$PWD/../../utils/geodesy
+INCLUDEPATH += $${PATH_GEODESY}
+HEADERS += $${PATH_GEODESY}/Geodesy.h
+
 # required libs
 LIBS += -lgdal -lCGAL_Core -lCGAL -lmpfr -lgmp -lboost_thread
 
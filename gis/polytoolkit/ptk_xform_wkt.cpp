@@ -6,11 +6,22 @@
 #include <fstream>
 #include <stack>
 #include <set>
+#include <vector>
+#include <thread>
+#include <algorithm>
 #include <sys/time.h>
 
 // OGR
 #include <ogrsf_frmts.h>
-#include <ogr_spatialref.h>
+
+// geodesy
+#include <Geodesy.h>
+
+// threadpool
+#include <ThreadPool.h>
+#include <Parallel.h>
+
+#include "PolyBin.hpp"
 
 // timing vars
 timeval t1,t2;
@@ -40,12 +51,60 @@ std::string NumberToString ( T Number )
     return ss.str();
 }
 
+// features are read, transformed in parallel and
+// written out (in order) this many at a time
+size_t const k_batch_lines = 65536;
+
+struct XformResult
+{
+    bool ok;
+    std::string record;
+    std::string error;
+};
+
+// Scratch space for XformFeature, kept per thread
+struct XformScratch
+{
+    PolyFeature feature;
+    std::vector<double> listX;
+    std::vector<double> listY;
+};
+
+// EPSG:3785 is spherical mercator, so the transform
+// to EPSG:4326 is closed form (see Geodesy.h) and
+// doesn't need an OGRCoordinateTransformation
+void XformFeature(PolyFeature &feature,
+                  XformScratch &xformScratch)
+{
+    // transform every point of the feature in one
+    // call instead of a point at a time
+    size_t const numPoints = feature.GetNumPoints();
+    std::vector<double> &listX = xformScratch.listX;
+    std::vector<double> &listY = xformScratch.listY;
+    listX.resize(numPoints);
+    listY.resize(numPoints);
+    for(size_t i=0; i < numPoints; i++)   {
+        listX[i] = feature.listXY[i*2];
+        listY[i] = feature.listXY[i*2+1];
+    }
+
+    scratch::geodesy::ConvMercatorToLLA(numPoints,listX.data(),listY.data(),
+                                        listX.data(),listY.data());
+
+    for(size_t i=0; i < numPoints; i++)   {
+        feature.listXY[i*2] = listX[i];
+        feature.listXY[i*2+1] = listY[i];
+    }
+    feature.CalcBounds();
+}
+
 int main(int argc, const char *argv[])
 {
     if(argc != 3) {
         std::cout << "Usage: #> ./ptk_xform_wkt myinputfile myoutputfile\n";
         std::cout << "* Expect each line of the input file to contain a single WKT POLYGON() def\n";
-        std::cout << "* The output file is in the same format as the input file\n";
+        std::cout << "  or the input file to be pbin (see ptk_polybin)\n";
+        std::cout << "* The output file is pbin if it ends in .pbin and wkt otherwise\n";
         return 0;
     }
 
@@ -61,109 +120,58 @@ int main(int argc, const char *argv[])
 
     StartTiming("[Transform from EPSG 3785 (Mercator) to EPSG 4326 (WGS84 Lat/Lon)]");
 
-    std::ifstream inputWktFile;
-    inputWktFile.open(argv[1]);
-
-    std::ofstream outputWktFile;
-    outputWktFile.open(argv[2]);
-
-    // get number of input lines
-    unsigned int numInputLines=0;
-    if(inputWktFile.is_open())   {
-        while(!inputWktFile.eof())   {
-            std::string wktLine;
-            std::getline(inputWktFile,wktLine);
-            numInputLines++;
-        }
-    }
-    inputWktFile.close();
-    inputWktFile.open(argv[1]);
+    PolyReader reader;
+    PolyWriter writer;
 
     // do stuff
-    if(inputWktFile.is_open() && outputWktFile.is_open())
+    if(reader.Open(argv[1]) && writer.Open(argv[2]))
     {
-        int linesProcessed = 0;
-        outputWktFile << "WKT\n";
+        size_t linesProcessed = 0;
 
-        // setup coordinate transform (from EPSG:3785
-        // [Google Mercator]) to EPSG:4326 [WGS84 lat/lon]
-        OGRSpatialReference sourceSRS, targetSRS;
-        sourceSRS.importFromEPSG(3785);
-        targetSRS.importFromEPSG(4326);
+        scratch::ThreadPool threadPool(
+                    std::max(1u,std::thread::hardware_concurrency()));
+        size_t const numThreads = threadPool.GetThreadCount();
 
-        OGRCoordinateTransformation * coordXform;
-        coordXform = OGRCreateCoordinateTransformation(&sourceSRS,&targetSRS);
+        std::vector<XformResult> listResults;
 
-        while(!inputWktFile.eof())
+        while(reader.ReadBatch(k_batch_lines))
         {
-            std::string wktLine;
-            std::getline(inputWktFile,wktLine);
-
-            // remove any quotes around wktLine
-            if(wktLine[0] == '\"' || wktLine[0] == '\'')
-            {   wktLine.erase(0,1);   }
-
-            if(wktLine[wktLine.size()-1] == '\"' || wktLine[wktLine.size()-1] == '\'')
-            {   wktLine.erase(wktLine.size()-1,1);   }
-
-            // create geometry from wkt
-            char *inputWKT = new char[wktLine.size()+1];
-            char *inputWKTRef = inputWKT;
-            strcpy(inputWKT,wktLine.c_str());
-
-            OGRGeometry *inputGeometry;
-            OGRGeometryFactory::createFromWkt(&inputWKT, NULL, &inputGeometry);
-
-            if (inputGeometry == NULL)   {
-                std::cout << "Error: WKT is not valid (ignoring)" << std::endl;
-                std::cout << "-> " << wktLine << std::endl;
-                delete[] inputWKTRef;
-                continue;
-            }
-            delete[] inputWKTRef;
-
-            if(inputGeometry->getGeometryType() == wkbPolygon)   {
-                // outer ring
-                OGRPolygon *singlePoly = (OGRPolygon*)inputGeometry;
-                OGRLinearRing* outerRing = singlePoly->getExteriorRing();
-                for(int j=0; j < outerRing->getNumPoints(); j++)   {
-                    double px = outerRing->getX(j);
-                    double py = outerRing->getY(j);
-                    coordXform->Transform(1,&px,&py);
-                    outerRing->setPoint(j,px,py,0);
-                }
-                // inner rings
-                for(int j=0; j < singlePoly->getNumInteriorRings(); j++)   {
-                    OGRLinearRing *innerRing = singlePoly->getInteriorRing(j);
-                    for(int k=0; k < innerRing->getNumPoints(); k++)   {
-                        double px = innerRing->getX(k);
-                        double py = innerRing->getY(k);
-                        coordXform->Transform(1,&px,&py);
-                        innerRing->setPoint(k,px,py,0);
+            // transform the batch
+            listResults.resize(reader.GetBatchSize());
+            scratch::ParallelForRange(
+                        threadPool,0,listResults.size(),
+                        [&](size_t rangeBegin, size_t rangeEnd) {
+                static thread_local XformScratch xformScratch;
+                for(size_t i=rangeBegin; i < rangeEnd; i++) {
+                    XformResult &result = listResults[i];
+                    result.ok = false;
+                    if(!reader.GetFeature(i,xformScratch.feature,result.error)) {
+                        continue;
                     }
+                    XformFeature(xformScratch.feature,xformScratch);
+                    result.ok = writer.Encode(xformScratch.feature,result.record);
                 }
+            },(listResults.size()+numThreads-1)/numThreads);
 
-                // write output
-                char *outputWKT;
-                inputGeometry->exportToWkt(&outputWKT);
-                outputWktFile << outputWKT << std::endl;
-                delete[] outputWKT;
-
-                // clean up
-                delete inputGeometry;
-            }
-            else   {
-                std::cout << "Error: Could not xform geometry, "
-                             "WKT type is not a POLYGON()\n";
-                std::cout << "-> WKT: " << wktLine << "\n";
+            // write output in input order
+            for(auto const &result : listResults)
+            {
+                if(result.ok) {
+                    writer.WriteRecord(result.record);
+                }
+                else if(!result.error.empty()) {
+                    std::cout << result.error << std::endl;
+                }
             }
 
-            linesProcessed++;
-            std::cout << "ptk_xform_wkt: Lines Processed: "
-                      << linesProcessed << "/" << numInputLines <<std::endl;
+            linesProcessed += listResults.size();
+            std::cout << "ptk_xform_wkt: Lines Processed: " << linesProcessed;
+            if(reader.GetFeatureCount() > 0) {
+                std::cout << "/" << reader.GetFeatureCount();
+            }
+            std::cout << std::endl;
         }
-        inputWktFile.close();
-        outputWktFile.close();
+        writer.Close();
     }
     EndTiming();
 
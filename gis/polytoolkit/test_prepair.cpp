@@ -0,0 +1,485 @@
+/*
+ Copyright (c) 2009-2012,
+ Gustavo Adolfo Ken Arroyo Ohori    g.a.k.arroyoohori@tudelft.nl
+ Hugo Ledoux                        h.ledoux@tudelft.nl
+ Martijn Meijers                    b.m.meijers@tudelft.nl
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+  Regression test for ptk_prepair.hpp: every fixture is repaired with
+  the original prepair reconstruction (kept below as prepair_ref) and
+  with the current one, and the output WKT has to match
+
+  Preet Desai       prismatic.project@gmail.com
+*/
+
+// STL
+#include <iostream>
+#include <string>
+#include <vector>
+#include <list>
+#include <set>
+#include <map>
+#include <stack>
+#include <cmath>
+#include <cassert>
+#include <sys/time.h>
+
+#include "PolyBin.hpp"
+#include "ptk_prepair.hpp"
+
+// ============================================================= //
+
+// The reconstruction as it was before the repair
+// tools shared ptk_prepair.hpp (ie. ptk_repair_wkt
+// at the baseline), minus the leaks and the front()
+// calls on an empty first chain; tag() didn't change
+// and is shared
+namespace prepair_ref
+{
+
+using prepair::Point;
+
+std::list<Triangulation::Vertex_handle> *getBoundary(Triangulation::Face_handle face, int edge) {
+
+    std::list<Triangulation::Vertex_handle> *vertices = new std::list<Triangulation::Vertex_handle>();
+
+    // Check clockwise edge
+    if (!face->is_constrained(face->cw(edge)) && face->neighbor(face->cw(edge))->info() != NULL) {
+        face->neighbor(face->cw(edge))->info() = NULL;
+        std::list<Triangulation::Vertex_handle> *v1 = getBoundary(face->neighbor(face->cw(edge)), face->neighbor(face->cw(edge))->index(face));
+        vertices->splice(vertices->end(), *v1);
+        delete v1;
+    }
+
+    // Add central vertex
+    vertices->push_back(face->vertex(edge));
+
+    // Check counterclockwise edge
+    if (!face->is_constrained(face->ccw(edge)) && face->neighbor(face->ccw(edge))->info() != NULL) {
+        face->neighbor(face->ccw(edge))->info() = NULL;
+        std::list<Triangulation::Vertex_handle> *v2 = getBoundary(face->neighbor(face->ccw(edge)), face->neighbor(face->ccw(edge))->index(face));
+        vertices->splice(vertices->end(), *v2);
+        delete v2;
+    }
+
+    return vertices;
+}
+
+void addRing(std::list<Triangulation::Vertex_handle> *newChain,
+             std::list<std::list<Triangulation::Vertex_handle> *> &rings) {
+    // Degenerate (insufficient vertices to be valid)
+    if (newChain->size() < 3) delete newChain;
+    else {
+        std::list<Triangulation::Vertex_handle>::iterator secondElement = newChain->begin();
+        ++secondElement;
+        // Degenerate (zero area)
+        if (newChain->back() == *secondElement) delete newChain;
+        // Valid
+        else rings.push_back(newChain);
+    }
+}
+
+OGRMultiPolygon* repair(OGRGeometry* geometry, Triangulation &triangulation) {
+
+    OGRPolygon *polygon = (OGRPolygon *)geometry;
+    for (int currentRing = -1; currentRing < polygon->getNumInteriorRings(); ++currentRing) {
+        OGRLinearRing *ring = (currentRing < 0) ?
+                    polygon->getExteriorRing() : polygon->getInteriorRing(currentRing);
+        for (int currentPoint = 0; currentPoint < ring->getNumPoints(); ++currentPoint)
+            triangulation.insert_constraint(Point(ring->getX(currentPoint),
+                                                  ring->getY(currentPoint)),
+                                            Point(ring->getX((currentPoint+1)%ring->getNumPoints()),
+                                                  ring->getY((currentPoint+1)%ring->getNumPoints())));
+    }
+
+    if (triangulation.number_of_faces() < 1) {
+        return NULL;
+    }
+
+    // Tag
+    char interiorTag, exteriorTag;
+    void *interior = &interiorTag;
+    void *exterior = &exteriorTag;
+    prepair::tag(triangulation, interior, exterior);
+
+    // Reconstruct
+    OGRMultiPolygon* outputPolygons = new OGRMultiPolygon();
+    for (Triangulation::Finite_faces_iterator seedingFace = triangulation.finite_faces_begin(); seedingFace != triangulation.finite_faces_end(); ++seedingFace) {
+
+        if (seedingFace->info() != interior) continue;
+
+        // Get boundary
+        std::list<Triangulation::Vertex_handle> *vertices = new std::list<Triangulation::Vertex_handle>();
+        seedingFace->info() = NULL;
+        if (seedingFace->neighbor(2)->info() == interior) {
+            seedingFace->neighbor(2)->info() = NULL;
+            std::list<Triangulation::Vertex_handle> *l2 = getBoundary(seedingFace->neighbor(2), seedingFace->neighbor(2)->index(seedingFace));
+            vertices->splice(vertices->end(), *l2);
+            delete l2;
+        } vertices->push_back(seedingFace->vertex(0));
+        if (seedingFace->neighbor(1)->info() == interior) {
+            seedingFace->neighbor(1)->info() = NULL;
+            std::list<Triangulation::Vertex_handle> *l1 = getBoundary(seedingFace->neighbor(1), seedingFace->neighbor(1)->index(seedingFace));
+            vertices->splice(vertices->end(), *l1);
+            delete l1;
+        } vertices->push_back(seedingFace->vertex(2));
+        if (seedingFace->neighbor(0)->info() == interior) {
+            seedingFace->neighbor(0)->info() = NULL;
+            std::list<Triangulation::Vertex_handle> *l0 = getBoundary(seedingFace->neighbor(0), seedingFace->neighbor(0)->index(seedingFace));
+            vertices->splice(vertices->end(), *l0);
+            delete l0;
+        } vertices->push_back(seedingFace->vertex(1));
+
+        // Find cutting vertices
+        std::set<Triangulation::Vertex_handle> visitedVertices;
+        std::set<Triangulation::Vertex_handle> repeatedVertices;
+        for (std::list<Triangulation::Vertex_handle>::iterator currentVertex = vertices->begin(); currentVertex != vertices->end(); ++currentVertex) {
+            if (!visitedVertices.insert(*currentVertex).second) repeatedVertices.insert(*currentVertex);
+        } visitedVertices.clear();
+
+        // Cut and join rings in the correct order
+        std::list<std::list<Triangulation::Vertex_handle> *> rings;
+        std::stack<std::list<Triangulation::Vertex_handle> *> chainsStack;
+        std::map<Triangulation::Vertex_handle, std::list<Triangulation::Vertex_handle> *> vertexChainMap;
+        std::list<Triangulation::Vertex_handle> *newChain = new std::list<Triangulation::Vertex_handle>();
+        // vertexChainMap may still point at spliced chains, so
+        // they're freed at the end to keep their addresses unique
+        std::vector<std::list<Triangulation::Vertex_handle> *> spentChains;
+        for (std::list<Triangulation::Vertex_handle>::iterator currentVertex = vertices->begin(); currentVertex != vertices->end(); ++currentVertex) {
+
+            // New chain
+            if (repeatedVertices.count(*currentVertex) > 0) {
+                // Closed by itself
+                if (!newChain->empty() && newChain->front() == *currentVertex) {
+                    addRing(newChain,rings);
+                }
+                // Open by itself
+                else {
+                    // Closed with others in stack
+                    if (vertexChainMap.count(*currentVertex)) {
+
+                        while (chainsStack.top() != vertexChainMap[*currentVertex]) {
+                            newChain->splice(newChain->begin(), *chainsStack.top());
+                            spentChains.push_back(chainsStack.top());
+                            chainsStack.pop();
+                        } newChain->splice(newChain->begin(), *chainsStack.top());
+                        spentChains.push_back(chainsStack.top());
+                        chainsStack.pop();
+                        vertexChainMap.erase(*currentVertex);
+                        addRing(newChain,rings);
+                    }
+                    // Open
+                    else {
+                        // Not first chain
+                        if (!newChain->empty() && repeatedVertices.count(newChain->front()) > 0) vertexChainMap[newChain->front()] = newChain;
+                        chainsStack.push(newChain);
+                    }
+                } newChain = new std::list<Triangulation::Vertex_handle>();
+            } newChain->push_back(*currentVertex);
+        }
+        delete vertices;
+
+        // Final ring
+        while (chainsStack.size() > 0) {
+            newChain->splice(newChain->begin(), *chainsStack.top());
+            spentChains.push_back(chainsStack.top());
+            chainsStack.pop();
+        }
+        addRing(newChain,rings);
+        for (size_t i = 0; i < spentChains.size(); ++i) delete spentChains[i];
+
+        // Make rings
+        std::list<OGRLinearRing *> ringsForPolygon;
+        for (std::list<std::list<Triangulation::Vertex_handle> *>::iterator currentRing = rings.begin(); currentRing != rings.end(); ++currentRing) {
+            OGRLinearRing *newRing = new OGRLinearRing();
+            for (std::list<Triangulation::Vertex_handle>::reverse_iterator currentVertex = (*currentRing)->rbegin(); currentVertex != (*currentRing)->rend(); ++currentVertex) {
+                newRing->addPoint((*currentVertex)->point().x(), (*currentVertex)->point().y());
+            } newRing->addPoint((*currentRing)->back()->point().x(), (*currentRing)->back()->point().y());
+            ringsForPolygon.push_back(newRing);
+            delete *currentRing;
+        } OGRPolygon *newPolygon = new OGRPolygon();
+        OGRLinearRing *outerRing = NULL;
+        for (std::list<OGRLinearRing *>::iterator currentRing = ringsForPolygon.begin(); currentRing != ringsForPolygon.end(); ++currentRing) {
+            if (!(*currentRing)->isClockwise()) {
+                outerRing = *currentRing;
+                newPolygon->addRingDirectly(*currentRing);
+                break;
+            }
+        } for (std::list<OGRLinearRing *>::iterator currentRing = ringsForPolygon.begin(); currentRing != ringsForPolygon.end(); ++currentRing) {
+            if ((*currentRing)->isClockwise()) newPolygon->addRingDirectly(*currentRing);
+            else if (*currentRing != outerRing) delete *currentRing;
+        }
+        outputPolygons->addGeometryDirectly(newPolygon);
+    }
+    return outputPolygons;
+}
+
+} // prepair_ref
+
+// ============================================================= //
+
+// timing var
+timeval t1,t2;
+
+void StartTiming()
+{
+    gettimeofday(&t1,NULL);
+}
+
+double EndTiming()
+{
+    gettimeofday(&t2,NULL);
+    double timeTaken = 0;
+    timeTaken += (t2.tv_sec - t1.tv_sec) * 1000.0 * 1000.0;
+    timeTaken += (t2.tv_usec - t1.tv_usec);
+    return timeTaken/1000;
+}
+
+OGRGeometry * GeometryFromWkt(std::string const &wkt)
+{
+    std::vector<char> buffer(wkt.begin(),wkt.end());
+    buffer.push_back('\0');
+    char *data = buffer.data();
+    OGRGeometry *geometry = NULL;
+    OGRGeometryFactory::createFromWkt(&data,NULL,&geometry);
+    assert(geometry != NULL);
+    return geometry;
+}
+
+// one WKT string per output polygon; the original
+// reconstruction wrote an empty POLYGON for regions
+// whose rings were all degenerate, the current one
+// leaves them out
+std::vector<std::string> ListPolygonWkt(OGRMultiPolygon *multiPoly)
+{
+    std::vector<std::string> listWkt;
+    if(multiPoly == NULL)   {
+        return listWkt;
+    }
+    for(int i=0; i < multiPoly->getNumGeometries(); i++)   {
+        OGRGeometry *geometry = multiPoly->getGeometryRef(i);
+        if(geometry->IsEmpty())   {
+            continue;
+        }
+        char *wkt;
+        geometry->exportToWkt(&wkt);
+        listWkt.push_back(wkt);
+        CPLFree(wkt);
+    }
+    delete multiPoly;
+    return listWkt;
+}
+
+// ============================================================= //
+
+// * self intersecting and touching rings, holes that
+//   touch, cross or leave the outer ring, repeated points
+//   and zero area spikes
+std::vector<std::string> const k_list_fixtures = {
+    // square
+    "POLYGON((0 0,10 0,10 10,0 10,0 0))",
+    // square, clockwise
+    "POLYGON((0 0,0 10,10 10,10 0,0 0))",
+    // square with a hole
+    "POLYGON((0 0,10 0,10 10,0 10,0 0),(3 3,7 3,7 7,3 7,3 3))",
+    // square with two holes
+    "POLYGON((0 0,20 0,20 10,0 10,0 0),(2 2,8 2,8 8,2 8,2 2),(12 2,18 2,18 8,12 8,12 2))",
+    // two holes sharing a vertex
+    "POLYGON((0 0,20 0,20 10,0 10,0 0),(2 2,10 5,2 8,2 2),(10 5,18 2,18 8,10 5))",
+    // hole touching the outer ring at a vertex
+    "POLYGON((0 0,10 0,10 10,0 10,0 0),(0 5,5 2,5 8,0 5))",
+    // hole crossing the outer ring
+    "POLYGON((0 0,10 0,10 10,0 10,0 0),(5 3,15 3,15 7,5 7,5 3))",
+    // hole outside the outer ring
+    "POLYGON((0 0,10 0,10 10,0 10,0 0),(20 20,30 20,30 30,20 30,20 20))",
+    // hole equal to the outer ring
+    "POLYGON((0 0,10 0,10 10,0 10,0 0),(0 0,10 0,10 10,0 10,0 0))",
+    // bowtie
+    "POLYGON((0 0,10 10,10 0,0 10,0 0))",
+    // pentagram
+    "POLYGON((0 3,10 3,2 -3,5 7,8 -3,0 3))",
+    // figure eight touching at a vertex
+    "POLYGON((0 0,5 5,10 0,10 10,5 5,0 10,0 0))",
+    // ring that loops back over itself
+    "POLYGON((0 0,10 0,10 10,2 10,2 2,8 2,8 8,0 8,0 0))",
+    // zero area spike
+    "POLYGON((0 0,10 0,10 10,5 10,5 15,5 10,0 10,0 0))",
+    // repeated points
+    "POLYGON((0 0,0 0,10 0,10 0,10 10,0 10,0 10,0 0))",
+    // collinear points on an edge
+    "POLYGON((0 0,5 0,10 0,10 5,10 10,0 10,0 0))",
+    // self overlapping comb with a hole
+    "POLYGON((0 0,30 0,30 10,25 10,25 -5,20 -5,20 10,0 10,0 0),(2 2,8 2,8 8,2 8,2 2))"
+};
+
+void testFixtures()
+{
+    for(std::string const &wkt : k_list_fixtures)
+    {
+        OGRGeometry *geometry = GeometryFromWkt(wkt);
+
+        Triangulation refTriangulation;
+        std::vector<std::string> const listRef =
+                ListPolygonWkt(prepair_ref::repair(geometry,refTriangulation));
+
+        Triangulation triangulation;
+        std::vector<std::string> const listOut =
+                ListPolygonWkt(repair(geometry,triangulation));
+
+        // repairPolyFeature with a scratch that has
+        // already repaired something else
+        static RepairScratch scratch;
+        PolyFeature input,output;
+        PolyFeatureFromOGR(geometry,input);
+        repairPolyFeature(input,output,scratch);
+        assert(scratch.buffers.numDroppedRings == 0);
+
+        std::vector<std::string> listFeature;
+        for(size_t i=0; i < output.GetNumParts(); i++)   {
+            OGRPolygon *polygon = PolyFeaturePartToOGR(output,i);
+            char *partWkt;
+            polygon->exportToWkt(&partWkt);
+            listFeature.push_back(partWkt);
+            CPLFree(partWkt);
+            delete polygon;
+        }
+
+        if(listOut != listRef || listFeature != listRef)   {
+            std::cout << "FAILED: " << wkt << std::endl;
+            for(auto const &s : listRef) { std::cout << "  ref: " << s << std::endl; }
+            for(auto const &s : listOut) { std::cout << "  out: " << s << std::endl; }
+            for(auto const &s : listFeature) { std::cout << "  ftr: " << s << std::endl; }
+        }
+        assert(listOut == listRef);
+        assert(listFeature == listRef);
+        assert(!listRef.empty());
+
+        delete geometry;
+    }
+
+    std::cout << "testFixtures... [ok]" << std::endl;
+}
+
+void testDroppedRings()
+{
+    // a region whose boundary came out as two
+    // counterclockwise rings and a clockwise one
+    Triangulation triangulation;
+    double const listXY[] = {
+        0,0, 10,0, 10,10, 0,10,     // ccw (reversed on output)
+        20,0, 30,0, 30,10,          // ccw
+        2,2, 2,8, 8,8               // cw
+    };
+    std::vector<prepair::VertexHandle> listVx;
+    for(size_t i=0; i < 10; i++)   {
+        listVx.push_back(triangulation.insert(prepair::Point(listXY[i*2],listXY[i*2+1])));
+    }
+
+    // rings are stored reversed
+    prepair::RepairBuffers buffers;
+    buffers.listRings.resize(3);
+    buffers.listRings[0].assign(listVx.rbegin()+6,listVx.rend());
+    buffers.listRings[1].assign(listVx.rbegin()+3,listVx.rbegin()+6);
+    buffers.listRings[2].assign(listVx.rbegin(),listVx.rbegin()+3);
+    buffers.numRings = 3;
+    buffers.numDroppedRings = 0;
+
+    PolyFeature output;
+    prepair::addRepairedPolygon(buffers,output);
+    assert(buffers.numDroppedRings == 1);
+    assert(output.GetNumParts() == 1);
+    assert(output.GetNumRings() == 2);
+    assert(output.listXY[0] == 0 && output.listXY[1] == 0);
+
+    std::cout << "testDroppedRings... [ok]" << std::endl;
+}
+
+void benchRepair()
+{
+    // a jagged circle where every tenth pair of
+    // points is swapped, so it crosses itself
+    size_t const numPts = 20000;
+    std::string wkt = "POLYGON((";
+    for(size_t i=0; i <= numPts; i++)   {
+        size_t const j = i%numPts;
+        size_t const k = (j%10 == 0) ? j+1 : (j%10 == 1) ? j-1 : j;
+        double const a = 2*M_PI*k/numPts;
+        double const r = (j%2) ? 105 : 95;
+        wkt += std::to_string(r*cos(a)) + " " + std::to_string(r*sin(a));
+        wkt += (i < numPts) ? "," : "))";
+    }
+    OGRGeometry *geometry = GeometryFromWkt(wkt);
+
+    double msRefBuild=0, msRefTotal=0, msBuild=0, msTotal=0;
+    int const numRuns = 5;
+    RepairScratch scratch;
+    PolyFeature input,output;
+    PolyFeatureFromOGR(geometry,input);
+    for(int run=0; run < numRuns; run++)
+    {
+        // the triangulation alone
+        {
+            Triangulation triangulation;
+            StartTiming();
+            for(size_t r=0; r < input.GetNumRings(); r++)   {
+                uint32_t const ptBegin = input.listRingPts[r];
+                uint32_t const ptEnd = input.listRingPts[r+1];
+                prepair::insertRingConstraints(triangulation,input.listXY.data()+ptBegin*2,ptEnd-ptBegin);
+            }
+            double const ms = EndTiming();
+            msRefBuild += ms;
+            msBuild += ms;
+        }
+        {
+            Triangulation triangulation;
+            StartTiming();
+            delete prepair_ref::repair(geometry,triangulation);
+            msRefTotal += EndTiming();
+        }
+        {
+            StartTiming();
+            repairPolyFeature(input,output,scratch);
+            msTotal += EndTiming();
+        }
+    }
+
+    std::cout << "benchRepair: " << numPts << " points, "
+              << output.GetNumParts() << " polygons" << std::endl;
+    std::cout << "  triangulation: " << msBuild/numRuns << " ms" << std::endl;
+    std::cout << "  original repair: " << msRefTotal/numRuns << " ms ("
+              << (msRefTotal-msRefBuild)/numRuns << " ms after triangulation)" << std::endl;
+    std::cout << "  repairPolyFeature: " << msTotal/numRuns << " ms ("
+              << (msTotal-msBuild)/numRuns << " ms after triangulation)" << std::endl;
+
+    delete geometry;
+}
+
+int main()
+{
+    testFixtures();
+    testDroppedRings();
+    benchRepair();
+    return 0;
+}
@@ -0,0 +1,11 @@
+TEMPLATE = app
+CONFIG += console debug
+CONFIG -= qt
+HEADERS += PolyBin.hpp ptk_prepair.hpp
+SOURCES += test_prepair.cpp
+TARGET = test_prepair
+
+# required libs
+LIBS += -lgdal -lCGAL_Core -lCGAL -lmpfr -lgmp -lboost_thread
+
+QMAKE_CXXFLAGS += -std=c++11
@@ -25,6 +25,12 @@
 #include <string>
 #include <map>
 
+// geodesy (WGS84)
+#include <Geodesy.h>
+
+// visvalingam-whyatt heap
+#include <VWHeap.h>
+
 #define K_PI 3.141592653589
 #define K_DEG2RAD K_PI/180.0
 #define K_RAD2DEG 180.0/K_PI
@@ -36,18 +42,6 @@
 // average radius
 #define RAD_AV 6371000
 
-// WGS84 ellipsoid parameters
-// (http://en.wikipedia.org/wiki/WGS_84)
-#define ELL_SEMI_MAJOR 6378137.0            // meters
-#define ELL_SEMI_MAJOR_EXP2 40680631590769.0
-
-#define ELL_SEMI_MINOR 6356752.3142         // meters
-#define ELL_SEMI_MINOR_EXP2 40408299984087.1
-
-#define ELL_F 1.0/298.257223563
-#define ELL_ECC_EXP2 6.69437999014e-3
-#define ELL_ECC2_EXP2 6.73949674228e-3
-
 // circumference
 #define CIR_EQ 40075017.0   // around equator  (meters)
 #define CIR_MD 40007860.0   // around meridian (meters)
@@ -265,47 +259,55 @@ struct PointLLA
 Vec3 ConvLLAToECEF(const PointLLA &pointLLA)
 {
     Vec3 pointECEF;
-
-    // remember to convert deg->rad
-    double sinLat = sin(pointLLA.lat * K_DEG2RAD);
-    double sinLon = sin(pointLLA.lon * K_DEG2RAD);
-    double cosLat = cos(pointLLA.lat * K_DEG2RAD);
-    double cosLon = cos(pointLLA.lon * K_DEG2RAD);
-
-    // v = radius of curvature (meters)
-    double v = ELL_SEMI_MAJOR / (sqrt(1-(ELL_ECC_EXP2*sinLat*sinLat)));
-    pointECEF.x = (v + pointLLA.alt) * cosLat * cosLon;
-    pointECEF.y = (v + pointLLA.alt) * cosLat * sinLon;
-    pointECEF.z = ((1-ELL_ECC_EXP2)*v + pointLLA.alt)*sinLat;
-
+    scratch::geodesy::ConvLLAToECEF(pointLLA.lon,pointLLA.lat,pointLLA.alt,
+                                    pointECEF.x,pointECEF.y,pointECEF.z);
     return pointECEF;
 }
 
 PointLLA ConvECEFToLLA(const Vec3 &pointECEF)
 {
     PointLLA pointLLA;
+    scratch::geodesy::ConvECEFToLLA(pointECEF.x,pointECEF.y,pointECEF.z,
+                                    pointLLA.lon,pointLLA.lat,pointLLA.alt);
+    return pointLLA;
+}
 
-    double p = (sqrt(pow(pointECEF.x,2) + pow(pointECEF.y,2)));
-    double th = atan2(pointECEF.z*ELL_SEMI_MAJOR, p*ELL_SEMI_MINOR);
-    double sinTh = sin(th);
-    double cosTh = cos(th);
+// batch versions of the above for whole rings (on
+// the surface), which convert several points at once
+void ConvListLLAToECEF(std::vector<double> const &listLon,
+                       std::vector<double> const &listLat,
+                       std::vector<Vec3> &listECEF)
+{
+    size_t const numPoints = listLon.size();
+    std::vector<double> listX(numPoints),listY(numPoints),listZ(numPoints);
+    scratch::geodesy::ConvLLAToECEF(numPoints,listLon.data(),listLat.data(),NULL,
+                                    listX.data(),listY.data(),listZ.data());
 
-    // calc longitude
-    pointLLA.lon = atan2(pointECEF.y, pointECEF.x);
+    listECEF.resize(numPoints);
+    for(size_t i=0; i < numPoints; i++)   {
+        listECEF[i] = Vec3(listX[i],listY[i],listZ[i]);
+    }
+}
 
-    // calc latitude
-    pointLLA.lat = atan2(pointECEF.z + ELL_ECC2_EXP2*ELL_SEMI_MINOR*sinTh*sinTh*sinTh,
-                         p - ELL_ECC_EXP2*ELL_SEMI_MAJOR*cosTh*cosTh*cosTh);
-    // calc altitude
-    double sinLat = sin(pointLLA.lat);
-    double N = ELL_SEMI_MAJOR / (sqrt(1-(ELL_ECC_EXP2*sinLat*sinLat)));
-    pointLLA.alt = (p/cos(pointLLA.lat)) - N;
+void ConvListECEFToLLA(std::vector<Vec3> const &listECEF,
+                       std::vector<PointLLA> &listLLA)
+{
+    size_t const numPoints = listECEF.size();
+    std::vector<double> listX(numPoints),listY(numPoints),listZ(numPoints);
+    for(size_t i=0; i < numPoints; i++)   {
+        listX[i] = listECEF[i].x;
+        listY[i] = listECEF[i].y;
+        listZ[i] = listECEF[i].z;
+    }
 
-    // convert from rad to deg
-    pointLLA.lon = pointLLA.lon * K_RAD2DEG;
-    pointLLA.lat = pointLLA.lat * K_RAD2DEG;
+    std::vector<double> listLon(numPoints),listLat(numPoints),listAlt(numPoints);
+    scratch::geodesy::ConvECEFToLLA(numPoints,listX.data(),listY.data(),listZ.data(),
+                                    listLon.data(),listLat.data(),listAlt.data());
 
-    return pointLLA;
+    listLLA.resize(numPoints);
+    for(size_t i=0; i < numPoints; i++)   {
+        listLLA[i] = PointLLA(listLat[i],listLon[i],listAlt[i]);
+    }
 }
 
 double CalcTriangleArea(const Vec3 &vxA,
@@ -321,19 +323,6 @@ enum VWSimplifyType
     VW_QUANTITY
 };
 
-// VWPoint32
-// * 3d point struct for Visvalingam-Whyatt
-//   polyline simplification
-struct VWPoint3
-{
-    VWPoint3() : next_vx(NULL),prev_vx(NULL) {}
-
-    Vec3 vx;
-    VWPoint3 * prev_vx;
-    VWPoint3 * next_vx;
-    std::multimap<double,VWPoint3*>::iterator it;
-};
-
 void CalcPolylineSimplifyVW(std::vector<Vec3> const &listVx,
                             std::vector<Vec3> &listSimpleVx,
                             VWSimplifyType simplifyType,
@@ -371,103 +360,75 @@ void CalcPolylineSimplifyVW(std::vector<Vec3> const &listVx,
         if(numVxFinal < 4)   {   numVxFinal = 4;   }    // clamp
     }
 
-    VWPoint3 * vwpoint;
-    std::vector<VWPoint3*> listVWPoints;
-    listVWPoints.reserve(listVx.size());
-    std::multimap<double,VWPoint3*> mapAreaToVx;
-    std::multimap<double,VWPoint3*>::iterator itArea;
+    // the polyline is linked through listPrev/listNext (by
+    // index into listVx) as points are removed; the first
+    // and last points are never removed
+    size_t const firstIdx = 0;
+    size_t const lastIdx = listVx.size()-1;
+    std::vector<size_t> listPrev(listVx.size(),firstIdx);
+    std::vector<size_t> listNext(listVx.size(),lastIdx);
+    scratch::VWHeap<size_t> heap(listVx.size());
+
+    size_t prevIdx = firstIdx;
     for(size_t i=1; i < listVx.size()-1; i++)
     {
         double triArea =
             CalcTriangleArea(listVx[i-1],listVx[i],listVx[i+1]);
 
+        // points with no area (colinear) are dropped
         if(triArea > 0)   {
-            std::pair<double,VWPoint3*> insData;
-            insData.first  = triArea;
-            insData.second = NULL;
-            itArea = mapAreaToVx.insert(insData);
-
-            vwpoint = new VWPoint3;
-            vwpoint->vx = listVx[i];
-            vwpoint->it = itArea;
-
-            itArea->second = vwpoint;
-            listVWPoints.push_back(vwpoint);
+            heap.Push(i,triArea);
+            listPrev[i] = prevIdx;
+            listNext[prevIdx] = i;
+            prevIdx = i;
         }
     }
-    //
-    vwpoint = new VWPoint3;
-    vwpoint->vx = listVx[0];
-    vwpoint->next_vx = listVWPoints[0];
-    listVWPoints.insert(listVWPoints.begin(),vwpoint);
-
-    vwpoint = new VWPoint3;
-    vwpoint->vx = listVx[listVx.size()-1];
-    vwpoint->prev_vx = listVWPoints.back();
-    listVWPoints.push_back(vwpoint);
-
-    //
-    for(size_t i=1; i < listVWPoints.size()-1; i++)   {
-        listVWPoints[i]->prev_vx = listVWPoints[i-1];
-        listVWPoints[i]->next_vx = listVWPoints[i+1];
-    }
+    listNext[prevIdx] = lastIdx;
+    listPrev[lastIdx] = prevIdx;
 
     //
-    while(mapAreaToVx.size() > numVxFinal)
+    while(heap.GetSize() > numVxFinal)
     {
         // Lookup the vertex with the minimum area
-        itArea = mapAreaToVx.begin();
-        VWPoint3 * vw = itArea->second;
-        bool isFirst = (vw->prev_vx->prev_vx == NULL);
-        bool isLast  = (vw->next_vx->next_vx == NULL);
+        size_t idx = heap.GetTop();
 
         // stop if all subsequent points have a greater
         // area than the specified tolerance
-        if(itArea->first > areaTolerance)
+        if(heap.GetArea(idx) > areaTolerance)
         {   break;   }
 
         // Delete the minimum area vertex
-        mapAreaToVx.erase(itArea);
+        heap.Pop();
 
-        // adjust the adjacent vertex pointers
-        vw->prev_vx->next_vx = vw->next_vx;
-        vw->next_vx->prev_vx = vw->prev_vx;
+        size_t p = listPrev[idx];
+        size_t n = listNext[idx];
+        listNext[p] = n;
+        listPrev[n] = p;
 
-        if(!isLast)   {
+        if(n != lastIdx)   {
             // recalculate the adjacent triangle area for
             // the next vx (vx_prev,vx_next,vx_next_next)
-            double nextArea = CalcTriangleArea(vw->prev_vx->vx,
-                                               vw->next_vx->vx,
-                                               vw->next_vx->next_vx->vx);
-            mapAreaToVx.erase(vw->next_vx->it);
-            vw->next_vx->it = mapAreaToVx.insert(std::make_pair(nextArea,vw->next_vx));
+            heap.Update(n,CalcTriangleArea(listVx[p],
+                                           listVx[n],
+                                           listVx[listNext[n]]));
         }
 
-        if(!isFirst)  {
+        if(p != firstIdx)  {
             // recalculate the adjacent triangle area for
             // the prev vx (vx_prev_prev,vx_prev,vx_next)
-            double prevArea = CalcTriangleArea(vw->prev_vx->prev_vx->vx,
-                                               vw->prev_vx->vx,
-                                               vw->next_vx->vx);
-            mapAreaToVx.erase(vw->prev_vx->it);
-            vw->prev_vx->it = mapAreaToVx.insert(std::make_pair(prevArea,vw->prev_vx));
+            heap.Update(p,CalcTriangleArea(listVx[listPrev[p]],
+                                           listVx[p],
+                                           listVx[n]));
         }
     }
 
     // save points
     listSimpleVx.clear();
-    listSimpleVx.reserve(numVxFinal+2);
-    vwpoint = listVWPoints[0];
-    while(vwpoint != NULL)
-    {
-        listSimpleVx.push_back(vwpoint->vx);
-        vwpoint = vwpoint->next_vx;
-    }
-
-    // clean up
-    for(size_t i=0; i < listVWPoints.size(); i++)   {
-        delete listVWPoints[i];
+    listSimpleVx.reserve(heap.GetSize()+2);
+    for(size_t i=firstIdx; i != lastIdx; i=listNext[i])   {
+        listSimpleVx.push_back(listVx[i]);
     }
+    listSimpleVx.push_back(listVx[lastIdx]);
 }
 
 struct GeoBounds
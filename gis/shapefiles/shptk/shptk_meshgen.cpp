@@ -21,20 +21,8 @@
 #include "shptk.hpp"
 #include "shptk_prepair.hpp"
 
-bool vxExistsInList(Vec2 const &vx,
-                    std::vector<Vec2> const &listVx,
-                    int &idx)
-{
-    bool exists = false;
-    for(size_t i=0; i < listVx.size(); i++)   {
-        if(vx == listVx[i])   {
-            exists = true;
-            idx = i;
-            break;
-        }
-    }
-    return exists;
-}
+// vertexweld
+#include <VertexWelder.h>
 
 int main(int argc, const char *argv[])
 {
@@ -106,17 +94,20 @@ int main(int argc, const char *argv[])
         OGRPolygon * sPolygon = new OGRPolygon;
 
         // outer ring
+        std::vector<double> listLon, listLat;
+        std::vector<PointLLA> listLLA;
         std::vector<Vec3> listOuterVx, listOuterVxSimp;
         OGRLinearRing * ipOuterRing = ipPoly->getExteriorRing();
         for(int i=0; i < ipOuterRing->getNumPoints(); i++)   {
-            PointLLA lla(ipOuterRing->getY(i),ipOuterRing->getX(i));
-            listOuterVx.push_back(ConvLLAToECEF(lla));
+            listLon.push_back(ipOuterRing->getX(i));
+            listLat.push_back(ipOuterRing->getY(i));
         }
+        ConvListLLAToECEF(listLon,listLat,listOuterVx);
         CalcPolylineSimplifyVW(listOuterVx,listOuterVxSimp,VW_AREA,1500.0);
+        ConvListECEFToLLA(listOuterVxSimp,listLLA);
         OGRLinearRing * sOuterRing = new OGRLinearRing;
-        for(size_t i=0; i < listOuterVxSimp.size(); i++)   {
-            PointLLA lla = ConvECEFToLLA(listOuterVxSimp[i]);
-            sOuterRing->addPoint(lla.lon,lla.lat,0);
+        for(size_t i=0; i < listLLA.size(); i++)   {
+            sOuterRing->addPoint(listLLA[i].lon,listLLA[i].lat,0);
         }
         if(sOuterRing->getNumPoints() < 3)   {
             delete sOuterRing;
@@ -128,15 +119,18 @@ int main(int argc, const char *argv[])
         for(int i=0; i < ipPoly->getNumInteriorRings(); i++)   {
             std::vector<Vec3> listInnerVx,listInnerVxSimp;
             OGRLinearRing * ipInnerRing = ipPoly->getInteriorRing(i);
+            listLon.clear();
+            listLat.clear();
             for(int j=0; j < ipInnerRing->getNumPoints(); j++)   {
-                PointLLA lla(ipInnerRing->getY(j),ipInnerRing->getX(j));
-                listInnerVx.push_back(ConvLLAToECEF(lla));
+                listLon.push_back(ipInnerRing->getX(j));
+                listLat.push_back(ipInnerRing->getY(j));
             }
+            ConvListLLAToECEF(listLon,listLat,listInnerVx);
             CalcPolylineSimplifyVW(listInnerVx,listInnerVxSimp,VW_AREA,1500.0);
+            ConvListECEFToLLA(listInnerVxSimp,listLLA);
             OGRLinearRing * sInnerRing = new OGRLinearRing;
-            for(size_t j=0; j < listInnerVxSimp.size(); j++)   {
-                PointLLA lla = ConvECEFToLLA(listInnerVxSimp[j]);
-                sInnerRing->addPoint(lla.lon,lla.lat,0);
+            for(size_t j=0; j < listLLA.size(); j++)   {
+                sInnerRing->addPoint(listLLA[j].lon,listLLA[j].lat,0);
             }
             if(sInnerRing->getNumPoints() < 3)   {
                 delete sInnerRing;
@@ -147,10 +141,11 @@ int main(int argc, const char *argv[])
         sPolygon->flattenTo2D();    // required to convert to wkbPolygon
 
         // geometry mesh
-        int ix;
         Vec2 vx;
         std::vector<Vec2> listVx;
         std::vector<size_t> listIx;
+        scratch::VertexWelder vxWelder;
+        bool isNewVx;
 
         // simultaneously repair ipGeometry and retrieve
         // the triangulation used in the repair process
@@ -184,32 +179,20 @@ int main(int argc, const char *argv[])
                 // point A
                 vx.x = cdtTri[0].x();
                 vx.y = cdtTri[0].y();
-                if(vxExistsInList(vx,listVx,ix))
-                {   listIx.push_back(ix);   }
-                else   {
-                    listVx.push_back(vx);
-                    listIx.push_back(listVx.size()-1);
-                }
+                listIx.push_back(vxWelder.Weld(vx.x,vx.y,0,&isNewVx));
+                if(isNewVx)   {   listVx.push_back(vx);   }
 
                 // point B
                 vx.x = cdtTri[1].x();
                 vx.y = cdtTri[1].y();
-                if(vxExistsInList(vx,listVx,ix))
-                {   listIx.push_back(ix);   }
-                else   {
-                    listVx.push_back(vx);
-                    listIx.push_back(listVx.size()-1);
-                }
+                listIx.push_back(vxWelder.Weld(vx.x,vx.y,0,&isNewVx));
+                if(isNewVx)   {   listVx.push_back(vx);   }
 
                 // point C
                 vx.x = cdtTri[2].x();
                 vx.y = cdtTri[2].y();
-                if(vxExistsInList(vx,listVx,ix))
-                {   listIx.push_back(ix);   }
-                else   {
-                    listVx.push_back(vx);
-                    listIx.push_back(listVx.size()-1);
-                }
+                listIx.push_back(vxWelder.Weld(vx.x,vx.y,0,&isNewVx));
+                if(isNewVx)   {   listVx.push_back(vx);   }
             }
         }
         // adj indices
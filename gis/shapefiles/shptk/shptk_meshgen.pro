@@ -38,6 +38,22 @@ INCLUDEPATH += $${PATH_OPENCTM}
                $${PATH_OPENCTM}/compressMG2.c \
                $${PATH_OPENCTM}/compressMG1.c
 
+# vertexweld
+PATH_VERTEXWELD = $$PWD/../../../utils/vertexweld
+INCLUDEPATH += $${PATH_VERTEXWELD}
+HEADERS += $${PATH_VERTEXWELD}/VertexWelder.h
+
+# geodesy
+PATH_GEODESY = $$PWD/../../../utils/geodesy
+INCLUDEPATH += $${PATH_GEODESY}
+HEADERS += $${PATH_GEODESY}/Geodesy.h
+
+# vwheap
+PATH_VWHEAP = $$PWD/../../../utils/vwheap
+INCLUDEPATH += $${PATH_VWHEAP}
+HEADERS += $${PATH_VWHEAP}/VWHeap.h
+
 # gdal/ogr and cgal
 LIBS += -lgdal -lCGAL_Core -lCGAL -lmpfr -lgmp -lboost_thread
 QMAKE_CXXFLAGS += -frounding-math -fno-strict-aliasing
+QMAKE_CXXFLAGS += -std=c++11
@@ -1,5 +1,7 @@
 #include <exception>
 #include <map>
+#include <thread>
+#include <algorithm>
 
 // qt
 #include <QCoreApplication>
@@ -21,6 +23,10 @@
 #include "KompexSQLiteException.h"
 #include "KompexSQLiteBlob.h"
 
+// threadpool
+#include <ThreadPool.h>
+#include <Parallel.h>
+
 // ============================================================== //
 
 struct MapObject
@@ -303,7 +309,8 @@ ColorRGBA calcRainbowGradient(double cVal)
 
 // ============================================================== //
 
-bool buildTable(Kompex::SQLiteStatement * stmt,
+bool buildTable(scratch::ThreadPool &thread_pool,
+                Kompex::SQLiteStatement * stmt,
                 int32_t &name_id,
                 boost::unordered_map<std::string,int32_t> &table_names,
                 std::string const &sql_table_name,
@@ -424,6 +431,15 @@ bool buildTable(Kompex::SQLiteStatement * stmt,
             list_map_objects.push_back(map_object);
         }
 
+        // convert names to lookup strings in parallel; the
+        // osmscout queries, name ids and sqlite writes have
+        // to stay serial (they aren't thread safe and name ids
+        // are assigned in tile order)
+        std::vector<std::string> list_name_lookups(list_map_objects.size());
+        scratch::ParallelFor(thread_pool,0,list_map_objects.size(),[&](size_t j)   {
+            list_name_lookups[j] = convNameToLookup(list_map_objects[j].name);
+        },64);
+
         // create structs to sort file offsets by name lookup
         // [name_lookup_id] [list_offsets]
         boost::unordered_map<int32_t,OffsetGroup> entry_admin_regions;
@@ -433,7 +449,7 @@ bool buildTable(Kompex::SQLiteStatement * stmt,
             MapObject &map_object = list_map_objects[j];
 
             // add name_lookup up to table_names
-            std::string name_lookup = convNameToLookup(map_object.name);
+            std::string const &name_lookup = list_name_lookups[j];
             int32_t name_lookup_id;
 
             // check if this lookup string already exists
@@ -905,10 +921,13 @@ int main(int argc, char *argv[])
     // build database tables
     bool opOk=false;
 
+    scratch::ThreadPool thread_pool(
+                std::max(1u,std::thread::hardware_concurrency()));
+
     // admin_regions
     qDebug() << "INFO: Building admin_regions table...";
     setTypesForAdminRegions(typeConfig,typeSet);
-    opOk = buildTable(stmt,name_id,table_names,"admin_regions",
+    opOk = buildTable(thread_pool,stmt,name_id,table_names,"admin_regions",
                       list_tiles,map,typeSet,false,true,true);
     if(opOk)   {
         qDebug() << "INFO: Finished building admin_regions table";
@@ -921,7 +940,7 @@ int main(int argc, char *argv[])
     // streets
     qDebug() << "INFO: Building streets table...";
     setTypesForStreets(typeConfig,typeSet);
-    opOk = buildTable(stmt,name_id,table_names,"streets",
+    opOk = buildTable(thread_pool,stmt,name_id,table_names,"streets",
                       list_tiles,map,typeSet,false,false,false);
     if(opOk)   {
         qDebug() << "INFO: Finished building streets table";
@@ -934,7 +953,7 @@ int main(int argc, char *argv[])
     // pois
     qDebug() << "INFO: Building pois table...";
     setTypesForPOIs(typeConfig,typeSet);
-    opOk = buildTable(stmt,name_id,table_names,"pois",
+    opOk = buildTable(thread_pool,stmt,name_id,table_names,"pois",
                       list_tiles,map,typeSet,false,false,false);
     if(opOk)   {
         qDebug() << "INFO: Finished building pois table";
@@ -4,6 +4,8 @@
 #include <iostream>
 #include <exception>
 #include <map>
+#include <algorithm>
+#include <thread>
 
 // qt
 #include <QCoreApplication>
@@ -25,6 +27,10 @@
 #include "KompexSQLiteException.h"
 #include "KompexSQLiteBlob.h"
 
+// threadpool
+#include <ThreadPool.h>
+#include <Parallel.h>
+
 // ============================================================== //
 
 class Timer
@@ -186,14 +192,20 @@ void stressDistCalcTest()
     int64_t name_id=0;
     int64_t min_id = name_id << g_sz_bits_tile_id;
     int64_t max_id = min_id | (1024*1024);
+    size_t const tile_count = max_id-min_id+1;
+
+    scratch::ThreadPool thread_pool(
+                std::max(1u,std::thread::hardware_concurrency()),
+                scratch::ThreadPool::Scheduler::WorkStealing);
 
     Timer timer;
     timer.Start();
 
     //std::multimap<double,std::pair<int,qint64> > table_dist_tile;
-    std::vector<double> list_dist2_rads;
-    list_dist2_rads.reserve(max_id-min_id);
-    for(int64_t tile_id=min_id; tile_id <= max_id; tile_id++)   {
+    std::vector<double> list_dist2_rads(tile_count);
+    scratch::ParallelFor(thread_pool,0,tile_count,[&](size_t i)   {
+        int64_t const tile_id = min_id+i;
+
         Tile tile;
         buildTileFromId(tile_id,tile);
         double midLon = (tile.bbox.minLon + tile.bbox.maxLon)*0.5;
@@ -203,17 +215,12 @@ void stressDistCalcTest()
         double dist2_rads = CalcGeoDist2RadsApprox(refLLA,cenLLA);
 
         // save
-        std::pair<int,qint64> data_idx_rowid(0,tile_id);
-        std::pair<double,std::pair<int,qint64> > data_dist_tile;
-        data_dist_tile.first  = dist2_rads;
-        data_dist_tile.second = data_idx_rowid;
-
-        //table_dist_tile.insert(data_dist_tile);
-        list_dist2_rads.push_back(dist2_rads);
-    }
+        list_dist2_rads[i] = dist2_rads;
+    });
 
-    std::sort(list_dist2_rads.begin(),
-              list_dist2_rads.end());
+    scratch::ParallelSort(thread_pool,
+                          list_dist2_rads.begin(),
+                          list_dist2_rads.end());
 
     timer.Stop();
     std::cout << "That took:" << timer.ElapsedMs() << "ms, "
@@ -5,6 +5,22 @@ QT += core
 CONFIG += console debug
 SOURCES += searchdb_test.cpp
 
+#threadpool
+PATH_THREADPOOL = $$PWD/../../../utils/threadpool
+INCLUDEPATH += $${PATH_THREADPOOL}
+HEADERS += \
+    $${PATH_THREADPOOL}/ThreadPool.h \
+    $${PATH_THREADPOOL}/Parallel.h
+SOURCES += \
+    $${PATH_THREADPOOL}/Job.cpp \
+    $${PATH_THREADPOOL}/ThreadPool.cpp \
+    $${PATH_THREADPOOL}/ThreadPoolStats.cpp
+
+# need these flags for gcc 4.8.x bug for threads
+QMAKE_LFLAGS += -Wl,--no-as-needed
+LIBS += -lpthread
+QMAKE_CXXFLAGS += -std=c++11
+
 #boost
 DEFINES += USE_BOOST
 INCLUDEPATH += /home/preet/Dev/env/sys/boost-1.53
@@ -21,17 +21,8 @@
 #define K_EPS 1E-11
 #define K_NEPS -1E-11
 
-// WGS84 ellipsoid parameters
-// (http://en.wikipedia.org/wiki/WGS_84)
-#define ELL_SEMI_MAJOR 6378137.0            // meters
-#define ELL_SEMI_MAJOR_EXP2 40680631590769.0
-
-#define ELL_SEMI_MINOR 6356752.3142         // meters
-#define ELL_SEMI_MINOR_EXP2 40408299984087.1
-
-#define ELL_F 1.0/298.257223563
-#define ELL_ECC_EXP2 6.69437999014e-3
-#define ELL_ECC2_EXP2 6.73949674228e-3
+// WGS84 ellipsoid
+#include "../../utils/geodesy/Geodesy.h"
 
 // circumference
 #define CIR_EQ 40075017.0   // around equator  (meters)
@@ -348,91 +339,27 @@ int main(int argc, char *argv[])
 
 void ConvLLAToECEF(const PointLLA &pointLLA, Vec3 &pointECEF)
 {
-    // conversion formula from...
-    // hxxp://www.microem.ru/pages/u_blox/tech/dataconvert/GPS.G1-X-00006.pdf
-
-    // remember to convert deg->rad
-    double sinLat = sin(pointLLA.lat * K_PI/180.0f);
-    double sinLon = sin(pointLLA.lon * K_PI/180.0f);
-    double cosLat = cos(pointLLA.lat * K_PI/180.0f);
-    double cosLon = cos(pointLLA.lon * K_PI/180.0f);
-
-    // v = radius of curvature (meters)
-    double v = ELL_SEMI_MAJOR / (sqrt(1-(ELL_ECC_EXP2*sinLat*sinLat)));
-    pointECEF.x = (v + pointLLA.alt) * cosLat * cosLon;
-    pointECEF.y = (v + pointLLA.alt) * cosLat * sinLon;
-    pointECEF.z = ((1-ELL_ECC_EXP2)*v + pointLLA.alt)*sinLat;
+    scratch::geodesy::ConvLLAToECEF(pointLLA.lon,pointLLA.lat,pointLLA.alt,
+                                    pointECEF.x,pointECEF.y,pointECEF.z);
 }
 
 Vec3 ConvLLAToECEF(const PointLLA &pointLLA)
 {
     Vec3 pointECEF;
-
-    // remember to convert deg->rad
-    double sinLat = sin(pointLLA.lat * K_PI/180.0f);
-    double sinLon = sin(pointLLA.lon * K_PI/180.0f);
-    double cosLat = cos(pointLLA.lat * K_PI/180.0f);
-    double cosLon = cos(pointLLA.lon * K_PI/180.0f);
-
-    // v = radius of curvature (meters)
-    double v = ELL_SEMI_MAJOR / (sqrt(1-(ELL_ECC_EXP2*sinLat*sinLat)));
-    pointECEF.x = (v + pointLLA.alt) * cosLat * cosLon;
-    pointECEF.y = (v + pointLLA.alt) * cosLat * sinLon;
-    pointECEF.z = ((1-ELL_ECC_EXP2)*v + pointLLA.alt)*sinLat;
-
+    ConvLLAToECEF(pointLLA,pointECEF);
     return pointECEF;
 }
 
 void ConvECEFToLLA(const Vec3 &pointECEF, PointLLA &pointLLA)
 {
-    // conversion formula from...
-    // hxxp://www.microem.ru/pages/u_blox/tech/dataconvert/GPS.G1-X-00006.pdf
-
-    double p = (sqrt(pow(pointECEF.x,2) + pow(pointECEF.y,2)));
-    double th = atan2(pointECEF.z*ELL_SEMI_MAJOR, p*ELL_SEMI_MINOR);
-    double sinTh = sin(th);
-    double cosTh = cos(th);
-
-    // calc longitude
-    pointLLA.lon = atan2(pointECEF.y, pointECEF.x);
-
-    // calc latitude
-    pointLLA.lat = atan2(pointECEF.z + ELL_ECC2_EXP2*ELL_SEMI_MINOR*sinTh*sinTh*sinTh,
-                         p - ELL_ECC_EXP2*ELL_SEMI_MAJOR*cosTh*cosTh*cosTh);
-    // calc altitude
-    double sinLat = sin(pointLLA.lat);
-    double N = ELL_SEMI_MAJOR / (sqrt(1-(ELL_ECC_EXP2*sinLat*sinLat)));
-    pointLLA.alt = (p/cos(pointLLA.lat)) - N;
-
-    // convert from rad to deg
-    pointLLA.lon = pointLLA.lon * 180.0/K_PI;
-    pointLLA.lat = pointLLA.lat * 180.0/K_PI;
+    scratch::geodesy::ConvECEFToLLA(pointECEF.x,pointECEF.y,pointECEF.z,
+                                    pointLLA.lon,pointLLA.lat,pointLLA.alt);
 }
 
 PointLLA ConvECEFToLLA(const Vec3 &pointECEF)
 {
     PointLLA pointLLA;
-
-    double p = (sqrt(pow(pointECEF.x,2) + pow(pointECEF.y,2)));
-    double th = atan2(pointECEF.z*ELL_SEMI_MAJOR, p*ELL_SEMI_MINOR);
-    double sinTh = sin(th);
-    double cosTh = cos(th);
-
-    // calc longitude
-    pointLLA.lon = atan2(pointECEF.y, pointECEF.x);
-
-    // calc latitude
-    pointLLA.lat = atan2(pointECEF.z + ELL_ECC2_EXP2*ELL_SEMI_MINOR*sinTh*sinTh*sinTh,
-                         p - ELL_ECC_EXP2*ELL_SEMI_MAJOR*cosTh*cosTh*cosTh);
-    // calc altitude
-    double sinLat = sin(pointLLA.lat);
-    double N = ELL_SEMI_MAJOR / (sqrt(1-(ELL_ECC_EXP2*sinLat*sinLat)));
-    pointLLA.alt = (p/cos(pointLLA.lat)) - N;
-
-    // convert from rad to deg
-    pointLLA.lon = pointLLA.lon * 180.0/K_PI;
-    pointLLA.lat = pointLLA.lat * 180.0/K_PI;
-
+    ConvECEFToLLA(pointECEF,pointLLA);
     return pointLLA;
 }
 
@@ -461,12 +388,28 @@ bool BuildEarthSurfaceGeometry(double minLon, double maxLon,
     texCoords.clear();
     triIdx.clear();
 
-    // build vertex attributes
+    // build vertex attributes; the surface vertices
+    // are converted to ecef all at once
+    size_t const numVertices = (latSegments+1)*(lonSegments+1);
+    std::vector<double> listLon,listLat;
+    listLon.reserve(numVertices);
+    listLat.reserve(numVertices);
+    for(size_t i=0; i <= latSegments; i++)   {
+        for(size_t j=0; j <= lonSegments; j++)   {
+            listLon.push_back((j*lonStep)+minLon);
+            listLat.push_back((i*latStep)+minLat);
+        }
+    }
+    std::vector<double> listX(numVertices),listY(numVertices),listZ(numVertices);
+    scratch::geodesy::ConvLLAToECEF(numVertices,listLon.data(),listLat.data(),NULL,
+                                    listX.data(),listY.data(),listZ.data());
+
     for(size_t i=0; i <= latSegments; i++)   {
         for(size_t j=0; j <= lonSegments; j++)   {
             // surface vertex
-            vertexArray.push_back(ConvLLAToECEF(PointLLA((i*latStep)+minLat,
-                                                         (j*lonStep)+minLon)));
+            size_t const k = i*(lonSegments+1)+j;
+            vertexArray.push_back(Vec3(listX[k],listY[k],listZ[k]));
+
             // surface tex coord
             texCoords.push_back(Vec2((j*lonStep)/(maxLon-minLon),
                                      (i*latStep)/(maxLat-minLat)));
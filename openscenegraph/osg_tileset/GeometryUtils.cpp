@@ -22,40 +22,41 @@
 
 LLA ConvECEFToLLA(const osg::Vec3d &pointECEF)
 {
-    double radius = pointECEF.length();
-
     LLA pointLLA;
-    pointLLA.lon = (atan2(pointECEF.y(),pointECEF.x()))*K_RAD2DEG;
-    pointLLA.lat = (asin(pointECEF.z()/radius))*K_RAD2DEG;
-    pointLLA.alt = radius-RAD_AV;
-
+    scratch::geodesy::ConvECEFToLLA(pointECEF.x(),pointECEF.y(),pointECEF.z(),
+                                    pointLLA.lon,pointLLA.lat,pointLLA.alt,
+                                    K_EARTH);
     return pointLLA;
 }
 
 osg::Vec3d ConvLLAToECEF(const LLA &pointLLA)
 {
-    // remember to convert deg->rad
-    double sinLat = sin(pointLLA.lat * K_DEG2RAD);
-    double sinLon = sin(pointLLA.lon * K_DEG2RAD);
-    double cosLat = cos(pointLLA.lat * K_DEG2RAD);
-    double cosLon = cos(pointLLA.lon * K_DEG2RAD);
-    double radius = RAD_AV+pointLLA.alt;
-
     osg::Vec3d pointECEF;
-    pointECEF.x() = cosLat * cosLon * radius;
-    pointECEF.y() = cosLat * sinLon * radius;
-    pointECEF.z() = sinLat * radius;
-
+    scratch::geodesy::ConvLLAToECEF(pointLLA.lon,pointLLA.lat,pointLLA.alt,
+                                    pointECEF.x(),pointECEF.y(),pointECEF.z(),
+                                    K_EARTH);
     return pointECEF;
 }
 
 std::vector<LLA> ConvListECEFToLLA(std::vector<osg::Vec3d> const &list_ecef)
 {
-    std::vector<LLA> list_lla;
-    list_lla.reserve(list_ecef.size());
+    size_t const count = list_ecef.size();
+    std::vector<double> list_x(count),list_y(count),list_z(count);
+    for(size_t i=0; i < count; i++) {
+        list_x[i] = list_ecef[i].x();
+        list_y[i] = list_ecef[i].y();
+        list_z[i] = list_ecef[i].z();
+    }
+
+    std::vector<double> list_lon(count),list_lat(count),list_alt(count);
+    scratch::geodesy::ConvECEFToLLA(count,list_x.data(),list_y.data(),list_z.data(),
+                                    list_lon.data(),list_lat.data(),list_alt.data(),
+                                    K_EARTH);
 
-    for(auto const &ecef : list_ecef) {
-        list_lla.push_back(ConvECEFToLLA(ecef));
+    std::vector<LLA> list_lla;
+    list_lla.reserve(count);
+    for(size_t i=0; i < count; i++) {
+        list_lla.push_back(LLA(list_lon[i],list_lat[i],list_alt[i]));
     }
 
     return list_lla;
@@ -63,11 +64,25 @@ std::vector<LLA> ConvListECEFToLLA(std::vector<osg::Vec3d> const &list_ecef)
 
 std::vector<osg::Vec3d> ConvListLLAToECEF(std::vector<LLA> const &list_lla)
 {
-    std::vector<osg::Vec3d> list_ecef;
-    list_ecef.reserve(list_lla.size());
+    // the sin/cos of every point are computed a few
+    // at a time instead of one by one (see Geodesy.h)
+    size_t const count = list_lla.size();
+    std::vector<double> list_lon(count),list_lat(count),list_alt(count);
+    for(size_t i=0; i < count; i++) {
+        list_lon[i] = list_lla[i].lon;
+        list_lat[i] = list_lla[i].lat;
+        list_alt[i] = list_lla[i].alt;
+    }
+
+    std::vector<double> list_x(count),list_y(count),list_z(count);
+    scratch::geodesy::ConvLLAToECEF(count,list_lon.data(),list_lat.data(),list_alt.data(),
+                                    list_x.data(),list_y.data(),list_z.data(),
+                                    K_EARTH);
 
-    for(auto const &lla : list_lla) {
-        list_ecef.push_back(ConvLLAToECEF(lla));
+    std::vector<osg::Vec3d> list_ecef;
+    list_ecef.reserve(count);
+    for(size_t i=0; i < count; i++) {
+        list_ecef.push_back(osg::Vec3d(list_x[i],list_y[i],list_z[i]));
     }
 
     return list_ecef;
@@ -1356,7 +1371,8 @@ void BuildEarthSurface(double min_lon,
     list_ix.clear();
 
     // build vertex attributes
-    list_vx.reserve((lat_segments+1)*(lon_segments+1));
+    std::vector<LLA> list_lla;
+    list_lla.reserve((lat_segments+1)*(lon_segments+1));
     list_tx.reserve((lat_segments+1)*(lon_segments+1));
     for(uint16_t i=0; i <= lat_segments; i++)   {
         for(uint16_t j=0; j <= lon_segments; j++)   {
@@ -1365,13 +1381,14 @@ void BuildEarthSurface(double min_lon,
             lla.lon = (j*lon_step)+min_lon;
             lla.lat = (i*lat_step)+min_lat;
             lla.alt = 0.0;
-            list_vx.push_back(ConvLLAToECEF(lla));
+            list_lla.push_back(lla);
 
             // surface tex coord
             list_tx.push_back(osg::Vec2d(double(j)/lon_segments,
                                          double(i)/lat_segments));
         }
     }
+    list_vx = ConvListLLAToECEF(list_lla);
 
     // stitch faces together
     // TODO FIX ME TO MATCH other BuildEarthSurface?
@@ -1412,7 +1429,8 @@ void BuildEarthSurface(double min_lon,
     list_ix.clear();
 
     // build vertex attributes
-    list_vx.reserve((lat_segments+1)*(lon_segments+1));
+    std::vector<LLA> list_lla;
+    list_lla.reserve((lat_segments+1)*(lon_segments+1));
     for(uint16_t i=0; i <= lat_segments; i++)   {
         for(uint16_t j=0; j <= lon_segments; j++)   {
             // surface vertex
@@ -1420,9 +1438,10 @@ void BuildEarthSurface(double min_lon,
             lla.lon = (j*lon_step)+min_lon;
             lla.lat = (i*lat_step)+min_lat;
             lla.alt = 0.0;
-            list_vx.push_back(ConvLLAToECEF(lla));
+            list_lla.push_back(lla);
         }
     }
+    list_vx = ConvListLLAToECEF(list_lla);
 
     // stitch faces together
     list_ix.reserve(lon_segments*lat_segments*6);
@@ -1462,7 +1481,6 @@ void BuildEarthSurface(double min_lon,
 
     // build vertex attributes
     list_lla.reserve((lat_segments+1)*(lon_segments+1));
-    list_vx.reserve((lat_segments+1)*(lon_segments+1));
     for(uint16_t i=0; i <= lat_segments; i++)   {
         for(uint16_t j=0; j <= lon_segments; j++)   {
             // surface vertex
@@ -1471,9 +1489,9 @@ void BuildEarthSurface(double min_lon,
             lla.lat = (i*lat_step)+min_lat;
             lla.alt = 0.0;
             list_lla.push_back(lla);
-            list_vx.push_back(ConvLLAToECEF(lla));
         }
     }
+    list_vx = ConvListLLAToECEF(list_lla);
 
     // stitch faces together
     list_ix.reserve(lon_segments*lat_segments*6);
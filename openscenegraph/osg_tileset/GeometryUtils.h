@@ -29,6 +29,8 @@
 #include <osg/io_utils>
 #include <osg/Camera>
 
+#include <Geodesy.h>
+
 // ============================================================= //
 // ============================================================= //
 
@@ -45,6 +47,11 @@
 
 double const RAD_AV_INV_EXP2 = (1.0/6371000.0)*(1.0/6371000.0);
 
+// the horizon, ray intersection and tile bounds math
+// all treat the Earth as a sphere of RAD_AV, so the
+// ecef conversions use the same sphere instead of WGS84
+scratch::geodesy::Ellipsoid const K_EARTH = scratch::geodesy::MakeSphere(RAD_AV);
+
 std::vector<osg::Vec4> const K_COLOR_TABLE {
     {255/255., 255/255., 255/255., 1.},
     {202/255., 245/255., 29/255., 1.},
@@ -17,7 +17,8 @@
 #include <ThreadPool.h>
 
 #include <iostream>
-
+#include <algorithm>
+#include <limits>
 
 namespace scratch
 {
@@ -25,6 +26,7 @@ namespace scratch
 
     ThreadPool::Task::Task(Id id) :
         m_id(id),
+        m_queue_index(ThreadPool::k_not_queued),
         m_started(false),
         m_running(false),
         m_canceled(false),
@@ -90,8 +92,15 @@ namespace scratch
 
     // ============================================================= //
 
+    ThreadPool::Task::Priority const ThreadPool::k_priority_default = 0.0;
+
+    size_t const ThreadPool::k_not_queued =
+            std::numeric_limits<size_t>::max();
+
     ThreadPool::ThreadPool(size_t thread_count) :
         m_thread_count(thread_count),
+        m_seq_back(0),
+        m_seq_front(-1),
         m_running(false)
     {
         this->Resume();
@@ -100,6 +109,10 @@ namespace scratch
     ThreadPool::~ThreadPool()
     {
         this->Stop();
+
+        for(auto & item : m_queue_tasks) {
+            item.task->m_queue_index = k_not_queued;
+        }
     }
 
     size_t ThreadPool::GetTaskCount() const
@@ -112,13 +125,22 @@ namespace scratch
     {
         std::lock_guard<std::mutex> lock(m_mutex);
 
-        std::vector<Task::Id> list_ids;
-        list_ids.reserve(m_queue_tasks.size());
+        std::vector<QueueItem const *> list_items;
+        list_items.reserve(m_queue_tasks.size());
+        for(auto const &item : m_queue_tasks) {
+            list_items.push_back(&item);
+        }
 
-        for(auto it = m_queue_tasks.begin();
-            it != m_queue_tasks.end(); ++it)
-        {
-            list_ids.push_back((*it)->GetId());
+        std::sort(list_items.begin(),
+                  list_items.end(),
+                  [](QueueItem const * a, QueueItem const * b) {
+                      return compareQueueItems(*b,*a);
+                  });
+
+        std::vector<Task::Id> list_ids;
+        list_ids.reserve(list_items.size());
+        for(auto item : list_items) {
+            list_ids.push_back(item->task->GetId());
         }
 
         return list_ids;
@@ -128,7 +150,7 @@ namespace scratch
     {
         std::lock_guard<std::mutex> lock(m_mutex);
         // Add work to shared queue
-        m_queue_tasks.push_front(task);
+        pushItem(task,k_priority_default,m_seq_front--);
 
         // Wake one thread from the pool
         m_wait_cond.notify_one();
@@ -138,7 +160,7 @@ namespace scratch
     {
         std::lock_guard<std::mutex> lock(m_mutex);
         // Add work to shared queue
-        m_queue_tasks.push_back(task);
+        pushItem(task,k_priority_default,m_seq_back++);
 
         // Wake one thread from the pool
         m_wait_cond.notify_one();
@@ -148,17 +170,15 @@ namespace scratch
     {
         std::lock_guard<std::mutex> lock(m_mutex);
 
-        std::string slist;
-
         // Add work to shared queue
         for(auto r_it = list_tasks.rbegin();
             r_it != list_tasks.rend(); ++r_it)
         {
-            m_queue_tasks.push_front(*r_it);
+            pushItem(*r_it,k_priority_default,m_seq_front--);
         }
 
-        // Wake one thread from the pool
-        m_wait_cond.notify_one();
+        // Wake all threads from the pool
+        m_wait_cond.notify_all();
     }
 
     void ThreadPool::PushBack(std::vector<std::shared_ptr<Task>> const &list_tasks)
@@ -169,13 +189,62 @@ namespace scratch
         for(auto it = list_tasks.begin();
             it != list_tasks.end(); ++it)
         {
-            m_queue_tasks.push_back(*it);
+            pushItem(*it,k_priority_default,m_seq_back++);
         }
 
+        // Wake all threads from the pool
+        m_wait_cond.notify_all();
+    }
+
+    void ThreadPool::Push(std::shared_ptr<Task> const &task,
+                          Task::Priority priority)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Add work to shared queue
+        pushItem(task,priority,m_seq_back++);
+
         // Wake one thread from the pool
         m_wait_cond.notify_one();
     }
 
+    void ThreadPool::Push(std::vector<std::shared_ptr<Task>> const &list_tasks,
+                          std::vector<Task::Priority> const &list_priorities)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Add work to shared queue
+        for(size_t i=0; i < list_tasks.size(); i++) {
+            pushItem(list_tasks[i],list_priorities[i],m_seq_back++);
+        }
+
+        // Wake all threads from the pool
+        m_wait_cond.notify_all();
+    }
+
+    bool ThreadPool::UpdatePriority(Task const * task,
+                                    Task::Priority priority)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        size_t const index = task->m_queue_index;
+        if(index == k_not_queued) {
+            return false;
+        }
+
+        Task::Priority const prev_priority =
+                m_queue_tasks[index].priority;
+
+        m_queue_tasks[index].priority = priority;
+
+        if(priority > prev_priority) {
+            siftUp(index);
+        }
+        else if(priority < prev_priority) {
+            siftDown(index);
+        }
+
+        return true;
+    }
 
     void ThreadPool::Stop()
     {
@@ -217,9 +286,8 @@ namespace scratch
                 return;
             }
 
-            // Take a task to process
-            std::shared_ptr<Task> task = std::move(m_queue_tasks.front());
-            m_queue_tasks.pop_front();
+            // Take the highest priority task to process
+            std::shared_ptr<Task> task = popItem();
 
             lock.unlock(); // release lock
 
@@ -228,6 +296,94 @@ namespace scratch
         }
     }
 
+    bool ThreadPool::compareQueueItems(QueueItem const &a,
+                                       QueueItem const &b)
+    {
+        // true if @a should be processed after @b
+        if(a.priority != b.priority) {
+            return (a.priority < b.priority);
+        }
+        return (a.seq > b.seq);
+    }
+
+    void ThreadPool::pushItem(std::shared_ptr<Task> const &task,
+                              Task::Priority priority,
+                              int64_t seq)
+    {
+        if(task->m_queue_index != k_not_queued) {
+            // already queued
+            return;
+        }
+
+        QueueItem item;
+        item.task = task;
+        item.priority = priority;
+        item.seq = seq;
+
+        m_queue_tasks.push_back(std::move(item));
+        task->m_queue_index = m_queue_tasks.size()-1;
+        siftUp(m_queue_tasks.size()-1);
+    }
+
+    std::shared_ptr<ThreadPool::Task> ThreadPool::popItem()
+    {
+        std::shared_ptr<Task> task = std::move(m_queue_tasks.front().task);
+        task->m_queue_index = k_not_queued;
+
+        QueueItem last = std::move(m_queue_tasks.back());
+        m_queue_tasks.pop_back();
+
+        if(!m_queue_tasks.empty()) {
+            placeItem(std::move(last),0);
+            siftDown(0);
+        }
+
+        return task;
+    }
+
+    void ThreadPool::siftUp(size_t index)
+    {
+        QueueItem item = std::move(m_queue_tasks[index]);
+        while(index > 0) {
+            size_t const parent = (index-1)/2;
+            if(!compareQueueItems(m_queue_tasks[parent],item)) {
+                break;
+            }
+            placeItem(std::move(m_queue_tasks[parent]),index);
+            index = parent;
+        }
+        placeItem(std::move(item),index);
+    }
+
+    void ThreadPool::siftDown(size_t index)
+    {
+        size_t const count = m_queue_tasks.size();
+        QueueItem item = std::move(m_queue_tasks[index]);
+        while(true) {
+            size_t child = 2*index+1;
+            if(child >= count) {
+                break;
+            }
+            if((child+1 < count) &&
+               compareQueueItems(m_queue_tasks[child],
+                                 m_queue_tasks[child+1])) {
+                child++;
+            }
+            if(!compareQueueItems(item,m_queue_tasks[child])) {
+                break;
+            }
+            placeItem(std::move(m_queue_tasks[child]),index);
+            index = child;
+        }
+        placeItem(std::move(item),index);
+    }
+
+    void ThreadPool::placeItem(QueueItem item, size_t index)
+    {
+        item.task->m_queue_index = index;
+        m_queue_tasks[index] = std::move(item);
+    }
+
     // ============================================================= //
 
 } // scratch
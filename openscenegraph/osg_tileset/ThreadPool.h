@@ -18,7 +18,6 @@
 #define SCRATCH_THREAD_POOL_H
 
 #include <vector>
-#include <list>
 #include <atomic>
 #include <thread>
 #include <mutex>
@@ -40,6 +39,7 @@ namespace scratch
 
         public:
             typedef uint64_t Id;
+            typedef double Priority;
 
             Task(Task::Id id);
             virtual ~Task();
@@ -73,6 +73,11 @@ namespace scratch
 
             Id const m_id;
 
+            // Position of this task in ThreadPool's queue
+            // or k_not_queued. Bookkeeping that belongs to
+            // the pool, guarded by ThreadPool::m_mutex
+            mutable size_t m_queue_index;
+
             std::atomic<bool> m_started;
             std::atomic<bool> m_running;
             std::atomic<bool> m_canceled;
@@ -92,13 +97,36 @@ namespace scratch
         ThreadPool(ThreadPool const &)              = delete;
         ThreadPool & operator=(ThreadPool const &)  = delete;
 
+        // Tasks are processed in order of decreasing priority.
+        // PushFront and PushBack use k_priority_default and
+        // place tasks before or after all other queued tasks
+        // that have the same priority.
+        static Task::Priority const k_priority_default;
+
         size_t GetTaskCount() const;
+
+        // Returns queued task ids in the order they
+        // would be processed
         std::vector<Task::Id> GetTaskIdList() const;
+
         void PushFront(std::shared_ptr<Task> const &task);
         void PushBack(std::shared_ptr<Task> const &task);
         void PushFront(std::vector<std::shared_ptr<Task>> const &list_tasks);
         void PushBack(std::vector<std::shared_ptr<Task>> const &list_tasks);
 
+        void Push(std::shared_ptr<Task> const &task,
+                  Task::Priority priority);
+
+        // list_priorities[i] is the priority of list_tasks[i]
+        void Push(std::vector<std::shared_ptr<Task>> const &list_tasks,
+                  std::vector<Task::Priority> const &list_priorities);
+
+        // Changes the priority of a queued task. Returns false
+        // if @task isn't queued (it was never pushed or has
+        // already been taken by a worker)
+        bool UpdatePriority(Task const * task,
+                            Task::Priority priority);
+
 //        // TODO maybe make this into a template function that
 //        // accepts any kind of container?
 //        template<typename ForwardIterator>
@@ -123,11 +151,40 @@ namespace scratch
         void Resume();
 
     private:
+        // Queued tasks are kept in an indexed binary max-heap
+        // ordered by priority, then by insertion sequence. Each
+        // task stores its heap position so UpdatePriority
+        // doesn't need to search for it.
+        struct QueueItem
+        {
+            std::shared_ptr<Task> task;
+            Task::Priority priority;
+            int64_t seq;
+        };
+
+        static size_t const k_not_queued;
+
+        static bool compareQueueItems(QueueItem const &a,
+                                      QueueItem const &b);
+
+        void pushItem(std::shared_ptr<Task> const &task,
+                      Task::Priority priority,
+                      int64_t seq);
+        std::shared_ptr<Task> popItem();
+        void siftUp(size_t index);
+        void siftDown(size_t index);
+        void placeItem(QueueItem item, size_t index);
+
         void loop();
 
         size_t m_thread_count;
         std::vector<std::thread> m_list_threads;
-        std::list<std::shared_ptr<Task>> m_queue_tasks;
+        std::vector<QueueItem> m_queue_tasks;
+
+        // PushBack sequence numbers count up from 0 and
+        // PushFront ones count down from -1
+        int64_t m_seq_back;
+        int64_t m_seq_front;
 
         std::atomic<bool> m_running;
         mutable std::mutex m_mutex;
@@ -116,6 +116,14 @@ namespace scratch
         virtual std::shared_ptr<Request>
         RequestData(TileLL::Id id) = 0;
 
+        // Sets how urgently the data for @request is needed;
+        // requests with a higher priority are processed first.
+        // Can be called for requests in the current request
+        // block or for requests sent in an earlier one. Has
+        // no effect once a request has started processing.
+        virtual void UpdatePriority(Request const * request,
+                                    ThreadPool::Task::Priority priority) = 0;
+
     private:
         GeoBounds const m_bounds;
         uint8_t const m_max_level;
@@ -98,26 +98,17 @@ namespace scratch
     void TileImageSourceLL::StartRequestBlock()
     {
         m_list_requests.clear();
+        m_list_request_priorities.clear();
+        m_lkup_request_index.clear();
     }
 
     void TileImageSourceLL::EndRequestBlock()
     {
-        // TODO
-
-        // PushFront(...) may load certain tiles out
-        // of order (ie further away), but loads tiles
-        // requested recently first. For slow load times,
-        // PushFront is better
-
-        // PushBack(...) loads tiles in the order they
-        // are requested. As the number of requests accumulate,
-        // the time taken to load the mostly recently requested
-        // tiles increases substantially. However this method
-        // doesn't load tiles out of order. For fast load times,
-        // PushBack is better
-
-        // We need to provide an option to choose
-        m_thread_pool.PushFront(m_list_requests);
+        // Requests are processed by priority (see UpdatePriority)
+        // instead of PushFront/PushBack order so tiles that
+        // are no longer visible don't hold up ones that are
+        m_thread_pool.Push(m_list_requests,
+                           m_list_request_priorities);
 //        std::cout << "task_count: "
 //                  << m_thread_pool.GetTaskCount() << std::endl;
 
@@ -143,6 +134,8 @@ namespace scratch
 
 
         m_list_requests.clear();
+        m_list_request_priorities.clear();
+        m_lkup_request_index.clear();
     }
 
     std::shared_ptr<TileDataSourceLL::Request>
@@ -152,10 +145,27 @@ namespace scratch
                 std::make_shared<ImageRequest>(
                     id,m_path_gen(id));
 
+        m_lkup_request_index.emplace(request.get(),m_list_requests.size());
         m_list_requests.push_back(request);
+        m_list_request_priorities.push_back(
+                    ThreadPool::k_priority_default);
+
         return request;
     }
 
+    void TileImageSourceLL::UpdatePriority(Request const * request,
+                                           ThreadPool::Task::Priority priority)
+    {
+        auto it = m_lkup_request_index.find(request);
+        if(it != m_lkup_request_index.end()) {
+            // not sent yet
+            m_list_request_priorities[it->second] = priority;
+            return;
+        }
+
+        m_thread_pool.UpdatePriority(request,priority);
+    }
+
 
 
 } // scratch
@@ -18,6 +18,7 @@
 #define SCRATCH_TILE_IMAGE_SOURCE_LL_H
 
 #include <functional>
+#include <unordered_map>
 
 #include <TileDataSourceLL.h>
 
@@ -68,11 +69,18 @@ namespace scratch
 
         std::shared_ptr<Request> RequestData(TileLL::Id id);
 
+        void UpdatePriority(Request const * request,
+                            ThreadPool::Task::Priority priority);
+
     private:
         std::function<std::string(TileLL::Id)> m_path_gen;
         ThreadPool m_thread_pool;
 
+        // requests in the current block that haven't
+        // been sent to the thread pool yet
         std::vector<std::shared_ptr<ThreadPool::Task>> m_list_requests;
+        std::vector<ThreadPool::Task::Priority> m_list_request_priorities;
+        std::unordered_map<Request const *,size_t> m_lkup_request_index;
     };
 
 } // scratch
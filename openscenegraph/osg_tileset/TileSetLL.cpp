@@ -335,6 +335,18 @@ namespace scratch
                         }
                         save_this_tile = false;
                     }
+                    else {
+                        // The children's visibility isn't known
+                        // until their data is, so their requests
+                        // get the rank of the tile they refine
+                        double const rank = calcTileRank(meta);
+                        for(auto child_meta : list_children) {
+                            if(!child_meta->ready) {
+                                m_tile_data_source->UpdatePriority(
+                                            child_meta->request,rank);
+                            }
+                        }
+                    }
                 }
 
                 if(save_this_tile) {                   
@@ -389,6 +401,15 @@ namespace scratch
 //        std::cout << std::endl;
 
 
+        // Requests that weren't reused in this update are for
+        // tiles that are no longer in the tile set; drop them
+        // behind everything else if they haven't started yet
+        for(auto it = std::next(it_mark_upd_start);
+            it != m_ll_view_data.end(); ++it) {
+            m_tile_data_source->UpdatePriority(
+                        it->second.get(),k_priority_stale);
+        }
+
         // Trim the tile data cache according to the cache_size_hint.
         // Only data inserted before the data requests made before
         // @it_mark_upd_start was inserted will be trimmed (even if
@@ -697,21 +718,7 @@ namespace scratch
         std::sort(list_ranked_tiles.begin(),
                   list_ranked_tiles.end(),
                   [](TileMetaData const * a, TileMetaData const * b) {
-                        // TODO
-                        // Should tiles with clip==k_clip_ALL have
-                        // a rank of 0?
-
-                        double rank_a =
-                                double(a->tile->level)*
-                                double(a->is_visible)* // should work, false==0.0,true==1.0
-                                a->norm_error;
-
-                        double rank_b =
-                                double(b->tile->level)*
-                                double(b->is_visible)*
-                                b->norm_error;
-
-                        return (rank_a > rank_b);
+                        return (calcTileRank(a) > calcTileRank(b));
                     }
                 );
 
@@ -721,10 +728,16 @@ namespace scratch
                 std::min(list_ranked_tiles.size(),
                          static_cast<size_t>(m_max_view_data));
 
+        // Requests are prioritized by rank so that data for
+        // visible tiles with the most error is loaded first.
+        // This includes requests from previous updates that
+        // are still waiting to be processed
         m_tile_data_source->StartRequestBlock();
         for(size_t i=0; i < num_requests; i++) {
             TileMetaData * meta = list_ranked_tiles[i];
             meta->request = getOrCreateDataRequest(meta->tile,true);
+            m_tile_data_source->UpdatePriority(
+                        meta->request,calcTileRank(meta));
         }
         m_tile_data_source->EndRequestBlock();
 
@@ -769,6 +782,15 @@ namespace scratch
                         sample_meta->request->GetData().get());
         }
 
+        // Requests that weren't reused in this update are for
+        // tiles that are no longer in the tile set; drop them
+        // behind everything else if they haven't started yet
+        for(auto it = std::next(it_mark_upd_start);
+            it != m_ll_view_data.end(); ++it) {
+            m_tile_data_source->UpdatePriority(
+                        it->second.get(),k_priority_stale);
+        }
+
         // trim cache
         m_ll_view_data.trim(it_mark_upd_start,m_opts.cache_size_hint);
         m_ll_view_data.erase(TileLL::GetIdFromLevelXY(255,0,0));
@@ -781,6 +803,16 @@ namespace scratch
         return list_tile_items;
     }
 
+    double TileSetLL::calcTileRank(TileMetaData const * meta)
+    {
+        // TODO
+        // Should tiles with clip==k_clip_ALL have
+        // a rank of 0?
+        return double(meta->tile->level)*
+               double(meta->is_visible)* // should work, false==0.0,true==1.0
+               meta->norm_error;
+    }
+
     TileDataSourceLL::Data const *
     TileSetLL::getData(TileLL const * tile)
     {
@@ -194,6 +194,14 @@ namespace scratch
         static bool compareMetaDataRankIncreasing(TileMetaData const * a,
                                                   TileMetaData const * b);
 
+        // Ranks tiles by level, visibility and norm_error. Used
+        // to order tiles and as the priority of their requests
+        static double calcTileRank(TileMetaData const * meta);
+
+        // Priority for requests that are no longer needed by
+        // the current tile set; ranks are never negative
+        static constexpr double k_priority_stale = -1.0;
+
         TileDataSourceLL::Data const *
         getData(TileLL const *tile);
 
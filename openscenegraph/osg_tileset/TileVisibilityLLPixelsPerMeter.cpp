@@ -65,18 +65,25 @@ namespace scratch
         // surface area
         surf_area_m2 = CalcGeoBoundsArea(bounds);
 
-        // (mid lon,mid lat) ecef
-        LLA lla_mid;
-        lla_mid.lon = (bounds.minLon+bounds.maxLon)*0.5;
-        lla_mid.lat = (bounds.minLat+bounds.maxLat)*0.5;
-        lla_mid.alt = 0.0;
-        ecef_mid = ConvLLAToECEF(lla_mid);
-
-        // corners
-        c_min_min = ConvLLAToECEF(LLA(bounds.minLon,bounds.minLat));
-        c_max_min = ConvLLAToECEF(LLA(bounds.maxLon,bounds.minLat));
-        c_max_max = ConvLLAToECEF(LLA(bounds.maxLon,bounds.maxLat));
-        c_min_max = ConvLLAToECEF(LLA(bounds.minLon,bounds.maxLat));
+        // (mid lon,mid lat) and corner ecef, converted
+        // together since every new tile needs them
+        double const mid_lon = (bounds.minLon+bounds.maxLon)*0.5;
+        double const mid_lat = (bounds.minLat+bounds.maxLat)*0.5;
+        double const list_lon[5] = {
+            mid_lon, bounds.minLon, bounds.maxLon, bounds.maxLon, bounds.minLon
+        };
+        double const list_lat[5] = {
+            mid_lat, bounds.minLat, bounds.minLat, bounds.maxLat, bounds.maxLat
+        };
+        double list_x[5],list_y[5],list_z[5];
+        geodesy::ConvLLAToECEF(5,list_lon,list_lat,NULL,
+                               list_x,list_y,list_z,K_EARTH);
+
+        ecef_mid = osg::Vec3d(list_x[0],list_y[0],list_z[0]);
+        c_min_min = osg::Vec3d(list_x[1],list_y[1],list_z[1]);
+        c_max_min = osg::Vec3d(list_x[2],list_y[2],list_z[2]);
+        c_max_max = osg::Vec3d(list_x[3],list_y[3],list_z[3]);
+        c_min_max = osg::Vec3d(list_x[4],list_y[4],list_z[4]);
 
         // lon and lat planes
         plane_min_lon = CalcLonPlane(bounds.minLon,true,true);
@@ -22,6 +22,10 @@ LIBS += -L$${PATH_OPENSCENEGRAPH_LIB} -losgDB
 LIBS += -L$${PATH_OPENSCENEGRAPH_LIB} -losg
 LIBS += -L$${PATH_OPENSCENEGRAPH_LIB} -lOpenThreads
 
+# geodesy
+PATH_GEODESY = $$PWD/../../utils/geodesy
+INCLUDEPATH += $${PATH_GEODESY}
+
 HEADERS += \
         ViewController.hpp \
         MiscUtils.h \
@@ -35,7 +39,8 @@ HEADERS += \
         TileVisibilityLL.h \
         TileVisibilityLLPixelsPerMeter.h \
         TileSetLL.h \
-        DataSetTileAtlasLL.h
+        DataSetTileAtlasLL.h \
+        $${PATH_GEODESY}/Geodesy.h
 	
 SOURCES += \
         GeometryUtils.cpp \
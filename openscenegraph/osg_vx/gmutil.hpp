@@ -28,6 +28,8 @@
 #include <osg/Vec3d>
 #include <osg/Geometry>
 
+#include <Geodesy.h>
+
 //////////////////////////////////////////////////////
 
 #define K_PI 3.141592653589
@@ -352,35 +354,61 @@ struct PointLLA
     double alt;
 };
 
+// the horizon, ray intersection and tile bounds math here
+// all treat the Earth as a sphere of RAD_AV, so the ecef
+// conversions use the same sphere instead of WGS84
+scratch::geodesy::Ellipsoid const K_EARTH = scratch::geodesy::MakeSphere(RAD_AV);
+
 PointLLA ConvECEFToLLA(const osg::Vec3d &pointECEF)
 {
-    double radius = pointECEF.length();
-
     PointLLA pointLLA;
-    pointLLA.lon = (atan2(pointECEF.y(),pointECEF.x()))*K_RAD2DEG;
-    pointLLA.lat = (asin(pointECEF.z()/radius))*K_RAD2DEG;
-    pointLLA.alt = radius-RAD_AV;
-
+    scratch::geodesy::ConvECEFToLLA(pointECEF.x(),pointECEF.y(),pointECEF.z(),
+                                    pointLLA.lon,pointLLA.lat,pointLLA.alt,
+                                    K_EARTH);
     return pointLLA;
 }
 
 osg::Vec3d ConvLLAToECEF(const PointLLA &pointLLA)
 {
-    // remember to convert deg->rad
-    double sinLat = sin(pointLLA.lat * K_DEG2RAD);
-    double sinLon = sin(pointLLA.lon * K_DEG2RAD);
-    double cosLat = cos(pointLLA.lat * K_DEG2RAD);
-    double cosLon = cos(pointLLA.lon * K_DEG2RAD);
-    double radius = RAD_AV+pointLLA.alt;
-
     osg::Vec3d pointECEF;
-    pointECEF.x() = cosLat * cosLon * radius;
-    pointECEF.y() = cosLat * sinLon * radius;
-    pointECEF.z() = sinLat * radius;
-
+    scratch::geodesy::ConvLLAToECEF(pointLLA.lon,pointLLA.lat,pointLLA.alt,
+                                    pointECEF.x(),pointECEF.y(),pointECEF.z(),
+                                    K_EARTH);
     return pointECEF;
 }
 
+// appends the ecef positions of a (lonSegments+1) by
+// (latSegments+1) grid of surface points, row by row
+// from minLat, converting them all at once
+// * ListVec3d is std::vector<osg::Vec3d> or osg::Vec3dArray
+template <typename ListVec3d>
+void ConvGridLLAToECEF(double minLon, double minLat,
+                       double lonStep, double latStep,
+                       size_t lonSegments, size_t latSegments,
+                       ListVec3d &listECEF)
+{
+    size_t const numPoints = (latSegments+1)*(lonSegments+1);
+    std::vector<double> listLon,listLat;
+    listLon.reserve(numPoints);
+    listLat.reserve(numPoints);
+    for(size_t i=0; i <= latSegments; i++)   {
+        for(size_t j=0; j <= lonSegments; j++)   {
+            listLon.push_back((j*lonStep)+minLon);
+            listLat.push_back((i*latStep)+minLat);
+        }
+    }
+
+    std::vector<double> listX(numPoints),listY(numPoints),listZ(numPoints);
+    scratch::geodesy::ConvLLAToECEF(numPoints,listLon.data(),listLat.data(),NULL,
+                                    listX.data(),listY.data(),listZ.data(),
+                                    K_EARTH);
+
+    listECEF.reserve(listECEF.size()+numPoints);
+    for(size_t i=0; i < numPoints; i++)   {
+        listECEF.push_back(osg::Vec3d(listX[i],listY[i],listZ[i]));
+    }
+}
+
 bool CalcRayEarthIntersection(osg::Vec3d const &rayPoint,
                               osg::Vec3d const &rayDirn,
                               osg::Vec3d &xsecNear,
@@ -462,11 +490,10 @@ bool BuildEarthSurfaceGeometry(double minLon, double minLat,
     // build vertex attributes
 //    vertexArray.reserve((latSegments+1)*(lonSegments+1));
 //    texCoords.reserve((latSegments+1)*(lonSegments+1));
+    ConvGridLLAToECEF(minLon,minLat,lonStep,latStep,
+                      lonSegments,latSegments,vertexArray);
     for(size_t i=0; i <= latSegments; i++)   {
         for(size_t j=0; j <= lonSegments; j++)   {
-            // surface vertex
-            vertexArray.push_back(ConvLLAToECEF(PointLLA((j*lonStep)+minLon,
-                                                         (i*latStep)+minLat,0.0)));
             // surface tex coord
             texCoords.push_back(osg::Vec2d((double(j)/lonSegments),
                                            (double(i)/latSegments)));
@@ -517,11 +544,10 @@ bool BuildEarthSurfaceGeometry(double minLon, double minLat,
     // build vertex attributes
 //    vertexArray.reserve((latSegments+1)*(lonSegments+1));
 //    texCoords.reserve((latSegments+1)*(lonSegments+1));
+    ConvGridLLAToECEF(minLon,minLat,lonStep,latStep,
+                      lonSegments,latSegments,*vertexArray);
     for(size_t i=0; i <= latSegments; i++)   {
         for(size_t j=0; j <= lonSegments; j++)   {
-            // surface vertex
-            vertexArray->push_back(ConvLLAToECEF(PointLLA((j*lonStep)+minLon,
-                                                         (i*latStep)+minLat,0.0)));
             // surface tex coord
             texCoords->push_back(osg::Vec2d((double(j)/lonSegments),
                                            (double(i)/latSegments)));
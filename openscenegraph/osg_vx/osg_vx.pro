@@ -26,6 +26,11 @@ LIBS += -L$${PATH_OPENSCENEGRAPH_LIB} -lOpenThreads
 HEADERS += clipper.hpp
 SOURCES += clipper.cpp
 
+# geodesy
+PATH_GEODESY = $$PWD/../../utils/geodesy
+INCLUDEPATH += $${PATH_GEODESY}
+HEADERS += $${PATH_GEODESY}/Geodesy.h
+
 
 #SOURCES += vx_tilegen_async.cpp
 SOURCES += vx_tilegen4.cpp
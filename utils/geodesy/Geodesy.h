@@ -0,0 +1,570 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_GEODESY_H
+#define SCRATCH_GEODESY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// Batch coordinate conversions
+// * WGS84 lon/lat/alt (degrees, meters) <-> ECEF (meters) and
+//   spherical (web) Mercator (EPSG:3857/3785) <-> WGS84
+// * arrays are structure-of-arrays: one array per component,
+//   so a batch of n points is n lons, n lats and so on
+// * every conversion takes an Ellipsoid, which defaults to
+//   WGS84; MakeSphere covers code that models the Earth as
+//   a sphere
+// * the sin/cos of lon and lat are computed together, a
+//   few at a time, with SSE2/AVX2 or NEON (AArch64) kernels
+//   picked from the compiler's target flags (ie. -mavx2);
+//   the scalar kernel evaluates the same polynomials so
+//   results don't depend on where a point lands in a batch
+// * define GEODESY_NO_SIMD to force the scalar kernels
+
+#if !defined(GEODESY_NO_SIMD)
+    #if defined(__AVX2__)
+        #define GEODESY_SIMD_AVX2
+    #elif defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+        #define GEODESY_SIMD_SSE2
+    #elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+        // float64x2_t is only available on AArch64
+        #define GEODESY_SIMD_NEON
+    #endif
+#endif
+
+#if defined(GEODESY_SIMD_AVX2)
+    #include <immintrin.h>
+#endif
+#if defined(GEODESY_SIMD_SSE2)
+    #include <emmintrin.h>
+#endif
+#if defined(GEODESY_SIMD_NEON)
+    #include <arm_neon.h>
+#endif
+
+namespace scratch
+{
+namespace geodesy
+{
+    // ============================================================= //
+
+    double const k_pi = 3.14159265358979323846;
+    double const k_deg2rad = k_pi/180.0;
+    double const k_rad2deg = 180.0/k_pi;
+
+    struct Ellipsoid
+    {
+        double a;       // semi-major axis (meters)
+        double b;       // semi-minor axis (meters)
+        double e2;      // first eccentricity squared
+        double ep2;     // second eccentricity squared
+    };
+
+    // inv_f: inverse flattening, or 0 for a sphere
+    inline Ellipsoid MakeEllipsoid(double a, double inv_f)
+    {
+        double const f = (inv_f == 0.0) ? 0.0 : 1.0/inv_f;
+
+        Ellipsoid ellipsoid;
+        ellipsoid.a = a;
+        ellipsoid.b = a*(1.0-f);
+        ellipsoid.e2 = f*(2.0-f);
+        ellipsoid.ep2 = ellipsoid.e2/(1.0-ellipsoid.e2);
+        return ellipsoid;
+    }
+
+    inline Ellipsoid MakeSphere(double radius)
+    {
+        return MakeEllipsoid(radius,0.0);
+    }
+
+    // (http://en.wikipedia.org/wiki/WGS_84)
+    Ellipsoid const k_wgs84 = MakeEllipsoid(6378137.0,298.257223563);
+
+    // web mercator projects WGS84 lon/lat as if they
+    // were on a sphere with the WGS84 semi-major axis
+    double const k_mercator_radius = 6378137.0;
+
+    // ============================================================= //
+
+    namespace detail
+    {
+        // sin/cos kernel
+        // * x is reduced to r = x - q*(pi/2) with a three part
+        //   (Cody-Waite) pi/2 so |r| <= pi/4, and sin(r) and
+        //   cos(r) come from the cephes minimax polynomials
+        // * q mod 4 picks the quadrant: odd q swaps sin and
+        //   cos, and the signs come from bits of q and q+1
+        // * q is rounded by adding and subtracting 1.5*2^52,
+        //   which also leaves q's low bits in the low bits
+        //   of the sum; the reduction is exact for |x| up to
+        //   k_sincos_max_arg and larger (or non-finite) args
+        //   go to std::sin/cos
+
+        double const k_sincos_max_arg = 1.0E6;
+        double const k_round_magic = 6755399441055744.0;   // 1.5*2^52
+        double const k_two_over_pi = 0.63661977236758134308;
+        double const k_pio2_1 = 1.57079625129699707031E0;
+        double const k_pio2_2 = 7.54978941586159635335E-8;
+        double const k_pio2_3 = 5.39030285815811905290E-15;
+
+        double const k_sin_c0 = 1.58962301576546568060E-10;
+        double const k_sin_c1 = -2.50507477628578072866E-8;
+        double const k_sin_c2 = 2.75573136213857245213E-6;
+        double const k_sin_c3 = -1.98412698295895385996E-4;
+        double const k_sin_c4 = 8.33333333332211858878E-3;
+        double const k_sin_c5 = -1.66666666666666307295E-1;
+
+        double const k_cos_c0 = -1.13585365213876817300E-11;
+        double const k_cos_c1 = 2.08757008419747316778E-9;
+        double const k_cos_c2 = -2.75573141792967388112E-7;
+        double const k_cos_c3 = 2.48015872888517045348E-5;
+        double const k_cos_c4 = -1.38888888888730564116E-3;
+        double const k_cos_c5 = 4.16666666666665929218E-2;
+
+        inline void SinCosScalar(double x, double &s, double &c)
+        {
+            if(!(std::fabs(x) <= k_sincos_max_arg)) {
+                s = std::sin(x);
+                c = std::cos(x);
+                return;
+            }
+
+            double const qm = x*k_two_over_pi + k_round_magic;
+            uint64_t qi;
+            std::memcpy(&qi,&qm,sizeof(qi));
+            double const q = qm - k_round_magic;
+
+            double const r = ((x - q*k_pio2_1) - q*k_pio2_2) - q*k_pio2_3;
+            double const z = r*r;
+
+            double ps = k_sin_c0;
+            ps = ps*z + k_sin_c1;
+            ps = ps*z + k_sin_c2;
+            ps = ps*z + k_sin_c3;
+            ps = ps*z + k_sin_c4;
+            ps = ps*z + k_sin_c5;
+            double const sr = r + r*z*ps;
+
+            double pc = k_cos_c0;
+            pc = pc*z + k_cos_c1;
+            pc = pc*z + k_cos_c2;
+            pc = pc*z + k_cos_c3;
+            pc = pc*z + k_cos_c4;
+            pc = pc*z + k_cos_c5;
+            double const cr = (1.0 - 0.5*z) + z*z*pc;
+
+            bool const swap = (qi & 1) != 0;
+            s = swap ? cr : sr;
+            c = swap ? sr : cr;
+            if(qi & 2) {
+                s = -s;
+            }
+            if((qi+1) & 2) {
+                c = -c;
+            }
+        }
+
+#if defined(GEODESY_SIMD_AVX2)
+        #define GEODESY_SIMD
+
+        typedef __m256d VecD;
+        size_t const k_lanes = 4;
+
+        inline VecD Load(double const * p) { return _mm256_loadu_pd(p); }
+        inline void Store(double * p, VecD v) { _mm256_storeu_pd(p,v); }
+        inline VecD Set1(double x) { return _mm256_set1_pd(x); }
+        inline VecD Add(VecD a, VecD b) { return _mm256_add_pd(a,b); }
+        inline VecD Sub(VecD a, VecD b) { return _mm256_sub_pd(a,b); }
+        inline VecD Mul(VecD a, VecD b) { return _mm256_mul_pd(a,b); }
+        inline VecD Div(VecD a, VecD b) { return _mm256_div_pd(a,b); }
+        inline VecD Sqrt(VecD a) { return _mm256_sqrt_pd(a); }
+
+        // true if any lane is out of range or not a number
+        inline bool AnyOutOfRange(VecD x)
+        {
+            VecD const abs_x = _mm256_andnot_pd(_mm256_set1_pd(-0.0),x);
+            return _mm256_movemask_pd(
+                        _mm256_cmp_pd(abs_x,_mm256_set1_pd(k_sincos_max_arg),
+                                      _CMP_NLE_UQ)) != 0;
+        }
+
+        inline VecD QuadrantFix(VecD qm, VecD sr, VecD cr, VecD &c)
+        {
+            __m256i const qi = _mm256_castpd_si256(qm);
+            __m256i const sign = _mm256_set1_epi64x(int64_t(1) << 63);
+
+            // blendv picks on the sign bit, so move bit 0 there
+            VecD const swap = _mm256_castsi256_pd(_mm256_slli_epi64(qi,63));
+            VecD s = _mm256_blendv_pd(sr,cr,swap);
+            c = _mm256_blendv_pd(cr,sr,swap);
+
+            __m256i const s_sign = _mm256_and_si256(_mm256_slli_epi64(qi,62),sign);
+            __m256i const c_sign = _mm256_and_si256(
+                        _mm256_slli_epi64(_mm256_add_epi64(qi,_mm256_set1_epi64x(1)),62),sign);
+            s = _mm256_xor_pd(s,_mm256_castsi256_pd(s_sign));
+            c = _mm256_xor_pd(c,_mm256_castsi256_pd(c_sign));
+            return s;
+        }
+
+#elif defined(GEODESY_SIMD_SSE2)
+        #define GEODESY_SIMD
+
+        typedef __m128d VecD;
+        size_t const k_lanes = 2;
+
+        inline VecD Load(double const * p) { return _mm_loadu_pd(p); }
+        inline void Store(double * p, VecD v) { _mm_storeu_pd(p,v); }
+        inline VecD Set1(double x) { return _mm_set1_pd(x); }
+        inline VecD Add(VecD a, VecD b) { return _mm_add_pd(a,b); }
+        inline VecD Sub(VecD a, VecD b) { return _mm_sub_pd(a,b); }
+        inline VecD Mul(VecD a, VecD b) { return _mm_mul_pd(a,b); }
+        inline VecD Div(VecD a, VecD b) { return _mm_div_pd(a,b); }
+        inline VecD Sqrt(VecD a) { return _mm_sqrt_pd(a); }
+
+        inline bool AnyOutOfRange(VecD x)
+        {
+            VecD const abs_x = _mm_andnot_pd(_mm_set1_pd(-0.0),x);
+            return _mm_movemask_pd(
+                        _mm_cmpnle_pd(abs_x,_mm_set1_pd(k_sincos_max_arg))) != 0;
+        }
+
+        inline VecD QuadrantFix(VecD qm, VecD sr, VecD cr, VecD &c)
+        {
+            __m128i const qi = _mm_castpd_si128(qm);
+            __m128i const sign = _mm_castpd_si128(_mm_set1_pd(-0.0));
+
+            // SSE2 has no 64-bit arithmetic shift: move bit 0
+            // to the top, copy the high dword of each lane into
+            // both halves and spread it with a 32-bit shift
+            __m128i swap = _mm_slli_epi64(qi,63);
+            swap = _mm_shuffle_epi32(swap,_MM_SHUFFLE(3,3,1,1));
+            swap = _mm_srai_epi32(swap,31);
+            VecD const swap_mask = _mm_castsi128_pd(swap);
+
+            VecD s = _mm_or_pd(_mm_and_pd(swap_mask,cr),_mm_andnot_pd(swap_mask,sr));
+            c = _mm_or_pd(_mm_and_pd(swap_mask,sr),_mm_andnot_pd(swap_mask,cr));
+
+            __m128i const s_sign = _mm_and_si128(_mm_slli_epi64(qi,62),sign);
+            __m128i const c_sign = _mm_and_si128(
+                        _mm_slli_epi64(_mm_add_epi64(qi,_mm_set1_epi64x(1)),62),sign);
+            s = _mm_xor_pd(s,_mm_castsi128_pd(s_sign));
+            c = _mm_xor_pd(c,_mm_castsi128_pd(c_sign));
+            return s;
+        }
+
+#elif defined(GEODESY_SIMD_NEON)
+        #define GEODESY_SIMD
+
+        typedef float64x2_t VecD;
+        size_t const k_lanes = 2;
+
+        inline VecD Load(double const * p) { return vld1q_f64(p); }
+        inline void Store(double * p, VecD v) { vst1q_f64(p,v); }
+        inline VecD Set1(double x) { return vdupq_n_f64(x); }
+        inline VecD Add(VecD a, VecD b) { return vaddq_f64(a,b); }
+        inline VecD Sub(VecD a, VecD b) { return vsubq_f64(a,b); }
+        inline VecD Mul(VecD a, VecD b) { return vmulq_f64(a,b); }
+        inline VecD Div(VecD a, VecD b) { return vdivq_f64(a,b); }
+        inline VecD Sqrt(VecD a) { return vsqrtq_f64(a); }
+
+        inline bool AnyOutOfRange(VecD x)
+        {
+            // |x| <= max is false for NaN
+            uint64x2_t const in_range = vcaleq_f64(x,vdupq_n_f64(k_sincos_max_arg));
+            return (vgetq_lane_u64(in_range,0) & vgetq_lane_u64(in_range,1)) == 0;
+        }
+
+        inline VecD QuadrantFix(VecD qm, VecD sr, VecD cr, VecD &c)
+        {
+            int64x2_t const qi = vreinterpretq_s64_f64(qm);
+            uint64x2_t const sign = vdupq_n_u64(uint64_t(1) << 63);
+
+            uint64x2_t const swap = vreinterpretq_u64_s64(
+                        vshrq_n_s64(vshlq_n_s64(qi,63),63));
+            VecD s = vbslq_f64(swap,cr,sr);
+            c = vbslq_f64(swap,sr,cr);
+
+            uint64x2_t const s_sign = vandq_u64(
+                        vreinterpretq_u64_s64(vshlq_n_s64(qi,62)),sign);
+            uint64x2_t const c_sign = vandq_u64(
+                        vreinterpretq_u64_s64(vshlq_n_s64(vaddq_s64(qi,vdupq_n_s64(1)),62)),sign);
+            s = vreinterpretq_f64_u64(veorq_u64(vreinterpretq_u64_f64(s),s_sign));
+            c = vreinterpretq_f64_u64(veorq_u64(vreinterpretq_u64_f64(c),c_sign));
+            return s;
+        }
+#endif
+
+#if defined(GEODESY_SIMD)
+        // only valid if !AnyOutOfRange(x)
+        inline void SinCosVec(VecD x, VecD &s, VecD &c)
+        {
+            VecD const magic = Set1(k_round_magic);
+            VecD const qm = Add(Mul(x,Set1(k_two_over_pi)),magic);
+            VecD const q = Sub(qm,magic);
+
+            VecD r = Sub(x,Mul(q,Set1(k_pio2_1)));
+            r = Sub(r,Mul(q,Set1(k_pio2_2)));
+            r = Sub(r,Mul(q,Set1(k_pio2_3)));
+            VecD const z = Mul(r,r);
+
+            VecD ps = Set1(k_sin_c0);
+            ps = Add(Mul(ps,z),Set1(k_sin_c1));
+            ps = Add(Mul(ps,z),Set1(k_sin_c2));
+            ps = Add(Mul(ps,z),Set1(k_sin_c3));
+            ps = Add(Mul(ps,z),Set1(k_sin_c4));
+            ps = Add(Mul(ps,z),Set1(k_sin_c5));
+            VecD const sr = Add(r,Mul(Mul(r,z),ps));
+
+            VecD pc = Set1(k_cos_c0);
+            pc = Add(Mul(pc,z),Set1(k_cos_c1));
+            pc = Add(Mul(pc,z),Set1(k_cos_c2));
+            pc = Add(Mul(pc,z),Set1(k_cos_c3));
+            pc = Add(Mul(pc,z),Set1(k_cos_c4));
+            pc = Add(Mul(pc,z),Set1(k_cos_c5));
+            VecD const cr = Add(Sub(Set1(1.0),Mul(Set1(0.5),z)),Mul(Mul(z,z),pc));
+
+            s = QuadrantFix(qm,sr,cr,c);
+        }
+#endif
+
+        inline void ConvLLAToECEFScalar(Ellipsoid const &ellipsoid,
+                                        double lon, double lat, double alt,
+                                        double &x, double &y, double &z)
+        {
+            double sin_lon,cos_lon,sin_lat,cos_lat;
+            SinCosScalar(lon*k_deg2rad,sin_lon,cos_lon);
+            SinCosScalar(lat*k_deg2rad,sin_lat,cos_lat);
+
+            // n = prime vertical radius of curvature
+            double const n = ellipsoid.a/std::sqrt(1.0-ellipsoid.e2*sin_lat*sin_lat);
+            x = (n+alt)*cos_lat*cos_lon;
+            y = (n+alt)*cos_lat*sin_lon;
+            z = ((1.0-ellipsoid.e2)*n+alt)*sin_lat;
+        }
+    }
+
+    // ============================================================= //
+
+    // SinCos
+    // * s[i] = sin(x[i]), c[i] = cos(x[i]) with x in radians
+    // * within a couple of ulps of std::sin/cos for |x| up
+    //   to 1E6
+    inline void SinCos(size_t count,
+                       double const * x,
+                       double * s,
+                       double * c)
+    {
+        size_t i=0;
+
+#if defined(GEODESY_SIMD)
+        size_t const lanes = detail::k_lanes;
+        for(; i+lanes <= count; i+=lanes) {
+            detail::VecD const vx = detail::Load(x+i);
+            if(detail::AnyOutOfRange(vx)) {
+                for(size_t j=i; j < i+lanes; j++) {
+                    detail::SinCosScalar(x[j],s[j],c[j]);
+                }
+                continue;
+            }
+            detail::VecD vs,vc;
+            detail::SinCosVec(vx,vs,vc);
+            detail::Store(s+i,vs);
+            detail::Store(c+i,vc);
+        }
+#endif
+        for(; i < count; i++) {
+            detail::SinCosScalar(x[i],s[i],c[i]);
+        }
+    }
+
+    // ============================================================= //
+
+    // ConvLLAToECEF
+    // * lon, lat in degrees and alt in meters above the
+    //   ellipsoid; alt may be NULL for points on the surface
+    // * outputs x, y and z must not overlap the inputs
+    inline void ConvLLAToECEF(size_t count,
+                              double const * lon,
+                              double const * lat,
+                              double const * alt,
+                              double * x,
+                              double * y,
+                              double * z,
+                              Ellipsoid const &ellipsoid=k_wgs84)
+    {
+        size_t i=0;
+
+#if defined(GEODESY_SIMD)
+        using namespace detail;
+        size_t const lanes = k_lanes;
+        VecD const deg2rad = Set1(k_deg2rad);
+        VecD const a = Set1(ellipsoid.a);
+        VecD const e2 = Set1(ellipsoid.e2);
+        VecD const one = Set1(1.0);
+        VecD const one_minus_e2 = Set1(1.0-ellipsoid.e2);
+        VecD const zero = Set1(0.0);
+
+        for(; i+lanes <= count; i+=lanes) {
+            VecD const lon_rad = Mul(Load(lon+i),deg2rad);
+            VecD const lat_rad = Mul(Load(lat+i),deg2rad);
+            if(AnyOutOfRange(lon_rad) || AnyOutOfRange(lat_rad)) {
+                for(size_t j=i; j < i+lanes; j++) {
+                    ConvLLAToECEFScalar(ellipsoid,lon[j],lat[j],
+                                        alt ? alt[j] : 0.0,
+                                        x[j],y[j],z[j]);
+                }
+                continue;
+            }
+
+            VecD sin_lon,cos_lon,sin_lat,cos_lat;
+            SinCosVec(lon_rad,sin_lon,cos_lon);
+            SinCosVec(lat_rad,sin_lat,cos_lat);
+
+            VecD const h = alt ? Load(alt+i) : zero;
+            VecD const n = Div(a,Sqrt(Sub(one,Mul(e2,Mul(sin_lat,sin_lat)))));
+            VecD const n_cos_lat = Mul(Add(n,h),cos_lat);
+            Store(x+i,Mul(n_cos_lat,cos_lon));
+            Store(y+i,Mul(n_cos_lat,sin_lon));
+            Store(z+i,Mul(Add(Mul(one_minus_e2,n),h),sin_lat));
+        }
+#endif
+        for(; i < count; i++) {
+            detail::ConvLLAToECEFScalar(ellipsoid,lon[i],lat[i],
+                                        alt ? alt[i] : 0.0,
+                                        x[i],y[i],z[i]);
+        }
+    }
+
+    inline void ConvLLAToECEF(double lon, double lat, double alt,
+                              double &x, double &y, double &z,
+                              Ellipsoid const &ellipsoid=k_wgs84)
+    {
+        detail::ConvLLAToECEFScalar(ellipsoid,lon,lat,alt,x,y,z);
+    }
+
+    // ============================================================= //
+
+    // ConvECEFToLLA
+    // * Heikkinen's closed form (no iteration), which is
+    //   exact to well under a millimeter for points near
+    //   the surface; lon, lat in degrees and alt in meters
+    // * it needs atan2 and cbrt per point, so unlike
+    //   ConvLLAToECEF this is a plain loop
+    // * the center of the ellipsoid has no lon/lat and
+    //   gives NaN
+    inline void ConvECEFToLLA(size_t count,
+                              double const * x,
+                              double const * y,
+                              double const * z,
+                              double * lon,
+                              double * lat,
+                              double * alt,
+                              Ellipsoid const &ellipsoid=k_wgs84)
+    {
+        double const a = ellipsoid.a;
+        double const b = ellipsoid.b;
+        double const e2 = ellipsoid.e2;
+        double const ep2 = ellipsoid.ep2;
+        double const a2 = a*a;
+        double const b2 = b*b;
+        double const e4 = e2*e2;
+
+        for(size_t i=0; i < count; i++) {
+            double const px = x[i];
+            double const py = y[i];
+            double const pz = z[i];
+            double const z2 = pz*pz;
+            double const p2 = px*px + py*py;
+            double const p = std::sqrt(p2);
+
+            double const F = 54.0*b2*z2;
+            double const G = p2 + (1.0-e2)*z2 - e2*(a2-b2);
+            double const c = (e4*F*p2)/(G*G*G);
+            double const s = std::cbrt(1.0 + c + std::sqrt(c*c + 2.0*c));
+            double const k = s + 1.0 + 1.0/s;
+            double const P = F/(3.0*k*k*G*G);
+            double const Q = std::sqrt(1.0 + 2.0*e4*P);
+            // the sqrt term cancels to ~0 near the poles
+            // and can round to slightly below zero
+            double const r0 = -(P*e2*p)/(1.0+Q) +
+                    std::sqrt(std::max(0.0,0.5*a2*(1.0+1.0/Q) -
+                                           (P*(1.0-e2)*z2)/(Q*(1.0+Q)) -
+                                           0.5*P*p2));
+            double const pe = p - e2*r0;
+            double const U = std::sqrt(pe*pe + z2);
+            double const V = std::sqrt(pe*pe + (1.0-e2)*z2);
+            double const z0 = (b2*pz)/(a*V);
+
+            lon[i] = std::atan2(py,px)*k_rad2deg;
+            lat[i] = std::atan2(pz + ep2*z0,p)*k_rad2deg;
+            if(alt) {
+                alt[i] = U*(1.0 - b2/(a*V));
+            }
+        }
+    }
+
+    inline void ConvECEFToLLA(double x, double y, double z,
+                              double &lon, double &lat, double &alt,
+                              Ellipsoid const &ellipsoid=k_wgs84)
+    {
+        ConvECEFToLLA(1,&x,&y,&z,&lon,&lat,&alt,ellipsoid);
+    }
+
+    // ============================================================= //
+
+    // ConvMercatorToLLA, ConvLLAToMercator
+    // * spherical (web) mercator, EPSG:3857 and the older
+    //   EPSG:3785, in meters <-> WGS84 lon/lat in degrees
+    // * the conversions are in place safe (ie. x and lon can
+    //   be the same array)
+    // * lat = +-90 has no mercator y and gives +-inf
+    inline void ConvMercatorToLLA(size_t count,
+                                  double const * x,
+                                  double const * y,
+                                  double * lon,
+                                  double * lat)
+    {
+        double const inv_r = 1.0/k_mercator_radius;
+        for(size_t i=0; i < count; i++) {
+            lon[i] = (x[i]*inv_r)*k_rad2deg;
+            lat[i] = std::atan(std::sinh(y[i]*inv_r))*k_rad2deg;
+        }
+    }
+
+    inline void ConvLLAToMercator(size_t count,
+                                  double const * lon,
+                                  double const * lat,
+                                  double * x,
+                                  double * y)
+    {
+        double const r = k_mercator_radius;
+        for(size_t i=0; i < count; i++) {
+            x[i] = (lon[i]*k_deg2rad)*r;
+            y[i] = std::asinh(std::tan(lat[i]*k_deg2rad))*r;
+        }
+    }
+
+    // ============================================================= //
+}
+}
+
+#endif // SCRATCH_GEODESY_H
@@ -0,0 +1,10 @@
+TEMPLATE    = app
+TARGET      = runme
+CONFIG      -= qt
+
+INCLUDEPATH += $${PWD}
+
+HEADERS += Geodesy.h
+SOURCES += test_geodesy.cpp
+
+QMAKE_CXXFLAGS += -std=c++11
@@ -0,0 +1,396 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cassert>
+
+#include <Geodesy.h>
+
+using namespace scratch::geodesy;
+
+// the per point conversion the tools used to copy around
+void naiveLLAToECEF(double lon, double lat, double alt,
+                    double &x, double &y, double &z)
+{
+    double const sin_lat = std::sin(lat*k_deg2rad);
+    double const sin_lon = std::sin(lon*k_deg2rad);
+    double const cos_lat = std::cos(lat*k_deg2rad);
+    double const cos_lon = std::cos(lon*k_deg2rad);
+
+    double const n = k_wgs84.a/std::sqrt(1.0-k_wgs84.e2*sin_lat*sin_lat);
+    x = (n+alt)*cos_lat*cos_lon;
+    y = (n+alt)*cos_lat*sin_lon;
+    z = ((1.0-k_wgs84.e2)*n+alt)*sin_lat;
+}
+
+// Bowring's approximation, as in shptk.hpp
+void naiveECEFToLLA(double x, double y, double z,
+                    double &lon, double &lat, double &alt)
+{
+    double const a = k_wgs84.a;
+    double const b = k_wgs84.b;
+    double const p = std::sqrt(x*x + y*y);
+    double const th = std::atan2(z*a,p*b);
+    double const sin_th = std::sin(th);
+    double const cos_th = std::cos(th);
+
+    lon = std::atan2(y,x);
+    lat = std::atan2(z + k_wgs84.ep2*b*sin_th*sin_th*sin_th,
+                     p - k_wgs84.e2*a*cos_th*cos_th*cos_th);
+    double const sin_lat = std::sin(lat);
+    double const n = a/std::sqrt(1.0-k_wgs84.e2*sin_lat*sin_lat);
+    alt = p/std::cos(lat) - n;
+
+    lon *= k_rad2deg;
+    lat *= k_rad2deg;
+}
+
+// vertices along a random walk, roughly like a coastline
+void randomCoastline(size_t count,
+                     unsigned int seed,
+                     std::vector<double> &list_lon,
+                     std::vector<double> &list_lat)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist_start(-60.0,60.0);
+    std::uniform_real_distribution<double> dist_step(-0.01,0.01);
+
+    list_lon.resize(count);
+    list_lat.resize(count);
+    double lon = dist_start(rng)*3;
+    double lat = dist_start(rng);
+    for(size_t i=0; i < count; i++) {
+        if(i % 10000 == 0) {
+            lon = dist_start(rng)*3;
+            lat = dist_start(rng);
+        }
+        lon = std::max(-180.0,std::min(180.0,lon+dist_step(rng)));
+        lat = std::max(-85.0,std::min(85.0,lat+dist_step(rng)));
+        list_lon[i] = lon;
+        list_lat[i] = lat;
+    }
+}
+
+double ms(std::chrono::steady_clock::time_point a,
+          std::chrono::steady_clock::time_point b)
+{
+    return std::chrono::duration<double,std::milli>(b-a).count();
+}
+
+// ============================================================= //
+
+void testSinCos()
+{
+    std::vector<double> list_x;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> dist_small(-10.0,10.0);
+    std::uniform_real_distribution<double> dist_large(-1.0E6,1.0E6);
+    for(size_t i=0; i < 100000; i++) {
+        list_x.push_back(dist_small(rng));
+    }
+    for(size_t i=0; i < 1000; i++) {
+        list_x.push_back(dist_large(rng));
+    }
+
+    // quadrant boundaries, signed zeros and args that
+    // fall back to std::sin/cos
+    for(int q=-8; q <= 8; q++) {
+        list_x.push_back(q*k_pi*0.25);
+        list_x.push_back(std::nextafter(q*k_pi*0.25,1E9));
+        list_x.push_back(std::nextafter(q*k_pi*0.25,-1E9));
+    }
+    list_x.push_back(0.0);
+    list_x.push_back(-0.0);
+    list_x.push_back(1.0E7);
+    list_x.push_back(-3.0E12);
+    list_x.push_back(std::numeric_limits<double>::infinity());
+    list_x.push_back(std::numeric_limits<double>::quiet_NaN());
+
+    std::vector<double> list_s(list_x.size());
+    std::vector<double> list_c(list_x.size());
+    SinCos(list_x.size(),list_x.data(),list_s.data(),list_c.data());
+
+    for(size_t i=0; i < list_x.size(); i++) {
+        double const x = list_x[i];
+        if(std::isnan(std::sin(x))) {
+            assert(std::isnan(list_s[i]) && std::isnan(list_c[i]));
+            continue;
+        }
+        // absolute error, since sin/cos are bounded
+        assert(std::fabs(list_s[i]-std::sin(x)) < 1E-15);
+        assert(std::fabs(list_c[i]-std::cos(x)) < 1E-15);
+
+        // the scalar tail matches the vector lanes
+        double s,c;
+        scratch::geodesy::detail::SinCosScalar(x,s,c);
+        assert(s == list_s[i] && c == list_c[i]);
+    }
+
+    std::cout << "testSinCos... [ok]" << std::endl;
+}
+
+void testLLAToECEF()
+{
+    std::vector<double> list_lon,list_lat;
+    randomCoastline(50001,1,list_lon,list_lat);
+
+    // poles, the antimeridian and a few altitudes
+    double const list_edge[][3] = {
+        {0,90,0}, {0,-90,0}, {180,0,0}, {-180,0,0},
+        {45,45,-100}, {-120,-30,8848}, {10,10,400000}
+    };
+
+    std::vector<double> list_alt(list_lon.size(),0.0);
+    for(auto const &edge : list_edge) {
+        list_lon.push_back(edge[0]);
+        list_lat.push_back(edge[1]);
+        list_alt.push_back(edge[2]);
+    }
+
+    size_t const n = list_lon.size();
+    std::vector<double> list_x(n),list_y(n),list_z(n);
+    ConvLLAToECEF(n,list_lon.data(),list_lat.data(),list_alt.data(),
+                  list_x.data(),list_y.data(),list_z.data());
+
+    for(size_t i=0; i < n; i++) {
+        double x,y,z;
+        naiveLLAToECEF(list_lon[i],list_lat[i],list_alt[i],x,y,z);
+        assert(std::fabs(x-list_x[i]) < 1E-6);
+        assert(std::fabs(y-list_y[i]) < 1E-6);
+        assert(std::fabs(z-list_z[i]) < 1E-6);
+    }
+
+    // no alt is the same as zero alt
+    std::vector<double> list_x0(n),list_y0(n),list_z0(n);
+    ConvLLAToECEF(n,list_lon.data(),list_lat.data(),NULL,
+                  list_x0.data(),list_y0.data(),list_z0.data());
+    for(size_t i=0; i < n; i++) {
+        if(list_alt[i] == 0.0) {
+            assert(list_x0[i] == list_x[i]);
+            assert(list_y0[i] == list_y[i]);
+            assert(list_z0[i] == list_z[i]);
+        }
+    }
+
+    // on a sphere, everything is radius+alt from the center
+    Ellipsoid const sphere = MakeSphere(6371000.0);
+    ConvLLAToECEF(n,list_lon.data(),list_lat.data(),list_alt.data(),
+                  list_x.data(),list_y.data(),list_z.data(),sphere);
+    for(size_t i=0; i < n; i++) {
+        double const radius = std::sqrt(list_x[i]*list_x[i]+
+                                        list_y[i]*list_y[i]+
+                                        list_z[i]*list_z[i]);
+        assert(std::fabs(radius-(6371000.0+list_alt[i])) < 1E-6);
+    }
+
+    std::cout << "testLLAToECEF... [ok]" << std::endl;
+}
+
+void testECEFRoundTrip()
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> dist_lon(-180.0,180.0);
+    std::uniform_real_distribution<double> dist_lat(-90.0,90.0);
+    std::uniform_real_distribution<double> dist_alt(-10000.0,1000000.0);
+
+    size_t const n = 100000;
+    std::vector<double> list_lon(n),list_lat(n),list_alt(n);
+    for(size_t i=0; i < n; i++) {
+        list_lon[i] = dist_lon(rng);
+        list_lat[i] = dist_lat(rng);
+        list_alt[i] = dist_alt(rng);
+    }
+    list_lat[0] = 90.0;
+    list_lat[1] = -90.0;
+    list_lat[2] = 0.0;
+    list_alt[2] = 0.0;
+
+    Ellipsoid const list_ellipsoids[] = { k_wgs84, MakeSphere(6371000.0) };
+    for(auto const &ellipsoid : list_ellipsoids) {
+        std::vector<double> list_x(n),list_y(n),list_z(n);
+        ConvLLAToECEF(n,list_lon.data(),list_lat.data(),list_alt.data(),
+                      list_x.data(),list_y.data(),list_z.data(),ellipsoid);
+
+        std::vector<double> list_lon2(n),list_lat2(n),list_alt2(n);
+        ConvECEFToLLA(n,list_x.data(),list_y.data(),list_z.data(),
+                      list_lon2.data(),list_lat2.data(),list_alt2.data(),
+                      ellipsoid);
+
+        for(size_t i=0; i < n; i++) {
+            // ~1mm at the equator; lon is meaningless at the poles
+            assert(std::fabs(list_lat2[i]-list_lat[i]) < 1E-8);
+            assert(std::fabs(list_alt2[i]-list_alt[i]) < 1E-3);
+            if(std::fabs(list_lat[i]) < 89.9) {
+                assert(std::fabs(list_lon2[i]-list_lon[i]) < 1E-8);
+            }
+        }
+    }
+
+    std::cout << "testECEFRoundTrip... [ok]" << std::endl;
+}
+
+void testMercator()
+{
+    // the origin and the corner of the EPSG:3857 square
+    double list_lon[] = { 0.0, 180.0, -79.3832, 85.0 };
+    double list_lat[] = { 0.0, 85.0511287798066, 43.6532, -60.0 };
+    double list_x[4],list_y[4];
+    ConvLLAToMercator(4,list_lon,list_lat,list_x,list_y);
+    assert(std::fabs(list_x[0]) < 1E-9 && std::fabs(list_y[0]) < 1E-9);
+    assert(std::fabs(list_x[1]-20037508.342789244) < 1E-6);
+    assert(std::fabs(list_y[1]-20037508.342789244) < 1E-3);
+
+    // in place round trip
+    ConvMercatorToLLA(4,list_x,list_y,list_x,list_y);
+    for(size_t i=0; i < 4; i++) {
+        assert(std::fabs(list_x[i]-list_lon[i]) < 1E-10);
+        assert(std::fabs(list_y[i]-list_lat[i]) < 1E-10);
+    }
+
+    std::cout << "testMercator... [ok]" << std::endl;
+}
+
+// ============================================================= //
+
+void benchCoastline()
+{
+    size_t const n = 4000000;
+    std::vector<double> list_lon,list_lat;
+    randomCoastline(n,3,list_lon,list_lat);
+    std::vector<double> list_x(n),list_y(n),list_z(n);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(size_t i=0; i < n; i++) {
+        naiveLLAToECEF(list_lon[i],list_lat[i],0.0,
+                       list_x[i],list_y[i],list_z[i]);
+    }
+    double naive_check = list_x[n/2];
+
+    auto t1 = std::chrono::steady_clock::now();
+    ConvLLAToECEF(n,list_lon.data(),list_lat.data(),NULL,
+                  list_x.data(),list_y.data(),list_z.data());
+    assert(std::fabs(naive_check-list_x[n/2]) < 1E-6);
+
+    auto t2 = std::chrono::steady_clock::now();
+    std::vector<double> list_lon2(n),list_lat2(n),list_alt2(n);
+    for(size_t i=0; i < n; i++) {
+        naiveECEFToLLA(list_x[i],list_y[i],list_z[i],
+                       list_lon2[i],list_lat2[i],list_alt2[i]);
+    }
+
+    auto t3 = std::chrono::steady_clock::now();
+    ConvECEFToLLA(n,list_x.data(),list_y.data(),list_z.data(),
+                  list_lon2.data(),list_lat2.data(),list_alt2.data());
+
+    auto t4 = std::chrono::steady_clock::now();
+    ConvLLAToMercator(n,list_lon.data(),list_lat.data(),
+                      list_x.data(),list_y.data());
+
+    auto t5 = std::chrono::steady_clock::now();
+    ConvMercatorToLLA(n,list_x.data(),list_y.data(),
+                      list_lon2.data(),list_lat2.data());
+    auto t6 = std::chrono::steady_clock::now();
+
+    std::cout << "benchCoastline: " << n << " vertices, total times" << std::endl;
+    std::cout << "benchCoastline: lla->ecef, one call per point: " << ms(t0,t1) << "ms" << std::endl;
+    std::cout << "benchCoastline: lla->ecef batch: " << ms(t1,t2) << "ms" << std::endl;
+    std::cout << "benchCoastline: ecef->lla, one call per point (bowring): " << ms(t2,t3) << "ms" << std::endl;
+    std::cout << "benchCoastline: ecef->lla batch: " << ms(t3,t4) << "ms" << std::endl;
+    std::cout << "benchCoastline: lla->mercator batch: " << ms(t4,t5) << "ms" << std::endl;
+    std::cout << "benchCoastline: mercator->lla batch: " << ms(t5,t6) << "ms" << std::endl;
+}
+
+void benchTileCorners()
+{
+    // the four corners and middle of every visible
+    // tile are converted each frame
+    size_t const num_frames = 1000;
+    size_t const num_tiles = 400;
+    size_t const n = num_tiles*5;
+
+    std::mt19937 rng(9);
+    std::uniform_real_distribution<double> dist_lon(-170.0,170.0);
+    std::uniform_real_distribution<double> dist_lat(-80.0,80.0);
+
+    std::vector<double> list_lon(n),list_lat(n);
+    for(size_t t=0; t < num_tiles; t++) {
+        double const min_lon = dist_lon(rng);
+        double const min_lat = dist_lat(rng);
+        double const max_lon = min_lon+5.625;
+        double const max_lat = min_lat+5.625;
+        double const tile_lon[5] = { min_lon, max_lon, max_lon, min_lon, min_lon+2.8125 };
+        double const tile_lat[5] = { min_lat, min_lat, max_lat, max_lat, min_lat+2.8125 };
+        for(size_t k=0; k < 5; k++) {
+            list_lon[t*5+k] = tile_lon[k];
+            list_lat[t*5+k] = tile_lat[k];
+        }
+    }
+
+    Ellipsoid const sphere = MakeSphere(6371000.0);
+    std::vector<double> list_x(n),list_y(n),list_z(n);
+    double sum_naive = 0;
+    double sum_batch = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(size_t f=0; f < num_frames; f++) {
+        for(size_t i=0; i < n; i++) {
+            // the sphere the osg tools use
+            double const lon = list_lon[i]*k_deg2rad;
+            double const lat = list_lat[i]*k_deg2rad;
+            list_x[i] = std::cos(lat)*std::cos(lon)*6371000.0;
+            list_y[i] = std::cos(lat)*std::sin(lon)*6371000.0;
+            list_z[i] = std::sin(lat)*6371000.0;
+        }
+        sum_naive += list_x[f % n];
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    for(size_t f=0; f < num_frames; f++) {
+        // one batch per tile, as TileVisibility does
+        for(size_t t=0; t < num_tiles; t++) {
+            ConvLLAToECEF(5,&list_lon[t*5],&list_lat[t*5],NULL,
+                          &list_x[t*5],&list_y[t*5],&list_z[t*5],sphere);
+        }
+        sum_batch += list_x[f % n];
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    assert(std::fabs(sum_naive-sum_batch) < 1E-3);
+
+    std::cout << "benchTileCorners: " << num_frames << " frames of "
+              << num_tiles << " tiles, total times" << std::endl;
+    std::cout << "benchTileCorners: one call per point: " << ms(t0,t1) << "ms" << std::endl;
+    std::cout << "benchTileCorners: batch: " << ms(t1,t2) << "ms" << std::endl;
+}
+
+// ============================================================= //
+
+int main()
+{
+    testSinCos();
+    testLLAToECEF();
+    testECEFRoundTrip();
+    testMercator();
+    benchCoastline();
+    benchTileCorners();
+    return 0;
+}
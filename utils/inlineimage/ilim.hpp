@@ -27,6 +27,7 @@
 #include <iostream>
 #include <cassert>
 #include <limits>
+#include <algorithm>
 
 namespace ilim
 {
@@ -733,6 +734,135 @@ namespace ilim
     // ============================================================= //
     // ============================================================= //
 
+    // ImageView
+    // * non-owning view of width x height pixels in memory
+    //   that belongs to someone else (an mmap'd file, an
+    //   osg::Image buffer, a GPU staging buffer...)
+    // * rows are row_pitch bytes apart so padded rows and
+    //   sub-rectangles of larger images work
+    // * copying a view doesn't copy pixels, the memory has
+    //   to outlive the view
+    template<typename Pixel>
+    class ImageView
+    {
+    public:
+        // initialize null view
+        ImageView() :
+            m_width(0),
+            m_height(0),
+            m_row_pitch(0),
+            m_data(nullptr)
+        {
+            // empty
+        }
+
+        // row_pitch is in bytes; 0 means rows are
+        // tightly packed (width*sizeof(Pixel))
+        ImageView(Pixel * data,
+                  uint32_t width,
+                  uint32_t height,
+                  size_t row_pitch=0) :
+            m_width(width),
+            m_height(height),
+            m_row_pitch((row_pitch == 0) ? (width*sizeof(Pixel)) : row_pitch),
+            m_data(data)
+        {
+            assert(m_row_pitch >= width*sizeof(Pixel));
+        }
+
+        uint32_t width() const
+        {
+            return m_width;
+        }
+
+        uint32_t height() const
+        {
+            return m_height;
+        }
+
+        size_t row_pitch() const
+        {
+            return m_row_pitch;
+        }
+
+        Pixel * data() const
+        {
+            return m_data;
+        }
+
+        // true if the rows follow each other without padding
+        bool contiguous() const
+        {
+            return (m_row_pitch == m_width*sizeof(Pixel));
+        }
+
+        PixelTraits pixel_traits() const
+        {
+            PixelTraits traits;
+            traits.channel_count = ilim_detail::pixel_traits<Pixel>::channel_count;
+            traits.is_int_type = ilim_detail::pixel_traits<Pixel>::is_int_type;
+            traits.single_bitdepth = ilim_detail::pixel_traits<Pixel>::single_bitdepth;
+            traits.bits_r = ilim_detail::pixel_traits<Pixel>::bits_r;
+            traits.bits_g = ilim_detail::pixel_traits<Pixel>::bits_g;
+            traits.bits_b = ilim_detail::pixel_traits<Pixel>::bits_b;
+            traits.bits_a = ilim_detail::pixel_traits<Pixel>::bits_a;
+
+            return traits;
+        }
+
+        Pixel * row(uint32_t row) const
+        {
+            return reinterpret_cast<Pixel*>(
+                        reinterpret_cast<uint8_t*>(m_data)+(row*m_row_pitch));
+        }
+
+        Pixel & at(uint32_t col, uint32_t row) const
+        {
+            return this->row(row)[col];
+        }
+
+        // view of a sub-rectangle, clipped to this view
+        ImageView<Pixel> subview(uint32_t col,
+                                 uint32_t row,
+                                 uint32_t cols,
+                                 uint32_t rows) const
+        {
+            if(col >= m_width || row >= m_height) {
+                return ImageView<Pixel>();
+            }
+
+            return ImageView<Pixel>(
+                        this->row(row)+col,
+                        std::min(cols,m_width-col),
+                        std::min(rows,m_height-row),
+                        m_row_pitch);
+        }
+
+        // copies the part of source that overlaps this view
+        // when source's top left pixel is placed at (col,row)
+        void insert(ImageView<Pixel> const &source,
+                    uint32_t col,
+                    uint32_t row) const
+        {
+            ImageView<Pixel> const target =
+                    subview(col,row,source.width(),source.height());
+
+            for(uint32_t i=0; i < target.height(); i++) {
+                Pixel const * source_row = source.row(i);
+                std::copy(source_row,source_row+target.width(),target.row(i));
+            }
+        }
+
+    private:
+        uint32_t m_width;
+        uint32_t m_height;
+        size_t m_row_pitch;
+        Pixel * m_data;
+    };
+
+    // ============================================================= //
+    // ============================================================= //
+
     template<typename Pixel>
     class Image
     {
@@ -865,6 +995,21 @@ namespace ilim
             return (*m_data);
         }
 
+        std::vector<Pixel> const & data() const
+        {
+            return (*m_data);
+        }
+
+        // view of this image's pixels; invalidated by
+        // anything that reallocates the pixel data
+        ImageView<Pixel> view()
+        {
+            if((*m_data).empty()) {
+                return ImageView<Pixel>();
+            }
+            return ImageView<Pixel>(&((*m_data)[0]),m_width,m_height);
+        }
+
         //
         void insert(Image<Pixel> const &source,
                     PixelIterator source_it,
@@ -904,6 +1049,12 @@ namespace ilim
                 std::advance(target_it,target.width());
             }
         }
+
+        void insert(ImageView<Pixel> const &source,
+                    PixelIterator target_it)
+        {
+            view().insert(source,col(target_it),row(target_it));
+        }
     };
 
 
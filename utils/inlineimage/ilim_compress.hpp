@@ -0,0 +1,1282 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_INLINE_IMAGE_COMPRESS_H
+#define SCRATCH_INLINE_IMAGE_COMPRESS_H
+
+// sys
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+// stl
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+// ilim
+#include <ilim.hpp>
+
+// Block compressed textures
+// * compress_image encodes RGBA8 pixels into 4x4 blocks for
+//   upload with glCompressedTexImage2D; blocks are stored in
+//   rows, left to right, and edge blocks repeat the last
+//   row/column of the image
+// * BlockQuality::FAST is meant for encoding tiles as they
+//   stream in, BlockQuality::BEST for packing offline
+// * ETC2 blocks use the ETC1 compatible modes or planar
+//   mode, whichever fits better (no T or H blocks); planar
+//   blocks hold smooth gradients that ETC1 turns into steps.
+//   ETC2_RGBA adds an EAC alpha block
+// * decompress_image decodes the same formats, ie. for a
+//   software fallback or to check quality
+
+namespace ilim
+{
+    enum class BlockFormat {
+        BC1,        // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 1 bit alpha
+        BC3,        // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+        ETC1,       // GL_ETC1_RGB8_OES
+        ETC2_RGB,   // GL_COMPRESSED_RGB8_ETC2
+        ETC2_RGBA   // GL_COMPRESSED_RGBA8_ETC2_EAC
+    };
+
+    enum class BlockQuality {
+        FAST,
+        BEST
+    };
+
+    namespace ilim_detail
+    {
+        inline int clamp_u8(int v)
+        {
+            return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+        }
+
+        inline uint32_t rgb_error(RGBA8 const &px, int r, int g, int b)
+        {
+            int const dr = int(px.r)-r;
+            int const dg = int(px.g)-g;
+            int const db = int(px.b)-b;
+            return uint32_t(dr*dr + dg*dg + db*db);
+        }
+
+        // Quantizes an 8 bit value to bits and expands
+        // it back by bit replication
+        inline int quantize_u8(int v, int bits)
+        {
+            int const max = (1 << bits)-1;
+            return (clamp_u8(v)*max+127)/255;
+        }
+
+        inline int expand_bits(int q, int bits)
+        {
+            return (q << (8-bits)) | (q >> (2*bits-8));
+        }
+
+        // ============================================================= //
+
+        // BC1/BC3 color
+
+        inline uint16_t pack_565(int r, int g, int b)
+        {
+            return uint16_t((quantize_u8(r,5) << 11) |
+                            (quantize_u8(g,6) << 5) |
+                            quantize_u8(b,5));
+        }
+
+        inline void unpack_565(uint16_t c, int rgb[3])
+        {
+            rgb[0] = expand_bits((c >> 11) & 31,5);
+            rgb[1] = expand_bits((c >> 5) & 63,6);
+            rgb[2] = expand_bits(c & 31,5);
+        }
+
+        // Fills in the four palette entries of a color block;
+        // entry 3 of a three color block is transparent black
+        inline void bc1_palette(uint16_t c0,
+                                uint16_t c1,
+                                bool four_color,
+                                int palette[4][3])
+        {
+            unpack_565(c0,palette[0]);
+            unpack_565(c1,palette[1]);
+            for(int c=0; c < 3; c++) {
+                if(four_color) {
+                    palette[2][c] = (2*palette[0][c]+palette[1][c]+1)/3;
+                    palette[3][c] = (palette[0][c]+2*palette[1][c]+1)/3;
+                }
+                else {
+                    palette[2][c] = (palette[0][c]+palette[1][c]+1)/2;
+                    palette[3][c] = 0;
+                }
+            }
+        }
+
+        // Picks the nearest palette entry for each pixel and
+        // returns the total squared error. With transparent
+        // set, pixels with alpha < 128 get entry 3
+        inline uint32_t bc1_pick_indices(RGBA8 const * block,
+                                         int const palette[4][3],
+                                         bool four_color,
+                                         bool transparent,
+                                         uint32_t &indices)
+        {
+            int const entry_count = four_color ? 4 : 3;
+            uint32_t error=0;
+            indices=0;
+
+            for(int i=0; i < 16; i++) {
+                uint32_t best_index=0;
+                if(transparent && block[i].a < 128) {
+                    best_index = 3;
+                }
+                else {
+                    uint32_t best_error = std::numeric_limits<uint32_t>::max();
+                    for(int k=0; k < entry_count; k++) {
+                        uint32_t const e = rgb_error(block[i],
+                                                     palette[k][0],
+                                                     palette[k][1],
+                                                     palette[k][2]);
+                        if(e < best_error) {
+                            best_error = e;
+                            best_index = k;
+                        }
+                    }
+                    error += best_error;
+                }
+                indices |= (best_index << (2*i));
+            }
+
+            return error;
+        }
+
+        struct bc1_fit
+        {
+            uint16_t c0;
+            uint16_t c1;
+            uint32_t indices;
+            uint32_t error;
+        };
+
+        // Quantizes endpoints e0,e1 and picks indices, keeping
+        // the c0 > c1 (four color) or c0 <= c1 (three color)
+        // order the decoder uses to tell the modes apart
+        inline void bc1_try_endpoints(RGBA8 const * block,
+                                      float const e0[3],
+                                      float const e1[3],
+                                      bool transparent,
+                                      bc1_fit &best)
+        {
+            uint16_t c0 = pack_565(int(e0[0]+0.5f),int(e0[1]+0.5f),int(e0[2]+0.5f));
+            uint16_t c1 = pack_565(int(e1[0]+0.5f),int(e1[1]+0.5f),int(e1[2]+0.5f));
+
+            bool const four_color = !transparent;
+            if(four_color ? (c0 < c1) : (c0 > c1)) {
+                std::swap(c0,c1);
+            }
+
+            int palette[4][3];
+            bc1_palette(c0,c1,four_color && (c0 != c1),palette);
+
+            uint32_t indices;
+            uint32_t const error = bc1_pick_indices(
+                        block,palette,four_color && (c0 != c1),transparent,indices);
+
+            if(error < best.error) {
+                best.c0 = c0;
+                best.c1 = c1;
+                best.indices = indices;
+                best.error = error;
+            }
+        }
+
+        // Solves for the endpoints that best fit the current
+        // indices of a four color block (least squares)
+        inline bool bc1_refine(RGBA8 const * block,
+                               uint32_t indices,
+                               float e0[3],
+                               float e1[3])
+        {
+            static float const k_weights[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+
+            float aa=0,ab=0,bb=0;
+            float ax[3] = {0,0,0};
+            float bx[3] = {0,0,0};
+            for(int i=0; i < 16; i++) {
+                float const a = k_weights[(indices >> (2*i)) & 3];
+                float const b = 1.0f-a;
+                float const x[3] = { float(block[i].r), float(block[i].g), float(block[i].b) };
+                aa += a*a;
+                ab += a*b;
+                bb += b*b;
+                for(int c=0; c < 3; c++) {
+                    ax[c] += a*x[c];
+                    bx[c] += b*x[c];
+                }
+            }
+
+            float const det = aa*bb-ab*ab;
+            if(std::fabs(det) < 1e-6f) {
+                return false;
+            }
+
+            for(int c=0; c < 3; c++) {
+                e0[c] = std::min(255.0f,std::max(0.0f,(bb*ax[c]-ab*bx[c])/det));
+                e1[c] = std::min(255.0f,std::max(0.0f,(aa*bx[c]-ab*ax[c])/det));
+            }
+            return true;
+        }
+
+        // Encodes the color half of a BC1/BC3 block. BC3 color
+        // is always decoded as four colors so transparent
+        // must be false for it
+        inline void encode_bc1_color(RGBA8 const * block,
+                                     BlockQuality quality,
+                                     bool allow_transparent,
+                                     uint8_t * out)
+        {
+            bool transparent=false;
+            if(allow_transparent) {
+                for(int i=0; i < 16; i++) {
+                    transparent = transparent || (block[i].a < 128);
+                }
+            }
+
+            // bounds and mean of the pixels that keep their color
+            float lo[3] = {255,255,255};
+            float hi[3] = {0,0,0};
+            float mean[3] = {0,0,0};
+            int count=0;
+            for(int i=0; i < 16; i++) {
+                if(transparent && block[i].a < 128) {
+                    continue;
+                }
+                float const x[3] = { float(block[i].r), float(block[i].g), float(block[i].b) };
+                for(int c=0; c < 3; c++) {
+                    lo[c] = std::min(lo[c],x[c]);
+                    hi[c] = std::max(hi[c],x[c]);
+                    mean[c] += x[c];
+                }
+                count++;
+            }
+
+            bc1_fit best;
+            best.error = std::numeric_limits<uint32_t>::max();
+
+            if(count == 0) {
+                // fully transparent
+                float const black[3] = {0,0,0};
+                bc1_try_endpoints(block,black,black,true,best);
+            }
+            else {
+                float cov[6] = {0,0,0,0,0,0}; // rr rg rb gg gb bb
+                for(int c=0; c < 3; c++) {
+                    mean[c] /= count;
+                }
+                for(int i=0; i < 16; i++) {
+                    if(transparent && block[i].a < 128) {
+                        continue;
+                    }
+                    float const d[3] = { block[i].r-mean[0], block[i].g-mean[1], block[i].b-mean[2] };
+                    cov[0] += d[0]*d[0]; cov[1] += d[0]*d[1]; cov[2] += d[0]*d[2];
+                    cov[3] += d[1]*d[1]; cov[4] += d[1]*d[2]; cov[5] += d[2]*d[2];
+                }
+
+                // bounding box diagonal that follows the
+                // direction the colors vary in
+                float e0[3] = { hi[0], hi[1], hi[2] };
+                float e1[3] = { lo[0], lo[1], lo[2] };
+                bool const ref_red = (cov[0] >= cov[3]);
+                float const cov_g = ref_red ? cov[1] : cov[3];
+                float const cov_b = ref_red ? cov[2] : cov[4];
+                if(cov_g < 0) {
+                    std::swap(e0[1],e1[1]);
+                }
+                if(cov_b < 0) {
+                    std::swap(e0[2],e1[2]);
+                }
+
+                // inset by 1/16 of the range since the end
+                // points are rarely hit exactly
+                for(int c=0; c < 3; c++) {
+                    float const inset = (e0[c]-e1[c])/16.0f;
+                    e0[c] -= inset;
+                    e1[c] += inset;
+                }
+                bc1_try_endpoints(block,e0,e1,transparent,best);
+
+                if(quality == BlockQuality::BEST) {
+                    // principal axis through power iteration
+                    float axis[3] = { hi[0]-lo[0], hi[1]-lo[1], hi[2]-lo[2] };
+                    if(cov_g < 0) { axis[1] = -axis[1]; }
+                    if(cov_b < 0) { axis[2] = -axis[2]; }
+                    for(int k=0; k < 8; k++) {
+                        float const next[3] = {
+                            cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2],
+                            cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2],
+                            cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2]
+                        };
+                        float const len = std::max(std::fabs(next[0]),
+                                                   std::max(std::fabs(next[1]),std::fabs(next[2])));
+                        if(len < 1e-6f) {
+                            break;
+                        }
+                        for(int c=0; c < 3; c++) {
+                            axis[c] = next[c]/len;
+                        }
+                    }
+
+                    float const axis_len2 = axis[0]*axis[0]+axis[1]*axis[1]+axis[2]*axis[2];
+                    if(axis_len2 > 1e-6f) {
+                        float t_min = std::numeric_limits<float>::max();
+                        float t_max = -t_min;
+                        for(int i=0; i < 16; i++) {
+                            if(transparent && block[i].a < 128) {
+                                continue;
+                            }
+                            float const t = ((block[i].r-mean[0])*axis[0] +
+                                             (block[i].g-mean[1])*axis[1] +
+                                             (block[i].b-mean[2])*axis[2])/axis_len2;
+                            t_min = std::min(t_min,t);
+                            t_max = std::max(t_max,t);
+                        }
+                        for(int c=0; c < 3; c++) {
+                            e0[c] = std::min(255.0f,std::max(0.0f,mean[c]+axis[c]*t_max));
+                            e1[c] = std::min(255.0f,std::max(0.0f,mean[c]+axis[c]*t_min));
+                        }
+                        bc1_try_endpoints(block,e0,e1,transparent,best);
+                    }
+
+                    // least squares passes on the best indices
+                    if(!transparent) {
+                        for(int k=0; k < 2; k++) {
+                            if(!bc1_refine(block,best.indices,e0,e1)) {
+                                break;
+                            }
+                            bc1_try_endpoints(block,e0,e1,false,best);
+                        }
+                    }
+                }
+            }
+
+            out[0] = uint8_t(best.c0 & 0xFF);
+            out[1] = uint8_t(best.c0 >> 8);
+            out[2] = uint8_t(best.c1 & 0xFF);
+            out[3] = uint8_t(best.c1 >> 8);
+            for(int i=0; i < 4; i++) {
+                out[4+i] = uint8_t(best.indices >> (8*i));
+            }
+        }
+
+        inline void decode_bc1_color(uint8_t const * in,
+                                     bool allow_three_color,
+                                     RGBA8 * block)
+        {
+            uint16_t const c0 = uint16_t(in[0] | (in[1] << 8));
+            uint16_t const c1 = uint16_t(in[2] | (in[3] << 8));
+            bool const four_color = !allow_three_color || (c0 > c1);
+
+            int palette[4][3];
+            bc1_palette(c0,c1,four_color,palette);
+
+            uint32_t const indices =
+                    uint32_t(in[4]) | (uint32_t(in[5]) << 8) |
+                    (uint32_t(in[6]) << 16) | (uint32_t(in[7]) << 24);
+
+            for(int i=0; i < 16; i++) {
+                uint32_t const k = (indices >> (2*i)) & 3;
+                block[i].r = uint8_t(palette[k][0]);
+                block[i].g = uint8_t(palette[k][1]);
+                block[i].b = uint8_t(palette[k][2]);
+                block[i].a = (!four_color && k == 3) ? 0 : 255;
+            }
+        }
+
+        // ============================================================= //
+
+        // BC3 alpha
+
+        // a0 > a1 gives 8 interpolated values, otherwise
+        // 6 values plus 0 and 255
+        inline void bc3_alpha_palette(int a0, int a1, int palette[8])
+        {
+            palette[0] = a0;
+            palette[1] = a1;
+            if(a0 > a1) {
+                for(int k=1; k < 7; k++) {
+                    palette[k+1] = ((7-k)*a0 + k*a1 + 3)/7;
+                }
+            }
+            else {
+                for(int k=1; k < 5; k++) {
+                    palette[k+1] = ((5-k)*a0 + k*a1 + 2)/5;
+                }
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+
+        inline uint32_t bc3_alpha_try(RGBA8 const * block,
+                                      int a0,
+                                      int a1,
+                                      uint64_t &indices)
+        {
+            int palette[8];
+            bc3_alpha_palette(a0,a1,palette);
+
+            uint32_t error=0;
+            indices=0;
+            for(int i=0; i < 16; i++) {
+                int best_error = std::numeric_limits<int>::max();
+                uint64_t best_index=0;
+                for(int k=0; k < 8; k++) {
+                    int const d = palette[k]-int(block[i].a);
+                    if(d*d < best_error) {
+                        best_error = d*d;
+                        best_index = uint64_t(k);
+                    }
+                }
+                error += uint32_t(best_error);
+                indices |= (best_index << (3*i));
+            }
+            return error;
+        }
+
+        inline void encode_bc3_alpha(RGBA8 const * block,
+                                     BlockQuality quality,
+                                     uint8_t * out)
+        {
+            int lo=255,hi=0;
+            int inner_lo=255,inner_hi=0; // ignoring 0 and 255
+            for(int i=0; i < 16; i++) {
+                int const a = block[i].a;
+                lo = std::min(lo,a);
+                hi = std::max(hi,a);
+                if(a != 0 && a != 255) {
+                    inner_lo = std::min(inner_lo,a);
+                    inner_hi = std::max(inner_hi,a);
+                }
+            }
+
+            int best_a0=hi, best_a1=lo;
+            uint64_t best_indices;
+            uint32_t best_error = bc3_alpha_try(block,hi,lo,best_indices);
+
+            if(quality == BlockQuality::BEST && best_error > 0) {
+                // nudge the end points in and try the 6 value
+                // mode, which has exact 0 and 255
+                int const list_insets[3] = {1,2,4};
+                for(int inset : list_insets) {
+                    int const a0 = hi-(hi-lo)*inset/32;
+                    int const a1 = lo+(hi-lo)*inset/32;
+                    if(a0 <= a1) {
+                        break;
+                    }
+                    uint64_t indices;
+                    uint32_t const error = bc3_alpha_try(block,a0,a1,indices);
+                    if(error < best_error) {
+                        best_a0 = a0; best_a1 = a1;
+                        best_indices = indices; best_error = error;
+                    }
+                }
+                if(inner_lo <= inner_hi) {
+                    uint64_t indices;
+                    uint32_t const error = bc3_alpha_try(block,inner_lo,inner_hi,indices);
+                    if(error < best_error) {
+                        best_a0 = inner_lo; best_a1 = inner_hi;
+                        best_indices = indices; best_error = error;
+                    }
+                }
+            }
+
+            out[0] = uint8_t(best_a0);
+            out[1] = uint8_t(best_a1);
+            for(int i=0; i < 6; i++) {
+                out[2+i] = uint8_t(best_indices >> (8*i));
+            }
+        }
+
+        inline void decode_bc3_alpha(uint8_t const * in, RGBA8 * block)
+        {
+            int palette[8];
+            bc3_alpha_palette(in[0],in[1],palette);
+
+            uint64_t indices=0;
+            for(int i=0; i < 6; i++) {
+                indices |= (uint64_t(in[2+i]) << (8*i));
+            }
+            for(int i=0; i < 16; i++) {
+                block[i].a = uint8_t(palette[(indices >> (3*i)) & 7]);
+            }
+        }
+
+        // ============================================================= //
+
+        // ETC1 (and the ETC1 compatible part of ETC2)
+
+        // modifier pairs for each table codeword; a pixel
+        // index of 0,1,2,3 means +small, +large, -small, -large
+        static int const k_etc_modifiers[8][2] = {
+            {2,8}, {5,17}, {9,29}, {13,42},
+            {18,60}, {24,80}, {33,106}, {47,183}
+        };
+
+        inline int etc_modifier(int table, int index)
+        {
+            int const m = k_etc_modifiers[table][index & 1];
+            return (index & 2) ? -m : m;
+        }
+
+        // Pixels of subblock s: with flip unset the block is
+        // split into left/right 2x4 halves, otherwise into
+        // top/bottom 4x2 halves. Pixel numbering is y*4+x
+        inline void etc_subblock_pixels(bool flip, int s, int list_px[8])
+        {
+            int n=0;
+            for(int y=0; y < 4; y++) {
+                for(int x=0; x < 4; x++) {
+                    int const half = flip ? (y/2) : (x/2);
+                    if(half == s) {
+                        list_px[n++] = y*4+x;
+                    }
+                }
+            }
+        }
+
+        struct etc_subblock_fit
+        {
+            int q[3];       // quantized base color
+            int table;
+            uint8_t list_index[8];
+            uint32_t error;
+        };
+
+        // Best table and pixel indices for one base color
+        inline void etc_fit_base(RGBA8 const * block,
+                                 int const list_px[8],
+                                 int const q[3],
+                                 int bits,
+                                 etc_subblock_fit &best)
+        {
+            int const base[3] = {
+                expand_bits(q[0],bits),
+                expand_bits(q[1],bits),
+                expand_bits(q[2],bits)
+            };
+
+            for(int table=0; table < 8; table++) {
+                uint32_t error=0;
+                uint8_t list_index[8];
+                for(int i=0; i < 8 && error < best.error; i++) {
+                    RGBA8 const &px = block[list_px[i]];
+                    uint32_t best_px_error = std::numeric_limits<uint32_t>::max();
+                    for(int index=0; index < 4; index++) {
+                        int const m = etc_modifier(table,index);
+                        uint32_t const e = rgb_error(px,
+                                                     clamp_u8(base[0]+m),
+                                                     clamp_u8(base[1]+m),
+                                                     clamp_u8(base[2]+m));
+                        if(e < best_px_error) {
+                            best_px_error = e;
+                            list_index[i] = uint8_t(index);
+                        }
+                    }
+                    error += best_px_error;
+                }
+
+                if(error < best.error) {
+                    for(int c=0; c < 3; c++) {
+                        best.q[c] = q[c];
+                    }
+                    best.table = table;
+                    std::copy(list_index,list_index+8,best.list_index);
+                    best.error = error;
+                }
+            }
+        }
+
+        // Fits a base color (bits per channel) to a subblock;
+        // BEST also searches the neighbouring base colors
+        inline void etc_fit_subblock(RGBA8 const * block,
+                                     int const list_px[8],
+                                     int bits,
+                                     BlockQuality quality,
+                                     etc_subblock_fit &best)
+        {
+            int sum[3] = {0,0,0};
+            for(int i=0; i < 8; i++) {
+                sum[0] += block[list_px[i]].r;
+                sum[1] += block[list_px[i]].g;
+                sum[2] += block[list_px[i]].b;
+            }
+            int const q_avg[3] = {
+                quantize_u8((sum[0]+4)/8,bits),
+                quantize_u8((sum[1]+4)/8,bits),
+                quantize_u8((sum[2]+4)/8,bits)
+            };
+
+            best.error = std::numeric_limits<uint32_t>::max();
+            etc_fit_base(block,list_px,q_avg,bits,best);
+
+            if(quality == BlockQuality::BEST) {
+                int const max = (1 << bits)-1;
+                for(int dr=-1; dr <= 1; dr++) {
+                    for(int dg=-1; dg <= 1; dg++) {
+                        for(int db=-1; db <= 1; db++) {
+                            int const q[3] = { q_avg[0]+dr, q_avg[1]+dg, q_avg[2]+db };
+                            if((dr == 0 && dg == 0 && db == 0) ||
+                               q[0] < 0 || q[1] < 0 || q[2] < 0 ||
+                               q[0] > max || q[1] > max || q[2] > max) {
+                                continue;
+                            }
+                            etc_fit_base(block,list_px,q,bits,best);
+                        }
+                    }
+                }
+            }
+        }
+
+        struct etc_block_fit
+        {
+            bool diff;
+            bool flip;
+            etc_subblock_fit list_sub[2];
+            uint32_t error;
+        };
+
+        inline void etc_fit_flip(RGBA8 const * block,
+                                 bool flip,
+                                 BlockQuality quality,
+                                 etc_block_fit &best)
+        {
+            int list_px[2][8];
+            etc_subblock_pixels(flip,0,list_px[0]);
+            etc_subblock_pixels(flip,1,list_px[1]);
+
+            // differential: 555 base + 333 signed delta
+            etc_subblock_fit list_diff[2];
+            etc_fit_subblock(block,list_px[0],5,quality,list_diff[0]);
+            etc_fit_subblock(block,list_px[1],5,quality,list_diff[1]);
+
+            bool in_range = true;
+            for(int c=0; c < 3; c++) {
+                int const d = list_diff[1].q[c]-list_diff[0].q[c];
+                in_range = in_range && (d >= -4) && (d <= 3);
+            }
+            if(!in_range) {
+                // pull the second base color within reach
+                int q[3];
+                for(int c=0; c < 3; c++) {
+                    int const d = list_diff[1].q[c]-list_diff[0].q[c];
+                    q[c] = list_diff[0].q[c]+std::min(3,std::max(-4,d));
+                }
+                list_diff[1].error = std::numeric_limits<uint32_t>::max();
+                etc_fit_base(block,list_px[1],q,5,list_diff[1]);
+            }
+
+            uint32_t const diff_error = list_diff[0].error+list_diff[1].error;
+            if(diff_error < best.error) {
+                best.diff = true;
+                best.flip = flip;
+                best.list_sub[0] = list_diff[0];
+                best.list_sub[1] = list_diff[1];
+                best.error = diff_error;
+            }
+
+            // individual: two 444 base colors
+            if(!in_range || quality == BlockQuality::BEST) {
+                etc_subblock_fit list_ind[2];
+                etc_fit_subblock(block,list_px[0],4,quality,list_ind[0]);
+                etc_fit_subblock(block,list_px[1],4,quality,list_ind[1]);
+
+                uint32_t const ind_error = list_ind[0].error+list_ind[1].error;
+                if(ind_error < best.error) {
+                    best.diff = false;
+                    best.flip = flip;
+                    best.list_sub[0] = list_ind[0];
+                    best.list_sub[1] = list_ind[1];
+                    best.error = ind_error;
+                }
+            }
+        }
+
+        // Returns the squared error of the encoded block
+        inline uint32_t encode_etc1_block(RGBA8 const * block,
+                                          BlockQuality quality,
+                                          uint8_t * out)
+        {
+            etc_block_fit best;
+            best.error = std::numeric_limits<uint32_t>::max();
+            etc_fit_flip(block,false,quality,best);
+            etc_fit_flip(block,true,quality,best);
+
+            etc_subblock_fit const &s0 = best.list_sub[0];
+            etc_subblock_fit const &s1 = best.list_sub[1];
+            for(int c=0; c < 3; c++) {
+                out[c] = best.diff ?
+                            uint8_t((s0.q[c] << 3) | ((s1.q[c]-s0.q[c]) & 7)) :
+                            uint8_t((s0.q[c] << 4) | s1.q[c]);
+            }
+            out[3] = uint8_t((s0.table << 5) | (s1.table << 2) |
+                             (best.diff ? 2 : 0) | (best.flip ? 1 : 0));
+
+            // index bits are numbered down the columns
+            uint32_t msb=0,lsb=0;
+            for(int s=0; s < 2; s++) {
+                int list_px[8];
+                etc_subblock_pixels(best.flip,s,list_px);
+                for(int i=0; i < 8; i++) {
+                    int const x = list_px[i]%4;
+                    int const y = list_px[i]/4;
+                    int const index = best.list_sub[s].list_index[i];
+                    msb |= uint32_t(index >> 1) << (x*4+y);
+                    lsb |= uint32_t(index & 1) << (x*4+y);
+                }
+            }
+            out[4] = uint8_t(msb >> 8);
+            out[5] = uint8_t(msb);
+            out[6] = uint8_t(lsb >> 8);
+            out[7] = uint8_t(lsb);
+
+            return best.error;
+        }
+
+        // Returns false for the ETC2 T, H and planar modes
+        inline bool decode_etc1_block(uint8_t const * in, RGBA8 * block)
+        {
+            bool const diff = (in[3] & 2) != 0;
+            bool const flip = (in[3] & 1) != 0;
+            int const list_table[2] = { in[3] >> 5, (in[3] >> 2) & 7 };
+
+            int list_base[2][3];
+            for(int c=0; c < 3; c++) {
+                if(diff) {
+                    int const q0 = in[c] >> 3;
+                    int const d = ((in[c] & 7) ^ 4) - 4; // sign extend
+                    int const q1 = q0+d;
+                    if(q1 < 0 || q1 > 31) {
+                        return false;
+                    }
+                    list_base[0][c] = expand_bits(q0,5);
+                    list_base[1][c] = expand_bits(q1,5);
+                }
+                else {
+                    list_base[0][c] = expand_bits(in[c] >> 4,4);
+                    list_base[1][c] = expand_bits(in[c] & 15,4);
+                }
+            }
+
+            uint32_t const msb = (uint32_t(in[4]) << 8) | in[5];
+            uint32_t const lsb = (uint32_t(in[6]) << 8) | in[7];
+            for(int y=0; y < 4; y++) {
+                for(int x=0; x < 4; x++) {
+                    int const s = flip ? (y/2) : (x/2);
+                    int const bit = x*4+y;
+                    int const index = int(((msb >> bit) & 1) << 1 | ((lsb >> bit) & 1));
+                    int const m = etc_modifier(list_table[s],index);
+                    RGBA8 &px = block[y*4+x];
+                    px.r = uint8_t(clamp_u8(list_base[s][0]+m));
+                    px.g = uint8_t(clamp_u8(list_base[s][1]+m));
+                    px.b = uint8_t(clamp_u8(list_base[s][2]+m));
+                    px.a = 255;
+                }
+            }
+            return true;
+        }
+
+        // ============================================================= //
+
+        // ETC2 planar mode
+
+        // Colors at the origin (O), at x=4 (H) and at y=4 (V);
+        // pixels are interpolated between them. Red, green
+        // and blue are stored with 6, 7 and 6 bits
+        static int const k_planar_bits[3] = {6,7,6};
+
+        struct etc_planar_fit
+        {
+            int list_q[3][3];   // [O,H,V][r,g,b]
+            uint32_t error;
+        };
+
+        inline int etc_planar_value(int const q[3], int bits, int x, int y)
+        {
+            int const o = expand_bits(q[0],bits);
+            int const h = expand_bits(q[1],bits);
+            int const v = expand_bits(q[2],bits);
+            return clamp_u8((x*(h-o) + y*(v-o) + 4*o + 2) >> 2);
+        }
+
+        inline uint8_t etc_channel(RGBA8 const &px, int c)
+        {
+            return (c == 0) ? px.r : ((c == 1) ? px.g : px.b);
+        }
+
+        inline uint32_t etc_planar_channel_error(RGBA8 const * block,
+                                                 int c,
+                                                 int const q[3])
+        {
+            uint32_t error=0;
+            for(int y=0; y < 4; y++) {
+                for(int x=0; x < 4; x++) {
+                    int const d = int(etc_channel(block[y*4+x],c))-
+                                  etc_planar_value(q,k_planar_bits[c],x,y);
+                    error += uint32_t(d*d);
+                }
+            }
+            return error;
+        }
+
+        // Least squares plane through each channel; BEST
+        // also searches the neighbouring quantized values.
+        // Channels are independent so they're fit one by one
+        inline void etc_fit_planar(RGBA8 const * block,
+                                   BlockQuality quality,
+                                   etc_planar_fit &fit)
+        {
+            fit.error = 0;
+            for(int c=0; c < 3; c++) {
+                // c(x,y) = a + b*x + d*y with x,y in [0,3]
+                int sum=0,sum_x=0,sum_y=0;
+                for(int y=0; y < 4; y++) {
+                    for(int x=0; x < 4; x++) {
+                        int const p = etc_channel(block[y*4+x],c);
+                        sum += p;
+                        sum_x += (2*x-3)*p;
+                        sum_y += (2*y-3)*p;
+                    }
+                }
+                double const b = sum_x/40.0;
+                double const d = sum_y/40.0;
+                double const a = sum/16.0 - 1.5*b - 1.5*d;
+
+                int const bits = k_planar_bits[c];
+                int const max = (1 << bits)-1;
+                double const list_value[3] = { a, a+4.0*b, a+4.0*d };
+                int q_fit[3];
+                for(int i=0; i < 3; i++) {
+                    double const v = std::min(255.0,std::max(0.0,list_value[i]));
+                    q_fit[i] = int(std::floor(v*max/255.0+0.5));
+                }
+
+                uint32_t best_error = etc_planar_channel_error(block,c,q_fit);
+                int q_best[3] = { q_fit[0], q_fit[1], q_fit[2] };
+
+                if(quality == BlockQuality::BEST) {
+                    for(int n=0; n < 27; n++) {
+                        int const q[3] = {
+                            q_fit[0] + (n%3)-1,
+                            q_fit[1] + (n/3)%3-1,
+                            q_fit[2] + (n/9)-1
+                        };
+                        if(q[0] < 0 || q[1] < 0 || q[2] < 0 ||
+                           q[0] > max || q[1] > max || q[2] > max) {
+                            continue;
+                        }
+                        uint32_t const error = etc_planar_channel_error(block,c,q);
+                        if(error < best_error) {
+                            best_error = error;
+                            std::copy(q,q+3,q_best);
+                        }
+                    }
+                }
+
+                for(int i=0; i < 3; i++) {
+                    fit.list_q[i][c] = q_best[i];
+                }
+                fit.error += best_error;
+            }
+        }
+
+        // ETC1 differential base color q plus delta d
+        // (signed 3 bits) is out of range
+        inline bool etc_diff_overflows(uint64_t bits, int shift)
+        {
+            int const q = int((bits >> (shift+3)) & 31);
+            int const d = int(((bits >> shift) & 7) ^ 4) - 4;
+            return (q+d < 0) || (q+d > 31);
+        }
+
+        // Planar blocks are differential blocks whose blue
+        // base color overflows (and red and green don't);
+        // the color bits fill the space around those fields
+        inline void write_etc_planar_block(etc_planar_fit const &fit,
+                                           uint8_t * out)
+        {
+            int const (&o)[3] = fit.list_q[0];
+            int const (&h)[3] = fit.list_q[1];
+            int const (&v)[3] = fit.list_q[2];
+
+            uint64_t bits =
+                    (uint64_t(o[0]) << 57) |
+                    (uint64_t(o[1] >> 6) << 56) |
+                    (uint64_t(o[1] & 63) << 49) |
+                    (uint64_t(o[2] >> 5) << 48) |
+                    (uint64_t((o[2] >> 3) & 3) << 43) |
+                    (uint64_t(o[2] & 7) << 39) |
+                    (uint64_t(h[0] >> 1) << 34) |
+                    (uint64_t(1) << 33) | // diff bit
+                    (uint64_t(h[0] & 1) << 32) |
+                    (uint64_t(h[1]) << 25) |
+                    (uint64_t(h[2]) << 19) |
+                    (uint64_t(v[0]) << 13) |
+                    (uint64_t(v[1]) << 6) |
+                    uint64_t(v[2]);
+
+            // bits 63, 55, 47-45 and 42 are free; pick them
+            // so only blue overflows
+            uint64_t const list_free[6] = {
+                uint64_t(1) << 63, uint64_t(1) << 55, uint64_t(1) << 47,
+                uint64_t(1) << 46, uint64_t(1) << 45, uint64_t(1) << 42
+            };
+            for(int n=0; n < 64; n++) {
+                uint64_t candidate = bits;
+                for(int i=0; i < 6; i++) {
+                    if((n >> i) & 1) {
+                        candidate |= list_free[i];
+                    }
+                }
+                if(!etc_diff_overflows(candidate,56) &&
+                   !etc_diff_overflows(candidate,48) &&
+                   etc_diff_overflows(candidate,40)) {
+                    bits = candidate;
+                    break;
+                }
+            }
+
+            for(int i=0; i < 8; i++) {
+                out[i] = uint8_t(bits >> (56-8*i));
+            }
+        }
+
+        inline void decode_etc_planar_block(uint8_t const * in, RGBA8 * block)
+        {
+            uint64_t bits=0;
+            for(int i=0; i < 8; i++) {
+                bits = (bits << 8) | in[i];
+            }
+
+            int const o[3] = {
+                int((bits >> 57) & 63),
+                int((((bits >> 56) & 1) << 6) | ((bits >> 49) & 63)),
+                int((((bits >> 48) & 1) << 5) | (((bits >> 43) & 3) << 3) |
+                    ((bits >> 39) & 7))
+            };
+            int const h[3] = {
+                int((((bits >> 34) & 31) << 1) | ((bits >> 32) & 1)),
+                int((bits >> 25) & 127),
+                int((bits >> 19) & 63)
+            };
+            int const v[3] = {
+                int((bits >> 13) & 63),
+                int((bits >> 6) & 127),
+                int(bits & 63)
+            };
+
+            for(int y=0; y < 4; y++) {
+                for(int x=0; x < 4; x++) {
+                    int rgb[3];
+                    for(int c=0; c < 3; c++) {
+                        int const q[3] = { o[c], h[c], v[c] };
+                        rgb[c] = etc_planar_value(q,k_planar_bits[c],x,y);
+                    }
+                    RGBA8 &px = block[y*4+x];
+                    px.r = uint8_t(rgb[0]);
+                    px.g = uint8_t(rgb[1]);
+                    px.b = uint8_t(rgb[2]);
+                    px.a = 255;
+                }
+            }
+        }
+
+        inline void encode_etc2_block(RGBA8 const * block,
+                                      BlockQuality quality,
+                                      uint8_t * out)
+        {
+            uint32_t const etc1_error = encode_etc1_block(block,quality,out);
+
+            etc_planar_fit planar;
+            etc_fit_planar(block,quality,planar);
+            if(planar.error < etc1_error) {
+                write_etc_planar_block(planar,out);
+            }
+        }
+
+        // Returns false for the T and H modes
+        inline bool decode_etc2_block(uint8_t const * in, RGBA8 * block)
+        {
+            uint64_t bits=0;
+            for(int i=0; i < 8; i++) {
+                bits = (bits << 8) | in[i];
+            }
+
+            if((in[3] & 2) &&
+               !etc_diff_overflows(bits,56) &&
+               !etc_diff_overflows(bits,48) &&
+               etc_diff_overflows(bits,40)) {
+                decode_etc_planar_block(in,block);
+                return true;
+            }
+            return decode_etc1_block(in,block);
+        }
+
+        // ============================================================= //
+
+        // ETC2 EAC alpha
+
+        static int const k_eac_modifiers[16][8] = {
+            {-3,-6,-9,-15,2,5,8,14},  {-3,-7,-10,-13,2,6,9,12},
+            {-2,-5,-8,-13,1,4,7,12},  {-2,-4,-6,-13,1,3,5,12},
+            {-3,-6,-8,-12,2,5,7,11},  {-3,-7,-9,-11,2,6,8,10},
+            {-4,-7,-8,-11,3,6,7,10},  {-3,-5,-8,-11,2,4,7,10},
+            {-2,-6,-8,-10,1,5,7,9},   {-2,-5,-8,-10,1,4,7,9},
+            {-2,-4,-8,-10,1,3,7,9},   {-2,-5,-7,-10,1,4,6,9},
+            {-3,-4,-7,-10,2,3,6,9},   {-1,-2,-3,-10,0,1,2,9},
+            {-4,-6,-8,-9,3,5,7,8},    {-3,-5,-7,-9,2,4,6,8}
+        };
+
+        inline uint32_t eac_try(RGBA8 const * block,
+                                int base,
+                                int mul,
+                                int table,
+                                uint32_t best_error,
+                                uint64_t &indices)
+        {
+            uint32_t error=0;
+            indices=0;
+            for(int i=0; i < 16 && error < best_error; i++) {
+                int best_px_error = std::numeric_limits<int>::max();
+                int best_index=0;
+                for(int k=0; k < 8; k++) {
+                    int const d = clamp_u8(base+k_eac_modifiers[table][k]*mul)-int(block[i].a);
+                    if(d*d < best_px_error) {
+                        best_px_error = d*d;
+                        best_index = k;
+                    }
+                }
+                error += uint32_t(best_px_error);
+
+                // 3 bit indices, numbered down the columns,
+                // first pixel in the top bits
+                int const x = i%4;
+                int const y = i/4;
+                indices |= uint64_t(best_index) << (45-3*(x*4+y));
+            }
+            return error;
+        }
+
+        inline void encode_eac_alpha(RGBA8 const * block,
+                                     BlockQuality quality,
+                                     uint8_t * out)
+        {
+            int lo=255,hi=0;
+            for(int i=0; i < 16; i++) {
+                lo = std::min(lo,int(block[i].a));
+                hi = std::max(hi,int(block[i].a));
+            }
+
+            // table 13 has a zero modifier, so a flat
+            // block is exact with a multiplier of 1
+            int best_base=hi, best_mul=1, best_table=13;
+            uint64_t best_indices;
+            uint32_t best_error = eac_try(block,hi,1,13,
+                                          std::numeric_limits<uint32_t>::max(),
+                                          best_indices);
+
+            for(int table=0; table < 16 && best_error > 0; table++) {
+                int const mod_lo = k_eac_modifiers[table][3];
+                int const mod_hi = k_eac_modifiers[table][7];
+                int const mul_est = std::max(1,std::min(15,((hi-lo)+(mod_hi-mod_lo)/2)/(mod_hi-mod_lo)));
+
+                int const mul_range = (quality == BlockQuality::BEST) ? 1 : 0;
+                int const base_range = (quality == BlockQuality::BEST) ? 2 : 0;
+                for(int mul=std::max(1,mul_est-mul_range);
+                    mul <= std::min(15,mul_est+mul_range); mul++) {
+                    // center the table's range on the block's
+                    int const base_est = clamp_u8((hi+lo-(mod_hi+mod_lo)*mul+1)/2);
+                    for(int base=std::max(0,base_est-base_range);
+                        base <= std::min(255,base_est+base_range); base++) {
+                        uint64_t indices;
+                        uint32_t const error = eac_try(block,base,mul,table,best_error,indices);
+                        if(error < best_error) {
+                            best_base = base; best_mul = mul; best_table = table;
+                            best_indices = indices; best_error = error;
+                        }
+                    }
+                }
+            }
+
+            out[0] = uint8_t(best_base);
+            out[1] = uint8_t((best_mul << 4) | best_table);
+            for(int i=0; i < 6; i++) {
+                out[2+i] = uint8_t(best_indices >> (40-8*i));
+            }
+        }
+
+        inline void decode_eac_alpha(uint8_t const * in, RGBA8 * block)
+        {
+            int const base = in[0];
+            int const mul = in[1] >> 4;
+            int const table = in[1] & 15;
+
+            uint64_t indices=0;
+            for(int i=0; i < 6; i++) {
+                indices = (indices << 8) | in[2+i];
+            }
+            for(int y=0; y < 4; y++) {
+                for(int x=0; x < 4; x++) {
+                    int const k = int((indices >> (45-3*(x*4+y))) & 7);
+                    block[y*4+x].a = uint8_t(clamp_u8(base+k_eac_modifiers[table][k]*mul));
+                }
+            }
+        }
+    }
+
+    // ============================================================= //
+
+    inline size_t get_block_bytes(BlockFormat format)
+    {
+        return ((format == BlockFormat::BC3) ||
+                (format == BlockFormat::ETC2_RGBA)) ? 16 : 8;
+    }
+
+    inline size_t calc_compressed_size(BlockFormat format,
+                                       uint32_t width,
+                                       uint32_t height)
+    {
+        return size_t((width+3)/4)*((height+3)/4)*get_block_bytes(format);
+    }
+
+    inline void compress_image(ImageView<RGBA8> const &image,
+                               BlockFormat format,
+                               BlockQuality quality,
+                               std::vector<uint8_t> &list_blocks)
+    {
+        using namespace ilim_detail;
+
+        list_blocks.resize(calc_compressed_size(format,image.width(),image.height()));
+        if(list_blocks.empty()) {
+            return;
+        }
+
+        size_t const block_bytes = get_block_bytes(format);
+        uint8_t * out = &(list_blocks[0]);
+        RGBA8 block[16];
+
+        for(uint32_t by=0; by < image.height(); by+=4) {
+            for(uint32_t bx=0; bx < image.width(); bx+=4) {
+                for(uint32_t y=0; y < 4; y++) {
+                    RGBA8 const * row = image.row(std::min(by+y,image.height()-1));
+                    for(uint32_t x=0; x < 4; x++) {
+                        block[y*4+x] = row[std::min(bx+x,image.width()-1)];
+                    }
+                }
+
+                switch(format) {
+                    case BlockFormat::BC1: {
+                        encode_bc1_color(block,quality,true,out);
+                        break;
+                    }
+                    case BlockFormat::BC3: {
+                        encode_bc3_alpha(block,quality,out);
+                        encode_bc1_color(block,quality,false,out+8);
+                        break;
+                    }
+                    case BlockFormat::ETC1: {
+                        encode_etc1_block(block,quality,out);
+                        break;
+                    }
+                    case BlockFormat::ETC2_RGB: {
+                        encode_etc2_block(block,quality,out);
+                        break;
+                    }
+                    case BlockFormat::ETC2_RGBA: {
+                        encode_eac_alpha(block,quality,out);
+                        encode_etc2_block(block,quality,out+8);
+                        break;
+                    }
+                }
+                out += block_bytes;
+            }
+        }
+    }
+
+    // image must be the size the blocks were compressed
+    // at; returns false for blocks it can't decode
+    inline bool decompress_image(std::vector<uint8_t> const &list_blocks,
+                                 BlockFormat format,
+                                 ImageView<RGBA8> const &image)
+    {
+        using namespace ilim_detail;
+
+        if(list_blocks.size() < calc_compressed_size(format,image.width(),image.height())) {
+            std::cout << "ERROR: ilim: decompress_image: "
+                         "not enough block data" << std::endl;
+            return false;
+        }
+        if(list_blocks.empty()) {
+            return true;
+        }
+
+        size_t const block_bytes = get_block_bytes(format);
+        uint8_t const * in = &(list_blocks[0]);
+        RGBA8 block[16];
+        bool ok = true;
+
+        for(uint32_t by=0; by < image.height(); by+=4) {
+            for(uint32_t bx=0; bx < image.width(); bx+=4) {
+                switch(format) {
+                    case BlockFormat::BC1: {
+                        decode_bc1_color(in,true,block);
+                        break;
+                    }
+                    case BlockFormat::BC3: {
+                        decode_bc1_color(in+8,false,block);
+                        decode_bc3_alpha(in,block);
+                        break;
+                    }
+                    case BlockFormat::ETC1: {
+                        ok = decode_etc1_block(in,block) && ok;
+                        break;
+                    }
+                    case BlockFormat::ETC2_RGB: {
+                        ok = decode_etc2_block(in,block) && ok;
+                        break;
+                    }
+                    case BlockFormat::ETC2_RGBA: {
+                        ok = decode_etc2_block(in+8,block) && ok;
+                        decode_eac_alpha(in,block);
+                        break;
+                    }
+                }
+
+                for(uint32_t y=0; y < 4 && by+y < image.height(); y++) {
+                    RGBA8 * row = image.row(by+y);
+                    for(uint32_t x=0; x < 4 && bx+x < image.width(); x++) {
+                        row[bx+x] = block[y*4+x];
+                    }
+                }
+                in += block_bytes;
+            }
+        }
+
+        return ok;
+    }
+
+} // ilim
+
+#endif // SCRATCH_INLINE_IMAGE_COMPRESS_H
@@ -0,0 +1,707 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_INLINE_IMAGE_CONV_H
+#define SCRATCH_INLINE_IMAGE_CONV_H
+
+// sys
+#include <cstdint>
+#include <cstring>
+
+// stl
+#include <vector>
+#include <algorithm>
+
+// ilim
+#include <ilim.hpp>
+
+// Bulk pixel conversion
+// * conv_pixels_bulk converts whole buffers and is specialized
+//   at compile time on the (PixelSrc,PixelDst) pair
+// * common pairs use SSE2/SSSE3/AVX2 or NEON kernels picked
+//   from the compiler's target flags (ie. -mavx2); every
+//   other pair falls back to the per pixel channel_r/g/b/a
+//   assignment used by ilim_detail::conv_pixels
+// * results match ilim_detail::conv_pixels exactly for
+//   values in range; out of range float values saturate
+//   instead of being undefined
+// * define ILIM_NO_SIMD to force the scalar kernels
+
+#if !defined(ILIM_NO_SIMD)
+    #if defined(__AVX2__)
+        #define ILIM_SIMD_AVX2
+    #endif
+    #if defined(__SSSE3__)
+        #define ILIM_SIMD_SSSE3
+    #endif
+    #if defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+        #define ILIM_SIMD_SSE2
+    #endif
+    #if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        #define ILIM_SIMD_NEON
+        #if defined(__aarch64__)
+            // vdivq_f32 is only available on AArch64
+            #define ILIM_SIMD_NEON_DIV
+        #endif
+    #endif
+#endif
+
+#if defined(ILIM_SIMD_AVX2)
+    #include <immintrin.h>
+#endif
+#if defined(ILIM_SIMD_SSSE3)
+    #include <tmmintrin.h>
+#endif
+#if defined(ILIM_SIMD_SSE2)
+    #include <emmintrin.h>
+#endif
+#if defined(ILIM_SIMD_NEON)
+    #include <arm_neon.h>
+#endif
+
+namespace ilim
+{
+    namespace ilim_detail
+    {
+        // ============================================================= //
+
+        // Kernels on flat arrays of channels. Each one runs the
+        // widest available vector loop and finishes the tail
+        // with the scalar version of the same expression
+
+        // upscale: (65535/255)*x
+        inline void conv_u8_to_u16(uint8_t const * src,
+                                   uint16_t * dst,
+                                   size_t n)
+        {
+            size_t i=0;
+
+#if defined(ILIM_SIMD_AVX2)
+            for(; i+16 <= n; i+=16) {
+                __m256i x = _mm256_cvtepu8_epi16(
+                            _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+i)));
+                x = _mm256_or_si256(_mm256_slli_epi16(x,8),x);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst+i),x);
+            }
+#elif defined(ILIM_SIMD_SSE2)
+            __m128i const zero = _mm_setzero_si128();
+            for(; i+16 <= n; i+=16) {
+                __m128i const x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+i));
+                __m128i lo = _mm_unpacklo_epi8(x,zero);
+                __m128i hi = _mm_unpackhi_epi8(x,zero);
+                lo = _mm_or_si128(_mm_slli_epi16(lo,8),lo);
+                hi = _mm_or_si128(_mm_slli_epi16(hi,8),hi);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i),lo);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i+8),hi);
+            }
+#elif defined(ILIM_SIMD_NEON)
+            for(; i+16 <= n; i+=16) {
+                uint8x16_t const x = vld1q_u8(src+i);
+                uint16x8_t const lo = vmovl_u8(vget_low_u8(x));
+                uint16x8_t const hi = vmovl_u8(vget_high_u8(x));
+                vst1q_u16(dst+i,vorrq_u16(vshlq_n_u16(lo,8),lo));
+                vst1q_u16(dst+i+8,vorrq_u16(vshlq_n_u16(hi,8),hi));
+            }
+#endif
+            for(; i < n; i++) {
+                dst[i] = static_cast<uint16_t>(257*src[i]);
+            }
+        }
+
+        // downscale: x >> 8
+        inline void conv_u16_to_u8(uint16_t const * src,
+                                   uint8_t * dst,
+                                   size_t n)
+        {
+            size_t i=0;
+
+#if defined(ILIM_SIMD_AVX2)
+            for(; i+32 <= n; i+=32) {
+                __m256i const a = _mm256_srli_epi16(
+                            _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src+i)),8);
+                __m256i const b = _mm256_srli_epi16(
+                            _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src+i+16)),8);
+
+                // packus works per 128 bit lane, put the
+                // 64 bit quarters back in order
+                __m256i const x = _mm256_permute4x64_epi64(
+                            _mm256_packus_epi16(a,b),0xD8);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst+i),x);
+            }
+#elif defined(ILIM_SIMD_SSE2)
+            for(; i+16 <= n; i+=16) {
+                __m128i const a = _mm_srli_epi16(
+                            _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+i)),8);
+                __m128i const b = _mm_srli_epi16(
+                            _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+i+8)),8);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i),
+                                 _mm_packus_epi16(a,b));
+            }
+#elif defined(ILIM_SIMD_NEON)
+            for(; i+16 <= n; i+=16) {
+                uint8x8_t const a = vshrn_n_u16(vld1q_u16(src+i),8);
+                uint8x8_t const b = vshrn_n_u16(vld1q_u16(src+i+8),8);
+                vst1q_u8(dst+i,vcombine_u8(a,b));
+            }
+#endif
+            for(; i < n; i++) {
+                dst[i] = static_cast<uint8_t>(src[i] >> 8);
+            }
+        }
+
+        // int_to_float: x/255
+        inline void conv_u8_to_f32(uint8_t const * src,
+                                   float * dst,
+                                   size_t n)
+        {
+            float const max = 255.0f;
+            size_t i=0;
+
+#if defined(ILIM_SIMD_AVX2)
+            __m256 const vmax = _mm256_set1_ps(max);
+            for(; i+8 <= n; i+=8) {
+                __m256i const x = _mm256_cvtepu8_epi32(
+                            _mm_loadl_epi64(reinterpret_cast<__m128i const*>(src+i)));
+                _mm256_storeu_ps(dst+i,_mm256_div_ps(_mm256_cvtepi32_ps(x),vmax));
+            }
+#elif defined(ILIM_SIMD_SSE2)
+            __m128 const vmax = _mm_set1_ps(max);
+            __m128i const zero = _mm_setzero_si128();
+            for(; i+16 <= n; i+=16) {
+                __m128i const x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+i));
+                __m128i const lo = _mm_unpacklo_epi8(x,zero);
+                __m128i const hi = _mm_unpackhi_epi8(x,zero);
+
+                __m128i const list_x[4] = {
+                    _mm_unpacklo_epi16(lo,zero),
+                    _mm_unpackhi_epi16(lo,zero),
+                    _mm_unpacklo_epi16(hi,zero),
+                    _mm_unpackhi_epi16(hi,zero)
+                };
+                for(size_t k=0; k < 4; k++) {
+                    _mm_storeu_ps(dst+i+(4*k),
+                                  _mm_div_ps(_mm_cvtepi32_ps(list_x[k]),vmax));
+                }
+            }
+#elif defined(ILIM_SIMD_NEON_DIV)
+            float32x4_t const vmax = vdupq_n_f32(max);
+            for(; i+16 <= n; i+=16) {
+                uint8x16_t const x = vld1q_u8(src+i);
+                uint16x8_t const lo = vmovl_u8(vget_low_u8(x));
+                uint16x8_t const hi = vmovl_u8(vget_high_u8(x));
+
+                uint32x4_t const list_x[4] = {
+                    vmovl_u16(vget_low_u16(lo)),
+                    vmovl_u16(vget_high_u16(lo)),
+                    vmovl_u16(vget_low_u16(hi)),
+                    vmovl_u16(vget_high_u16(hi))
+                };
+                for(size_t k=0; k < 4; k++) {
+                    vst1q_f32(dst+i+(4*k),
+                              vdivq_f32(vcvtq_f32_u32(list_x[k]),vmax));
+                }
+            }
+#endif
+            for(; i < n; i++) {
+                dst[i] = src[i]/max;
+            }
+        }
+
+        // int_to_float: x/65535
+        inline void conv_u16_to_f32(uint16_t const * src,
+                                    float * dst,
+                                    size_t n)
+        {
+            float const max = 65535.0f;
+            size_t i=0;
+
+#if defined(ILIM_SIMD_AVX2)
+            __m256 const vmax = _mm256_set1_ps(max);
+            for(; i+8 <= n; i+=8) {
+                __m256i const x = _mm256_cvtepu16_epi32(
+                            _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+i)));
+                _mm256_storeu_ps(dst+i,_mm256_div_ps(_mm256_cvtepi32_ps(x),vmax));
+            }
+#elif defined(ILIM_SIMD_SSE2)
+            __m128 const vmax = _mm_set1_ps(max);
+            __m128i const zero = _mm_setzero_si128();
+            for(; i+8 <= n; i+=8) {
+                __m128i const x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+i));
+                __m128i const lo = _mm_unpacklo_epi16(x,zero);
+                __m128i const hi = _mm_unpackhi_epi16(x,zero);
+                _mm_storeu_ps(dst+i,_mm_div_ps(_mm_cvtepi32_ps(lo),vmax));
+                _mm_storeu_ps(dst+i+4,_mm_div_ps(_mm_cvtepi32_ps(hi),vmax));
+            }
+#elif defined(ILIM_SIMD_NEON_DIV)
+            float32x4_t const vmax = vdupq_n_f32(max);
+            for(; i+8 <= n; i+=8) {
+                uint16x8_t const x = vld1q_u16(src+i);
+                uint32x4_t const lo = vmovl_u16(vget_low_u16(x));
+                uint32x4_t const hi = vmovl_u16(vget_high_u16(x));
+                vst1q_f32(dst+i,vdivq_f32(vcvtq_f32_u32(lo),vmax));
+                vst1q_f32(dst+i+4,vdivq_f32(vcvtq_f32_u32(hi),vmax));
+            }
+#endif
+            for(; i < n; i++) {
+                dst[i] = src[i]/max;
+            }
+        }
+
+        // x*max clamped to [0,max] (and NaN to 0) so the
+        // float to int conversion is always defined; the x86
+        // kernels clamp the same way and NEON's conversion
+        // saturates on its own
+        inline float clamp_scaled(float x, float max)
+        {
+            return std::min(std::max(0.0f,x*max),max);
+        }
+
+        // float_to_int: x*255, truncated
+        inline void conv_f32_to_u8(float const * src,
+                                   uint8_t * dst,
+                                   size_t n)
+        {
+            float const max = 255.0f;
+            size_t i=0;
+
+#if defined(ILIM_SIMD_AVX2)
+            __m256 const vmax = _mm256_set1_ps(max);
+            __m256 const vzero = _mm256_setzero_ps();
+            __m256i const order = _mm256_setr_epi32(0,4,1,5,2,6,3,7);
+            for(; i+32 <= n; i+=32) {
+                __m256i list_x[4];
+                for(size_t k=0; k < 4; k++) {
+                    __m256 const x = _mm256_mul_ps(_mm256_loadu_ps(src+i+(8*k)),vmax);
+                    list_x[k] = _mm256_cvttps_epi32(
+                                _mm256_min_ps(_mm256_max_ps(x,vzero),vmax));
+                }
+                __m256i const ab = _mm256_packs_epi32(list_x[0],list_x[1]);
+                __m256i const cd = _mm256_packs_epi32(list_x[2],list_x[3]);
+
+                // packs/packus work per 128 bit lane, put the
+                // 32 bit groups back in order
+                __m256i const x = _mm256_permutevar8x32_epi32(
+                            _mm256_packus_epi16(ab,cd),order);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst+i),x);
+            }
+#elif defined(ILIM_SIMD_SSE2)
+            __m128 const vmax = _mm_set1_ps(max);
+            __m128 const vzero = _mm_setzero_ps();
+            for(; i+16 <= n; i+=16) {
+                __m128i list_x[4];
+                for(size_t k=0; k < 4; k++) {
+                    __m128 const x = _mm_mul_ps(_mm_loadu_ps(src+i+(4*k)),vmax);
+                    list_x[k] = _mm_cvttps_epi32(
+                                _mm_min_ps(_mm_max_ps(x,vzero),vmax));
+                }
+                __m128i const ab = _mm_packs_epi32(list_x[0],list_x[1]);
+                __m128i const cd = _mm_packs_epi32(list_x[2],list_x[3]);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i),
+                                 _mm_packus_epi16(ab,cd));
+            }
+#elif defined(ILIM_SIMD_NEON)
+            for(; i+16 <= n; i+=16) {
+                uint16x4_t list_x[4];
+                for(size_t k=0; k < 4; k++) {
+                    list_x[k] = vqmovn_u32(vcvtq_u32_f32(
+                                    vmulq_n_f32(vld1q_f32(src+i+(4*k)),max)));
+                }
+                uint8x8_t const ab = vqmovn_u16(vcombine_u16(list_x[0],list_x[1]));
+                uint8x8_t const cd = vqmovn_u16(vcombine_u16(list_x[2],list_x[3]));
+                vst1q_u8(dst+i,vcombine_u8(ab,cd));
+            }
+#endif
+            for(; i < n; i++) {
+                dst[i] = static_cast<uint8_t>(clamp_scaled(src[i],max));
+            }
+        }
+
+        // float_to_int: x*65535, truncated
+        inline void conv_f32_to_u16(float const * src,
+                                    uint16_t * dst,
+                                    size_t n)
+        {
+            float const max = 65535.0f;
+            size_t i=0;
+
+            // SSE2 and AVX2 only have a signed 32 to 16 bit
+            // pack, so values are offset into the signed range
+            // and flipped back after packing
+#if defined(ILIM_SIMD_AVX2)
+            __m256 const vmax = _mm256_set1_ps(max);
+            __m256 const vzero = _mm256_setzero_ps();
+            __m256i const offset = _mm256_set1_epi32(32768);
+            __m256i const flip = _mm256_set1_epi16(int16_t(0x8000));
+            for(; i+16 <= n; i+=16) {
+                __m256 const xa = _mm256_mul_ps(_mm256_loadu_ps(src+i),vmax);
+                __m256 const xb = _mm256_mul_ps(_mm256_loadu_ps(src+i+8),vmax);
+                __m256i const a = _mm256_sub_epi32(_mm256_cvttps_epi32(
+                            _mm256_min_ps(_mm256_max_ps(xa,vzero),vmax)),offset);
+                __m256i const b = _mm256_sub_epi32(_mm256_cvttps_epi32(
+                            _mm256_min_ps(_mm256_max_ps(xb,vzero),vmax)),offset);
+                __m256i const x = _mm256_permute4x64_epi64(
+                            _mm256_packs_epi32(a,b),0xD8);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst+i),
+                                    _mm256_xor_si256(x,flip));
+            }
+#elif defined(ILIM_SIMD_SSE2)
+            __m128 const vmax = _mm_set1_ps(max);
+            __m128 const vzero = _mm_setzero_ps();
+            __m128i const offset = _mm_set1_epi32(32768);
+            __m128i const flip = _mm_set1_epi16(int16_t(0x8000));
+            for(; i+8 <= n; i+=8) {
+                __m128 const xa = _mm_mul_ps(_mm_loadu_ps(src+i),vmax);
+                __m128 const xb = _mm_mul_ps(_mm_loadu_ps(src+i+4),vmax);
+                __m128i const a = _mm_sub_epi32(_mm_cvttps_epi32(
+                            _mm_min_ps(_mm_max_ps(xa,vzero),vmax)),offset);
+                __m128i const b = _mm_sub_epi32(_mm_cvttps_epi32(
+                            _mm_min_ps(_mm_max_ps(xb,vzero),vmax)),offset);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i),
+                                 _mm_xor_si128(_mm_packs_epi32(a,b),flip));
+            }
+#elif defined(ILIM_SIMD_NEON)
+            for(; i+8 <= n; i+=8) {
+                uint16x4_t const a = vqmovn_u32(vcvtq_u32_f32(
+                                        vmulq_n_f32(vld1q_f32(src+i),max)));
+                uint16x4_t const b = vqmovn_u32(vcvtq_u32_f32(
+                                        vmulq_n_f32(vld1q_f32(src+i+4),max)));
+                vst1q_u16(dst+i,vcombine_u16(a,b));
+            }
+#endif
+            for(; i < n; i++) {
+                dst[i] = static_cast<uint16_t>(clamp_scaled(src[i],max));
+            }
+        }
+
+        // 3 -> 4 channels, alpha is filled in
+        inline void conv_rgb8_to_rgba8(uint8_t const * src,
+                                       uint8_t * dst,
+                                       size_t count,
+                                       uint8_t alpha)
+        {
+            size_t i=0;
+
+#if defined(ILIM_SIMD_SSSE3)
+            // 4 pixels at a time; the 16 byte load reads 4 bytes
+            // past the 4th pixel so stop 6 pixels from the end
+            __m128i const shuffle = _mm_setr_epi8(
+                        0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1);
+            __m128i const valpha = _mm_set1_epi32(int32_t(uint32_t(alpha) << 24));
+            for(; i+6 <= count; i+=4) {
+                __m128i const x = _mm_loadu_si128(
+                            reinterpret_cast<__m128i const*>(src+(3*i)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+(4*i)),
+                                 _mm_or_si128(_mm_shuffle_epi8(x,shuffle),valpha));
+            }
+#elif defined(ILIM_SIMD_NEON)
+            for(; i+16 <= count; i+=16) {
+                uint8x16x3_t const x = vld3q_u8(src+(3*i));
+                uint8x16x4_t y;
+                y.val[0] = x.val[0];
+                y.val[1] = x.val[1];
+                y.val[2] = x.val[2];
+                y.val[3] = vdupq_n_u8(alpha);
+                vst4q_u8(dst+(4*i),y);
+            }
+#endif
+            for(; i < count; i++) {
+                dst[(4*i)+0] = src[(3*i)+0];
+                dst[(4*i)+1] = src[(3*i)+1];
+                dst[(4*i)+2] = src[(3*i)+2];
+                dst[(4*i)+3] = alpha;
+            }
+        }
+
+        // 4 -> 3 channels, alpha is dropped
+        inline void conv_rgba8_to_rgb8(uint8_t const * src,
+                                       uint8_t * dst,
+                                       size_t count)
+        {
+            size_t i=0;
+
+#if defined(ILIM_SIMD_SSSE3)
+            // 4 pixels at a time; the 16 byte store writes 4
+            // bytes past the 4th pixel (which are overwritten by
+            // the next pass) so stop 6 pixels from the end
+            __m128i const shuffle = _mm_setr_epi8(
+                        0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+            for(; i+6 <= count; i+=4) {
+                __m128i const x = _mm_loadu_si128(
+                            reinterpret_cast<__m128i const*>(src+(4*i)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+(3*i)),
+                                 _mm_shuffle_epi8(x,shuffle));
+            }
+#elif defined(ILIM_SIMD_NEON)
+            for(; i+16 <= count; i+=16) {
+                uint8x16x4_t const x = vld4q_u8(src+(4*i));
+                uint8x16x3_t y;
+                y.val[0] = x.val[0];
+                y.val[1] = x.val[1];
+                y.val[2] = x.val[2];
+                vst3q_u8(dst+(3*i),y);
+            }
+#endif
+            for(; i < count; i++) {
+                dst[(3*i)+0] = src[(4*i)+0];
+                dst[(3*i)+1] = src[(4*i)+1];
+                dst[(3*i)+2] = src[(4*i)+2];
+            }
+        }
+
+        // ============================================================= //
+
+        // bulk_conv<PixelSrc,PixelDst>::conv
+        // * the fallback assigns each pixel channel by
+        //   channel, just like conv_pixels
+        // * specializations below call a kernel on the
+        //   flat channel data
+        template<typename PixelSrc, typename PixelDst>
+        struct bulk_conv
+        {
+            static void conv(PixelSrc const * src,
+                             PixelDst * dst,
+                             size_t count)
+            {
+                for(size_t i=0; i < count; i++) {
+                    assign_r(src[i],dst[i]);
+                    assign_g(src[i],dst[i]);
+                    assign_b(src[i],dst[i]);
+                    assign_a(src[i],dst[i]);
+                }
+            }
+        };
+
+        // same format
+        template<typename Pixel>
+        struct bulk_conv<Pixel,Pixel>
+        {
+            static void conv(Pixel const * src,
+                             Pixel * dst,
+                             size_t count)
+            {
+                std::copy(src,src+count,dst);
+            }
+        };
+
+        // ============================================================= //
+
+        template<>
+        struct bulk_conv<R8,R16>
+        {
+            static void conv(R8 const * src, R16 * dst, size_t count)
+            {
+                static_assert(sizeof(R16)==2,"Unexpected pixel size");
+                conv_u8_to_u16(&(src->r),&(dst->r),count);
+            }
+        };
+
+        template<>
+        struct bulk_conv<R16,R8>
+        {
+            static void conv(R16 const * src, R8 * dst, size_t count)
+            {
+                static_assert(sizeof(R16)==2,"Unexpected pixel size");
+                conv_u16_to_u8(&(src->r),&(dst->r),count);
+            }
+        };
+
+        template<>
+        struct bulk_conv<RGBA8,RGBA16>
+        {
+            static void conv(RGBA8 const * src, RGBA16 * dst, size_t count)
+            {
+                static_assert(sizeof(RGBA8)==4 && sizeof(RGBA16)==8,"Unexpected pixel size");
+                conv_u8_to_u16(&(src->r),&(dst->r),count*4);
+            }
+        };
+
+        template<>
+        struct bulk_conv<RGBA16,RGBA8>
+        {
+            static void conv(RGBA16 const * src, RGBA8 * dst, size_t count)
+            {
+                static_assert(sizeof(RGBA8)==4 && sizeof(RGBA16)==8,"Unexpected pixel size");
+                conv_u16_to_u8(&(src->r),&(dst->r),count*4);
+            }
+        };
+
+        template<>
+        struct bulk_conv<RGB8,RGB32F>
+        {
+            static void conv(RGB8 const * src, RGB32F * dst, size_t count)
+            {
+                static_assert(sizeof(RGB8)==3 && sizeof(RGB32F)==12,"Unexpected pixel size");
+                conv_u8_to_f32(&(src->r),&(dst->r),count*3);
+            }
+        };
+
+        template<>
+        struct bulk_conv<RGB32F,RGB8>
+        {
+            static void conv(RGB32F const * src, RGB8 * dst, size_t count)
+            {
+                static_assert(sizeof(RGB8)==3 && sizeof(RGB32F)==12,"Unexpected pixel size");
+                conv_f32_to_u8(&(src->r),&(dst->r),count*3);
+            }
+        };
+
+        template<>
+        struct bulk_conv<RGBA8,RGBA32F>
+        {
+            static void conv(RGBA8 const * src, RGBA32F * dst, size_t count)
+            {
+                static_assert(sizeof(RGBA8)==4 && sizeof(RGBA32F)==16,"Unexpected pixel size");
+                conv_u8_to_f32(&(src->r),&(dst->r),count*4);
+            }
+        };
+
+        template<>
+        struct bulk_conv<RGBA32F,RGBA8>
+        {
+            static void conv(RGBA32F const * src, RGBA8 * dst, size_t count)
+            {
+                static_assert(sizeof(RGBA8)==4 && sizeof(RGBA32F)==16,"Unexpected pixel size");
+                conv_f32_to_u8(&(src->r),&(dst->r),count*4);
+            }
+        };
+
+        template<>
+        struct bulk_conv<RGBA16,RGBA32F>
+        {
+            static void conv(RGBA16 const * src, RGBA32F * dst, size_t count)
+            {
+                static_assert(sizeof(RGBA16)==8 && sizeof(RGBA32F)==16,"Unexpected pixel size");
+                conv_u16_to_f32(&(src->r),&(dst->r),count*4);
+            }
+        };
+
+        template<>
+        struct bulk_conv<RGBA32F,RGBA16>
+        {
+            static void conv(RGBA32F const * src, RGBA16 * dst, size_t count)
+            {
+                static_assert(sizeof(RGBA16)==8 && sizeof(RGBA32F)==16,"Unexpected pixel size");
+                conv_f32_to_u16(&(src->r),&(dst->r),count*4);
+            }
+        };
+
+        // alpha is subbed in as 1, see channel_a<assign_mode::sub>
+        template<>
+        struct bulk_conv<RGB8,RGBA8>
+        {
+            static void conv(RGB8 const * src, RGBA8 * dst, size_t count)
+            {
+                static_assert(sizeof(RGB8)==3 && sizeof(RGBA8)==4,"Unexpected pixel size");
+                conv_rgb8_to_rgba8(&(src->r),&(dst->r),count,1);
+            }
+        };
+
+        template<>
+        struct bulk_conv<RGBA8,RGB8>
+        {
+            static void conv(RGBA8 const * src, RGB8 * dst, size_t count)
+            {
+                static_assert(sizeof(RGB8)==3 && sizeof(RGBA8)==4,"Unexpected pixel size");
+                conv_rgba8_to_rgb8(&(src->r),&(dst->r),count);
+            }
+        };
+
+        // RGB8 -> RGBA8 -> RGBA16 through a small buffer
+        // that stays in cache; alpha is subbed in as 1
+        template<>
+        struct bulk_conv<RGB8,RGBA16>
+        {
+            static void conv(RGB8 const * src, RGBA16 * dst, size_t count)
+            {
+                size_t const k_chunk_size = 1024;
+                RGBA8 list_temp[k_chunk_size];
+
+                for(size_t i=0; i < count; i+=k_chunk_size) {
+                    size_t const chunk_count = std::min(k_chunk_size,count-i);
+                    bulk_conv<RGB8,RGBA8>::conv(src+i,list_temp,chunk_count);
+                    bulk_conv<RGBA8,RGBA16>::conv(list_temp,dst+i,chunk_count);
+                    for(size_t j=i; j < i+chunk_count; j++) {
+                        dst[j].a = 1;
+                    }
+                }
+            }
+        };
+
+    } // ilim_detail
+
+    // ============================================================= //
+    // ============================================================= //
+
+    // Name of the instruction set the kernels were built for
+    inline char const * get_simd_name()
+    {
+#if defined(ILIM_SIMD_AVX2)
+        return "AVX2";
+#elif defined(ILIM_SIMD_SSSE3)
+        return "SSSE3";
+#elif defined(ILIM_SIMD_SSE2)
+        return "SSE2";
+#elif defined(ILIM_SIMD_NEON)
+        return "NEON";
+#else
+        return "scalar";
+#endif
+    }
+
+    // Converts count pixels from src to dst; src
+    // and dst must not overlap
+    template<typename PixelSrc, typename PixelDst>
+    void conv_pixels_bulk(PixelSrc const * src,
+                          PixelDst * dst,
+                          size_t count)
+    {
+        ilim_detail::bulk_conv<PixelSrc,PixelDst>::conv(src,dst,count);
+    }
+
+    // Resizes list_dst to match list_src
+    template<typename PixelSrc, typename PixelDst>
+    void conv_pixels_bulk(std::vector<PixelSrc> const &list_src,
+                          std::vector<PixelDst> &list_dst)
+    {
+        list_dst.resize(list_src.size());
+        if(!list_src.empty()) {
+            conv_pixels_bulk(&(list_src[0]),&(list_dst[0]),list_src.size());
+        }
+    }
+
+    // Converts the overlapping top left part of two views
+    template<typename PixelSrc, typename PixelDst>
+    void conv_pixels_bulk(ImageView<PixelSrc> const &src,
+                          ImageView<PixelDst> const &dst)
+    {
+        uint32_t const width = std::min(src.width(),dst.width());
+        uint32_t const height = std::min(src.height(),dst.height());
+
+        if((src.width() == dst.width()) &&
+           src.contiguous() && dst.contiguous()) {
+            conv_pixels_bulk(src.data(),dst.data(),size_t(width)*height);
+            return;
+        }
+
+        for(uint32_t r=0; r < height; r++) {
+            conv_pixels_bulk(src.row(r),dst.row(r),width);
+        }
+    }
+
+} // ilim
+
+#endif // SCRATCH_INLINE_IMAGE_CONV_H
@@ -0,0 +1,705 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_INLINE_IMAGE_MIP_H
+#define SCRATCH_INLINE_IMAGE_MIP_H
+
+// sys
+#include <cstdint>
+#include <cmath>
+
+// stl
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+// ilim
+#include <ilim.hpp>
+#include <ilim_conv.hpp> // ILIM_SIMD_* and intrinsics
+
+// Mipmap chains
+// * every level is half the size of the one above it (a side
+//   of 1 stays 1) and each pixel is the average of a 2x2 box
+//   in the level above; odd sizes drop the last row/column
+// * MipFilter::GAMMA averages the color channels of 8 and 16
+//   bit pixels in linear light (sRGB decode, average, encode)
+//   so thin bright/dark features don't shift in brightness.
+//   Alpha is always averaged as is. Float and 32 bit int
+//   pixels are treated as linear so GAMMA is the same as BOX
+// * box rows of RGBA8, R8, RGBA16 and RGBA32F use SSE2 or NEON
+//   (RGB8 too on NEON); everything else runs the scalar loop
+// * integer channels round to nearest: (a+b+c+d+2)/4
+
+namespace ilim
+{
+    enum class MipFilter {
+        BOX,
+        GAMMA
+    };
+
+    namespace ilim_detail
+    {
+        // Levels with fewer pixels than this aren't
+        // worth splitting across threads
+        uint32_t const k_mip_parallel_min_pixels = 128*128;
+
+        // ============================================================= //
+
+        template<typename T>
+        struct mip_avg
+        {
+            static T calc(T a, T b, T c, T d)
+            {
+                return T((uint32_t(a)+b+c+d+2) >> 2);
+            }
+        };
+
+        template<>
+        struct mip_avg<uint32_t>
+        {
+            static uint32_t calc(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+            {
+                return uint32_t((uint64_t(a)+b+c+d+2) >> 2);
+            }
+        };
+
+        template<>
+        struct mip_avg<float>
+        {
+            static float calc(float a, float b, float c, float d)
+            {
+                return (a+b+c+d)*0.25f;
+            }
+        };
+
+        template<>
+        struct mip_avg<double>
+        {
+            static double calc(double a, double b, double c, double d)
+            {
+                return (a+b+c+d)*0.25;
+            }
+        };
+
+        // ============================================================= //
+
+        // Box filters output pixels [x,out_width) of one row of a
+        // level made of C channels of T per pixel. row0 and row1
+        // are the two source rows, dx is the channel offset to the
+        // second pixel of each pair (C, or 0 if the source is one
+        // pixel wide)
+        template<typename T, uint8_t C>
+        void mip_box_row_scalar(T const * row0,
+                                T const * row1,
+                                T * out,
+                                uint32_t out_width,
+                                size_t dx,
+                                uint32_t x)
+        {
+            for(; x < out_width; x++) {
+                T const * p0 = row0 + size_t(x)*2*C;
+                T const * p1 = row1 + size_t(x)*2*C;
+                for(uint8_t c=0; c < C; c++) {
+                    out[size_t(x)*C+c] =
+                            mip_avg<T>::calc(p0[c],p0[c+dx],p1[c],p1[c+dx]);
+                }
+            }
+        }
+
+        // Specializations run a vector loop first when dx == C
+        // and finish the row with mip_box_row_scalar
+        template<typename T, uint8_t C>
+        struct mip_box_row
+        {
+            static void calc(T const * row0,
+                             T const * row1,
+                             T * out,
+                             uint32_t out_width,
+                             size_t dx)
+            {
+                mip_box_row_scalar<T,C>(row0,row1,out,out_width,dx,0);
+            }
+        };
+
+        // RGBA8
+        template<>
+        struct mip_box_row<uint8_t,4>
+        {
+            static void calc(uint8_t const * row0,
+                             uint8_t const * row1,
+                             uint8_t * out,
+                             uint32_t out_width,
+                             size_t dx)
+            {
+                uint32_t x=0;
+
+                if(dx == 4) {
+#if defined(ILIM_SIMD_NEON)
+                    for(; x+8 <= out_width; x+=8) {
+                        // deinterleave 16 pixels, then pairwise add
+                        // neighbours within each channel
+                        uint8x16x4_t const a = vld4q_u8(row0+size_t(x)*8);
+                        uint8x16x4_t const b = vld4q_u8(row1+size_t(x)*8);
+                        uint8x8x4_t o;
+                        for(int c=0; c < 4; c++) {
+                            o.val[c] = vrshrn_n_u16(
+                                        vaddq_u16(vpaddlq_u8(a.val[c]),
+                                                  vpaddlq_u8(b.val[c])),2);
+                        }
+                        vst4_u8(out+size_t(x)*4,o);
+                    }
+#elif defined(ILIM_SIMD_SSE2)
+                    __m128i const zero = _mm_setzero_si128();
+                    __m128i const two = _mm_set1_epi16(2);
+                    for(; x+4 <= out_width; x+=4) {
+                        uint8_t const * a = row0+size_t(x)*8;
+                        uint8_t const * b = row1+size_t(x)*8;
+                        __m128i const a0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a));
+                        __m128i const a1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a+16));
+                        __m128i const b0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b));
+                        __m128i const b1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b+16));
+
+                        // vertical sums, two pixels per register
+                        __m128i const s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0,zero),_mm_unpacklo_epi8(b0,zero));
+                        __m128i const s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0,zero),_mm_unpackhi_epi8(b0,zero));
+                        __m128i const s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1,zero),_mm_unpacklo_epi8(b1,zero));
+                        __m128i const s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1,zero),_mm_unpackhi_epi8(b1,zero));
+
+                        // add neighbouring pixels
+                        __m128i h0 = _mm_add_epi16(_mm_unpacklo_epi64(s0,s1),_mm_unpackhi_epi64(s0,s1));
+                        __m128i h1 = _mm_add_epi16(_mm_unpacklo_epi64(s2,s3),_mm_unpackhi_epi64(s2,s3));
+                        h0 = _mm_srli_epi16(_mm_add_epi16(h0,two),2);
+                        h1 = _mm_srli_epi16(_mm_add_epi16(h1,two),2);
+
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(out+size_t(x)*4),
+                                         _mm_packus_epi16(h0,h1));
+                    }
+#endif
+                }
+
+                mip_box_row_scalar<uint8_t,4>(row0,row1,out,out_width,dx,x);
+            }
+        };
+
+        // RGB8
+        template<>
+        struct mip_box_row<uint8_t,3>
+        {
+            static void calc(uint8_t const * row0,
+                             uint8_t const * row1,
+                             uint8_t * out,
+                             uint32_t out_width,
+                             size_t dx)
+            {
+                uint32_t x=0;
+
+#if defined(ILIM_SIMD_NEON)
+                if(dx == 3) {
+                    for(; x+8 <= out_width; x+=8) {
+                        uint8x16x3_t const a = vld3q_u8(row0+size_t(x)*6);
+                        uint8x16x3_t const b = vld3q_u8(row1+size_t(x)*6);
+                        uint8x8x3_t o;
+                        for(int c=0; c < 3; c++) {
+                            o.val[c] = vrshrn_n_u16(
+                                        vaddq_u16(vpaddlq_u8(a.val[c]),
+                                                  vpaddlq_u8(b.val[c])),2);
+                        }
+                        vst3_u8(out+size_t(x)*3,o);
+                    }
+                }
+#endif
+
+                mip_box_row_scalar<uint8_t,3>(row0,row1,out,out_width,dx,x);
+            }
+        };
+
+        // R8
+        template<>
+        struct mip_box_row<uint8_t,1>
+        {
+            static void calc(uint8_t const * row0,
+                             uint8_t const * row1,
+                             uint8_t * out,
+                             uint32_t out_width,
+                             size_t dx)
+            {
+                uint32_t x=0;
+
+                if(dx == 1) {
+#if defined(ILIM_SIMD_NEON)
+                    for(; x+8 <= out_width; x+=8) {
+                        uint8x16_t const a = vld1q_u8(row0+size_t(x)*2);
+                        uint8x16_t const b = vld1q_u8(row1+size_t(x)*2);
+                        vst1_u8(out+x,vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a),
+                                                             vpaddlq_u8(b)),2));
+                    }
+#elif defined(ILIM_SIMD_SSE2)
+                    __m128i const zero = _mm_setzero_si128();
+                    __m128i const ones = _mm_set1_epi16(1);
+                    __m128i const two = _mm_set1_epi16(2);
+                    for(; x+8 <= out_width; x+=8) {
+                        __m128i const a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row0+size_t(x)*2));
+                        __m128i const b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row1+size_t(x)*2));
+                        __m128i const lo = _mm_add_epi16(_mm_unpacklo_epi8(a,zero),_mm_unpacklo_epi8(b,zero));
+                        __m128i const hi = _mm_add_epi16(_mm_unpackhi_epi8(a,zero),_mm_unpackhi_epi8(b,zero));
+
+                        // madd with 1s adds neighbouring columns
+                        __m128i s = _mm_packs_epi32(_mm_madd_epi16(lo,ones),
+                                                    _mm_madd_epi16(hi,ones));
+                        s = _mm_srli_epi16(_mm_add_epi16(s,two),2);
+                        _mm_storel_epi64(reinterpret_cast<__m128i*>(out+x),
+                                         _mm_packus_epi16(s,s));
+                    }
+#endif
+                }
+
+                mip_box_row_scalar<uint8_t,1>(row0,row1,out,out_width,dx,x);
+            }
+        };
+
+        // RGBA16
+        template<>
+        struct mip_box_row<uint16_t,4>
+        {
+            static void calc(uint16_t const * row0,
+                             uint16_t const * row1,
+                             uint16_t * out,
+                             uint32_t out_width,
+                             size_t dx)
+            {
+                uint32_t x=0;
+
+                if(dx == 4) {
+#if defined(ILIM_SIMD_NEON)
+                    for(; x+4 <= out_width; x+=4) {
+                        uint16x8x4_t const a = vld4q_u16(row0+size_t(x)*8);
+                        uint16x8x4_t const b = vld4q_u16(row1+size_t(x)*8);
+                        uint16x4x4_t o;
+                        for(int c=0; c < 4; c++) {
+                            o.val[c] = vrshrn_n_u32(
+                                        vaddq_u32(vpaddlq_u16(a.val[c]),
+                                                  vpaddlq_u16(b.val[c])),2);
+                        }
+                        vst4_u16(out+size_t(x)*4,o);
+                    }
+#elif defined(ILIM_SIMD_SSE2)
+                    __m128i const zero = _mm_setzero_si128();
+                    __m128i const two = _mm_set1_epi32(2);
+                    __m128i const bias32 = _mm_set1_epi32(32768);
+                    __m128i const bias16 = _mm_set1_epi16(-32768);
+                    for(; x+2 <= out_width; x+=2) {
+                        uint16_t const * a = row0+size_t(x)*8;
+                        uint16_t const * b = row1+size_t(x)*8;
+                        __m128i const a0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a));
+                        __m128i const a1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a+8));
+                        __m128i const b0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b));
+                        __m128i const b1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b+8));
+
+                        // one pixel per register in 32 bits
+                        __m128i s0 = _mm_add_epi32(
+                                    _mm_add_epi32(_mm_unpacklo_epi16(a0,zero),_mm_unpackhi_epi16(a0,zero)),
+                                    _mm_add_epi32(_mm_unpacklo_epi16(b0,zero),_mm_unpackhi_epi16(b0,zero)));
+                        __m128i s1 = _mm_add_epi32(
+                                    _mm_add_epi32(_mm_unpacklo_epi16(a1,zero),_mm_unpackhi_epi16(a1,zero)),
+                                    _mm_add_epi32(_mm_unpacklo_epi16(b1,zero),_mm_unpackhi_epi16(b1,zero)));
+                        s0 = _mm_srli_epi32(_mm_add_epi32(s0,two),2);
+                        s1 = _mm_srli_epi32(_mm_add_epi32(s1,two),2);
+
+                        // SSE2 only has a signed 32 -> 16 pack
+                        __m128i const s = _mm_packs_epi32(_mm_sub_epi32(s0,bias32),
+                                                          _mm_sub_epi32(s1,bias32));
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(out+size_t(x)*4),
+                                         _mm_xor_si128(s,bias16));
+                    }
+#endif
+                }
+
+                mip_box_row_scalar<uint16_t,4>(row0,row1,out,out_width,dx,x);
+            }
+        };
+
+        // RGBA32F
+        template<>
+        struct mip_box_row<float,4>
+        {
+            static void calc(float const * row0,
+                             float const * row1,
+                             float * out,
+                             uint32_t out_width,
+                             size_t dx)
+            {
+                uint32_t x=0;
+
+                if(dx == 4) {
+                    // same order of additions as the scalar
+                    // loop so results match exactly
+#if defined(ILIM_SIMD_NEON)
+                    for(; x < out_width; x++) {
+                        float const * a = row0+size_t(x)*8;
+                        float const * b = row1+size_t(x)*8;
+                        float32x4_t s = vaddq_f32(vld1q_f32(a),vld1q_f32(a+4));
+                        s = vaddq_f32(vaddq_f32(s,vld1q_f32(b)),vld1q_f32(b+4));
+                        vst1q_f32(out+size_t(x)*4,vmulq_n_f32(s,0.25f));
+                    }
+#elif defined(ILIM_SIMD_SSE2)
+                    __m128 const quarter = _mm_set1_ps(0.25f);
+                    for(; x < out_width; x++) {
+                        float const * a = row0+size_t(x)*8;
+                        float const * b = row1+size_t(x)*8;
+                        __m128 s = _mm_add_ps(_mm_loadu_ps(a),_mm_loadu_ps(a+4));
+                        s = _mm_add_ps(_mm_add_ps(s,_mm_loadu_ps(b)),_mm_loadu_ps(b+4));
+                        _mm_storeu_ps(out+size_t(x)*4,_mm_mul_ps(s,quarter));
+                    }
+#endif
+                }
+
+                mip_box_row_scalar<float,4>(row0,row1,out,out_width,dx,x);
+            }
+        };
+
+        // ============================================================= //
+
+        inline double srgb_to_linear(double s)
+        {
+            return (s <= 0.04045) ? (s/12.92) : std::pow((s+0.055)/1.055,2.4);
+        }
+
+        inline double linear_to_srgb(double l)
+        {
+            return (l <= 0.0031308) ? (l*12.92) : (1.055*std::pow(l,1.0/2.4)-0.055);
+        }
+
+        // 8 bit sRGB <-> 16 bit linear; 16 bits keeps
+        // the dark end from collapsing to a few values
+        struct srgb8_tables
+        {
+            srgb8_tables()
+            {
+                for(uint32_t i=0; i < 256; i++) {
+                    list_to_linear[i] = uint16_t(srgb_to_linear(i/255.0)*65535.0+0.5);
+                }
+                for(uint32_t i=0; i < 65536; i++) {
+                    list_to_srgb[i] = uint8_t(linear_to_srgb(i/65535.0)*255.0+0.5);
+                }
+            }
+
+            uint16_t list_to_linear[256];
+            uint8_t list_to_srgb[65536];
+        };
+
+        inline srgb8_tables const & get_srgb8_tables()
+        {
+            static srgb8_tables const tables;
+            return tables;
+        }
+
+        // 16 bit sRGB -> linear; the other way uses pow
+        struct srgb16_tables
+        {
+            srgb16_tables() :
+                list_to_linear(65536)
+            {
+                for(uint32_t i=0; i < 65536; i++) {
+                    list_to_linear[i] = float(srgb_to_linear(i/65535.0));
+                }
+            }
+
+            std::vector<float> list_to_linear;
+        };
+
+        inline srgb16_tables const & get_srgb16_tables()
+        {
+            static srgb16_tables const tables;
+            return tables;
+        }
+
+        // Gamma correct version of mip_box_row; the first
+        // channels (all but alpha if Alpha) are sRGB color.
+        // Types without sRGB tables are treated as linear
+        template<typename T, uint8_t C, bool Alpha>
+        struct mip_gamma_row
+        {
+            static void calc(T const * row0,
+                             T const * row1,
+                             T * out,
+                             uint32_t out_width,
+                             size_t dx)
+            {
+                mip_box_row<T,C>::calc(row0,row1,out,out_width,dx);
+            }
+        };
+
+        template<uint8_t C, bool Alpha>
+        struct mip_gamma_row<uint8_t,C,Alpha>
+        {
+            static void calc(uint8_t const * row0,
+                             uint8_t const * row1,
+                             uint8_t * out,
+                             uint32_t out_width,
+                             size_t dx)
+            {
+                srgb8_tables const &tables = get_srgb8_tables();
+                uint16_t const * to_linear = tables.list_to_linear;
+                uint8_t const * to_srgb = tables.list_to_srgb;
+                uint8_t const color_count = Alpha ? C-1 : C;
+
+                for(uint32_t x=0; x < out_width; x++) {
+                    uint8_t const * p0 = row0 + size_t(x)*2*C;
+                    uint8_t const * p1 = row1 + size_t(x)*2*C;
+                    uint8_t * o = out + size_t(x)*C;
+                    for(uint8_t c=0; c < color_count; c++) {
+                        o[c] = to_srgb[mip_avg<uint16_t>::calc(
+                                    to_linear[p0[c]],to_linear[p0[c+dx]],
+                                    to_linear[p1[c]],to_linear[p1[c+dx]])];
+                    }
+                    for(uint8_t c=color_count; c < C; c++) {
+                        o[c] = mip_avg<uint8_t>::calc(p0[c],p0[c+dx],p1[c],p1[c+dx]);
+                    }
+                }
+            }
+        };
+
+        template<uint8_t C, bool Alpha>
+        struct mip_gamma_row<uint16_t,C,Alpha>
+        {
+            static void calc(uint16_t const * row0,
+                             uint16_t const * row1,
+                             uint16_t * out,
+                             uint32_t out_width,
+                             size_t dx)
+            {
+                float const * to_linear = &(get_srgb16_tables().list_to_linear[0]);
+                uint8_t const color_count = Alpha ? C-1 : C;
+
+                for(uint32_t x=0; x < out_width; x++) {
+                    uint16_t const * p0 = row0 + size_t(x)*2*C;
+                    uint16_t const * p1 = row1 + size_t(x)*2*C;
+                    uint16_t * o = out + size_t(x)*C;
+                    for(uint8_t c=0; c < color_count; c++) {
+                        float const linear = mip_avg<float>::calc(
+                                    to_linear[p0[c]],to_linear[p0[c+dx]],
+                                    to_linear[p1[c]],to_linear[p1[c+dx]]);
+                        o[c] = uint16_t(linear_to_srgb(linear)*65535.0+0.5);
+                    }
+                    for(uint8_t c=color_count; c < C; c++) {
+                        o[c] = mip_avg<uint16_t>::calc(p0[c],p0[c+dx],p1[c],p1[c+dx]);
+                    }
+                }
+            }
+        };
+
+        // ============================================================= //
+
+        // Averages one bitfield channel of a packed pixel
+        template<uint8_t Bits>
+        struct mip_packed_channel
+        {
+            static uint8_t calc(uint8_t a, uint8_t b, uint8_t c, uint8_t d,
+                                MipFilter filter)
+            {
+                if(filter == MipFilter::BOX) {
+                    return mip_avg<uint8_t>::calc(a,b,c,d);
+                }
+
+                // expand to 8 bits to use the sRGB tables
+                uint32_t const max = (1u << Bits)-1;
+                srgb8_tables const &tables = get_srgb8_tables();
+                uint16_t const linear = mip_avg<uint16_t>::calc(
+                            tables.list_to_linear[(a*255+max/2)/max],
+                            tables.list_to_linear[(b*255+max/2)/max],
+                            tables.list_to_linear[(c*255+max/2)/max],
+                            tables.list_to_linear[(d*255+max/2)/max]);
+
+                return uint8_t((tables.list_to_srgb[linear]*max+127)/255);
+            }
+        };
+
+        template<>
+        struct mip_packed_channel<0>
+        {
+            static uint8_t calc(uint8_t, uint8_t, uint8_t, uint8_t, MipFilter)
+            {
+                return 0;
+            }
+        };
+
+        // ============================================================= //
+
+        // Filters one row of Pixels. Pixels made of equal
+        // channels (everything but RGB555/RGB565) are handled
+        // as flat arrays of channels
+        template<typename Pixel,
+                 bool Packed = !pixel_traits<Pixel>::single_bitdepth>
+        struct mip_row
+        {
+            typedef decltype(Pixel::r) channel_type;
+            static uint8_t const channel_count = pixel_traits<Pixel>::channel_count;
+            static bool const has_alpha = (pixel_traits<Pixel>::bits_a > 0);
+
+            static_assert(sizeof(Pixel) == sizeof(channel_type)*channel_count,
+                          "ilim: mip_row: Pixel must be a plain array of channels");
+
+            static void calc(Pixel const * row0,
+                             Pixel const * row1,
+                             Pixel * out,
+                             uint32_t out_width,
+                             size_t dx,
+                             MipFilter filter)
+            {
+                channel_type const * c0 = reinterpret_cast<channel_type const*>(row0);
+                channel_type const * c1 = reinterpret_cast<channel_type const*>(row1);
+                channel_type * o = reinterpret_cast<channel_type*>(out);
+
+                if(filter == MipFilter::GAMMA) {
+                    mip_gamma_row<channel_type,channel_count,has_alpha>::calc(
+                                c0,c1,o,out_width,dx*channel_count);
+                }
+                else {
+                    mip_box_row<channel_type,channel_count>::calc(
+                                c0,c1,o,out_width,dx*channel_count);
+                }
+            }
+        };
+
+        template<typename Pixel>
+        struct mip_row<Pixel,true>
+        {
+            static void calc(Pixel const * row0,
+                             Pixel const * row1,
+                             Pixel * out,
+                             uint32_t out_width,
+                             size_t dx,
+                             MipFilter filter)
+            {
+                typedef pixel_traits<Pixel> traits;
+
+                for(uint32_t x=0; x < out_width; x++) {
+                    Pixel const &p00 = row0[size_t(x)*2];
+                    Pixel const &p01 = row0[size_t(x)*2+dx];
+                    Pixel const &p10 = row1[size_t(x)*2];
+                    Pixel const &p11 = row1[size_t(x)*2+dx];
+
+                    Pixel &o = out[x];
+                    o.r = mip_packed_channel<traits::bits_r>::calc(p00.r,p01.r,p10.r,p11.r,filter);
+                    o.g = mip_packed_channel<traits::bits_g>::calc(p00.g,p01.g,p10.g,p11.g,filter);
+                    o.b = mip_packed_channel<traits::bits_b>::calc(p00.b,p01.b,p10.b,p11.b,filter);
+                }
+            }
+        };
+
+        // Fills rows [row_begin,row_end) of dst from src
+        template<typename Pixel>
+        void mip_rows(ImageView<Pixel> const &src,
+                      ImageView<Pixel> const &dst,
+                      MipFilter filter,
+                      uint32_t row_begin,
+                      uint32_t row_end)
+        {
+            size_t const dx = (src.width() > 1) ? 1 : 0;
+            for(uint32_t y=row_begin; y < row_end; y++) {
+                Pixel const * row0 = src.row(std::min(2*y,src.height()-1));
+                Pixel const * row1 = src.row(std::min(2*y+1,src.height()-1));
+                mip_row<Pixel>::calc(row0,row1,dst.row(y),dst.width(),dx,filter);
+            }
+        }
+    }
+
+    // ============================================================= //
+
+    // Writes the next mip level of src to dst, which must
+    // be max(1,width/2) x max(1,height/2)
+    template<typename Pixel>
+    void downsample_2x(ImageView<Pixel> const &src,
+                       ImageView<Pixel> const &dst,
+                       MipFilter filter=MipFilter::BOX)
+    {
+        assert(dst.width() == std::max<uint32_t>(1,src.width()/2));
+        assert(dst.height() == std::max<uint32_t>(1,src.height()/2));
+
+        ilim_detail::mip_rows(src,dst,filter,0,dst.height());
+    }
+
+    // Returns the mip levels below image, from half its size
+    // down to 1x1. Each level depends on the one before it so
+    // only the rows within a level are split up; pass a
+    // parallel_for_range that calls fn(range_begin,range_end)
+    // for subranges covering [begin,end) and returns once
+    // they're done, ie. to use a scratch::ThreadPool:
+    //
+    //   [&](size_t begin, size_t end,
+    //       std::function<void(size_t,size_t)> const &fn) {
+    //       scratch::ParallelForRange(thread_pool,begin,end,fn);
+    //   }
+    template<typename Pixel, typename ParallelForRange>
+    std::vector<Image<Pixel>> build_mip_chain(Image<Pixel> const &image,
+                                              MipFilter filter,
+                                              ParallelForRange && parallel_for_range)
+    {
+        std::vector<Image<Pixel>> list_levels;
+        if(image.width() == 0 || image.height() == 0) {
+            return list_levels;
+        }
+
+        // the source is only read from
+        ImageView<Pixel> src(const_cast<Pixel*>(&(image.data()[0])),
+                             image.width(),
+                             image.height());
+
+        while(src.width() > 1 || src.height() > 1) {
+            uint32_t const width = std::max<uint32_t>(1,src.width()/2);
+            uint32_t const height = std::max<uint32_t>(1,src.height()/2);
+
+            Image<Pixel> level;
+            level.set(width,height,std::vector<Pixel>(size_t(width)*height));
+            ImageView<Pixel> const dst = level.view();
+
+            std::function<void(size_t,size_t)> const fill_rows =
+                    [&](size_t row_begin, size_t row_end) {
+                        ilim_detail::mip_rows(src,dst,filter,
+                                              uint32_t(row_begin),
+                                              uint32_t(row_end));
+                    };
+
+            if(size_t(width)*height >= ilim_detail::k_mip_parallel_min_pixels) {
+                parallel_for_range(size_t(0),size_t(height),fill_rows);
+            }
+            else {
+                fill_rows(0,height);
+            }
+
+            // the pixel vector doesn't move with the Image
+            list_levels.push_back(std::move(level));
+            src = list_levels.back().view();
+        }
+
+        return list_levels;
+    }
+
+    template<typename Pixel>
+    std::vector<Image<Pixel>> build_mip_chain(Image<Pixel> const &image,
+                                              MipFilter filter=MipFilter::BOX)
+    {
+        return build_mip_chain(
+                    image,filter,
+                    [](size_t begin, size_t end,
+                       std::function<void(size_t,size_t)> const &fn) {
+                        fn(begin,end);
+                    });
+    }
+
+} // ilim
+
+#endif // SCRATCH_INLINE_IMAGE_MIP_H
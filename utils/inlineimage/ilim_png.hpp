@@ -17,8 +17,17 @@
 #ifndef SCRATCH_INLINE_IMAGE_PNG_H
 #define SCRATCH_INLINE_IMAGE_PNG_H
 
+#include <cstdlib>
+
 #include <lodepng/lodepng.h>
 #include <ilim.hpp>
+#include <ilim_conv.hpp>
+
+#ifndef LODEPNG_COMPILE_ALLOCATORS
+// provided by the application (see lodepng.h)
+void* lodepng_malloc(size_t size);
+void lodepng_free(void* ptr);
+#endif
 
 namespace ilim
 {
@@ -72,12 +81,16 @@ namespace ilim
 
     namespace ilim_detail
     {
+        // png_data<Channels,BitDepth>::assign converts
+        // byte_count bytes of raw lodepng output to pixels;
+        // pixels must have room for byte_count*8/(Channels*BitDepth)
         template<uint8_t Channels, uint8_t BitDepth>
         struct png_data
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &,
-                               std::vector<Pixel> &)
+            static void assign(uint8_t const *,
+                               size_t,
+                               Pixel *)
             {
                 // do nothing
             }
@@ -87,18 +100,20 @@ namespace ilim
         struct png_data<1,1>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
-                for(uint8_t const byte : list_bytes) {
-                    list_pixels.emplace_back(Pixel{ byte & 1 });
-                    list_pixels.emplace_back(Pixel{ byte & 2 });
-                    list_pixels.emplace_back(Pixel{ byte & 4 });
-                    list_pixels.emplace_back(Pixel{ byte & 8 });
-                    list_pixels.emplace_back(Pixel{ byte & 16 });
-                    list_pixels.emplace_back(Pixel{ byte & 32 });
-                    list_pixels.emplace_back(Pixel{ byte & 64 });
-                    list_pixels.emplace_back(Pixel{ byte & 128 });
+                for(size_t i=0; i < byte_count; i++) {
+                    uint8_t const byte = bytes[i];
+                    *pixels++ = Pixel{ byte & 1 };
+                    *pixels++ = Pixel{ byte & 2 };
+                    *pixels++ = Pixel{ byte & 4 };
+                    *pixels++ = Pixel{ byte & 8 };
+                    *pixels++ = Pixel{ byte & 16 };
+                    *pixels++ = Pixel{ byte & 32 };
+                    *pixels++ = Pixel{ byte & 64 };
+                    *pixels++ = Pixel{ byte & 128 };
                 }
             }
         };
@@ -107,14 +122,16 @@ namespace ilim
         struct png_data<1,2>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
-                for(uint8_t const byte : list_bytes) {
-                    list_pixels.emplace_back(Pixel{ byte & 3 });
-                    list_pixels.emplace_back(Pixel{ byte & 12 });
-                    list_pixels.emplace_back(Pixel{ byte & 48 });
-                    list_pixels.emplace_back(Pixel{ byte & 192 });
+                for(size_t i=0; i < byte_count; i++) {
+                    uint8_t const byte = bytes[i];
+                    *pixels++ = Pixel{ byte & 3 };
+                    *pixels++ = Pixel{ byte & 12 };
+                    *pixels++ = Pixel{ byte & 48 };
+                    *pixels++ = Pixel{ byte & 192 };
                 }
             }
         };
@@ -123,12 +140,14 @@ namespace ilim
         struct png_data<1,4>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
-                for(uint8_t const byte : list_bytes) {
-                    list_pixels.emplace_back(Pixel{ byte & 15 });
-                    list_pixels.emplace_back(Pixel{ byte & 240 });
+                for(size_t i=0; i < byte_count; i++) {
+                    uint8_t const byte = bytes[i];
+                    *pixels++ = Pixel{ byte & 15 };
+                    *pixels++ = Pixel{ byte & 240 };
                 }
             }
         };
@@ -137,11 +156,12 @@ namespace ilim
         struct png_data<1,8>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
-                for(uint8_t const byte : list_bytes) {
-                    list_pixels.emplace_back(Pixel{ byte });
+                for(size_t i=0; i < byte_count; i++) {
+                    *pixels++ = Pixel{ bytes[i] };
                 }
             }
         };
@@ -150,15 +170,16 @@ namespace ilim
         struct png_data<1,16>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
                 // png data is in big endian
-                for(size_t i=0; i < list_bytes.size(); i+=2) {
+                for(size_t i=0; i < byte_count; i+=2) {
                     // TODO check platform endianess! (currently LE only)
-                    list_pixels.emplace_back(Pixel {
-                        (static_cast<uint16_t>(list_bytes[i+1]) << 8) | list_bytes[i]
-                    });
+                    *pixels++ = Pixel {
+                        static_cast<uint16_t>((bytes[i+1] << 8) | bytes[i])
+                    };
                 }
             }
         };
@@ -167,14 +188,15 @@ namespace ilim
         struct png_data<2,8>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
-                for(size_t i=0; i < list_bytes.size(); i+=2) {
-                    list_pixels.emplace_back(Pixel {
-                        list_bytes[i],
-                        list_bytes[i+1]
-                    });
+                for(size_t i=0; i < byte_count; i+=2) {
+                    *pixels++ = Pixel {
+                        bytes[i],
+                        bytes[i+1]
+                    };
                 }
             }
         };
@@ -183,15 +205,16 @@ namespace ilim
         struct png_data<2,16>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
-                for(size_t i=0; i < list_bytes.size(); i+=4) {
+                for(size_t i=0; i < byte_count; i+=4) {
                     // TODO check platform endianess! (currently LE only)
-                    list_pixels.emplace_back(Pixel {
-                        ((static_cast<uint16_t>(list_bytes[i+1]) << 8) | list_bytes[i+0]),
-                        ((static_cast<uint16_t>(list_bytes[i+3]) << 8) | list_bytes[i+2])
-                    });
+                    *pixels++ = Pixel {
+                        static_cast<uint16_t>((bytes[i+1] << 8) | bytes[i+0]),
+                        static_cast<uint16_t>((bytes[i+3] << 8) | bytes[i+2])
+                    };
                 }
             }
         };
@@ -200,15 +223,16 @@ namespace ilim
         struct png_data<3,8>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
-                for(size_t i=0; i < list_bytes.size(); i+=3) {
-                    list_pixels.emplace_back(Pixel {
-                        list_bytes[i+0],
-                        list_bytes[i+1],
-                        list_bytes[i+2]
-                    });
+                for(size_t i=0; i < byte_count; i+=3) {
+                    *pixels++ = Pixel {
+                        bytes[i+0],
+                        bytes[i+1],
+                        bytes[i+2]
+                    };
                 }
             }
         };
@@ -217,16 +241,17 @@ namespace ilim
         struct png_data<3,16>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
-                for(size_t i=0; i < list_bytes.size(); i+=6) {
+                for(size_t i=0; i < byte_count; i+=6) {
                     // TODO check platform endianess! (currently LE only)
-                    list_pixels.emplace_back(Pixel {
-                        ((static_cast<uint16_t>(list_bytes[i+1]) << 8) | list_bytes[i+0]),
-                        ((static_cast<uint16_t>(list_bytes[i+3]) << 8) | list_bytes[i+2]),
-                        ((static_cast<uint16_t>(list_bytes[i+5]) << 8) | list_bytes[i+4])
-                    });
+                    *pixels++ = Pixel {
+                        static_cast<uint16_t>((bytes[i+1] << 8) | bytes[i+0]),
+                        static_cast<uint16_t>((bytes[i+3] << 8) | bytes[i+2]),
+                        static_cast<uint16_t>((bytes[i+5] << 8) | bytes[i+4])
+                    };
                 }
             }
         };
@@ -235,16 +260,17 @@ namespace ilim
         struct png_data<4,8>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
-                for(size_t i=0; i < list_bytes.size(); i+=4) {
-                    list_pixels.emplace_back(Pixel {
-                        list_bytes[i+0],
-                        list_bytes[i+1],
-                        list_bytes[i+2],
-                        list_bytes[i+3]
-                    });
+                for(size_t i=0; i < byte_count; i+=4) {
+                    *pixels++ = Pixel {
+                        bytes[i+0],
+                        bytes[i+1],
+                        bytes[i+2],
+                        bytes[i+3]
+                    };
                 }
             }
         };
@@ -253,112 +279,556 @@ namespace ilim
         struct png_data<4,16>
         {
             template<typename Pixel>
-            static void assign(std::vector<uint8_t> const &list_bytes,
-                               std::vector<Pixel> &list_pixels)
+            static void assign(uint8_t const * bytes,
+                               size_t byte_count,
+                               Pixel * pixels)
             {
-                for(size_t i=0; i < list_bytes.size(); i+=8) {
+                for(size_t i=0; i < byte_count; i+=8) {
                     // TODO check platform endianess! (currently LE only)
-                    list_pixels.emplace_back(Pixel {
-                        ((static_cast<uint16_t>(list_bytes[i+1]) << 8) | list_bytes[i+0]),
-                        ((static_cast<uint16_t>(list_bytes[i+3]) << 8) | list_bytes[i+2]),
-                        ((static_cast<uint16_t>(list_bytes[i+5]) << 8) | list_bytes[i+4]),
-                        ((static_cast<uint16_t>(list_bytes[i+7]) << 8) | list_bytes[i+6])
-                    });
+                    *pixels++ = Pixel {
+                        static_cast<uint16_t>((bytes[i+1] << 8) | bytes[i+0]),
+                        static_cast<uint16_t>((bytes[i+3] << 8) | bytes[i+2]),
+                        static_cast<uint16_t>((bytes[i+5] << 8) | bytes[i+4]),
+                        static_cast<uint16_t>((bytes[i+7] << 8) | bytes[i+6])
+                    };
                 }
             }
         };
-    }
 
-    template <typename Pixel>
-    bool load_png(std::vector<uint8_t> const &png_data,
-                  Image<Pixel> &image,
-                  bool * format_match=nullptr)
-    {
-        // If the source png data colortype and bitdepth
-        // match the requested format, lodepng will provide
-        // the decoded data in that format
+        // Converts all of list_bytes, sub byte formats
+        // can produce a few extra pixels for the padding
+        // bits at the end of the last byte
+        template<uint8_t Channels, uint8_t BitDepth, typename Pixel>
+        void assign_png_data(std::vector<uint8_t> const &list_bytes,
+                             std::vector<Pixel> &list_pixels)
+        {
+            size_t const pixel_bits = size_t(Channels)*BitDepth;
+            if(list_bytes.empty() || (pixel_bits == 0)) {
+                return;
+            }
+            list_pixels.resize((list_bytes.size()*8 + pixel_bits-1)/pixel_bits);
+            png_data<Channels,BitDepth>::assign(
+                        &(list_bytes[0]),list_bytes.size(),&(list_pixels[0]));
+        }
 
-        // Otherwise, lodepng will only convert either to
-        // RGB8 or RGBA8 (see lodepng.cpp, lines 4610 and on)
+        template<typename Pixel>
+        struct png_req_format
+        {
+            // Get the requested format
+            // cast to uint16_t in case bitdepth is 64
+            static constexpr uint8_t bitdepth =
+                    (!(pixel_traits<Pixel>::is_int_type && pixel_traits<Pixel>::single_bitdepth)) ? 0 :
+                    (pixel_traits<Pixel>::bits_r > 0) ? pixel_traits<Pixel>::bits_r :
+                    (pixel_traits<Pixel>::bits_g > 0) ? pixel_traits<Pixel>::bits_g :
+                    (pixel_traits<Pixel>::bits_b > 0) ? pixel_traits<Pixel>::bits_b :
+                    (pixel_traits<Pixel>::bits_a > 0) ? pixel_traits<Pixel>::bits_a : 0;
+
+            static constexpr uint8_t channels = pixel_traits<Pixel>::channel_count;
+
+            static constexpr size_t pixel_bits = size_t(channels)*bitdepth;
+        };
 
-        using namespace ilim_detail;
+        struct png_header
+        {
+            unsigned width;
+            unsigned height;
+            PNGColorType colortype;
+            uint8_t bitdepth;
+            uint8_t channels; // 99 for palettes
+            bool interlaced;
+        };
 
-        // Default load opts:
-        lodepng::State state;
-        state.info_raw.bitdepth = 8;
-        state.info_raw.colortype = LCT_RGBA;
-        bool default_convert = true;
+        inline bool read_png_header(std::vector<uint8_t> const &png_data,
+                                    png_header &header)
+        {
+            if(png_data.size() < 26) {
+                std::cout << "ERROR: Image: Failed to load png"
+                          << ": Invalid header" << std::endl;
+                return false;
+            }
 
-        if(format_match) {
-            *format_match = false;
+            lodepng::State state;
+            unsigned error = lodepng_inspect(&header.width,
+                                             &header.height,
+                                             &state,
+                                             &(png_data[0]),
+                                             png_data.size());
+            if(error) {
+                std::cout << "ERROR: Image: Failed to load png "
+                          << ": " << lodepng_error_text(error) << std::endl;
+                return false;
+            }
+
+            header.colortype = static_cast<PNGColorType>(png_data[25]);
+            header.bitdepth = png_data[24];
+            header.channels =
+                    (header.colortype == PNGColorType::GREY) ? 1 :
+                    (header.colortype == PNGColorType::GREY_ALPHA) ? 2 :
+                    (header.colortype == PNGColorType::RGB) ? 3 :
+                    (header.colortype == PNGColorType::RGBA) ? 4 : 99; // shouldnt match req_bitdepth
+            header.interlaced = (state.info_png.interlace_method != 0);
+
+            return true;
+        }
+
+        // If the source png data colortype and bitdepth
+        // match the requested format, the decoded data is
+        // assigned as is. Otherwise it goes through RGBA8
+        template<typename Pixel>
+        bool png_format_match(png_header const &header)
+        {
+            return ((header.bitdepth == png_req_format<Pixel>::bitdepth) &&
+                    (header.channels == png_req_format<Pixel>::channels));
         }
 
-        // Get the source format
-        PNGColorType src_colortype = static_cast<PNGColorType>(png_data[25]);
-        uint8_t const src_bitdepth = png_data[24];
-        uint8_t const src_channels =
-                (src_colortype == PNGColorType::GREY) ? 1 :
-                (src_colortype == PNGColorType::GREY_ALPHA) ? 2 :
-                (src_colortype == PNGColorType::RGB) ? 3 :
-                (src_colortype == PNGColorType::RGBA) ? 4 : 99; // shouldnt match req_bitdepth
-
-        // Get the requested format
-        // cast to uint16_t in case bitdepth is 64
-        constexpr uint8_t req_bitdepth =
-                (!(pixel_traits<Pixel>::is_int_type && pixel_traits<Pixel>::single_bitdepth)) ? 0 :
-                (pixel_traits<Pixel>::bits_r > 0) ? pixel_traits<Pixel>::bits_r :
-                (pixel_traits<Pixel>::bits_g > 0) ? pixel_traits<Pixel>::bits_g :
-                (pixel_traits<Pixel>::bits_b > 0) ? pixel_traits<Pixel>::bits_b :
-                (pixel_traits<Pixel>::bits_a > 0) ? pixel_traits<Pixel>::bits_a : 0;
-
-        constexpr uint8_t req_channels = pixel_traits<Pixel>::channel_count;
-
-        if((src_bitdepth == req_bitdepth) &&
-           (src_channels == req_channels))
+        // Decodes the whole image with lodepng and then
+        // assigns it to view. Handles every png (palettes,
+        // color keys, interlacing...) but keeps a second
+        // full size copy of the image around
+        template<typename Pixel>
+        bool decode_png_lodepng(std::vector<uint8_t> const &png_data,
+                                png_header const &header,
+                                ImageView<Pixel> const &view)
         {
-            // lodepng should decode into the requested
-            // format since it matches the png data
-            state.info_raw.bitdepth = src_bitdepth;
-            state.info_raw.colortype = static_cast<LodePNGColorType>(src_colortype);
-            default_convert = false;
+            // lodepng will only convert either to RGB8 or
+            // RGBA8 (see lodepng.cpp, lines 4610 and on)
 
+            // Default load opts:
+            lodepng::State state;
+            state.info_raw.bitdepth = 8;
+            state.info_raw.colortype = LCT_RGBA;
+
+            bool const format_match = png_format_match<Pixel>(header);
             if(format_match) {
-                *format_match = true;
+                // lodepng should decode into the requested
+                // format since it matches the png data
+                state.info_raw.bitdepth = header.bitdepth;
+                state.info_raw.colortype = static_cast<LodePNGColorType>(header.colortype);
+            }
+
+            // Decode the png
+            unsigned width,height;
+            std::vector<uint8_t> list_bytes;
+            unsigned error = lodepng::decode(list_bytes,width,height,state,png_data);
+
+            if(error) {
+                std::cout << "ERROR: Image: Failed to load png "
+                          << ": " << lodepng_error_text(error) << std::endl;
+                return false;
+            }
+
+            if(format_match && (png_req_format<Pixel>::pixel_bits % 8 == 0)) {
+                // whole bytes per pixel, so each row can be
+                // assigned straight into the view
+                size_t const row_bytes = width*(png_req_format<Pixel>::pixel_bits/8);
+                for(uint32_t r=0; r < view.height(); r++) {
+                    ilim_detail::png_data<png_req_format<Pixel>::channels,
+                                          png_req_format<Pixel>::bitdepth>::assign(
+                                &(list_bytes[r*row_bytes]),
+                                row_bytes,
+                                view.row(r));
+                }
             }
+            else if(format_match) {
+                // rows of sub byte formats aren't byte aligned
+                std::vector<Pixel> list_pixels;
+                assign_png_data<png_req_format<Pixel>::channels,
+                                png_req_format<Pixel>::bitdepth>(
+                            list_bytes,list_pixels);
+
+                view.insert(ImageView<Pixel>(&(list_pixels[0]),
+                                             width,
+                                             height),0,0);
+            }
+            else {
+                // convert one row at a time through RGBA8
+                size_t const row_bytes = width*4;
+                std::vector<RGBA8> list_temp_pixels(width);
+                for(uint32_t r=0; r < view.height(); r++) {
+                    ilim_detail::png_data<4,8>::assign(
+                                &(list_bytes[r*row_bytes]),
+                                row_bytes,
+                                &(list_temp_pixels[0]));
+                    conv_pixels_bulk(&(list_temp_pixels[0]),
+                                     view.row(r),
+                                     width);
+                }
+            }
+
+            return true;
         }
 
-        // Decode the png
-        unsigned width,height;
-        std::vector<uint8_t> list_bytes;
-        unsigned error = lodepng::decode(list_bytes,width,height,state,png_data);
+        // ============================================================= //
 
-        if(error) {
-            std::cout << "ERROR: Image: Failed to load png "
-                      << ": " << lodepng_error_text(error) << std::endl;
-            return false;
+        inline uint8_t paeth_predictor(int a, int b, int c)
+        {
+            // same form as lodepng's: |p-a|, |p-b| and |p-c|
+            // without computing p, and ties go to a, then b
+            int const pa = std::abs(b-c);
+            int const pb = std::abs(a-c);
+            int const pc = std::abs(a+b-c-c);
+
+            if(pc < pa && pc < pb) {
+                return uint8_t(c);
+            }
+            return uint8_t((pb < pa) ? b : a);
+        }
+
+        // Reverses the png filter on one scanline in place.
+        // prev is the previous unfiltered scanline or nullptr
+        // for the first one; bytewidth is bytes per pixel
+        inline bool unfilter_png_row(uint8_t * row,
+                                     uint8_t const * prev,
+                                     size_t bytewidth,
+                                     uint8_t filter_type,
+                                     size_t length)
+        {
+            switch(filter_type) {
+                case 0: {
+                    // none
+                    break;
+                }
+                case 1: {
+                    // sub
+                    for(size_t i=bytewidth; i < length; i++) {
+                        row[i] += row[i-bytewidth];
+                    }
+                    break;
+                }
+                case 2: {
+                    // up
+                    if(prev) {
+                        for(size_t i=0; i < length; i++) {
+                            row[i] += prev[i];
+                        }
+                    }
+                    break;
+                }
+                case 3: {
+                    // average
+                    if(prev) {
+                        for(size_t i=0; i < bytewidth; i++) {
+                            row[i] += prev[i]/2;
+                        }
+                        for(size_t i=bytewidth; i < length; i++) {
+                            row[i] += (row[i-bytewidth]+prev[i])/2;
+                        }
+                    }
+                    else {
+                        for(size_t i=bytewidth; i < length; i++) {
+                            row[i] += row[i-bytewidth]/2;
+                        }
+                    }
+                    break;
+                }
+                case 4: {
+                    // paeth
+                    if(prev) {
+                        for(size_t i=0; i < bytewidth; i++) {
+                            row[i] += prev[i];
+                        }
+                        for(size_t i=bytewidth; i < length; i++) {
+                            row[i] += paeth_predictor(row[i-bytewidth],
+                                                      prev[i],
+                                                      prev[i-bytewidth]);
+                        }
+                    }
+                    else {
+                        for(size_t i=bytewidth; i < length; i++) {
+                            row[i] += row[i-bytewidth];
+                        }
+                    }
+                    break;
+                }
+                default: {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Converts one unfiltered 8 or 16 bit non palette
+        // scanline to RGBA8 the same way lodepng does; 16
+        // bit samples keep their most significant byte
+        inline void png_row_to_rgba8(uint8_t const * bytes,
+                                     png_header const &header,
+                                     RGBA8 * pixels)
+        {
+            size_t const step = header.bitdepth/8;
+            for(unsigned i=0; i < header.width; i++) {
+                RGBA8 &pixel = pixels[i];
+                switch(header.colortype) {
+                    case PNGColorType::GREY: {
+                        pixel.r = pixel.g = pixel.b = bytes[0];
+                        pixel.a = 255;
+                        break;
+                    }
+                    case PNGColorType::GREY_ALPHA: {
+                        pixel.r = pixel.g = pixel.b = bytes[0];
+                        pixel.a = bytes[step];
+                        break;
+                    }
+                    case PNGColorType::RGB: {
+                        pixel.r = bytes[0];
+                        pixel.g = bytes[step];
+                        pixel.b = bytes[2*step];
+                        pixel.a = 255;
+                        break;
+                    }
+                    default: {
+                        pixel.r = bytes[0];
+                        pixel.g = bytes[step];
+                        pixel.b = bytes[2*step];
+                        pixel.a = bytes[3*step];
+                        break;
+                    }
+                }
+                bytes += header.channels*step;
+            }
         }
-        else {
-            std::vector<Pixel> list_pixels;
 
-            if(!default_convert) {
-                list_pixels.reserve(width*height);
-                ilim_detail::png_data<req_channels,req_bitdepth>::assign(list_bytes,list_pixels);
+        // Buffer for lodepng's C api, which reallocs and
+        // frees with lodepng's own allocators
+        struct lodepng_buffer
+        {
+            explicit lodepng_buffer(size_t size)
+            {
+#ifdef LODEPNG_COMPILE_ALLOCATORS
+                data = static_cast<uint8_t*>(malloc(size));
+#else
+                data = static_cast<uint8_t*>(lodepng_malloc(size));
+#endif
+                this->size = (data) ? size : 0;
+            }
+
+            ~lodepng_buffer()
+            {
+#ifdef LODEPNG_COMPILE_ALLOCATORS
+                free(data);
+#else
+                lodepng_free(data);
+#endif
+            }
+
+            lodepng_buffer(lodepng_buffer const &) = delete;
+            lodepng_buffer & operator=(lodepng_buffer const &) = delete;
+
+            uint8_t * data;
+            size_t size;
+        };
+
+        enum class png_rows_result {
+            ok,
+            unsupported,
+            error
+        };
+
+        // Decodes into view without a full size intermediate
+        // image: IDAT is inflated into the filtered scanlines,
+        // then each scanline is unfiltered in place and
+        // converted straight into its row in view
+        // * a single IDAT chunk (the common case) is inflated
+        //   straight from png_data without being copied
+        // * palettes, color keys (tRNS), interlacing and sub
+        //   byte depths are unsupported; decode_png_lodepng
+        //   handles those
+        template<typename Pixel>
+        png_rows_result decode_png_rows(std::vector<uint8_t> const &png_data,
+                                        png_header const &header,
+                                        ImageView<Pixel> const &view)
+        {
+            if(header.interlaced ||
+               (header.channels > 4) ||
+               (header.bitdepth < 8)) {
+                return png_rows_result::unsupported;
+            }
+
+            // find the IDAT chunks; the first chunk
+            // after the signature is IHDR
+            std::vector<std::pair<uint8_t const*,size_t>> list_idat;
+            uint8_t const * const png_end = &(png_data[0])+png_data.size();
+            uint8_t const * chunk = &(png_data[8]);
+            bool iend=false;
+
+            while(!iend) {
+                if(png_end-chunk < 12) {
+                    std::cout << "ERROR: Image: Failed to load png "
+                              << ": " << lodepng_error_text(30) << std::endl;
+                    return png_rows_result::error;
+                }
+
+                size_t const chunk_length = lodepng_chunk_length(chunk);
+                if(size_t(png_end-chunk)-12 < chunk_length) {
+                    std::cout << "ERROR: Image: Failed to load png "
+                              << ": " << lodepng_error_text(64) << std::endl;
+                    return png_rows_result::error;
+                }
+
+                if(lodepng_chunk_type_equals(chunk,"IDAT")) {
+                    if(lodepng_chunk_check_crc(chunk)) {
+                        std::cout << "ERROR: Image: Failed to load png "
+                                  << ": " << lodepng_error_text(57) << std::endl;
+                        return png_rows_result::error;
+                    }
+                    list_idat.emplace_back(lodepng_chunk_data_const(chunk),
+                                           chunk_length);
+                }
+                else if(lodepng_chunk_type_equals(chunk,"PLTE") ||
+                        lodepng_chunk_type_equals(chunk,"tRNS")) {
+                    return png_rows_result::unsupported;
+                }
+                else if(lodepng_chunk_type_equals(chunk,"IEND")) {
+                    iend = true;
+                }
+
+                chunk = lodepng_chunk_next_const(chunk);
+            }
+
+            // inflate
+            std::vector<uint8_t> list_idat_bytes;
+            uint8_t const * idat_data = nullptr;
+            size_t idat_size = 0;
+
+            if(list_idat.size() == 1) {
+                idat_data = list_idat[0].first;
+                idat_size = list_idat[0].second;
             }
             else {
-                // The source colortype and bitdepth didn't match
-                // the corresponding requested params, so we request
-                // the data in RGBA8 format and conver to the desired
-                // target <Pixel> type
-                std::vector<RGBA8> list_temp_pixels;
-                list_temp_pixels.reserve(width*height);
-                ilim_detail::png_data<4,8>::assign(list_bytes,list_temp_pixels);
-                conv_pixels(list_temp_pixels,list_pixels);
+                for(auto const &idat : list_idat) {
+                    list_idat_bytes.insert(list_idat_bytes.end(),
+                                           idat.first,
+                                           idat.first+idat.second);
+                }
+                idat_data = list_idat_bytes.empty() ? nullptr : &(list_idat_bytes[0]);
+                idat_size = list_idat_bytes.size();
+            }
+
+            size_t const bytewidth = size_t(header.channels)*header.bitdepth/8;
+            size_t const linebytes = bytewidth*header.width;
+            size_t const scanline_size = size_t(header.height)*(linebytes+1);
+
+            // inflate into a buffer that's already big enough
+            // so lodepng doesn't have to grow it as it goes
+            lodepng_buffer scanlines(scanline_size);
+            unsigned error = lodepng_zlib_decompress(&(scanlines.data),
+                                                     &(scanlines.size),
+                                                     idat_data,
+                                                     idat_size,
+                                                     &lodepng_default_decompress_settings);
+            if(!error && scanlines.size < scanline_size) {
+                error = 91; // decompressed size doesn't match prediction
+            }
+            if(error) {
+                std::cout << "ERROR: Image: Failed to load png "
+                          << ": " << lodepng_error_text(error) << std::endl;
+                return png_rows_result::error;
+            }
+
+            // unfilter and convert each row
+            bool const format_match = png_format_match<Pixel>(header);
+            std::vector<RGBA8> list_temp_pixels;
+            if(!format_match) {
+                list_temp_pixels.resize(header.width);
+            }
+
+            uint8_t const * prev = nullptr;
+            for(uint32_t r=0; r < header.height; r++) {
+                uint8_t * scanline = scanlines.data+r*(linebytes+1);
+                uint8_t * row = scanline+1;
+
+                if(!unfilter_png_row(row,prev,bytewidth,scanline[0],linebytes)) {
+                    std::cout << "ERROR: Image: Failed to load png "
+                              << ": " << lodepng_error_text(36) << std::endl;
+                    return png_rows_result::error;
+                }
+                prev = row;
+
+                if(format_match) {
+                    ilim_detail::png_data<png_req_format<Pixel>::channels,
+                                          png_req_format<Pixel>::bitdepth>::assign(
+                                row,linebytes,view.row(r));
+                }
+                else {
+                    png_row_to_rgba8(row,header,&(list_temp_pixels[0]));
+                    conv_pixels_bulk(&(list_temp_pixels[0]),
+                                     view.row(r),
+                                     header.width);
+                }
             }
 
-            // Save data to image
-            image.set(width,height,std::move(list_pixels));
+            return png_rows_result::ok;
+        }
+    }
+
+    // Decodes into memory owned by someone else; view
+    // must be exactly the size of the png
+    template <typename Pixel>
+    bool load_png(std::vector<uint8_t> const &png_data,
+                  ImageView<Pixel> const &view,
+                  bool * format_match=nullptr)
+    {
+        using namespace ilim_detail;
+
+        if(format_match) {
+            *format_match = false;
+        }
+
+        png_header header;
+        if(!read_png_header(png_data,header)) {
+            return false;
+        }
+
+        if((header.width != view.width()) ||
+           (header.height != view.height())) {
+            std::cout << "ERROR: Image: Failed to load png"
+                      << ": view is " << view.width() << "x" << view.height()
+                      << ", png is " << header.width << "x" << header.height
+                      << std::endl;
+            return false;
+        }
 
+        png_rows_result const result = decode_png_rows(png_data,header,view);
+        if(result == png_rows_result::error) {
+            return false;
+        }
+        if(result == png_rows_result::unsupported) {
+            if(!decode_png_lodepng(png_data,header,view)) {
+                return false;
+            }
         }
+
+        if(format_match) {
+            *format_match = png_format_match<Pixel>(header);
+        }
+
+        return true;
+    }
+
+    template <typename Pixel>
+    bool load_png(std::vector<uint8_t> const &png_data,
+                  Image<Pixel> &image,
+                  bool * format_match=nullptr)
+    {
+        if(format_match) {
+            *format_match = false;
+        }
+
+        ilim_detail::png_header header;
+        if(!ilim_detail::read_png_header(png_data,header)) {
+            return false;
+        }
+
+        // decode straight into the image's final storage
+        std::vector<Pixel> list_pixels(size_t(header.width)*header.height);
+        ImageView<Pixel> view(&(list_pixels[0]),header.width,header.height);
+
+        if(!load_png(png_data,view,format_match)) {
+            return false;
+        }
+
+        // Save data to image
+        image.set(header.width,header.height,std::move(list_pixels));
+
         return true;
     }
 
@@ -379,6 +849,23 @@ namespace ilim
         return load_png(png_data,image,format_match);
     }
 
+    template <typename Pixel>
+    bool load_png(std::string const &filepath,
+                  ImageView<Pixel> const &view,
+                  bool * format_match=nullptr)
+    {
+        std::vector<uint8_t> png_data;
+        lodepng::load_file(png_data,filepath);
+
+        if(png_data.size() == 0) {
+            std::cout << "ERROR: ilim: Failed to load png file: "
+                      << filepath << std::endl;
+            return false;
+        }
+
+        return load_png(png_data,view,format_match);
+    }
+
 } // ilim
 
 #endif // SCRATCH_INLINE_IMAGE_PNG_H
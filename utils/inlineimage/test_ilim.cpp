@@ -26,10 +26,18 @@
 #include <limits>
 #include <cmath>
 #include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
 
 // ilim
 #include <ilim.hpp>
+#include <ilim_conv.hpp>
 #include <ilim_png.hpp>
+#include <ilim_mip.hpp>
+#include <ilim_compress.hpp>
 
 namespace ilim
 {
@@ -260,6 +268,98 @@ namespace ilim
 
 using namespace ilim;
 
+// ============================================================= //
+
+// Heap accounting for the png decode benchmark: everything
+// allocated through operator new and, since test_ilim.pro
+// defines LODEPNG_NO_COMPILE_ALLOCATORS, through lodepng's
+// lodepng_malloc/realloc/free hooks. Block sizes come from
+// malloc_usable_size (glibc). Not thread safe.
+
+size_t g_heap_current=0;
+size_t g_heap_peak=0;
+
+// kept out of line so gcc doesn't pair the free() here
+// with an inlined operator new and warn about a mismatch
+__attribute__((noinline))
+void * counted_malloc(size_t size)
+{
+    void * ptr = malloc(size);
+    if(ptr) {
+        g_heap_current += malloc_usable_size(ptr);
+        g_heap_peak = std::max(g_heap_peak,g_heap_current);
+    }
+    return ptr;
+}
+
+__attribute__((noinline))
+void counted_free(void * ptr)
+{
+    if(ptr) {
+        g_heap_current -= malloc_usable_size(ptr);
+        free(ptr);
+    }
+}
+
+void * operator new(size_t size)
+{
+    void * ptr = counted_malloc(size ? size : 1);
+    if(!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void * operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void * ptr) noexcept
+{
+    counted_free(ptr);
+}
+
+void operator delete[](void * ptr) noexcept
+{
+    counted_free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+    counted_free(ptr);
+}
+
+void operator delete[](void * ptr, size_t) noexcept
+{
+    counted_free(ptr);
+}
+
+#ifdef LODEPNG_NO_COMPILE_ALLOCATORS
+void * lodepng_malloc(size_t size)
+{
+    return counted_malloc(size);
+}
+
+void lodepng_free(void * ptr)
+{
+    counted_free(ptr);
+}
+
+void * lodepng_realloc(void * ptr, size_t new_size)
+{
+    // both blocks are live while the data is copied
+    void * resized = counted_malloc(new_size);
+    if(ptr && resized) {
+        memcpy(resized,ptr,std::min(malloc_usable_size(ptr),new_size));
+    }
+    if(resized || (new_size == 0)) {
+        counted_free(ptr);
+    }
+    return resized;
+}
+#endif
+
 template<typename PixelSrc,typename PixelDst>
 ilim_detail::assign_mode get_channel_r_assign_mode()
 {
@@ -733,46 +833,1003 @@ void test_channel_upsample()
     std::cout << "test_channel_upsample... [ok]" << std::endl;
 }
 
+template<typename PixelSrc, typename PixelDst>
+void bench_conv(std::string const &desc,
+                std::vector<RGBA8> const &list_rgba8)
+{
+    typedef std::chrono::steady_clock clock;
+    size_t const k_runs = 5;
+
+    // source pixels come from random RGBA8 data so
+    // float formats stay within [0,1]
+    std::vector<PixelSrc> list_src;
+    ilim_detail::conv_pixels(list_rgba8,list_src);
+
+    // best of k_runs for each
+    std::vector<PixelDst> list_dst_pixel;
+    double ms_pixel = std::numeric_limits<double>::max();
+    for(size_t i=0; i < k_runs; i++) {
+        auto const start = clock::now();
+        ilim_detail::conv_pixels(list_src,list_dst_pixel);
+        auto const end = clock::now();
+        ms_pixel = std::min(ms_pixel,std::chrono::duration<double>(end-start).count()*1000.0);
+    }
+
+    std::vector<PixelDst> list_dst_bulk;
+    double ms_bulk = std::numeric_limits<double>::max();
+    for(size_t i=0; i < k_runs; i++) {
+        auto const start = clock::now();
+        conv_pixels_bulk(list_src,list_dst_bulk);
+        auto const end = clock::now();
+        ms_bulk = std::min(ms_bulk,std::chrono::duration<double>(end-start).count()*1000.0);
+    }
+
+    bool const ok =
+            (list_dst_pixel.size() == list_dst_bulk.size()) &&
+            (memcmp(&(list_dst_pixel[0]),
+                    &(list_dst_bulk[0]),
+                    sizeof(PixelDst)*list_dst_bulk.size()) == 0);
+
+    std::cout << "  " << desc << ": per pixel: " << ms_pixel << "ms"
+              << ", bulk: " << ms_bulk << "ms"
+              << ", " << (ms_pixel/ms_bulk) << "x"
+              << (ok ? " [ok]" : " [err]") << std::endl;
+
+    assert(ok);
+}
+
 void test_speed()
 {
-    std::chrono::time_point<std::chrono::system_clock> start,end;
+    // full screen atlas sized, plus a few pixels so
+    // the kernels have a tail to finish
+    size_t const count = 2048*1024+13;
+
+    std::vector<RGBA8> list_rgba8;
+    list_rgba8.reserve(count);
+
+    uint32_t x = 12345;
+    for(size_t i=0; i < count; i++) {
+        x = x*1103515245u + 12345u;
+        list_rgba8.push_back(RGBA8{uint8_t(x >> 24),
+                                   uint8_t(x >> 16),
+                                   uint8_t(x >> 8),
+                                   uint8_t(x >> 4)});
+    }
+
+    std::cout << "test_speed (" << get_simd_name() << ", "
+              << count << " pixels)..." << std::endl;
+
+    bench_conv<R8,R16>("R8 -> R16",list_rgba8);
+    bench_conv<R16,R8>("R16 -> R8",list_rgba8);
+    bench_conv<RGBA8,RGBA16>("RGBA8 -> RGBA16",list_rgba8);
+    bench_conv<RGBA16,RGBA8>("RGBA16 -> RGBA8",list_rgba8);
+    bench_conv<RGB8,RGB32F>("RGB8 -> RGB32F",list_rgba8);
+    bench_conv<RGB32F,RGB8>("RGB32F -> RGB8",list_rgba8);
+    bench_conv<RGBA8,RGBA32F>("RGBA8 -> RGBA32F",list_rgba8);
+    bench_conv<RGBA32F,RGBA8>("RGBA32F -> RGBA8",list_rgba8);
+    bench_conv<RGBA16,RGBA32F>("RGBA16 -> RGBA32F",list_rgba8);
+    bench_conv<RGBA32F,RGBA16>("RGBA32F -> RGBA16",list_rgba8);
+    bench_conv<RGB8,RGBA8>("RGB8 -> RGBA8",list_rgba8);
+    bench_conv<RGBA8,RGB8>("RGBA8 -> RGB8",list_rgba8);
+    bench_conv<RGB8,RGBA16>("RGB8 -> RGBA16",list_rgba8);
+    bench_conv<RGBA8,RGBA8>("RGBA8 -> RGBA8",list_rgba8);
+
+    // no kernel, uses the per pixel fallback
+    bench_conv<RGBA8,R8>("RGBA8 -> R8 (fallback)",list_rgba8);
+
+    std::cout << "test_speed... [ok]" << std::endl;
+}
+
+void test_conv_saturate()
+{
+    // out of range floats saturate the same way in the
+    // vector loops and the scalar tail; 37 pixels covers
+    // both for every kernel width
+    float const list_values[] = {
+        0.0f, 0.5f, 1.0f, -0.25f, 1.5f, -1.0E10f, 1.0E10f,
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::quiet_NaN(), 0.999f
+    };
+    size_t const num_values = sizeof(list_values)/sizeof(float);
+
+    std::vector<RGBA32F> list_src(37);
+    float * src = &(list_src[0].r);
+    for(size_t i=0; i < list_src.size()*4; i++) {
+        src[i] = list_values[i % num_values];
+    }
+
+    std::vector<RGBA8> list_dst8;
+    std::vector<RGBA16> list_dst16;
+    conv_pixels_bulk(list_src,list_dst8);
+    conv_pixels_bulk(list_src,list_dst16);
+
+    uint8_t const * dst8 = &(list_dst8[0].r);
+    uint16_t const * dst16 = &(list_dst16[0].r);
+    for(size_t i=0; i < list_src.size()*4; i++) {
+        float const x = src[i];
+        uint8_t const x8 = (x > 0.0f) ? ((x < 1.0f) ? uint8_t(x*255.0f) : 255) : 0;
+        uint16_t const x16 = (x > 0.0f) ? ((x < 1.0f) ? uint16_t(x*65535.0f) : 65535) : 0;
+        assert(dst8[i] == x8);
+        assert(dst16[i] == x16);
+        (void)x8;
+        (void)x16;
+    }
+
+    std::cout << "test_conv_saturate... [ok]" << std::endl;
+}
+
+void test_image_view()
+{
+    // 5x4 view in the middle of a buffer with padded
+    // rows, like a tile inside a larger atlas
+    uint32_t const pitch_px = 8;
+    std::vector<RGBA8> list_buffer(pitch_px*6,RGBA8{0,0,0,0});
+    ImageView<RGBA8> view(&(list_buffer[pitch_px+1]),5,4,pitch_px*sizeof(RGBA8));
+    assert(!view.contiguous());
+
+    for(uint32_t r=0; r < view.height(); r++) {
+        for(uint32_t c=0; c < view.width(); c++) {
+            view.at(c,r) = RGBA8{uint8_t(c),uint8_t(r),7,255};
+        }
+    }
+    assert(list_buffer[pitch_px+1].r == 0 && list_buffer[pitch_px+1].a == 255);
+    assert(list_buffer[2*pitch_px+3].r == 2 && list_buffer[2*pitch_px+3].g == 1);
+    assert(list_buffer[pitch_px].a == 0 && list_buffer[pitch_px+6].a == 0);
+
+    // subviews are clipped
+    ImageView<RGBA8> sub = view.subview(3,2,10,10);
+    assert(sub.width() == 2 && sub.height() == 2);
+    assert(sub.at(1,1).r == 4 && sub.at(1,1).g == 3);
+
+    // insert a view into an image and an image into a view
+    Image<RGBA8> image;
+    image.set(3,3,std::vector<RGBA8>(9,RGBA8{9,9,9,9}));
+    image.insert(sub,image.at(2,2));
+    assert(image.at(2,2)->r == 3 && image.at(2,2)->g == 2);
+    assert(image.at(1,2)->r == 9);
+
+    view.insert(image.view(),4,3);
+    assert(view.at(4,3).r == 9 && view.at(3,3).r == 3);
+    assert(list_buffer[4*pitch_px+6].a == 0);
+
+    // convert between views with different pitches
+    std::vector<RGBA32F> list_float(5*4);
+    ImageView<RGBA32F> view_float(&(list_float[0]),5,4);
+    conv_pixels_bulk(view,view_float);
+
+    std::vector<RGBA8> list_view_pixels;
+    for(uint32_t r=0; r < view.height(); r++) {
+        list_view_pixels.insert(list_view_pixels.end(),view.row(r),view.row(r)+view.width());
+    }
+    std::vector<RGBA32F> list_float_check;
+    ilim_detail::conv_pixels(list_view_pixels,list_float_check);
+    assert(memcmp(&(list_float[0]),&(list_float_check[0]),
+                  sizeof(RGBA32F)*list_float.size()) == 0);
+
+    // decode a png straight into a view, both when
+    // the format matches and when it needs converting
+    std::vector<uint8_t> list_rgba_bytes;
+    for(uint32_t r=0; r < view.height(); r++) {
+        for(uint32_t c=0; c < view.width(); c++) {
+            list_rgba_bytes.push_back(uint8_t(c*50));
+            list_rgba_bytes.push_back(uint8_t(r*60));
+            list_rgba_bytes.push_back(200);
+            list_rgba_bytes.push_back(uint8_t(255-c));
+        }
+    }
+    std::vector<uint8_t> png_data;
+    unsigned error = lodepng::encode(png_data,list_rgba_bytes,5,4,LCT_RGBA,8);
+    assert(error == 0);
+    (void)error;
+
+    std::fill(list_buffer.begin(),list_buffer.end(),RGBA8{0,0,0,0});
+    bool format_match=false;
+    bool ok = load_png(png_data,view,&format_match);
+    assert(ok && format_match);
+    assert(view.at(4,3).r == 200 && view.at(4,3).g == 180 && view.at(4,3).a == 251);
+    assert(list_buffer[pitch_px].a == 0 && list_buffer[pitch_px+6].a == 0);
+
+    std::vector<RGB8> list_rgb(6*4);
+    ImageView<RGB8> view_rgb(&(list_rgb[0]),5,4,6*sizeof(RGB8));
+    ok = load_png(png_data,view_rgb,&format_match);
+    assert(ok && !format_match);
+    assert(view_rgb.at(2,1).r == 100 && view_rgb.at(2,1).g == 60);
+
+    // sizes must match
+    ok = load_png(png_data,view.subview(0,0,4,4));
+    assert(!ok);
+    (void)ok;
+
+    std::cout << "test_image_view... [ok]" << std::endl;
+}
+
+std::vector<uint8_t> encode_test_png(unsigned width,
+                                     unsigned height,
+                                     LodePNGColorType colortype,
+                                     unsigned bitdepth)
+{
+    // smooth gradients with some noise so the encoder
+    // picks a mix of filter types
+    lodepng::State state;
+    state.info_raw.colortype = colortype;
+    state.info_raw.bitdepth = bitdepth;
+    state.info_png.color.colortype = colortype;
+    state.info_png.color.bitdepth = bitdepth;
+    state.encoder.auto_convert = 0;
+
+    std::vector<uint8_t> list_bytes(
+                lodepng_get_raw_size(width,height,&state.info_raw));
+
+    uint32_t x = 4321;
+    for(size_t i=0; i < list_bytes.size(); i++) {
+        x = x*1103515245u + 12345u;
+        size_t const col = (i/std::max(1u,bitdepth/8)) % width;
+        size_t const row = i / (list_bytes.size()/height);
+        list_bytes[i] = uint8_t(col*3 + row*5 + ((x >> 16) & 7));
+    }
+
+    if(colortype == LCT_PALETTE) {
+        for(unsigned i=0; i < 256; i++) {
+            lodepng_palette_add(&state.info_png.color,i,255-i,i/2,255);
+            lodepng_palette_add(&state.info_raw,i,255-i,i/2,255);
+        }
+    }
+
+    std::vector<uint8_t> png_data;
+    unsigned error = lodepng::encode(png_data,list_bytes,width,height,state);
+    assert(error == 0);
+    (void)error;
+
+    return png_data;
+}
+
+// Splits the IDAT chunk in two like some encoders do
+std::vector<uint8_t> split_idat(std::vector<uint8_t> const &png_data)
+{
+    std::vector<uint8_t> split(png_data.begin(),png_data.begin()+8);
+
+    uint8_t const * chunk = &(png_data[8]);
+    while(true) {
+        uint8_t const * next = lodepng_chunk_next_const(chunk);
+        if(!lodepng_chunk_type_equals(chunk,"IDAT")) {
+            split.insert(split.end(),chunk,next);
+        }
+        else {
+            uint8_t const * data = lodepng_chunk_data_const(chunk);
+            unsigned const length = lodepng_chunk_length(chunk);
+            unsigned const list_lengths[2] = { length/2, length-length/2 };
+            for(unsigned i=0; i < 2; i++) {
+                size_t const offset = split.size();
+                split.resize(offset+12+list_lengths[i]);
+                uint8_t * out = &(split[offset]);
+                for(unsigned k=0; k < 4; k++) {
+                    out[k] = uint8_t(list_lengths[i] >> (24-8*k));
+                }
+                memcpy(out+4,"IDAT",4);
+                memcpy(out+8,data+(i*list_lengths[0]),list_lengths[i]);
+                lodepng_chunk_generate_crc(out);
+            }
+        }
+        if(lodepng_chunk_type_equals(chunk,"IEND")) {
+            break;
+        }
+        chunk = next;
+    }
+
+    return split;
+}
+
+template<typename Pixel>
+bool check_png_decode(std::vector<uint8_t> const &png_data)
+{
+    using namespace ilim_detail;
+
+    png_header header;
+    if(!read_png_header(png_data,header)) {
+        return false;
+    }
+
+    size_t const count = size_t(header.width)*header.height;
+
+    std::vector<Pixel> list_rows(count);
+    ImageView<Pixel> view_rows(&(list_rows[0]),header.width,header.height);
+    bool const ok_rows = load_png(png_data,view_rows);
+
+    std::vector<Pixel> list_lodepng(count);
+    ImageView<Pixel> view_lodepng(&(list_lodepng[0]),header.width,header.height);
+    bool const ok_lodepng = decode_png_lodepng(png_data,header,view_lodepng);
+
+    return (ok_rows && ok_lodepng &&
+            (memcmp(&(list_rows[0]),&(list_lodepng[0]),sizeof(Pixel)*count) == 0));
+}
+
+// The load_png this change replaced (see the baseline
+// commit), kept here as the benchmark's reference point:
+// lodepng decodes the whole image, then png_data::assign
+// emplace_back's every pixel into a vector
+namespace baseline_png
+{
+    template<uint8_t Channels, uint8_t BitDepth>
+    struct png_data
+    {
+        template<typename Pixel>
+        static void assign(std::vector<uint8_t> const &,
+                           std::vector<Pixel> &)
+        {
+            // do nothing
+        }
+    };
+
+    template<>
+    struct png_data<3,8>
+    {
+        template<typename Pixel>
+        static void assign(std::vector<uint8_t> const &list_bytes,
+                           std::vector<Pixel> &list_pixels)
+        {
+            for(size_t i=0; i < list_bytes.size(); i+=3) {
+                list_pixels.emplace_back(Pixel {
+                    list_bytes[i+0],
+                    list_bytes[i+1],
+                    list_bytes[i+2]
+                });
+            }
+        }
+    };
+
+    template<>
+    struct png_data<4,8>
+    {
+        template<typename Pixel>
+        static void assign(std::vector<uint8_t> const &list_bytes,
+                           std::vector<Pixel> &list_pixels)
+        {
+            for(size_t i=0; i < list_bytes.size(); i+=4) {
+                list_pixels.emplace_back(Pixel {
+                    list_bytes[i+0],
+                    list_bytes[i+1],
+                    list_bytes[i+2],
+                    list_bytes[i+3]
+                });
+            }
+        }
+    };
+
+    template <typename Pixel>
+    bool load_png(std::vector<uint8_t> const &png_data,
+                  Image<Pixel> &image)
+    {
+        lodepng::State state;
+        state.info_raw.bitdepth = 8;
+        state.info_raw.colortype = LCT_RGBA;
+        bool default_convert = true;
+
+        PNGColorType src_colortype = static_cast<PNGColorType>(png_data[25]);
+        uint8_t const src_bitdepth = png_data[24];
+        uint8_t const src_channels =
+                (src_colortype == PNGColorType::GREY) ? 1 :
+                (src_colortype == PNGColorType::GREY_ALPHA) ? 2 :
+                (src_colortype == PNGColorType::RGB) ? 3 :
+                (src_colortype == PNGColorType::RGBA) ? 4 : 99;
+
+        typedef ilim_detail::png_req_format<Pixel> req_format;
+        constexpr uint8_t req_bitdepth = req_format::bitdepth;
+        constexpr uint8_t req_channels = req_format::channels;
+
+        if((src_bitdepth == req_bitdepth) &&
+           (src_channels == req_channels))
+        {
+            state.info_raw.bitdepth = src_bitdepth;
+            state.info_raw.colortype = static_cast<LodePNGColorType>(src_colortype);
+            default_convert = false;
+        }
+
+        unsigned width,height;
+        std::vector<uint8_t> list_bytes;
+        unsigned error = lodepng::decode(list_bytes,width,height,state,png_data);
+        if(error) {
+            return false;
+        }
+
+        std::vector<Pixel> list_pixels;
+        if(!default_convert) {
+            list_pixels.reserve(width*height);
+            baseline_png::png_data<req_channels,req_bitdepth>::assign(list_bytes,list_pixels);
+        }
+        else {
+            std::vector<RGBA8> list_temp_pixels;
+            list_temp_pixels.reserve(width*height);
+            baseline_png::png_data<4,8>::assign(list_bytes,list_temp_pixels);
+            ilim_detail::conv_pixels(list_temp_pixels,list_pixels);
+        }
+        image.set(width,height,std::move(list_pixels));
+        return true;
+    }
+}
+
+template<typename Pixel>
+void bench_png_decode(std::string const &desc,
+                      std::vector<uint8_t> const &png_data)
+{
+    typedef std::chrono::steady_clock clock;
+    size_t const k_runs = 20;
+
+    ilim_detail::png_header header;
+    bool ok = ilim_detail::read_png_header(png_data,header);
+
+    // peak is the most heap in use at once during the
+    // decode, including the returned image
+    double ms_baseline = std::numeric_limits<double>::max();
+    size_t peak_baseline = 0;
+    for(size_t i=0; i < k_runs; i++) {
+        size_t const heap_start = g_heap_current;
+        g_heap_peak = g_heap_current;
+        auto const start = clock::now();
+
+        Image<Pixel> image;
+        ok = baseline_png::load_png(png_data,image) && ok;
+
+        auto const end = clock::now();
+        ms_baseline = std::min(ms_baseline,std::chrono::duration<double>(end-start).count()*1000.0);
+        peak_baseline = g_heap_peak-heap_start;
+    }
+
+    double ms_rows = std::numeric_limits<double>::max();
+    size_t peak_rows = 0;
+    for(size_t i=0; i < k_runs; i++) {
+        size_t const heap_start = g_heap_current;
+        g_heap_peak = g_heap_current;
+        auto const start = clock::now();
+
+        Image<Pixel> image;
+        ok = load_png(png_data,image) && ok;
+
+        auto const end = clock::now();
+        ms_rows = std::min(ms_rows,std::chrono::duration<double>(end-start).count()*1000.0);
+        peak_rows = g_heap_peak-heap_start;
+    }
+
+    // inflating and unfiltering the whole image with lodepng,
+    // without any conversion, for scale
+    double ms_inflate = std::numeric_limits<double>::max();
+    for(size_t i=0; i < k_runs; i++) {
+        auto const start = clock::now();
+
+        unsigned width,height;
+        std::vector<uint8_t> list_bytes;
+        lodepng::State state;
+        state.info_raw.colortype = static_cast<LodePNGColorType>(png_data[25]);
+        state.info_raw.bitdepth = png_data[24];
+        ok = (lodepng::decode(list_bytes,width,height,state,png_data) == 0) && ok;
+
+        auto const end = clock::now();
+        ms_inflate = std::min(ms_inflate,std::chrono::duration<double>(end-start).count()*1000.0);
+    }
+
+    std::cout << "  " << desc << " " << header.width << "x" << header.height
+              << ": baseline: " << ms_baseline << "ms, "
+              << peak_baseline/1024 << "KB peak"
+              << ", direct: " << ms_rows << "ms, "
+              << peak_rows/1024 << "KB peak"
+              << " (lodepng decode alone: " << ms_inflate << "ms)"
+              << (ok ? " [ok]" : " [err]") << std::endl;
+
+    assert(ok);
+}
+
+void test_png_decode()
+{
+    // the direct row decode must match lodepng
+    // for every format it handles
+    struct TestPng {
+        LodePNGColorType colortype;
+        unsigned bitdepth;
+    };
+    std::vector<TestPng> const list_test_pngs = {
+        {LCT_GREY,8}, {LCT_GREY,16},
+        {LCT_GREY_ALPHA,8}, {LCT_GREY_ALPHA,16},
+        {LCT_RGB,8}, {LCT_RGB,16},
+        {LCT_RGBA,8}, {LCT_RGBA,16},
+        {LCT_GREY,4}, {LCT_PALETTE,8} // unsupported, use lodepng
+    };
+
+    for(auto const &test_png : list_test_pngs) {
+        for(int split=0; split < 2; split++) {
+            std::vector<uint8_t> png_data =
+                    encode_test_png(67,33,test_png.colortype,test_png.bitdepth);
+            if(split) {
+                png_data = split_idat(png_data);
+            }
+
+            bool const ok =
+                    check_png_decode<R8>(png_data) &&
+                    check_png_decode<R16>(png_data) &&
+                    check_png_decode<RGB8>(png_data) &&
+                    check_png_decode<RGB32F>(png_data) &&
+                    check_png_decode<RGBA8>(png_data) &&
+                    check_png_decode<RGBA16>(png_data) &&
+                    check_png_decode<RGBA32F>(png_data);
+            assert(ok);
+            (void)ok;
+        }
+    }
+
+    // corrupt data is an error rather than a crash
+    std::vector<uint8_t> png_data = encode_test_png(16,16,LCT_RGBA,8);
+    png_data[png_data.size()-20] ^= 0xFF;
+    Image<RGBA8> image;
+    bool const ok = load_png(png_data,image);
+    assert(!ok);
+    (void)ok;
+
+    std::cout << "test_png_decode (256x256 tile)..." << std::endl;
+
+    bench_png_decode<RGBA8>("RGBA8 png -> RGBA8",encode_test_png(256,256,LCT_RGBA,8));
+    bench_png_decode<RGB8>("RGB8 png -> RGB8",encode_test_png(256,256,LCT_RGB,8));
+    bench_png_decode<RGBA8>("RGB8 png -> RGBA8",encode_test_png(256,256,LCT_RGB,8));
+    bench_png_decode<RGBA32F>("RGBA8 png -> RGBA32F",encode_test_png(256,256,LCT_RGBA,8));
+
+    std::cout << "test_png_decode... [ok]" << std::endl;
+}
+
+// Straightforward box filter over C channels of T
+// to check build_mip_chain against
+template<typename T, size_t C>
+std::vector<T> ref_downsample(std::vector<T> const &list_src,
+                              uint32_t width,
+                              uint32_t height)
+{
+    uint32_t const dst_width = std::max<uint32_t>(1,width/2);
+    uint32_t const dst_height = std::max<uint32_t>(1,height/2);
+    std::vector<T> list_dst(size_t(dst_width)*dst_height*C);
+
+    for(uint32_t y=0; y < dst_height; y++) {
+        for(uint32_t x=0; x < dst_width; x++) {
+            uint32_t const x0 = std::min(2*x,width-1);
+            uint32_t const x1 = std::min(2*x+1,width-1);
+            uint32_t const y0 = std::min(2*y,height-1);
+            uint32_t const y1 = std::min(2*y+1,height-1);
+            for(size_t c=0; c < C; c++) {
+                double sum =
+                        double(list_src[(size_t(y0)*width+x0)*C+c]) +
+                        double(list_src[(size_t(y0)*width+x1)*C+c]) +
+                        double(list_src[(size_t(y1)*width+x0)*C+c]) +
+                        double(list_src[(size_t(y1)*width+x1)*C+c]);
+                T value;
+                if(std::numeric_limits<T>::is_integer) {
+                    value = T((uint64_t(sum)+2)/4);
+                }
+                else {
+                    // same order of operations as the filter
+                    value = ((list_src[(size_t(y0)*width+x0)*C+c] +
+                              list_src[(size_t(y0)*width+x1)*C+c] +
+                              list_src[(size_t(y1)*width+x0)*C+c] +
+                              list_src[(size_t(y1)*width+x1)*C+c])*T(0.25));
+                }
+                list_dst[(size_t(y)*dst_width+x)*C+c] = value;
+            }
+        }
+    }
+
+    return list_dst;
+}
+
+template<typename Pixel>
+bool check_mip_chain(uint32_t width, uint32_t height)
+{
+    typedef decltype(Pixel::r) T;
+    size_t const C = sizeof(Pixel)/sizeof(T);
+
+    std::vector<T> list_channels(size_t(width)*height*C);
+    uint32_t x = 777;
+    for(auto &channel : list_channels) {
+        x = x*1103515245u + 12345u;
+        channel = std::numeric_limits<T>::is_integer ?
+                    T(x >> 8) : T((x >> 8) & 0xFFFF)/T(65535);
+    }
+
+    Image<Pixel> image;
+    image.set(width,height,std::vector<Pixel>(
+                  reinterpret_cast<Pixel*>(&(list_channels[0])),
+                  reinterpret_cast<Pixel*>(&(list_channels[0]))+size_t(width)*height));
+
+    std::vector<Image<Pixel>> list_levels = build_mip_chain(image);
+
+    bool ok = true;
+    uint32_t level_width = width;
+    uint32_t level_height = height;
+    for(auto &level : list_levels) {
+        list_channels = ref_downsample<T,C>(list_channels,level_width,level_height);
+        level_width = std::max<uint32_t>(1,level_width/2);
+        level_height = std::max<uint32_t>(1,level_height/2);
+
+        ok = ok &&
+                (level.width() == level_width) &&
+                (level.height() == level_height) &&
+                (memcmp(&(level.data()[0]),&(list_channels[0]),
+                        sizeof(T)*list_channels.size()) == 0);
+    }
+
+    return ok && (level_width == 1) && (level_height == 1);
+}
+
+void test_mip_chain()
+{
+    // odd sizes, thin images and widths that leave
+    // tails for the vector loops
+    uint32_t const list_sizes[][2] = {
+        {37,21}, {64,64}, {1,9}, {13,1}, {2,2}, {1,1}
+    };
 
-    std::vector<RGB8> list_src;
-    list_src.reserve(500*500);
+    for(auto const &size : list_sizes) {
+        bool const ok =
+                check_mip_chain<R8>(size[0],size[1]) &&
+                check_mip_chain<R16>(size[0],size[1]) &&
+                check_mip_chain<R32>(size[0],size[1]) &&
+                check_mip_chain<RGB8>(size[0],size[1]) &&
+                check_mip_chain<RGBA8>(size[0],size[1]) &&
+                check_mip_chain<RGBA16>(size[0],size[1]) &&
+                check_mip_chain<RGB32F>(size[0],size[1]) &&
+                check_mip_chain<RGBA32F>(size[0],size[1]) &&
+                check_mip_chain<RGBA64F>(size[0],size[1]);
+        assert(ok);
+        (void)ok;
+    }
 
-    for(size_t i=0; i < 500; i++) {
-        for(size_t j=0; j < 500; j++) {
-            uint8_t val = static_cast<uint8_t>(j);
-            list_src.emplace_back(RGB8{val,val,val});
+    // black and white checkerboard: a box filter gives
+    // 128, linear light 50% grey is 188 in sRGB
+    Image<RGBA8> checker;
+    checker.set(2,2,std::vector<RGBA8>{
+                    RGBA8{0,0,0,0}, RGBA8{255,255,255,255},
+                    RGBA8{255,255,255,255}, RGBA8{0,0,0,0}});
+
+    std::vector<Image<RGBA8>> list_box = build_mip_chain(checker,MipFilter::BOX);
+    std::vector<Image<RGBA8>> list_gamma = build_mip_chain(checker,MipFilter::GAMMA);
+    assert(list_box.size() == 1 && list_gamma.size() == 1);
+    assert(list_box[0].data()[0].r == 128 && list_box[0].data()[0].a == 128);
+    assert(list_gamma[0].data()[0].r == 188 && list_gamma[0].data()[0].a == 128);
+
+    Image<RGBA16> checker16;
+    checker16.set(2,1,std::vector<RGBA16>{
+                      RGBA16{0,0,0,0}, RGBA16{65535,65535,65535,65535}});
+    std::vector<Image<RGBA16>> list_gamma16 = build_mip_chain(checker16,MipFilter::GAMMA);
+    assert(list_gamma16[0].data()[0].r/256 == 188 && list_gamma16[0].data()[0].a == 32768);
+
+    Image<RGB565> checker565;
+    RGB565 black,white;
+    black.r = 0; black.g = 0; black.b = 0;
+    white.r = 31; white.g = 63; white.b = 31;
+    checker565.set(1,2,std::vector<RGB565>{black,white});
+    std::vector<Image<RGB565>> list_box565 = build_mip_chain(checker565);
+    std::vector<Image<RGB565>> list_gamma565 = build_mip_chain(checker565,MipFilter::GAMMA);
+    assert(list_box565[0].data()[0].r == 16 && list_box565[0].data()[0].g == 32);
+    assert(list_gamma565[0].data()[0].r == 23 && list_gamma565[0].data()[0].g == 46);
+    (void)list_box; (void)list_gamma; (void)list_gamma16;
+    (void)list_box565; (void)list_gamma565;
+
+    // splitting rows up gives the same levels
+    Image<RGBA8> image;
+    {
+        std::vector<RGBA8> list_pixels(1024*512);
+        uint32_t x = 99;
+        for(auto &pixel : list_pixels) {
+            x = x*1103515245u + 12345u;
+            pixel = RGBA8{uint8_t(x >> 24),uint8_t(x >> 16),uint8_t(x >> 8),255};
         }
+        image.set(1024,512,std::move(list_pixels));
     }
 
-    // manual
-    auto const us_div = ilim_detail::ct_ui_pow(2,8)-1;
-    auto const us_mul = ilim_detail::ct_ui_pow(2,16)-1;
+    size_t range_count=0;
+    std::vector<Image<RGBA8>> list_split = build_mip_chain(
+                image,MipFilter::GAMMA,
+                [&](size_t begin, size_t end,
+                    std::function<void(size_t,size_t)> const &fn) {
+                    // backwards in small ranges
+                    for(size_t range_end=end; range_end > begin; ) {
+                        size_t const range_begin =
+                                (range_end-begin > 7) ? (range_end-7) : begin;
+                        fn(range_begin,range_end);
+                        range_end = range_begin;
+                        range_count++;
+                    }
+                });
+    std::vector<Image<RGBA8>> list_serial = build_mip_chain(image,MipFilter::GAMMA);
+
+    assert(range_count > 0 && list_split.size() == list_serial.size());
+    for(size_t i=0; i < list_split.size(); i++) {
+        assert(memcmp(&(list_split[i].data()[0]),&(list_serial[i].data()[0]),
+                      sizeof(RGBA8)*list_serial[i].data().size()) == 0);
+    }
 
-    start = std::chrono::system_clock::now();
-    std::vector<RGBA16> list_dst;
-    list_dst.reserve(list_src.size());
-    for(auto const &src : list_src) {
-        RGBA16 dst;
-        dst.r = (us_mul/us_div)*src.r;
-        dst.g = (us_mul/us_div)*src.g;
-        dst.b = (us_mul/us_div)*src.b;
-        dst.a = 1;
+    // timing: full chain of a 2048x2048 RGBA8 atlas
+    typedef std::chrono::steady_clock clock;
+    Image<RGBA8> atlas;
+    {
+        std::vector<RGBA8> list_pixels(2048*2048);
+        uint32_t x = 5;
+        for(auto &pixel : list_pixels) {
+            x = x*1103515245u + 12345u;
+            pixel = RGBA8{uint8_t(x >> 24),uint8_t(x >> 16),uint8_t(x >> 8),uint8_t(x >> 4)};
+        }
+        atlas.set(2048,2048,std::move(list_pixels));
+    }
 
-        list_dst.push_back(dst);
+    double ms_ref = std::numeric_limits<double>::max();
+    double ms_box = std::numeric_limits<double>::max();
+    double ms_gamma = std::numeric_limits<double>::max();
+    for(size_t run=0; run < 3; run++) {
+        auto start = clock::now();
+        std::vector<uint8_t> list_channels(
+                    reinterpret_cast<uint8_t const*>(&(atlas.data()[0])),
+                    reinterpret_cast<uint8_t const*>(&(atlas.data()[0]))+2048*2048*4);
+        for(uint32_t size=2048; size > 1; size /= 2) {
+            list_channels = ref_downsample<uint8_t,4>(list_channels,size,size);
+        }
+        auto end = clock::now();
+        ms_ref = std::min(ms_ref,std::chrono::duration<double>(end-start).count()*1000.0);
+
+        start = clock::now();
+        std::vector<Image<RGBA8>> list_levels = build_mip_chain(atlas,MipFilter::BOX);
+        end = clock::now();
+        ms_box = std::min(ms_box,std::chrono::duration<double>(end-start).count()*1000.0);
+
+        start = clock::now();
+        list_levels = build_mip_chain(atlas,MipFilter::GAMMA);
+        end = clock::now();
+        ms_gamma = std::min(ms_gamma,std::chrono::duration<double>(end-start).count()*1000.0);
     }
-    end = std::chrono::system_clock::now();
-    double elapsedms_manual = std::chrono::duration<double>(end-start).count()*1000.0;
-    std::cout << "manual conv took: " << elapsedms_manual << "ms" << std::endl;
 
-    start = std::chrono::system_clock::now();
-    ilim_detail::conv_pixels(list_src,list_dst);
-    end = std::chrono::system_clock::now();
+    std::cout << "test_mip_chain (" << get_simd_name() << ", 2048x2048 RGBA8): "
+              << "reference: " << ms_ref << "ms"
+              << ", box: " << ms_box << "ms"
+              << ", gamma: " << ms_gamma << "ms" << std::endl;
+
+    std::cout << "test_mip_chain... [ok]" << std::endl;
+}
+
+// synthetic map tile: smooth land/water gradients, a few
+// hard edged roads and labels, and an alpha ramp with a
+// transparent cutout
+Image<RGBA8> make_test_tile(uint32_t width, uint32_t height)
+{
+    std::vector<RGBA8> list_pixels(width*height);
+    uint32_t noise = 7;
+    for(uint32_t y=0; y < height; y++) {
+        for(uint32_t x=0; x < width; x++) {
+            noise = noise*1103515245u + 12345u;
+            int const n = int((noise >> 24) & 7)-4;
+
+            bool const water = (x+y/2 < width*2/3);
+            RGBA8 px = water ?
+                    RGBA8{uint8_t(110+n),uint8_t(160+y*40/height),uint8_t(220-x*30/width),255} :
+                    RGBA8{uint8_t(232-y*20/height+n),uint8_t(228+n),uint8_t(205+x*20/width),255};
+
+            if((x/3)%29 == 5 || (y+x/4)%41 < 3) {
+                px = RGBA8{255,250,225,255}; // road
+            }
+            if(x > width/2 && y > height/2 && ((x*7+y*3)/5)%11 < 2) {
+                px = RGBA8{40,40,48,255}; // label
+            }
+
+            px.a = uint8_t(std::min(255,int(y*255/std::max(1u,height-1))+64+n*3));
+            if(x < width/8 && y < height/8) {
+                px.a = 0;
+            }
+            list_pixels[y*width+x] = px;
+        }
+    }
+
+    Image<RGBA8> image;
+    image.set(width,height,std::move(list_pixels));
+    return image;
+}
+
+// color is only compared where a is opaque when
+// skip_transparent is set (ie. BC1's 1 bit alpha)
+double calc_psnr(Image<RGBA8> const &a,
+                 Image<RGBA8> const &b,
+                 bool alpha,
+                 bool skip_transparent=false)
+{
+    double sum=0;
+    size_t count=0;
+    for(size_t i=0; i < a.data().size(); i++) {
+        RGBA8 const &pa = a.data()[i];
+        RGBA8 const &pb = b.data()[i];
+        if(skip_transparent && pa.a < 128) {
+            continue;
+        }
+        if(alpha) {
+            double const d = double(pa.a)-pb.a;
+            sum += d*d;
+            count++;
+        }
+        else {
+            double const list_d[3] = {
+                double(pa.r)-pb.r, double(pa.g)-pb.g, double(pa.b)-pb.b
+            };
+            for(double d : list_d) {
+                sum += d*d;
+                count++;
+            }
+        }
+    }
+    if(sum == 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return 10.0*std::log10(255.0*255.0*count/sum);
+}
+
+void test_block_compress()
+{
+    typedef std::chrono::steady_clock clock;
+
+    struct format_desc {
+        BlockFormat format;
+        char const * name;
+        bool has_alpha;
+        double min_psnr_rgb;
+        double min_psnr_alpha;
+    };
+
+    format_desc const list_formats[] = {
+        {BlockFormat::BC1,"BC1",false,29.0,0.0},
+        {BlockFormat::BC3,"BC3",true,29.0,35.0},
+        {BlockFormat::ETC1,"ETC1",false,26.0,0.0},
+        {BlockFormat::ETC2_RGB,"ETC2_RGB",false,26.0,0.0},
+        {BlockFormat::ETC2_RGBA,"ETC2_RGBA",true,26.0,35.0}
+    };
+
+    // flat blocks come back exactly for the alpha
+    // formats and within quantization error for color
+    {
+        Image<RGBA8> flat;
+        flat.set(4,4,std::vector<RGBA8>(16,RGBA8{200,100,50,160}));
+        for(auto const &desc : list_formats) {
+            std::vector<uint8_t> list_blocks;
+            compress_image(flat.view(),desc.format,BlockQuality::FAST,list_blocks);
+            assert(list_blocks.size() == get_block_bytes(desc.format));
+
+            Image<RGBA8> decoded;
+            decoded.set(4,4,std::vector<RGBA8>(16));
+            bool const ok = decompress_image(list_blocks,desc.format,decoded.view());
+            assert(ok);
+            (void)ok;
+            for(RGBA8 const &px : decoded.data()) {
+                assert(std::abs(int(px.r)-200) <= 4 &&
+                       std::abs(int(px.g)-100) <= 4 &&
+                       std::abs(int(px.b)-50) <= 4);
+                assert(!desc.has_alpha || px.a == 160);
+                (void)px;
+            }
+        }
+    }
+
+    // BC1 keeps fully transparent pixels transparent
+    {
+        Image<RGBA8> cutout = make_test_tile(16,16);
+        std::vector<uint8_t> list_blocks;
+        compress_image(cutout.view(),BlockFormat::BC1,BlockQuality::BEST,list_blocks);
+        Image<RGBA8> decoded;
+        decoded.set(16,16,std::vector<RGBA8>(16*16));
+        decompress_image(list_blocks,BlockFormat::BC1,decoded.view());
+        for(size_t i=0; i < decoded.data().size(); i++) {
+            assert((cutout.data()[i].a < 128) == (decoded.data()[i].a == 0));
+        }
+    }
+
+    // ETC2 picks planar blocks for smooth gradients: a block
+    // that is exactly a planar color decodes exactly, ETC1
+    // can't read it, and a gradient image comes out better
+    // than with ETC1
+    {
+        int const list_q[3][3] = { {10,20,30}, {40,100,50}, {5,90,60} };
+        int const list_bits[3] = {6,7,6};
+        Image<RGBA8> plane;
+        plane.set(4,4,std::vector<RGBA8>(16));
+        for(int y=0; y < 4; y++) {
+            for(int x=0; x < 4; x++) {
+                int rgb[3];
+                for(int c=0; c < 3; c++) {
+                    int const q[3] = { list_q[0][c], list_q[1][c], list_q[2][c] };
+                    rgb[c] = ilim_detail::etc_planar_value(q,list_bits[c],x,y);
+                }
+                plane.data()[y*4+x] = RGBA8{uint8_t(rgb[0]),uint8_t(rgb[1]),uint8_t(rgb[2]),255};
+            }
+        }
+
+        std::vector<uint8_t> list_blocks;
+        compress_image(plane.view(),BlockFormat::ETC2_RGB,BlockQuality::BEST,list_blocks);
+        Image<RGBA8> decoded;
+        decoded.set(4,4,std::vector<RGBA8>(16));
+        bool ok = decompress_image(list_blocks,BlockFormat::ETC2_RGB,decoded.view());
+        assert(ok);
+        assert(calc_psnr(plane,decoded,false) == std::numeric_limits<double>::infinity());
+        ok = decompress_image(list_blocks,BlockFormat::ETC1,decoded.view());
+        assert(!ok);
+        (void)ok;
+
+        uint32_t const size = 64;
+        Image<RGBA8> gradient;
+        gradient.set(size,size,std::vector<RGBA8>(size*size));
+        for(uint32_t y=0; y < size; y++) {
+            for(uint32_t x=0; x < size; x++) {
+                gradient.data()[y*size+x] = RGBA8{
+                        uint8_t(x*255/(size-1)),
+                        uint8_t(y*255/(size-1)),
+                        uint8_t((x+y)*255/(2*size-2)),
+                        255};
+            }
+        }
+
+        double list_psnr[2];
+        BlockFormat const list_format[2] = { BlockFormat::ETC1, BlockFormat::ETC2_RGB };
+        for(int i=0; i < 2; i++) {
+            compress_image(gradient.view(),list_format[i],BlockQuality::FAST,list_blocks);
+            decoded.set(size,size,std::vector<RGBA8>(size*size));
+            decompress_image(list_blocks,list_format[i],decoded.view());
+            list_psnr[i] = calc_psnr(gradient,decoded,false);
+        }
+        std::cout << "test_block_compress (gradient 64x64): "
+                  << "ETC1: " << list_psnr[0] << "dB"
+                  << ", ETC2_RGB: " << list_psnr[1] << "dB" << std::endl;
+        assert(list_psnr[1] > list_psnr[0]+3.0);
+    }
+
+    // quality against the source; odd sizes pad the edges
+    uint32_t const list_sizes[][2] = { {256,256}, {37,21} };
+    for(auto const &size : list_sizes) {
+        Image<RGBA8> source = make_test_tile(size[0],size[1]);
+
+        for(auto const &desc : list_formats) {
+            double list_psnr_rgb[2];
+            double list_psnr_alpha[2];
+            double list_ms[2];
+
+            BlockQuality const list_quality[2] = { BlockQuality::FAST, BlockQuality::BEST };
+            for(size_t q=0; q < 2; q++) {
+                std::vector<uint8_t> list_blocks;
+                auto const start = clock::now();
+                compress_image(source.view(),desc.format,list_quality[q],list_blocks);
+                auto const end = clock::now();
+                list_ms[q] = std::chrono::duration<double>(end-start).count()*1000.0;
+                assert(list_blocks.size() == calc_compressed_size(desc.format,size[0],size[1]));
+
+                Image<RGBA8> decoded;
+                decoded.set(size[0],size[1],std::vector<RGBA8>(size[0]*size[1]));
+                bool const ok = decompress_image(list_blocks,desc.format,decoded.view());
+                assert(ok);
+                (void)ok;
+
+                list_psnr_rgb[q] = calc_psnr(source,decoded,false,
+                                             desc.format == BlockFormat::BC1);
+                list_psnr_alpha[q] = calc_psnr(source,decoded,true);
+                assert(list_psnr_rgb[q] >= desc.min_psnr_rgb);
+                assert(!desc.has_alpha || list_psnr_alpha[q] >= desc.min_psnr_alpha);
+            }
+
+            // BEST searches a superset of FAST
+            assert(list_psnr_rgb[1] >= list_psnr_rgb[0]-0.01);
+            assert(!desc.has_alpha || list_psnr_alpha[1] >= list_psnr_alpha[0]-0.01);
+
+            if(size[0] == 256) {
+                std::cout << "test_block_compress (" << desc.name << ", 256x256): "
+                          << "fast: " << list_psnr_rgb[0] << "dB";
+                if(desc.has_alpha) {
+                    std::cout << " (a: " << list_psnr_alpha[0] << "dB)";
+                }
+                std::cout << " " << list_ms[0] << "ms"
+                          << ", best: " << list_psnr_rgb[1] << "dB";
+                if(desc.has_alpha) {
+                    std::cout << " (a: " << list_psnr_alpha[1] << "dB)";
+                }
+                std::cout << " " << list_ms[1] << "ms" << std::endl;
+            }
+        }
+    }
 
-    double elapsedms_auto = std::chrono::duration<double>(end-start).count()*1000.0;
-    std::cout << "auto conv took: " << elapsedms_auto << "ms" << std::endl;
+    std::cout << "test_block_compress... [ok]" << std::endl;
 }
 
 void test_png_format()
@@ -853,6 +1910,12 @@ int main()
 //    test_channel_downsample();
 //    test_channel_upsample();
 
+    test_speed();
+    test_conv_saturate();
+    test_image_view();
+    test_png_decode();
+    test_mip_chain();
+    test_block_compress();
     test_png_format();
 
     Image<R8> image;
@@ -4,8 +4,19 @@ CONFIG      -= qt
 
 INCLUDEPATH += $${PWD}
 
+HEADERS += lodepng/lodepng.h
+SOURCES += lodepng/lodepng.cpp
+
 SOURCES += test_ilim.cpp
 
+# ilim_conv.hpp picks its kernels from the target flags,
+# ie. enable AVX2 (SSE2 is the x86-64 default)
+# QMAKE_CXXFLAGS += -mavx2
+
+# lets test_ilim count lodepng's allocations for the
+# png decode benchmark
+DEFINES += LODEPNG_NO_COMPILE_ALLOCATORS
+
 # need these flags for gcc 4.8.x bug for threads
 # QMAKE_LFLAGS += -Wl,--no-as-needed
 # LIBS += -lpthread
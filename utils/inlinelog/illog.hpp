@@ -44,8 +44,18 @@
 #include <vector>
 #include <array>
 #include <ctime>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
 #include <mutex>
-#include <bitset>
+#include <condition_variable>
+#include <thread>
+#include <limits>
+#include <type_traits>
+
+#include <RecordRing.h>
 
 namespace illog
 {
@@ -55,6 +65,401 @@ namespace illog
         virtual void log(std::string const &line)=0;
     };
 
+    // receives binary lines (see Log::log_binary) as a byte
+    // stream that decode_binary_log turns back into text,
+    // ie. offline with the illog_decode tool
+    class BinarySink
+    {
+    public:
+        virtual ~BinarySink() {}
+        virtual void write(char const * data, size_t size)=0;
+    };
+
+    // a call site of Log::log_binary; keep it static so the
+    // format string is only registered once, see ILLOG_BIN
+    struct FormatSite
+    {
+        constexpr FormatSite() :
+            id(0)
+        {
+            // empty
+        }
+
+        std::atomic<uint32_t> id;
+    };
+
+    // settings for Log::enable_async
+    struct AsyncOptions
+    {
+        enum class Overflow : uint8_t
+        {
+            DROP,   // discard (and count) lines that don't fit
+            BLOCK   // wait for the drain thread to make room
+        };
+
+        // size of each logging thread's ring buffer in bytes,
+        // rounded up to a power of two
+        size_t buffer_size = 64*1024;
+
+        Overflow overflow = Overflow::BLOCK;
+
+        // the drain thread writes out lines at least this
+        // often, and sooner when a buffer gets half full
+        std::chrono::milliseconds drain_interval{20};
+    };
+
+    namespace illog_detail
+    {
+        using scratch::RecordRing;
+
+        // record tags in a RecordRing; binary records
+        // are [format id:4][level:1][args]
+        uint8_t const k_record_text = 0;
+        uint8_t const k_record_binary = 1;
+
+        typedef std::vector<std::pair<uint64_t,std::shared_ptr<RecordRing>>> ThreadRings;
+
+        // each thread's rings, keyed by the id of the
+        // Log they belong to
+        inline ThreadRings & get_thread_rings()
+        {
+            static thread_local ThreadRings list_rings;
+            return list_rings;
+        }
+
+        inline uint64_t next_async_log_id()
+        {
+            static std::atomic<uint64_t> id(0);
+            return ++id;
+        }
+
+        // ============================================================= //
+
+        // Binary lines
+        // * arguments are stored raw: integers widened to 64
+        //   bits, floats to double, strings as [size:4][chars]
+        // * format strings are registered once per call site
+        //   and referred to by id; "{}" marks an argument
+
+        enum class ArgType : uint8_t
+        {
+            I64 = 0,
+            U64 = 1,
+            F64 = 2,
+            STR = 3
+        };
+
+        struct FormatDef
+        {
+            std::string fmt;
+            std::vector<ArgType> list_types;
+        };
+
+        struct FormatRegistry
+        {
+            std::mutex mutex;
+            std::vector<FormatDef> list_defs; // id-1
+        };
+
+        inline FormatRegistry & get_format_registry()
+        {
+            static FormatRegistry registry;
+            return registry;
+        }
+
+        template<typename T, typename Enable=void>
+        struct arg_traits;
+
+        template<typename T>
+        struct arg_traits<T,typename std::enable_if<
+                std::is_integral<T>::value && std::is_signed<T>::value>::type>
+        {
+            static ArgType const type = ArgType::I64;
+            static void append(std::string &buffer, T val)
+            {
+                int64_t const v = val;
+                buffer.append(reinterpret_cast<char const*>(&v),8);
+            }
+        };
+
+        template<typename T>
+        struct arg_traits<T,typename std::enable_if<
+                std::is_integral<T>::value && std::is_unsigned<T>::value>::type>
+        {
+            static ArgType const type = ArgType::U64;
+            static void append(std::string &buffer, T val)
+            {
+                uint64_t const v = val;
+                buffer.append(reinterpret_cast<char const*>(&v),8);
+            }
+        };
+
+        template<typename T>
+        struct arg_traits<T,typename std::enable_if<
+                std::is_floating_point<T>::value>::type>
+        {
+            static ArgType const type = ArgType::F64;
+            static void append(std::string &buffer, T val)
+            {
+                double const v = val;
+                buffer.append(reinterpret_cast<char const*>(&v),8);
+            }
+        };
+
+        inline void append_str(std::string &buffer, char const * str, size_t size)
+        {
+            uint32_t const v = uint32_t(size);
+            buffer.append(reinterpret_cast<char const*>(&v),4);
+            buffer.append(str,size);
+        }
+
+        template<>
+        struct arg_traits<char const *>
+        {
+            static ArgType const type = ArgType::STR;
+            static void append(std::string &buffer, char const * val)
+            {
+                append_str(buffer,val,std::strlen(val));
+            }
+        };
+
+        template<>
+        struct arg_traits<char *> : arg_traits<char const *> {};
+
+        template<>
+        struct arg_traits<std::string>
+        {
+            static ArgType const type = ArgType::STR;
+            static void append(std::string &buffer, std::string const &val)
+            {
+                append_str(buffer,val.data(),val.size());
+            }
+        };
+
+        template<typename T>
+        using arg_traits_of = arg_traits<typename std::decay<T>::type>;
+
+        inline void append_args(std::string &)
+        {
+            // end
+        }
+
+        template<typename T, typename... Args>
+        void append_args(std::string &buffer, T const &arg, Args const &... args)
+        {
+            arg_traits_of<T>::append(buffer,arg);
+            append_args(buffer,args...);
+        }
+
+        template<typename... Args>
+        uint32_t register_format(FormatSite &site, char const * fmt)
+        {
+            FormatRegistry &registry = get_format_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+
+            // another thread may have got here first
+            uint32_t id = site.id.load(std::memory_order_relaxed);
+            if(id == 0) {
+                FormatDef def;
+                def.fmt = fmt;
+                def.list_types = { arg_traits_of<Args>::type... };
+                registry.list_defs.push_back(std::move(def));
+                id = uint32_t(registry.list_defs.size());
+                site.id.store(id,std::memory_order_release);
+            }
+            return id;
+        }
+
+        // Replaces each {} in the format with the next argument,
+        // formatted like Log::Line does. Returns false if args
+        // is too short for the argument types
+        inline bool format_binary(FormatDef const &def,
+                                  char const * args,
+                                  size_t args_size,
+                                  std::string &line)
+        {
+            size_t arg_idx=0;
+            size_t pos=0;
+            std::string const &fmt = def.fmt;
+            while(pos < fmt.size()) {
+                size_t const next = fmt.find("{}",pos);
+                if(next == std::string::npos || arg_idx == def.list_types.size()) {
+                    line.append(fmt,pos,std::string::npos);
+                    break;
+                }
+                line.append(fmt,pos,next-pos);
+                pos = next+2;
+
+                ArgType const type = def.list_types[arg_idx++];
+                size_t const fixed_size = (type == ArgType::STR) ? 4 : 8;
+                if(args_size < fixed_size) {
+                    return false;
+                }
+
+                if(type == ArgType::STR) {
+                    uint32_t size;
+                    std::memcpy(&size,args,4);
+                    if(args_size-4 < size) {
+                        return false;
+                    }
+                    line.append(args+4,size);
+                    args += 4+size;
+                    args_size -= 4+size;
+                    continue;
+                }
+
+                if(type == ArgType::I64) {
+                    int64_t v;
+                    std::memcpy(&v,args,8);
+                    line.append(std::to_string(v));
+                }
+                else if(type == ArgType::U64) {
+                    uint64_t v;
+                    std::memcpy(&v,args,8);
+                    line.append(std::to_string(v));
+                }
+                else {
+                    double v;
+                    std::memcpy(&v,args,8);
+                    line.append(std::to_string(v));
+                }
+                args += 8;
+                args_size -= 8;
+            }
+            return true;
+        }
+
+        // 00:00:00.000 (hours wrap at 100)
+        inline void format_run_time(uint64_t ns, std::string &time_str)
+        {
+            uint64_t const ms_total = ns/1000000;
+            uint64_t const ms = ms_total%1000;
+            uint64_t const secs = (ms_total/1000)%60;
+            uint64_t const mins = (ms_total/60000)%60;
+            uint64_t const hours = (ms_total/3600000)%100;
+
+            time_str.resize(12);
+            time_str[0] = char('0'+hours/10);
+            time_str[1] = char('0'+hours%10);
+            time_str[2] = ':';
+            time_str[3] = char('0'+mins/10);
+            time_str[4] = char('0'+mins%10);
+            time_str[5] = ':';
+            time_str[6] = char('0'+secs/10);
+            time_str[7] = char('0'+secs%10);
+            time_str[8] = '.';
+            time_str[9] = char('0'+ms/100);
+            time_str[10] = char('0'+(ms%100)/10);
+            time_str[11] = char('0'+ms%10);
+        }
+
+        // Binary stream written to a BinarySink:
+        // * "ILLOGBIN" once at the start
+        // * 'F' [id:4][type count:1][types][fmt size:4][fmt]
+        //   before the first record that uses a format
+        // * 'R' [time_ns:8][id:4][level:1][args size:4][args]
+        //   with time since the Log was created
+        static char const k_binary_magic[8] = {'I','L','L','O','G','B','I','N'};
+
+        inline void append_u32(std::string &buffer, uint32_t v)
+        {
+            buffer.append(reinterpret_cast<char const*>(&v),4);
+        }
+
+        // where log_binary packs the args of a line
+        inline std::string & get_thread_buffer()
+        {
+            static thread_local std::string buffer;
+            return buffer;
+        }
+    }
+
+    // Decodes a stream written to a BinarySink into lines of
+    // [00:00:00.000] [LEVEL] message, returns false if the
+    // stream is not valid (lines before the error are kept)
+    inline bool decode_binary_log(char const * data,
+                                  size_t size,
+                                  std::vector<std::string> &list_lines)
+    {
+        using namespace illog_detail;
+        static char const * const k_level_names[6] = {
+            "TRACE","DEBUG","INFO","WARN","ERROR","FATAL"
+        };
+
+        if(size < 8 || std::memcmp(data,k_binary_magic,8) != 0) {
+            return false;
+        }
+
+        std::vector<FormatDef> list_defs;
+        std::string time_str;
+        size_t pos=8;
+        while(pos < size) {
+            char const tag = data[pos++];
+            if(tag == 'F') {
+                uint32_t id;
+                if(size-pos < 5) {
+                    return false;
+                }
+                std::memcpy(&id,data+pos,4);
+                uint8_t const type_count = uint8_t(data[pos+4]);
+                pos += 5;
+
+                if(size-pos < size_t(type_count)+4) {
+                    return false;
+                }
+                FormatDef def;
+                for(uint8_t i=0; i < type_count; i++) {
+                    uint8_t const type = uint8_t(data[pos++]);
+                    if(type > uint8_t(ArgType::STR)) {
+                        return false;
+                    }
+                    def.list_types.push_back(ArgType(type));
+                }
+                uint32_t fmt_size;
+                std::memcpy(&fmt_size,data+pos,4);
+                pos += 4;
+                if(size-pos < fmt_size || id == 0) {
+                    return false;
+                }
+                def.fmt.assign(data+pos,fmt_size);
+                pos += fmt_size;
+
+                if(list_defs.size() < id) {
+                    list_defs.resize(id);
+                }
+                list_defs[id-1] = std::move(def);
+            }
+            else if(tag == 'R') {
+                uint64_t time_ns;
+                uint32_t id,args_size;
+                if(size-pos < 17) {
+                    return false;
+                }
+                std::memcpy(&time_ns,data+pos,8);
+                std::memcpy(&id,data+pos+8,4);
+                uint8_t const level = uint8_t(data[pos+12]);
+                std::memcpy(&args_size,data+pos+13,4);
+                pos += 17;
+                if(size-pos < args_size || id == 0 ||
+                   id > list_defs.size() || level > 5) {
+                    return false;
+                }
+
+                format_run_time(time_ns,time_str);
+                std::string line = "["+time_str+"] ["+k_level_names[level]+"] ";
+                if(!format_binary(list_defs[id-1],data+pos,args_size,line)) {
+                    return false;
+                }
+                list_lines.push_back(std::move(line));
+                pos += args_size;
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+
     class Log
     {
     public:
@@ -63,16 +468,24 @@ namespace illog
         public:
             virtual ~FormatBlock() {}
             virtual std::string get() = 0;
+
+            // for binary lines, which are formatted later on;
+            // time is when the line was logged. Only called
+            // with the Log's lock held
+            virtual std::string get_at(std::chrono::steady_clock::time_point time)
+            {
+                (void)time;
+                return get();
+            }
         };
 
-        // 00:00:00.000
+        // 00:00:00.000, get() is thread safe
         class FBRunTimeMs : public FormatBlock
         {
         public:
             FBRunTimeMs() :
-                m_time_str("00:00:00.000"),
-                m_start(std::chrono::system_clock::now()),
-                m_list_num_chars({'0','1','2','3','4','5','6','7','8','9'})
+                m_start(std::chrono::steady_clock::now()),
+                m_last_ms(std::numeric_limits<uint64_t>::max())
             {
                 // empty
             }
@@ -84,53 +497,37 @@ namespace illog
 
             std::string get()
             {
-                auto now = std::chrono::system_clock::now();
-                std::chrono::system_clock::duration elapsed = now-m_start;
-
-                std::chrono::hours hours =
-                        std::chrono::duration_cast<std::chrono::hours>(
-                            elapsed);
-                elapsed -= hours;
-
-                std::chrono::minutes mins =
-                        std::chrono::duration_cast<std::chrono::minutes>(
-                            elapsed);
-                elapsed -= mins;
+                auto const elapsed = std::chrono::steady_clock::now()-m_start;
 
-                std::chrono::seconds secs =
-                        std::chrono::duration_cast<std::chrono::seconds>(
-                            elapsed);
-                elapsed -= secs;
+                std::string time_str;
+                illog_detail::format_run_time(
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                elapsed).count(),time_str);
 
-                std::chrono::milliseconds ms =
-                        std::chrono::duration_cast<std::chrono::milliseconds>(
-                            elapsed);
-
-                uint_fast8_t const hours_count = hours.count();
-                uint_fast8_t const mins_count = mins.count();
-                uint_fast8_t const secs_count = secs.count();
-                uint_fast16_t const ms_count = ms.count();
-
-                m_time_str[0] = m_list_num_chars[hours_count/10];
-                m_time_str[1] = m_list_num_chars[hours_count%10];
-
-                m_time_str[3] = m_list_num_chars[mins_count/10];
-                m_time_str[4] = m_list_num_chars[mins_count%10];
-
-                m_time_str[6] = m_list_num_chars[secs_count/10];
-                m_time_str[7] = m_list_num_chars[secs_count%10];
+                return time_str;
+            }
 
-                m_time_str[9] = m_list_num_chars[ms_count/100];
-                m_time_str[10] = m_list_num_chars[(ms_count%100)/10];
-                m_time_str[11] = m_list_num_chars[(ms_count%100)%10];
+            std::string get_at(std::chrono::steady_clock::time_point time)
+            {
+                uint64_t const ns = (time > m_start) ?
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            time-m_start).count() : 0;
 
-                return m_time_str;
+                // lines drained together are mostly logged
+                // within the same millisecond
+                if(ns/1000000 != m_last_ms) {
+                    m_last_ms = ns/1000000;
+                    illog_detail::format_run_time(ns,m_last_str);
+                }
+                return m_last_str;
             }
 
         private:
-            std::string m_time_str;
-            std::chrono::system_clock::time_point const m_start;
-            std::array<char,10> const m_list_num_chars;
+            // steady_clock, so get and get_at agree
+            std::chrono::steady_clock::time_point const m_start;
+
+            uint64_t m_last_ms;
+            std::string m_last_str;
         };
 
         class FBCustomStr : public FormatBlock
@@ -163,11 +560,15 @@ namespace illog
             Line(std::vector<std::shared_ptr<Sink>> const * list_sinks,
                  std::vector<std::unique_ptr<FormatBlock>> const * list_fb,
                  std::mutex * mutex,
-                 bool line_valid) :
+                 bool line_valid,
+                 Log * async_log=nullptr,
+                 bool fatal=false) :
                 m_list_sinks(list_sinks),
                 m_list_fb(list_fb),
                 m_mutex(mutex),
-                m_line_valid(line_valid)
+                m_line_valid(line_valid),
+                m_async_log(async_log),
+                m_fatal(fatal)
             {
                 if(m_line_valid) {
                     // create the prefix
@@ -179,6 +580,14 @@ namespace illog
 
             ~Line()
             {
+                if(m_async_log) {
+                    // no lock was taken in async mode
+                    if(m_line_valid) {
+                        m_async_log->push_async(m_line,m_fatal);
+                    }
+                    return;
+                }
+
                 if(m_line_valid) {
                     for(auto &sink : (*m_list_sinks)) {
                         sink->log(m_line);
@@ -217,10 +626,38 @@ namespace illog
             std::vector<std::unique_ptr<FormatBlock>> const * m_list_fb;
             std::mutex * m_mutex;
             bool const m_line_valid;
+            Log * const m_async_log;
+            bool const m_fatal;
 
             std::string m_line;
         };
 
+        struct AsyncState
+        {
+            AsyncOptions options;
+            uint64_t id;
+
+            // rings of all threads that have logged; a ring
+            // whose thread has exited is only held here
+            std::mutex rings_mutex;
+            std::vector<std::shared_ptr<illog_detail::RecordRing>> list_rings;
+            uint64_t dropped_retired; // by rings no longer listed
+
+            // only one thread drains at a time (the drain
+            // thread or a caller of flush)
+            std::mutex drain_mutex;
+            std::vector<illog_detail::RecordRing::Record> list_records;
+            std::vector<size_t> list_order;
+            uint64_t dropped_reported;
+
+            std::mutex wake_mutex;
+            std::condition_variable wake_cv;
+            bool wake;
+            bool quit;
+
+            std::thread thread;
+        };
+
     public:
         enum class Level : uint8_t
         {
@@ -233,15 +670,24 @@ namespace illog
         };
 
 
-        Log()
+        Log() :
+            m_start(std::chrono::steady_clock::now()),
+            m_filter(0x3F) // default filter is all on
+        {
+            // empty
+        }
+
+        ~Log()
         {
-            // default filter is all on
-            m_filter.set(static_cast<size_t>(Level::TRACE));
-            m_filter.set(static_cast<size_t>(Level::DEBUG));
-            m_filter.set(static_cast<size_t>(Level::INFO));
-            m_filter.set(static_cast<size_t>(Level::WARN));
-            m_filter.set(static_cast<size_t>(Level::ERROR));
-            m_filter.set(static_cast<size_t>(Level::FATAL));
+            if(m_async) {
+                {
+                    std::lock_guard<std::mutex> lock(m_async->wake_mutex);
+                    m_async->quit = true;
+                }
+                m_async->wake_cv.notify_one();
+                m_async->thread.join();
+                drain_async();
+            }
         }
 
         bool add_sink(std::shared_ptr<Sink> const &new_sink)
@@ -278,16 +724,48 @@ namespace illog
             return false;
         }
 
-        void set_level(Level level)
+        bool add_binary_sink(std::shared_ptr<BinarySink> const &new_sink)
         {
             std::lock_guard<std::mutex> lock(m_mutex);
-            m_filter.set(static_cast<size_t>(level));
+
+            for(auto const &binary_sink : m_list_binary_sinks) {
+                if(binary_sink.sink == new_sink) {
+                    return false;
+                }
+            }
+
+            BinarySinkState binary_sink;
+            binary_sink.sink = new_sink;
+            binary_sink.started = false;
+            m_list_binary_sinks.push_back(std::move(binary_sink));
+
+            return true;
         }
 
-        void unset_level(Level level)
+        bool remove_binary_sink(std::shared_ptr<BinarySink> const &sink)
         {
             std::lock_guard<std::mutex> lock(m_mutex);
-            m_filter.reset(static_cast<size_t>(level));
+
+            for(auto sink_it = m_list_binary_sinks.begin();
+                sink_it != m_list_binary_sinks.end();
+                ++sink_it)
+            {
+                if(sink_it->sink == sink) {
+                    m_list_binary_sinks.erase(sink_it);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void set_level(Level level)
+        {
+            m_filter.fetch_or(uint8_t(1 << static_cast<size_t>(level)));
+        }
+
+        void unset_level(Level level)
+        {
+            m_filter.fetch_and(uint8_t(~(1 << static_cast<size_t>(level))));
         }
 
         void add_format_block(std::unique_ptr<FormatBlock> fb,
@@ -298,26 +776,461 @@ namespace illog
                         std::move(fb));
         }
 
+        // Switches to async mode: lines are formatted on
+        // the calling thread, queued in a ring buffer owned
+        // by that thread and written to the sinks by a drain
+        // thread, in time order within each drain.
+        // * fatal() lines are never dropped and are flushed
+        //   to the sinks before the call returns
+        // * format blocks are read without a lock, so add
+        //   them first and make sure get() is thread safe
+        // * call before logging from other threads
+        void enable_async(AsyncOptions const &options=AsyncOptions())
+        {
+            if(m_async) {
+                return;
+            }
+
+            m_async.reset(new AsyncState);
+            m_async->options = options;
+            m_async->id = illog_detail::next_async_log_id();
+            m_async->dropped_retired = 0;
+            m_async->dropped_reported = 0;
+            m_async->wake = false;
+            m_async->quit = false;
+
+            AsyncState * async = m_async.get();
+            m_async->thread = std::thread([this,async]() {
+                std::unique_lock<std::mutex> lock(async->wake_mutex);
+                while(!async->quit) {
+                    async->wake_cv.wait_for(lock,async->options.drain_interval,
+                                            [async]{ return async->wake || async->quit; });
+                    async->wake = false;
+
+                    lock.unlock();
+                    drain_async();
+                    lock.lock();
+                }
+            });
+        }
+
+        // writes out everything queued so far; a no-op
+        // in sync mode
+        void flush()
+        {
+            if(m_async) {
+                drain_async();
+            }
+        }
+
+        // number of lines discarded with Overflow::DROP
+        uint64_t get_dropped_count() const
+        {
+            if(!m_async) {
+                return 0;
+            }
+
+            std::lock_guard<std::mutex> lock(m_async->rings_mutex);
+            uint64_t dropped = m_async->dropped_retired;
+            for(auto const &ring : m_async->list_rings) {
+                dropped += ring->GetDroppedCount();
+            }
+            return dropped;
+        }
+
+        Line trace()
+        {
+            return create_line(Level::TRACE);
+        }
+
+        Line debug()
+        {
+            return create_line(Level::DEBUG);
+        }
+
         Line info()
         {
-            m_mutex.lock();
+            return create_line(Level::INFO);
+        }
 
-            size_t const level = static_cast<size_t>(Level::INFO);
+        Line warn()
+        {
+            return create_line(Level::WARN);
+        }
+
+        Line error()
+        {
+            return create_line(Level::ERROR);
+        }
+
+        Line fatal()
+        {
+            return create_line(Level::FATAL);
+        }
+
+        // Logs a line without formatting it: the format id,
+        // time and raw args are queued and only turned into
+        // text when the line is written out, and not at all
+        // for BinarySinks. In async mode that happens on the
+        // drain thread, otherwise right away. Each {} in the
+        // format is replaced by the next arg; args can be
+        // numbers, bools and strings. See ILLOG_BIN
+        template<typename... Args>
+        void log_binary(Level level,
+                        FormatSite &site,
+                        char const * fmt,
+                        Args const &... args)
+        {
+            size_t const level_idx = static_cast<size_t>(level);
+            if(((m_filter.load(std::memory_order_relaxed) >> level_idx) & 1) == 0) {
+                return;
+            }
+
+            uint32_t id = site.id.load(std::memory_order_acquire);
+            if(id == 0) {
+                id = illog_detail::register_format<Args...>(site,fmt);
+            }
+
+            std::string &buffer = illog_detail::get_thread_buffer();
+            buffer.clear();
+            illog_detail::append_u32(buffer,id);
+            buffer.push_back(char(level_idx));
+            illog_detail::append_args(buffer,args...);
+
+            uint64_t const time_ns =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+            if(m_async) {
+                push_async(time_ns,buffer.data(),buffer.size(),true,
+                           level == Level::FATAL);
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            write_binary(time_ns,buffer.data(),buffer.size());
+            flush_binary_sinks();
+        }
+
+    private:
+        Line create_line(Level level)
+        {
+            size_t const level_idx = static_cast<size_t>(level);
+            bool const line_valid = (m_filter.load(std::memory_order_relaxed) >> level_idx) & 1;
+
+            if(m_async) {
+                return Line(&m_list_sinks,
+                            &(m_list_fb[level_idx]),
+                            &m_mutex,
+                            line_valid,
+                            this,
+                            level == Level::FATAL);
+            }
+
+            m_mutex.lock();
 
             return Line(&m_list_sinks,
-                        &(m_list_fb[level]),
+                        &(m_list_fb[level_idx]),
                         &m_mutex,
-                        m_filter[level]);
+                        line_valid);
         }
 
-    private:
+        void wake_drain_thread()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_async->wake_mutex);
+                m_async->wake = true;
+            }
+            m_async->wake_cv.notify_one();
+        }
+
+        void push_async(std::string const &line, bool fatal)
+        {
+            uint64_t const time_ns =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+            push_async(time_ns,line.data(),line.size(),false,fatal);
+        }
+
+        void push_async(uint64_t time_ns,
+                        char const * data,
+                        size_t size,
+                        bool binary,
+                        bool fatal)
+        {
+            using illog_detail::RecordRing;
+            AsyncState * async = m_async.get();
+
+            // find this thread's ring, creating it on first use
+            illog_detail::ThreadRings &list_rings = illog_detail::get_thread_rings();
+            RecordRing * ring=nullptr;
+            for(auto const &id_ring : list_rings) {
+                if(id_ring.first == async->id) {
+                    ring = id_ring.second.get();
+                    break;
+                }
+            }
+            if(ring == nullptr) {
+                // forget rings of Logs that have been destroyed
+                list_rings.erase(
+                            std::remove_if(
+                                list_rings.begin(),
+                                list_rings.end(),
+                                [](std::pair<uint64_t,std::shared_ptr<RecordRing>> const &id_ring) {
+                                    return id_ring.second.use_count() == 1;
+                                }),
+                            list_rings.end());
+
+                std::shared_ptr<RecordRing> new_ring =
+                        std::make_shared<RecordRing>(async->options.buffer_size);
+                {
+                    std::lock_guard<std::mutex> lock(async->rings_mutex);
+                    async->list_rings.push_back(new_ring);
+                }
+                list_rings.emplace_back(async->id,new_ring);
+                ring = new_ring.get();
+            }
+
+            bool const block = fatal ||
+                    (async->options.overflow == AsyncOptions::Overflow::BLOCK);
+
+            if(binary && size > ring->GetMaxDataSize()) {
+                // args can't be cut short, so a binary line that
+                // could never fit is written directly, after the
+                // lines already queued; with DROP it's counted and
+                // reported like any other dropped line
+                if(!block) {
+                    ring->AddDropped();
+                    return;
+                }
+                drain_async();
+                std::lock_guard<std::mutex> lock(m_mutex);
+                write_binary(time_ns,data,size);
+                flush_binary_sinks();
+                return;
+            }
+
+            uint8_t const tag = binary ?
+                        illog_detail::k_record_binary :
+                        illog_detail::k_record_text;
+            while(!ring->TryPush(time_ns,tag,data,size)) {
+                if(!block) {
+                    ring->AddDropped();
+                    return;
+                }
+                wake_drain_thread();
+                std::this_thread::yield();
+            }
+
+            if(fatal) {
+                drain_async();
+            }
+            else if(ring->GetSize() > ring->GetCapacity()/2) {
+                wake_drain_thread();
+            }
+        }
+
+        void drain_async()
+        {
+            AsyncState * async = m_async.get();
+            std::lock_guard<std::mutex> drain_lock(async->drain_mutex);
+
+            std::vector<std::shared_ptr<illog_detail::RecordRing>> list_rings;
+            uint64_t dropped;
+            {
+                std::lock_guard<std::mutex> lock(async->rings_mutex);
+                list_rings = async->list_rings;
+                dropped = async->dropped_retired;
+            }
+
+            size_t record_count=0;
+            for(auto const &ring : list_rings) {
+                ring->PopAll(async->list_records,record_count);
+                dropped += ring->GetDroppedCount();
+            }
+
+            // interleave the threads' lines by time
+            async->list_order.resize(record_count);
+            for(size_t i=0; i < record_count; i++) {
+                async->list_order[i] = i;
+            }
+            auto const &list_records = async->list_records;
+            std::stable_sort(async->list_order.begin(),
+                             async->list_order.end(),
+                             [&list_records](size_t a, size_t b) {
+                                 return list_records[a].time_ns < list_records[b].time_ns;
+                             });
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for(size_t i : async->list_order) {
+                    illog_detail::RecordRing::Record const &record = list_records[i];
+                    if(record.tag == illog_detail::k_record_binary) {
+                        write_binary(record.time_ns,record.data.data(),record.data.size());
+                        continue;
+                    }
+                    for(auto &sink : m_list_sinks) {
+                        sink->log(record.data);
+                    }
+                }
+                flush_binary_sinks();
+
+                if(dropped > async->dropped_reported) {
+                    std::string const line = "illog: dropped " +
+                            std::to_string(dropped-async->dropped_reported) +
+                            " log lines";
+                    for(auto &sink : m_list_sinks) {
+                        sink->log(line);
+                    }
+                    async->dropped_reported = dropped;
+                }
+            }
+
+            // rings only held here belong to threads that have
+            // exited; they were just emptied
+            {
+                std::lock_guard<std::mutex> lock(async->rings_mutex);
+                list_rings.clear();
+                auto &list = async->list_rings;
+                list.erase(std::remove_if(
+                               list.begin(),
+                               list.end(),
+                               [async](std::shared_ptr<illog_detail::RecordRing> const &ring) {
+                                   bool const orphaned =
+                                           (ring.use_count() == 1) &&
+                                           (ring->GetSize() == 0);
+                                   if(orphaned) {
+                                       async->dropped_retired += ring->GetDroppedCount();
+                                   }
+                                   return orphaned;
+                               }),
+                           list.end());
+            }
+        }
+
+        illog_detail::FormatDef const * get_format_def(uint32_t id)
+        {
+            if(id > m_list_defs.size()) {
+                illog_detail::FormatRegistry &registry =
+                        illog_detail::get_format_registry();
+
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                m_list_defs.insert(m_list_defs.end(),
+                                   registry.list_defs.begin()+m_list_defs.size(),
+                                   registry.list_defs.end());
+            }
+            return (id > 0 && id <= m_list_defs.size()) ? &(m_list_defs[id-1]) : nullptr;
+        }
+
+        // Formats a binary line for the text sinks and queues
+        // it for the binary ones; m_mutex must be held. data
+        // is [format id:4][level:1][args]
+        void write_binary(uint64_t time_ns, char const * data, size_t size)
+        {
+            using namespace illog_detail;
+
+            uint32_t id;
+            std::memcpy(&id,data,4);
+            uint8_t const level = uint8_t(data[4]);
+            FormatDef const * def = get_format_def(id);
+            if(def == nullptr || level > 5) {
+                return;
+            }
+
+            uint64_t const start_ns =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        m_start.time_since_epoch()).count();
+            uint64_t const run_time_ns = (time_ns > start_ns) ? (time_ns-start_ns) : 0;
+
+            for(auto &binary_sink : m_list_binary_sinks) {
+                std::string &buffer = binary_sink.pending;
+                if(!binary_sink.started) {
+                    buffer.append(k_binary_magic,8);
+                    binary_sink.started = true;
+                }
+                if(binary_sink.list_def_written.size() < id) {
+                    binary_sink.list_def_written.resize(id,false);
+                }
+                if(!binary_sink.list_def_written[id-1]) {
+                    buffer.push_back('F');
+                    append_u32(buffer,id);
+                    buffer.push_back(char(def->list_types.size()));
+                    for(ArgType type : def->list_types) {
+                        buffer.push_back(char(type));
+                    }
+                    append_u32(buffer,uint32_t(def->fmt.size()));
+                    buffer.append(def->fmt);
+                    binary_sink.list_def_written[id-1] = true;
+                }
+
+                buffer.push_back('R');
+                buffer.append(reinterpret_cast<char const*>(&run_time_ns),8);
+                append_u32(buffer,id);
+                buffer.push_back(char(level));
+                append_u32(buffer,uint32_t(size-5));
+                buffer.append(data+5,size-5);
+            }
+
+            if(!m_list_sinks.empty()) {
+                std::chrono::steady_clock::time_point const time(
+                            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                std::chrono::nanoseconds(time_ns)));
+
+                std::string line;
+                for(auto &fb : m_list_fb[level]) {
+                    line.append(fb->get_at(time));
+                }
+                format_binary(*def,data+5,size-5,line);
+
+                for(auto &sink : m_list_sinks) {
+                    sink->log(line);
+                }
+            }
+        }
+
+        void flush_binary_sinks()
+        {
+            for(auto &binary_sink : m_list_binary_sinks) {
+                if(!binary_sink.pending.empty()) {
+                    binary_sink.sink->write(binary_sink.pending.data(),
+                                            binary_sink.pending.size());
+                    binary_sink.pending.clear();
+                }
+            }
+        }
+
+        struct BinarySinkState
+        {
+            std::shared_ptr<BinarySink> sink;
+            std::vector<bool> list_def_written; // by format id-1
+            bool started;
+            std::string pending;
+        };
+
         std::mutex m_mutex;
         std::vector<std::shared_ptr<Sink>> m_list_sinks;
+        std::vector<BinarySinkState> m_list_binary_sinks;
+        std::vector<illog_detail::FormatDef> m_list_defs; // by id-1
+
+        std::chrono::steady_clock::time_point const m_start;
 
-        std::bitset<6> m_filter;
+        std::atomic<uint8_t> m_filter; // bit per Level
 
         std::array<std::vector<std::unique_ptr<FormatBlock>>,6> m_list_fb;
+
+        std::unique_ptr<AsyncState> m_async;
     };
 }
 
+// ILLOG_BIN(log,illog::Log::Level::INFO,"tile {} took {}ms",id,ms);
+// registers the format string once per call site
+// (the format is the first of the variadic args so a
+// line without args doesn't need ##__VA_ARGS__)
+#define ILLOG_BIN(log,level,...) \
+    do { \
+        static illog::FormatSite illog_format_site; \
+        (log).log_binary((level),illog_format_site,__VA_ARGS__); \
+    } while(0)
+
 #endif // SCRATCH_INLINE_LOG_H
@@ -0,0 +1,64 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// illog_decode
+// * prints the lines in a file written by an illog
+//   BinarySink, ie. illog_decode tiles.illogbin
+
+// stl
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+
+// illog
+#include <illog.hpp>
+
+int main(int argc, char * argv[])
+{
+    if(argc != 2) {
+        std::cout << "usage: illog_decode <file>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream file(argv[1],std::ios::binary);
+    if(!file) {
+        std::cout << "ERROR: could not open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::vector<char> list_data((std::istreambuf_iterator<char>(file)),
+                                std::istreambuf_iterator<char>());
+
+    std::vector<std::string> list_lines;
+    bool const ok = illog::decode_binary_log(list_data.data(),
+                                             list_data.size(),
+                                             list_lines);
+
+    for(auto const &line : list_lines) {
+        std::cout << line << "\n";
+    }
+
+    if(!ok) {
+        // ie. the process was killed mid write
+        std::cout << "ERROR: " << argv[1]
+                  << " is truncated or not an illog binary log" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+TEMPLATE    = app
+TARGET      = illog_decode
+CONFIG      -= qt
+
+INCLUDEPATH += $${PWD}
+
+# recordring
+PATH_RECORDRING = $$PWD/../recordring
+INCLUDEPATH += $${PATH_RECORDRING}
+HEADERS += $${PATH_RECORDRING}/RecordRing.h
+
+SOURCES += illog_decode.cpp
+
+# need these flags for gcc 4.8.x bug for threads
+ QMAKE_LFLAGS += -Wl,--no-as-needed
+ LIBS += -lpthread
+ QMAKE_CXXFLAGS += -std=c++11
@@ -26,6 +26,9 @@
 #include <mutex>
 #include <sstream>
 #include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cassert>
 
 // ilim
 #include <illog.hpp>
@@ -47,6 +50,264 @@ private:
 };
 
 
+class SinkToCount : public illog::Sink
+{
+public:
+    SinkToCount() :
+        m_line_count(0)
+    {
+        // empty
+    }
+
+    void log(std::string const &line)
+    {
+        std::stringstream s;
+        s << line;
+        m_last_line = line;
+        m_line_count++;
+    }
+
+    std::string m_last_line;
+    std::atomic<uint64_t> m_line_count;
+};
+
+
+// Logs from thread_count threads at once and reports the
+// time each logging call takes on the calling thread
+void BenchLogThreads(size_t thread_count, bool async)
+{
+    size_t const lines_per_thread = 10000;
+
+    std::shared_ptr<SinkToCount> sink = std::make_shared<SinkToCount>();
+    std::vector<uint64_t> list_call_ns(thread_count*lines_per_thread);
+
+    {
+        illog::Log log;
+        log.add_sink(sink);
+        log.add_format_block(std::unique_ptr<illog::Log::FormatBlock>(
+                                 new illog::Log::FBRunTimeMs()),
+                             illog::Log::Level::INFO);
+        if(async) {
+            log.enable_async();
+        }
+
+        std::vector<std::thread> list_threads;
+        for(size_t t=0; t < thread_count; t++) {
+            list_threads.emplace_back([&,t]() {
+                uint64_t * call_ns = &(list_call_ns[t*lines_per_thread]);
+                for(size_t i=0; i < lines_per_thread; i++) {
+                    auto const start = std::chrono::steady_clock::now();
+                    log.info() << ": INFO: tile " << t << "/" << i << " loaded";
+                    auto const end = std::chrono::steady_clock::now();
+                    call_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                end-start).count();
+                }
+            });
+        }
+        for(auto &thread : list_threads) {
+            thread.join();
+        }
+    }
+
+    // the default overflow policy blocks, so every line
+    // has been written once the Log is gone
+    assert(sink->m_line_count == list_call_ns.size());
+
+    std::sort(list_call_ns.begin(),list_call_ns.end());
+    double mean_ns=0;
+    for(uint64_t ns : list_call_ns) {
+        mean_ns += ns;
+    }
+    mean_ns /= list_call_ns.size();
+
+    std::cout << "BenchLogThreads: " << thread_count << " threads, "
+              << (async ? "async" : "sync") << ": "
+              << mean_ns << " ns/record, p99: "
+              << list_call_ns[list_call_ns.size()*99/100] << " ns" << std::endl;
+}
+
+
+void TestAsyncFatal()
+{
+    std::shared_ptr<SinkToCount> sink = std::make_shared<SinkToCount>();
+
+    illog::Log log;
+    log.add_sink(sink);
+
+    illog::AsyncOptions options;
+    options.buffer_size = 256;
+    options.overflow = illog::AsyncOptions::Overflow::DROP;
+    options.drain_interval = std::chrono::milliseconds(1000);
+    log.enable_async(options);
+
+    for(size_t i=0; i < 100; i++) {
+        log.info() << "filler line " << i;
+    }
+    log.fatal() << "fatal line";
+    assert(sink->m_last_line == "fatal line");
+    assert(log.get_dropped_count() > 0);
+
+    std::cout << "TestAsyncFatal... [ok]" << std::endl;
+}
+
+
+class SinkToBuffer : public illog::BinarySink
+{
+public:
+    void write(char const * data, size_t size)
+    {
+        m_data.append(data,size);
+    }
+
+    std::string m_data;
+};
+
+
+void TestBinaryLog()
+{
+    std::shared_ptr<SinkToCount> sink = std::make_shared<SinkToCount>();
+    std::shared_ptr<SinkToBuffer> binary_sink = std::make_shared<SinkToBuffer>();
+
+    illog::Log log;
+    log.add_sink(sink);
+    log.add_binary_sink(binary_sink);
+    log.add_format_block(std::unique_ptr<illog::Log::FormatBlock>(
+                             new illog::Log::FBCustomStr(": INFO: ")),
+                         illog::Log::Level::INFO);
+
+    // formatted the same way as a text line
+    log.info() << "tile " << 12 << " took " << 1.5 << "ms (" << std::string("z3") << ")";
+    std::string const text_line = sink->m_last_line;
+
+    ILLOG_BIN(log,illog::Log::Level::INFO,"tile {} took {}ms ({})",12,1.5,"z3");
+    assert(sink->m_last_line == text_line);
+
+    // and once more through the drain thread
+    log.enable_async();
+    for(int i=0; i < 3; i++) {
+        ILLOG_BIN(log,illog::Log::Level::WARN,"retry {} of {}",i,3u);
+    }
+    ILLOG_BIN(log,illog::Log::Level::INFO,"done");
+    log.flush();
+    assert(sink->m_last_line == ": INFO: done");
+
+    std::vector<std::string> list_lines;
+    bool ok = illog::decode_binary_log(binary_sink->m_data.data(),
+                                       binary_sink->m_data.size(),
+                                       list_lines);
+    assert(ok && list_lines.size() == 5);
+    assert(list_lines[0].substr(15) == "[INFO] tile 12 took 1.500000ms (z3)");
+    assert(list_lines[3].substr(15) == "[WARN] retry 2 of 3");
+    assert(list_lines[4].substr(15) == "[INFO] done");
+
+    // a cut off stream keeps the lines before the cut
+    list_lines.clear();
+    ok = illog::decode_binary_log(binary_sink->m_data.data(),
+                                  binary_sink->m_data.size()-2,
+                                  list_lines);
+    assert(!ok && list_lines.size() == 4);
+
+    // an arg type the decoder doesn't know is an error
+    std::string bad_data = binary_sink->m_data;
+    size_t const type_pos = bad_data.find('F',8)+6;
+    bad_data[type_pos] = char(9);
+    list_lines.clear();
+    ok = illog::decode_binary_log(bad_data.data(),bad_data.size(),list_lines);
+    assert(!ok && list_lines.empty());
+    (void)ok;
+
+    std::cout << "TestBinaryLog... [ok]" << std::endl;
+}
+
+
+void TestBinaryLogOversized()
+{
+    // a binary line bigger than a thread's buffer can't
+    // be cut short; with BLOCK it's still written, in order
+    std::string const big(2000,'x');
+    for(size_t drop=0; drop < 2; drop++) {
+        std::shared_ptr<SinkToBuffer> binary_sink = std::make_shared<SinkToBuffer>();
+        illog::Log log;
+        log.add_binary_sink(binary_sink);
+
+        illog::AsyncOptions options;
+        options.buffer_size = 256;
+        options.overflow = drop ?
+                    illog::AsyncOptions::Overflow::DROP :
+                    illog::AsyncOptions::Overflow::BLOCK;
+        log.enable_async(options);
+
+        ILLOG_BIN(log,illog::Log::Level::INFO,"before");
+        ILLOG_BIN(log,illog::Log::Level::INFO,"big {}",big);
+        ILLOG_BIN(log,illog::Log::Level::INFO,"after");
+        log.flush();
+
+        std::vector<std::string> list_lines;
+        bool const ok = illog::decode_binary_log(binary_sink->m_data.data(),
+                                                 binary_sink->m_data.size(),
+                                                 list_lines);
+        assert(ok);
+        if(drop) {
+            // counted, and reported to the text sinks
+            assert(list_lines.size() == 2);
+            assert(log.get_dropped_count() == 1);
+        }
+        else {
+            assert(list_lines.size() == 3);
+            assert(list_lines[1].substr(15) == "[INFO] big "+big);
+            assert(list_lines[2].substr(15) == "[INFO] after");
+            assert(log.get_dropped_count() == 0);
+        }
+        (void)ok;
+    }
+
+    std::cout << "TestBinaryLogOversized... [ok]" << std::endl;
+}
+
+
+// Time spent on the logging thread per line for text
+// and binary lines with the same content, in async mode.
+// Reports the median call since the drain thread's work
+// lands on the logging thread when they share a core
+void BenchBinaryLog()
+{
+    size_t const line_count = 100000;
+
+    for(size_t binary=0; binary < 2; binary++) {
+        std::shared_ptr<SinkToCount> sink = std::make_shared<SinkToCount>();
+        std::vector<uint64_t> list_call_ns(line_count);
+        {
+            illog::Log log;
+            log.add_sink(sink);
+            log.add_format_block(std::unique_ptr<illog::Log::FormatBlock>(
+                                     new illog::Log::FBRunTimeMs()),
+                                 illog::Log::Level::INFO);
+            log.enable_async();
+
+            for(size_t i=0; i < line_count; i++) {
+                auto const start = std::chrono::steady_clock::now();
+                if(binary) {
+                    ILLOG_BIN(log,illog::Log::Level::INFO,
+                              ": INFO: tile {} took {}ms",i,1.2345);
+                }
+                else {
+                    log.info() << ": INFO: tile " << i << " took " << 1.2345 << "ms";
+                }
+                auto const end = std::chrono::steady_clock::now();
+                list_call_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            end-start).count();
+            }
+        }
+        assert(sink->m_line_count == line_count);
+
+        std::sort(list_call_ns.begin(),list_call_ns.end());
+        std::cout << "BenchBinaryLog: " << (binary ? "binary" : "text") << ": "
+                  << "median: " << list_call_ns[line_count/2] << " ns/record"
+                  << ", p99: " << list_call_ns[line_count*99/100] << " ns" << std::endl;
+    }
+}
+
+
 void CalcTime()
 {
     // duration<Rep,Period>
@@ -192,5 +453,17 @@ int main()
 
 //    CalcTime();
 
+    TestAsyncFatal();
+    TestBinaryLog();
+    TestBinaryLogOversized();
+    BenchBinaryLog();
+
+    size_t const max_threads =
+            std::max(4u,std::thread::hardware_concurrency());
+    for(size_t thread_count=1; thread_count <= max_threads; thread_count *= 2) {
+        BenchLogThreads(thread_count,false);
+        BenchLogThreads(thread_count,true);
+    }
+
     return 0;
 }
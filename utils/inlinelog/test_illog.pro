@@ -4,6 +4,11 @@ CONFIG      -= qt
 
 INCLUDEPATH += $${PWD}
 
+# recordring
+PATH_RECORDRING = $$PWD/../recordring
+INCLUDEPATH += $${PATH_RECORDRING}
+HEADERS += $${PATH_RECORDRING}/RecordRing.h
+
 SOURCES += test_illog.cpp
 
 # need these flags for gcc 4.8.x bug for threads
@@ -5,46 +5,103 @@
 #include <iostream>
 #include <vector>
 #include <list>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+#include <cstdint>
 #include <algorithm>
 #include <cassert>
 
 using uint = unsigned int;
 
-// TODO use forward_list instead?
+// RangeAllocator
+// * sub-allocates ranges [start,start+size) out of fixed
+//   size blocks, ie. vertex/index buffers
+// * every block keeps its ranges (used and available) in
+//   an address ordered list so a released range merges
+//   with its neighbours immediately
+// * available ranges from all blocks are also kept in
+//   segregated free lists indexed by size class (two level,
+//   TLSF style) with a bitmap per level, so acquire and
+//   release don't depend on the number of blocks or ranges
+// * Range nodes are pooled and reused, so acquire and
+//   release don't touch the heap once the pool has grown
+// * Compact() moves used ranges out of sparse blocks and
+//   towards the start of blocks a slice at a time, and
+//   reports each move so the owner can copy the contents
 
 template<typename T> // T should be copyable/movable(?), makes sense for it to be a reference or uid
 class RangeAllocator
 {
 public:
-    // 16 bytes
     struct Block;
 
+    using BlockListIterator         = typename std::list<Block>::iterator;
+    using BlockListConstIterator    = typename std::list<Block>::iterator;
+
     struct Range
     {
         uint start;
         uint size;
-        typename std::list<Block>::iterator block;
+        BlockListIterator block;
+
+        // everything below is managed by RangeAllocator
+        bool avail;
+
+        // neighbours in the block, ordered by start
+        Range * prev_addr;
+        Range * next_addr;
+
+        // neighbours in the free list for this size class
+        Range * prev_avail;
+        Range * next_avail;
     };
 
     struct Block
     {
         T data;
-        std::vector<Range> list_avail; // sorted, make sure to reserve
-        std::list<Range> list_used;
-    };
+        Range * range_first;
+        uint used_count;
+        uint used_size;
 
-    using BlockListIterator         = typename std::list<Block>::iterator;
-    using BlockListConstIterator    = typename std::list<Block>::iterator;
-    using RangeListIterator         = typename std::list<Range>::iterator;
-    using RangeListConstIterator    = typename std::list<Range>::iterator;
-    using RangeVectorIterator       = typename std::vector<Range>::iterator;
+        // false while Compact() is moving ranges out of this
+        // block, its available ranges are then left out of
+        // the free lists so nothing is moved back into it
+        bool avail_indexed;
+
+        // m_compact_count when the block was created; Compact
+        // only removes empty blocks from before its last call
+        uint64_t created_compact_count;
+
+        // Available ranges sorted by start. Walks every range
+        // in the block so it's meant for debugging and tests
+        std::vector<Range> GetAvailRanges() const
+        {
+            std::vector<Range> list_avail;
+            for(Range * range = range_first; range; range = range->next_addr) {
+                if(range->avail) {
+                    list_avail.push_back(*range);
+                }
+            }
+            return list_avail;
+        }
+    };
 
     //
 
     RangeAllocator(uint block_size) :
-        m_block_size(block_size)
+        m_block_size(block_size),
+        m_compact_count(0),
+        m_fl_bitmap(0)
     {
-
+        for(uint fl=0; fl < k_fl_count; fl++) {
+            m_sl_bitmap[fl] = 0;
+            for(uint sl=0; sl < k_sl_count; sl++) {
+                m_lkup_avail[fl][sl] = nullptr;
+            }
+        }
     }
 
     ~RangeAllocator()
@@ -52,108 +109,120 @@ public:
 
     }
 
+    // Ranges point into the allocator's pool
+    RangeAllocator(RangeAllocator const &) = delete;
+    RangeAllocator & operator=(RangeAllocator const &) = delete;
+
     BlockListConstIterator
     CreateBlock(T block_data)
     {
         m_list_blocks.push_back(
                     Block{
                         block_data,
-                        {}, // list_avail
-                        {}  // list_used
+                        nullptr, // range_first
+                        0,       // used_count
+                        0,       // used_size
+                        true,    // avail_indexed
+                        m_compact_count
                     });
 
+        auto block_it = std::prev(m_list_blocks.end());
+
         // add the initial range
-        m_list_blocks.back().list_avail.push_back(
-                    Range{0,
-                          m_block_size,
-                          std::prev(m_list_blocks.end())});
+        Range * range = createRange();
+        range->start = 0;
+        range->size = m_block_size;
+        range->block = block_it;
+        range->avail = true;
 
-        return std::prev(m_list_blocks.end());
+        block_it->range_first = range;
+        insertAvail(range);
+
+        return block_it;
     }
 
     T RemoveBlock(BlockListConstIterator it)
     {
+        Range * range = it->range_first;
+        while(range) {
+            Range * next = range->next_addr;
+            if(range->avail) {
+                removeAvail(range);
+            }
+            destroyRange(range);
+            range = next;
+        }
+
         auto block_data = it->data;
         m_list_blocks.erase(it);
 
         return block_data;
     }
 
-    RangeListConstIterator
+    Range *
     AcquireRange(uint size, bool &ok)
     {
         ok = false;
 
-        if(size > m_block_size) {
+        if(size == 0 || size > m_block_size) {
             // print some error here
-            RangeListConstIterator x;
-            return x;
+            return nullptr;
         }
 
-        for(auto block_it = m_list_blocks.begin();
-            block_it != m_list_blocks.end(); ++block_it)
-        {
-            Block &block = *block_it;
+        // The head of the list for size's own class may
+        // already be big enough (exact fits are common for
+        // tile churn), otherwise take the first range from
+        // a larger class which is guaranteed to fit
+        uint fl,sl;
+        mapSize(size,fl,sl);
 
-            for(auto range_it = block.list_avail.begin();
-                range_it != block.list_avail.end(); ++range_it)
-            {
-                if(range_it->size > size)
-                {
-                    // split the range
-                    Range range_used{
-                        range_it->start,
-                        size,
-                        block_it
-                    };
-
-                    Range range_keep{
-                        range_it->start+size,
-                        range_it->size-size,
-                        block_it
-                    };
-
-                    block.list_used.push_back(range_used);
-                    block.list_avail.erase(range_it);
-
-                    // ordered insert of split range
-                    listAvailOrderedInsert(block.list_avail,range_keep);
-
-                    ok = true;
-                    return std::prev(block.list_used.end());
-                }
-                else if(range_it->size == size)
-                {
-                    // no need to split the range,
-                    // just move it to the used list
-                    block.list_used.push_back(*range_it);
-                    block.list_avail.erase(range_it);
+        Range * range = m_lkup_avail[fl][sl];
+        if(range == nullptr || range->size < size) {
+            range = findAvail(size);
+        }
 
-                    ok = true;
-                    return std::prev(block.list_used.end());
-                }
-            }
+        if(range == nullptr) {
+            // all blocks are full
+            return nullptr;
         }
 
-        // If we get here it means all blocks are full
-        RangeListConstIterator x;
-        return x;
+        removeAvail(range);
+
+        ok = true;
+        return takeRange(range,size);
     }
 
     BlockListConstIterator
-    ReleaseRange(RangeListConstIterator range, bool &empty)
+    ReleaseRange(Range * range, bool &empty)
     {
         auto block = range->block;
 
-        // ordered insert back into list_avail
-        listAvailOrderedInsert(
-                    block->list_avail,
-                    *range);
+        range->avail = true;
+        block->used_count--;
+        block->used_size -= range->size;
+
+        // merge with the following range
+        Range * next = range->next_addr;
+        if(next && next->avail) {
+            removeAvail(next);
+            range->size += next->size;
+            unlinkAddr(next);
+            destroyRange(next);
+        }
+
+        // merge with the preceding range
+        Range * prev = range->prev_addr;
+        if(prev && prev->avail) {
+            removeAvail(prev);
+            prev->size += range->size;
+            unlinkAddr(range);
+            destroyRange(range);
+            range = prev;
+        }
 
-        // remove from list_used
-        block->list_used.erase(range);
+        insertAvail(range);
 
-        if(block->list_used.empty()) {
+        if(block->used_count == 0) {
             empty = true;
             return block;
         }
@@ -164,62 +233,428 @@ public:
         }
     }
 
-private:
-    void listAvailOrderedInsert(std::vector<Range> &list_avail,
-                                Range range)
+    // Called by Compact for each move. Both ranges are valid
+    // during the call: copy range_from->size units of data
+    // from range_from to range_to (they never overlap) and
+    // update anything that refers to range_from, which is
+    // released once the callback returns
+    using RelocateCallback =
+        std::function<void(Range * range_from, Range * range_to)>;
+
+    struct CompactResult
     {
-        auto it = std::upper_bound(
-                    list_avail.begin(),
-                    list_avail.end(),
-                    range,
-                    [](Range const &a, Range const &b){
-                        return (a.start < b.start);
-                    });
+        uint move_count;
+        uint64_t moved_size;
+
+        // data of the blocks that were removed because they
+        // were empty; the owner should free them
+        std::vector<T> list_removed_blocks;
+
+        // false if the budget ran out before compaction
+        // was finished
+        bool complete;
+    };
+
+    // Runs one slice of compaction:
+    // * removes empty blocks, except ones created since the
+    //   last call so that a block added to make room for an
+    //   acquire isn't freed before it's used
+    // * moves the used ranges of the block with the least
+    //   used space into the other blocks if they have room,
+    //   then removes it
+    // * moves used ranges into a free gap right before them
+    //   if the gap is big enough to hold them
+    // Stops once moving the next range would go over
+    // size_budget, or once time_budget has passed if it's
+    // not zero. At least one range is moved per call so
+    // ranges larger than size_budget aren't stuck
+    CompactResult Compact(RelocateCallback const &relocate,
+                          uint64_t size_budget,
+                          std::chrono::steady_clock::duration time_budget=
+                            std::chrono::steady_clock::duration::zero())
+    {
+        CompactResult result{0,0,{},false};
+
+        auto const time_start = std::chrono::steady_clock::now();
+        auto within_budget = [&](uint size) {
+            if(result.move_count == 0) {
+                return true;
+            }
+            if(result.moved_size+size > size_budget) {
+                return false;
+            }
+            if(time_budget > std::chrono::steady_clock::duration::zero() &&
+               std::chrono::steady_clock::now()-time_start >= time_budget) {
+                return false;
+            }
+            return true;
+        };
+
+        auto move_range = [&](Range * range_from, Range * range_to) {
+            relocate(range_from,range_to);
+            result.move_count++;
+            result.moved_size += range_from->size;
+
+            bool empty;
+            ReleaseRange(range_from,empty);
+        };
+
+        // remove empty blocks
+        for(auto block_it = m_list_blocks.begin();
+            block_it != m_list_blocks.end();)
+        {
+            auto block_next = std::next(block_it);
+            if(block_it->used_count == 0 &&
+               block_it->created_compact_count != m_compact_count) {
+                result.list_removed_blocks.push_back(RemoveBlock(block_it));
+            }
+            block_it = block_next;
+        }
+        m_compact_count++;
+
+        // evacuate sparse blocks
+        while(true)
+        {
+            auto block_src = findCompactSource();
+            if(block_src == m_list_blocks.end()) {
+                break;
+            }
+
+            setAvailIndexed(block_src,false);
+
+            Range * range = nextUsed(block_src->range_first);
+            while(range)
+            {
+                Range * range_next = nextUsed(range->next_addr);
 
-        if(it != list_avail.end())
+                if(!within_budget(range->size)) {
+                    setAvailIndexed(block_src,true);
+                    return result;
+                }
+
+                bool ok;
+                Range * range_to = AcquireRange(range->size,ok);
+                if(!ok) {
+                    // the other blocks are too fragmented
+                    // to take the rest of this one
+                    break;
+                }
+
+                move_range(range,range_to);
+                range = range_next;
+            }
+
+            if(block_src->used_count > 0) {
+                setAvailIndexed(block_src,true);
+                break;
+            }
+
+            result.list_removed_blocks.push_back(RemoveBlock(block_src));
+        }
+
+        // move ranges towards the start of each block
+        for(auto &block : m_list_blocks)
         {
-            // it points to a range with a start value
-            // greater than range
-
-            // see if we can merge with the next range
-            if(it->start == (range.start+range.size)) {
-                // we can merge with the next range (it)
-                it->start = range.start;
-                it->size += range.size;
-
-                // see if we can merge with the preceding range
-                if(it != list_avail.begin()) {
-                    auto it_prev = std::prev(it);
-                    if(it->start == (it_prev->start+it_prev->size)) {
-                        // we can merge with the prev range (it_prev)
-                        it->start = it_prev->start;
-                        it->size += it_prev->size;
-
-                        list_avail.erase(it_prev);
+            Range * range = nextUsed(block.range_first);
+            while(range)
+            {
+                Range * range_next = nextUsed(range->next_addr);
+
+                Range * prev = range->prev_addr;
+                if(prev && prev->avail && prev->size >= range->size) {
+                    if(!within_budget(range->size)) {
+                        return result;
                     }
+
+                    removeAvail(prev);
+                    move_range(range,takeRange(prev,range->size));
                 }
+
+                range = range_next;
             }
-            // see if we can merge with the preceding range
-            else if(it != list_avail.begin()) {
-                auto it_prev = std::prev(it);
-                if(range.start == (it_prev->start+it_prev->size)) {
-                    // we can merge with the prev range (it_prev)
-                    it_prev->size += range.size;
+        }
+
+        result.complete = true;
+        return result;
+    }
+
+private:
+    // Size classes: sizes below k_sl_count each get their
+    // own class, larger sizes are split by their highest
+    // set bit (first level) and the next k_sl_log2 bits
+    // (second level), so a class spans at most 1/16th of
+    // its sizes
+    static uint const k_sl_log2 = 4;
+    static uint const k_sl_count = 1 << k_sl_log2;
+    static uint const k_fl_count = 32-k_sl_log2+1;
+
+    static uint calcMsb(uint64_t x)
+    {
+#ifdef __GNUC__
+        return 63-__builtin_clzll(x);
+#else
+        uint msb=0;
+        while(x >>= 1) {
+            msb++;
+        }
+        return msb;
+#endif
+    }
+
+    static uint calcLsb(uint32_t x)
+    {
+#ifdef __GNUC__
+        return __builtin_ctz(x);
+#else
+        uint lsb=0;
+        while((x & 1) == 0) {
+            x >>= 1;
+            lsb++;
+        }
+        return lsb;
+#endif
+    }
+
+    // size should be > 0; fl may be >= k_fl_count
+    // for sizes rounded up past 32 bits
+    static void mapSize(uint64_t size, uint &fl, uint &sl)
+    {
+        if(size < k_sl_count) {
+            fl = 0;
+            sl = uint(size);
+        }
+        else {
+            uint const msb = calcMsb(size);
+            fl = msb-k_sl_log2+1;
+            sl = uint(size >> (msb-k_sl_log2))-k_sl_count;
+        }
+    }
+
+    // First range from the smallest non empty class whose
+    // ranges are all at least size
+    Range * findAvail(uint size)
+    {
+        // round size up to the next class boundary
+        uint64_t size_up = size;
+        if(size_up >= k_sl_count) {
+            size_up += (uint64_t(1) << (calcMsb(size_up)-k_sl_log2))-1;
+        }
+
+        uint fl,sl;
+        mapSize(size_up,fl,sl);
+        if(fl >= k_fl_count) {
+            return nullptr;
+        }
+
+        uint32_t sl_bitmap = m_sl_bitmap[fl] & (~uint32_t(0) << sl);
+        if(sl_bitmap == 0) {
+            // nothing left in this first level class,
+            // look in the larger ones
+            if(fl+1 >= k_fl_count) {
+                return nullptr;
+            }
+            uint32_t const fl_bitmap = m_fl_bitmap & (~uint32_t(0) << (fl+1));
+            if(fl_bitmap == 0) {
+                return nullptr;
+            }
+            fl = calcLsb(fl_bitmap);
+            sl_bitmap = m_sl_bitmap[fl];
+        }
+        sl = calcLsb(sl_bitmap);
+
+        return m_lkup_avail[fl][sl];
+    }
+
+    // Marks the first size units of range (which must be
+    // available and not in the free lists) as used
+    Range * takeRange(Range * range, uint size)
+    {
+        if(range->size > size)
+        {
+            // split the range and keep the remainder
+            Range * range_keep = createRange();
+            range_keep->start = range->start+size;
+            range_keep->size = range->size-size;
+            range_keep->block = range->block;
+            range_keep->avail = true;
+
+            range_keep->prev_addr = range;
+            range_keep->next_addr = range->next_addr;
+            if(range->next_addr) {
+                range->next_addr->prev_addr = range_keep;
+            }
+            range->next_addr = range_keep;
+            range->size = size;
+
+            insertAvail(range_keep);
+        }
+
+        range->avail = false;
+        range->block->used_count++;
+        range->block->used_size += size;
+
+        return range;
+    }
+
+    // First used range at or after range
+    static Range * nextUsed(Range * range)
+    {
+        while(range && range->avail) {
+            range = range->next_addr;
+        }
+        return range;
+    }
+
+    // The block with the least used space whose ranges
+    // would fit in the available space of the other blocks
+    BlockListIterator findCompactSource()
+    {
+        uint64_t avail_size = 0;
+        for(auto const &block : m_list_blocks) {
+            avail_size += (m_block_size-block.used_size);
+        }
+
+        auto block_src = m_list_blocks.end();
+        for(auto block_it = m_list_blocks.begin();
+            block_it != m_list_blocks.end(); ++block_it)
+        {
+            if(block_it->used_size == 0) {
+                continue;
+            }
+
+            uint64_t const avail_size_other =
+                    avail_size-(m_block_size-block_it->used_size);
+
+            if(avail_size_other >= block_it->used_size &&
+               (block_src == m_list_blocks.end() ||
+                block_it->used_size < block_src->used_size)) {
+                block_src = block_it;
+            }
+        }
+
+        return block_src;
+    }
+
+    void setAvailIndexed(BlockListIterator block, bool indexed)
+    {
+        if(block->avail_indexed == indexed) {
+            return;
+        }
+
+        // insertAvail and removeAvail only touch the free
+        // lists while avail_indexed is true
+        block->avail_indexed = true;
+        for(Range * range = block->range_first; range; range = range->next_addr) {
+            if(range->avail) {
+                if(indexed) {
+                    insertAvail(range);
+                }
+                else {
+                    removeAvail(range);
                 }
             }
-            else {
-                // can't merge
-                list_avail.insert(it,range);
+        }
+        block->avail_indexed = indexed;
+    }
+
+    void insertAvail(Range * range)
+    {
+        if(!range->block->avail_indexed) {
+            return;
+        }
+
+        uint fl,sl;
+        mapSize(range->size,fl,sl);
+
+        Range * head = m_lkup_avail[fl][sl];
+        range->prev_avail = nullptr;
+        range->next_avail = head;
+        if(head) {
+            head->prev_avail = range;
+        }
+        m_lkup_avail[fl][sl] = range;
+
+        m_fl_bitmap |= (uint32_t(1) << fl);
+        m_sl_bitmap[fl] |= (uint32_t(1) << sl);
+    }
+
+    void removeAvail(Range * range)
+    {
+        if(!range->block->avail_indexed) {
+            return;
+        }
+
+        uint fl,sl;
+        mapSize(range->size,fl,sl);
+
+        if(range->prev_avail) {
+            range->prev_avail->next_avail = range->next_avail;
+        }
+        else {
+            m_lkup_avail[fl][sl] = range->next_avail;
+        }
+        if(range->next_avail) {
+            range->next_avail->prev_avail = range->prev_avail;
+        }
+
+        if(m_lkup_avail[fl][sl] == nullptr) {
+            m_sl_bitmap[fl] &= ~(uint32_t(1) << sl);
+            if(m_sl_bitmap[fl] == 0) {
+                m_fl_bitmap &= ~(uint32_t(1) << fl);
             }
         }
+    }
+
+    void unlinkAddr(Range * range)
+    {
+        if(range->prev_addr) {
+            range->prev_addr->next_addr = range->next_addr;
+        }
+        else {
+            range->block->range_first = range->next_addr;
+        }
+        if(range->next_addr) {
+            range->next_addr->prev_addr = range->prev_addr;
+        }
+    }
+
+    Range * createRange()
+    {
+        Range * range;
+        if(m_list_range_pool_free.empty()) {
+            // deque doesn't move existing elements on push_back
+            m_list_range_pool.emplace_back();
+            range = &(m_list_range_pool.back());
+        }
         else {
-            list_avail.insert(it,range);
+            range = m_list_range_pool_free.back();
+            m_list_range_pool_free.pop_back();
         }
+
+        range->prev_addr = nullptr;
+        range->next_addr = nullptr;
+        range->prev_avail = nullptr;
+        range->next_avail = nullptr;
+
+        return range;
+    }
+
+    void destroyRange(Range * range)
+    {
+        m_list_range_pool_free.push_back(range);
     }
 
     //
     uint const m_block_size;
     std::list<Block> m_list_blocks;
+    uint64_t m_compact_count; // calls to Compact
+
+    std::deque<Range> m_list_range_pool;
+    std::vector<Range*> m_list_range_pool_free;
+
+    uint32_t m_fl_bitmap;
+    uint32_t m_sl_bitmap[k_fl_count];
+    Range * m_lkup_avail[k_fl_count][k_sl_count];
 };
 
 TEST_CASE("RangeAllocator","[rangeallocator]")
@@ -292,35 +727,35 @@ TEST_CASE("RangeAllocator","[rangeallocator]")
 
                 SECTION("Release Range")
                 {
-                    REQUIRE(it_b0->list_avail.size()==0);
+                    REQUIRE(it_b0->GetAvailRanges().size()==0);
 
                     bool empty;
                     rac.ReleaseRange(it2,empty);
                     REQUIRE(empty==false);
-                    REQUIRE(it_b0->list_avail.size()==1);
-                    REQUIRE(it_b0->list_avail.begin()->start == 50);
-                    REQUIRE(it_b0->list_avail.begin()->size == 50);
+                    REQUIRE(it_b0->GetAvailRanges().size()==1);
+                    REQUIRE(it_b0->GetAvailRanges().begin()->start == 50);
+                    REQUIRE(it_b0->GetAvailRanges().begin()->size == 50);
 
                     // disjoint ranges shouldn't merge
                     rac.ReleaseRange(it0,empty);
                     REQUIRE(empty==false);
-                    REQUIRE(it_b0->list_avail.size()==2);
-                    REQUIRE(it_b0->list_avail.begin()->start == 0);
-                    REQUIRE(it_b0->list_avail.begin()->size == 25);
+                    REQUIRE(it_b0->GetAvailRanges().size()==2);
+                    REQUIRE(it_b0->GetAvailRanges().begin()->start == 0);
+                    REQUIRE(it_b0->GetAvailRanges().begin()->size == 25);
 
                     // adjacent ranges should be merged
                     it0 = rac.AcquireRange(25,ok);
-                    REQUIRE(it_b0->list_avail.size()==1);
-                    REQUIRE(it_b0->list_avail.begin()->start == 50);
-                    REQUIRE(it_b0->list_avail.begin()->size == 50);
+                    REQUIRE(it_b0->GetAvailRanges().size()==1);
+                    REQUIRE(it_b0->GetAvailRanges().begin()->start == 50);
+                    REQUIRE(it_b0->GetAvailRanges().begin()->size == 50);
 
                     rac.ReleaseRange(it1,empty);
-                    REQUIRE(it_b0->list_avail.size()==1);
-                    REQUIRE(it_b0->list_avail.begin()->start == 25);
-                    REQUIRE(it_b0->list_avail.begin()->size == 75);
+                    REQUIRE(it_b0->GetAvailRanges().size()==1);
+                    REQUIRE(it_b0->GetAvailRanges().begin()->start == 25);
+                    REQUIRE(it_b0->GetAvailRanges().begin()->size == 75);
 
                     auto itf = rac.AcquireRange(75,ok);
-                    REQUIRE(it_b0->list_avail.size()==0);
+                    REQUIRE(it_b0->GetAvailRanges().size()==0);
 
                     // check that empty flag is set when
                     // the block is completely emptied
@@ -334,3 +769,332 @@ TEST_CASE("RangeAllocator","[rangeallocator]")
         }
     }
 }
+
+TEST_CASE("RangeAllocator multiple blocks","[rangeallocator]")
+{
+    RangeAllocator<uint> rac(100);
+    rac.CreateBlock(0);
+    rac.CreateBlock(1);
+
+    bool ok;
+    auto it0 = rac.AcquireRange(60,ok);
+    REQUIRE(ok);
+    auto it1 = rac.AcquireRange(60,ok);
+    REQUIRE(ok);
+    REQUIRE(it0->block != it1->block);
+
+    // only the 40 unit remainders are left
+    rac.AcquireRange(41,ok);
+    REQUIRE(ok==false);
+
+    auto it2 = rac.AcquireRange(40,ok);
+    REQUIRE(ok);
+    auto it3 = rac.AcquireRange(40,ok);
+    REQUIRE(ok);
+
+    // it2 and one of it0 and it1 share a block, releasing
+    // both merges everything back into one range
+    auto it_b = it2->block;
+    auto it_same = (it0->block == it_b) ? it0 : it1;
+    auto it_other = (it0->block == it_b) ? it1 : it0;
+    REQUIRE(it3->block == it_other->block);
+
+    bool empty;
+    rac.ReleaseRange(it2,empty);
+    REQUIRE(empty==false);
+    REQUIRE(it_b->GetAvailRanges().size()==1);
+    rac.ReleaseRange(it_same,empty);
+    REQUIRE(empty);
+    REQUIRE(it_b->GetAvailRanges().size()==1);
+    REQUIRE(it_b->GetAvailRanges().begin()->size==100);
+
+    // the removed block's ranges are no longer available
+    uint const data_other = it_other->block->data;
+    rac.RemoveBlock(it_b);
+    rac.AcquireRange(1,ok);
+    REQUIRE(ok==false);
+
+    rac.ReleaseRange(it_other,empty);
+    REQUIRE(empty==false);
+    rac.ReleaseRange(it3,empty);
+    REQUIRE(empty);
+
+    auto it4 = rac.AcquireRange(100,ok);
+    REQUIRE(ok);
+    REQUIRE(it4->start==0);
+    REQUIRE(it4->block->data==data_other);
+}
+
+TEST_CASE("RangeAllocator compaction","[rangeallocator]")
+{
+    // each block is backed by a buffer so moves can
+    // be checked by copying the contents around
+    uint const block_size = 1000;
+    RangeAllocator<uint> rac(block_size);
+    using Range = RangeAllocator<uint>::Range;
+
+    std::map<uint,std::vector<uint8_t>> lkup_buffers;
+    std::unordered_map<Range*,uint8_t> lkup_live;
+    uint block_count = 0;
+
+    uint32_t x = 12345;
+    auto rand_next = [&x]() {
+        x = x*1103515245u + 12345u;
+        return (x >> 8);
+    };
+
+    for(uint i=0; i < 300; i++) {
+        uint const size = 10 + (rand_next() % 50);
+        bool ok;
+        Range * range = rac.AcquireRange(size,ok);
+        if(!ok) {
+            lkup_buffers[block_count].resize(block_size,0);
+            rac.CreateBlock(block_count++);
+            range = rac.AcquireRange(size,ok);
+        }
+        REQUIRE(ok);
+
+        uint8_t const tag = uint8_t(i);
+        auto &buffer = lkup_buffers[range->block->data];
+        std::fill(buffer.begin()+range->start,
+                  buffer.begin()+range->start+range->size,
+                  tag);
+        lkup_live[range] = tag;
+    }
+
+    // release two thirds of the ranges
+    std::vector<Range*> list_release;
+    for(auto const &range_tag : lkup_live) {
+        if(rand_next() % 3 != 0) {
+            list_release.push_back(range_tag.first);
+        }
+    }
+    for(Range * range : list_release) {
+        bool empty;
+        rac.ReleaseRange(range,empty);
+        lkup_live.erase(range);
+    }
+
+    auto relocate = [&](Range * range_from, Range * range_to) {
+        auto &buffer_from = lkup_buffers[range_from->block->data];
+        auto &buffer_to = lkup_buffers[range_to->block->data];
+        std::copy(buffer_from.begin()+range_from->start,
+                  buffer_from.begin()+range_from->start+range_from->size,
+                  buffer_to.begin()+range_to->start);
+
+        REQUIRE(lkup_live.count(range_from)==1);
+        lkup_live[range_to] = lkup_live[range_from];
+        lkup_live.erase(range_from);
+    };
+
+    uint64_t const size_budget = 500;
+    bool budget_ok = true;
+    size_t slice_count = 0;
+    while(true) {
+        auto result = rac.Compact(relocate,size_budget);
+        budget_ok = budget_ok &&
+                ((result.moved_size <= size_budget) ||
+                 (result.move_count == 1));
+
+        for(uint block_data : result.list_removed_blocks) {
+            lkup_buffers.erase(block_data);
+        }
+
+        slice_count++;
+        if(result.complete) {
+            break;
+        }
+        REQUIRE(slice_count < 1000);
+    }
+    REQUIRE(budget_ok);
+    REQUIRE(slice_count > 1);
+    REQUIRE(lkup_buffers.size() < block_count);
+
+    // contents survived every move
+    bool contents_ok = true;
+    for(auto const &range_tag : lkup_live) {
+        Range * range = range_tag.first;
+        auto &buffer = lkup_buffers[range->block->data];
+        for(uint i=range->start; i < range->start+range->size; i++) {
+            contents_ok = contents_ok && (buffer[i] == range_tag.second);
+        }
+    }
+    REQUIRE(contents_ok);
+
+    // another pass has nothing left to do
+    auto result = rac.Compact(relocate,size_budget);
+    REQUIRE(result.complete);
+    REQUIRE(result.move_count==0);
+    REQUIRE(result.list_removed_blocks.empty());
+}
+
+TEST_CASE("RangeAllocator compaction keeps new blocks","[rangeallocator]")
+{
+    RangeAllocator<uint> rac(100);
+    using Range = RangeAllocator<uint>::Range;
+
+    auto relocate = [](Range *, Range *) {};
+    bool ok;
+    bool empty;
+
+    // a block added for an acquire survives the
+    // compaction that runs before the acquire
+    rac.CreateBlock(0);
+    auto result = rac.Compact(relocate,1000);
+    REQUIRE(result.list_removed_blocks.empty());
+
+    Range * range = rac.AcquireRange(50,ok);
+    REQUIRE(ok);
+    REQUIRE(range->block->data==0);
+
+    // once it's been through a compaction, an empty
+    // block is removed by the next one
+    rac.ReleaseRange(range,empty);
+    REQUIRE(empty);
+    result = rac.Compact(relocate,1000);
+    REQUIRE(result.list_removed_blocks.size()==1);
+    REQUIRE(result.list_removed_blocks[0]==0);
+
+    // same for a block created between two compactions
+    rac.CreateBlock(1);
+    result = rac.Compact(relocate,1000);
+    REQUIRE(result.list_removed_blocks.empty());
+    result = rac.Compact(relocate,1000);
+    REQUIRE(result.list_removed_blocks.size()==1);
+    REQUIRE(result.list_removed_blocks[0]==1);
+}
+
+TEST_CASE("RangeAllocator tile churn benchmark","[rangeallocator][benchmark]")
+{
+    // Tiles come and go with vertex buffers of 4KB to 256KB
+    // that are sub-allocated out of 16MB blocks; a new block
+    // is added whenever an acquire fails
+    uint const block_size = 16*1024*1024;
+    uint const size_min = 4*1024;
+    uint const size_max = 256*1024;
+    size_t const live_count = 1000;
+    size_t const op_count = 1000000;
+
+    RangeAllocator<uint> rac(block_size);
+    using Range = RangeAllocator<uint>::Range;
+
+    uint32_t x = 12345;
+    auto rand_next = [&x]() {
+        x = x*1103515245u + 12345u;
+        return (x >> 8);
+    };
+
+    std::vector<Range*> list_live;
+    list_live.reserve(live_count);
+    std::vector<RangeAllocator<uint>::BlockListIterator> list_blocks;
+    uint64_t used_size = 0;
+    size_t fail_count = 0;
+
+    auto acquire = [&]() {
+        uint const size = size_min + (rand_next() % (size_max-size_min));
+        bool ok;
+        Range * range = rac.AcquireRange(size,ok);
+        if(!ok) {
+            list_blocks.push_back(rac.CreateBlock(list_blocks.size()));
+            range = rac.AcquireRange(size,ok);
+        }
+        fail_count += (ok ? 0 : 1);
+        list_live.push_back(range);
+        used_size += size;
+    };
+
+    auto release = [&]() {
+        size_t const i = rand_next() % list_live.size();
+        used_size -= list_live[i]->size;
+        bool empty;
+        rac.ReleaseRange(list_live[i],empty);
+        list_live[i] = list_live.back();
+        list_live.pop_back();
+    };
+
+    for(size_t i=0; i < live_count; i++) {
+        acquire();
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+    for(size_t i=0; i < op_count; i++) {
+        release();
+        acquire();
+    }
+    auto const end = std::chrono::steady_clock::now();
+
+    double const ms =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                end-start).count()/1000.0;
+
+    // fragmentation: how much of the free space can't
+    // be used by a single max size acquire
+    uint64_t const total_size = uint64_t(list_blocks.size())*block_size;
+    uint64_t avail_size = 0;
+    uint64_t avail_size_largest = 0;
+    uint64_t avail_size_unusable = 0;
+    size_t avail_count = 0;
+    for(auto block_it : list_blocks) {
+        for(auto const &range : block_it->GetAvailRanges()) {
+            avail_size += range.size;
+            avail_size_largest = std::max<uint64_t>(
+                        avail_size_largest,range.size);
+            if(range.size < size_max) {
+                avail_size_unusable += range.size;
+            }
+            avail_count++;
+        }
+    }
+
+    REQUIRE(fail_count == 0);
+    REQUIRE(used_size+avail_size == total_size);
+
+    std::cout << "RangeAllocator tile churn: "
+              << op_count << " release+acquire in " << ms << " ms ("
+              << (op_count*2/ms*1000.0) << " ops/s)" << std::endl;
+    std::cout << ": blocks: " << list_blocks.size()
+              << ", utilization: " << (100.0*used_size/total_size) << "%"
+              << ", avail ranges: " << avail_count
+              << ", largest avail: " << avail_size_largest
+              << ", avail < max tile size: "
+              << (100.0*avail_size_unusable/std::max<uint64_t>(avail_size,1))
+              << "%" << std::endl;
+
+    // zoom out: most tiles go away, then compact in 1MB
+    // slices like a per frame budget would
+    while(list_live.size() > live_count/4) {
+        release();
+    }
+
+    auto relocate = [&](Range * range_from, Range * range_to) {
+        *std::find(list_live.begin(),list_live.end(),range_from) = range_to;
+    };
+
+    size_t slice_count = 0;
+    uint64_t moved_size = 0;
+    size_t block_count = list_blocks.size();
+    auto const compact_start = std::chrono::steady_clock::now();
+    while(true) {
+        auto result = rac.Compact(relocate,1024*1024);
+        moved_size += result.moved_size;
+        block_count -= result.list_removed_blocks.size();
+        slice_count++;
+        if(result.complete) {
+            break;
+        }
+    }
+    auto const compact_end = std::chrono::steady_clock::now();
+
+    double const compact_ms =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                compact_end-compact_start).count()/1000.0;
+
+    std::cout << ": after releasing 3/4 of the tiles, blocks: "
+              << list_blocks.size() << ", utilization: "
+              << (100.0*used_size/total_size) << "%" << std::endl;
+    std::cout << ": compacted in " << slice_count << " slices ("
+              << compact_ms << " ms, " << moved_size << " moved), blocks: "
+              << block_count << ", utilization: "
+              << (100.0*used_size/(uint64_t(block_count)*block_size))
+              << "%" << std::endl;
+}
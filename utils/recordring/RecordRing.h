@@ -0,0 +1,180 @@
+/*
+   Copyright (C) 2015 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_RECORD_RING_H
+#define SCRATCH_RECORD_RING_H
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace scratch
+{
+    // RecordRing
+    // * single producer, single consumer byte ring that passes
+    //   variable sized records from one thread to another
+    //   without locking; smlog and illog give each logging
+    //   thread one of these per async logger
+    // * a record is [time_ns:8][tag:1][size:4][data] and may
+    //   wrap around the end of the buffer. The tag is up to
+    //   the caller (a log level, a record type, ...)
+    // * the capacity is buffer_size rounded up to a power of
+    //   two, and a record can hold at most GetMaxDataSize()
+    //   bytes of data
+    class RecordRing
+    {
+    public:
+        static size_t const k_header_size = 13;
+
+        struct Record
+        {
+            uint64_t time_ns;
+            uint8_t tag;
+            std::string data;
+        };
+
+        explicit RecordRing(size_t buffer_size) :
+            m_head(0),
+            m_tail(0),
+            m_dropped(0)
+        {
+            size_t capacity=256;
+            while(capacity < buffer_size) {
+                capacity *= 2;
+            }
+            m_buffer.resize(capacity);
+            m_mask = capacity-1;
+        }
+
+        size_t GetCapacity() const
+        {
+            return m_buffer.size();
+        }
+
+        size_t GetMaxDataSize() const
+        {
+            return GetCapacity()-k_header_size;
+        }
+
+        size_t GetSize() const
+        {
+            return size_t(m_head.load(std::memory_order_acquire)-
+                          m_tail.load(std::memory_order_acquire));
+        }
+
+        // producer; false if there isn't room right now.
+        // Data longer than GetMaxDataSize() is cut short
+        bool TryPush(uint64_t time_ns,
+                     uint8_t tag,
+                     char const * data,
+                     size_t size)
+        {
+            uint32_t const data_size = uint32_t(std::min(size,GetMaxDataSize()));
+            size_t const record_size = k_header_size+data_size;
+
+            uint64_t const head = m_head.load(std::memory_order_relaxed);
+            uint64_t const tail = m_tail.load(std::memory_order_acquire);
+            if(GetCapacity()-size_t(head-tail) < record_size) {
+                return false;
+            }
+
+            char header[k_header_size];
+            std::memcpy(header,&time_ns,8);
+            header[8] = char(tag);
+            std::memcpy(header+9,&data_size,4);
+
+            write(head,header,k_header_size);
+            write(head+k_header_size,data,data_size);
+            m_head.store(head+record_size,std::memory_order_release);
+            return true;
+        }
+
+        // consumer; appends to list_records starting at
+        // record_count, reusing the strings already there
+        void PopAll(std::vector<Record> &list_records,
+                    size_t &record_count)
+        {
+            uint64_t tail = m_tail.load(std::memory_order_relaxed);
+            uint64_t const head = m_head.load(std::memory_order_acquire);
+
+            while(tail != head) {
+                char header[k_header_size];
+                read(tail,header,k_header_size);
+
+                if(record_count == list_records.size()) {
+                    list_records.emplace_back();
+                }
+                Record &record = list_records[record_count++];
+
+                uint32_t data_size;
+                std::memcpy(&record.time_ns,header,8);
+                record.tag = uint8_t(header[8]);
+                std::memcpy(&data_size,header+9,4);
+
+                record.data.resize(data_size);
+                if(data_size > 0) {
+                    read(tail+k_header_size,&(record.data[0]),data_size);
+                }
+                tail += k_header_size+data_size;
+            }
+
+            m_tail.store(tail,std::memory_order_release);
+        }
+
+        // records the producer gave up on, ie. because
+        // the ring was full; only counted here
+        void AddDropped()
+        {
+            m_dropped.fetch_add(1,std::memory_order_relaxed);
+        }
+
+        uint64_t GetDroppedCount() const
+        {
+            return m_dropped.load(std::memory_order_relaxed);
+        }
+
+    private:
+        void write(uint64_t pos, char const * data, size_t size)
+        {
+            size_t const offset = size_t(pos & m_mask);
+            size_t const first = std::min(size,m_buffer.size()-offset);
+            std::memcpy(&(m_buffer[offset]),data,first);
+            std::memcpy(&(m_buffer[0]),data+first,size-first);
+        }
+
+        void read(uint64_t pos, char * data, size_t size) const
+        {
+            size_t const offset = size_t(pos & m_mask);
+            size_t const first = std::min(size,m_buffer.size()-offset);
+            std::memcpy(data,&(m_buffer[offset]),first);
+            std::memcpy(data+first,&(m_buffer[0]),size-first);
+        }
+
+        std::vector<char> m_buffer;
+        size_t m_mask;
+
+        // head and tail on separate cache lines so the
+        // producer and consumer don't contend
+        alignas(64) std::atomic<uint64_t> m_head;
+        alignas(64) std::atomic<uint64_t> m_tail;
+        alignas(64) std::atomic<uint64_t> m_dropped;
+    };
+}
+
+#endif // SCRATCH_RECORD_RING_H
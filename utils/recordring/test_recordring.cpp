@@ -0,0 +1,115 @@
+/*
+   Copyright (C) 2015 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <cassert>
+
+#include <RecordRing.h>
+
+using namespace scratch;
+
+// ============================================================= //
+
+void testPushPop()
+{
+    RecordRing ring(100);
+    assert(ring.GetCapacity() == 256);
+    assert(ring.GetMaxDataSize() == 256-RecordRing::k_header_size);
+
+    std::vector<RecordRing::Record> list_records;
+    size_t count=0;
+
+    // records that wrap around the end of the buffer
+    for(size_t i=0; i < 100; i++) {
+        std::string const data(i % 50,char('a'+(i % 26)));
+        assert(ring.TryPush(i,uint8_t(i),data.data(),data.size()));
+
+        count=0;
+        ring.PopAll(list_records,count);
+        assert(count == 1);
+        assert(list_records[0].time_ns == i);
+        assert(list_records[0].tag == uint8_t(i));
+        assert(list_records[0].data == data);
+        assert(ring.GetSize() == 0);
+    }
+
+    // full
+    std::string const data(100,'x');
+    assert(ring.TryPush(0,0,data.data(),data.size()));
+    assert(ring.TryPush(1,0,data.data(),data.size()));
+    assert(!ring.TryPush(2,0,data.data(),data.size()));
+    count=0;
+    ring.PopAll(list_records,count);
+    assert(count == 2);
+
+    // too long for any record, so it's cut short
+    std::string const big(1000,'y');
+    assert(ring.TryPush(3,0,big.data(),big.size()));
+    count=0;
+    ring.PopAll(list_records,count);
+    assert(count == 1 && list_records[0].data == big.substr(0,ring.GetMaxDataSize()));
+
+    ring.AddDropped();
+    assert(ring.GetDroppedCount() == 1);
+
+    std::cout << "testPushPop... [ok]" << std::endl;
+}
+
+void testThreads()
+{
+    // one producer and one consumer, records come
+    // out complete and in order
+    RecordRing ring(1024);
+    size_t const k_count = 200000;
+
+    std::thread producer([&ring,k_count]() {
+        for(size_t i=0; i < k_count; i++) {
+            std::string const data = std::to_string(i);
+            while(!ring.TryPush(i,uint8_t(data.size()),data.data(),data.size())) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<RecordRing::Record> list_records;
+    size_t next=0;
+    while(next < k_count) {
+        size_t count=0;
+        ring.PopAll(list_records,count);
+        for(size_t i=0; i < count; i++) {
+            assert(list_records[i].time_ns == next);
+            assert(list_records[i].data == std::to_string(next));
+            assert(list_records[i].tag == list_records[i].data.size());
+            next++;
+        }
+    }
+    producer.join();
+
+    std::cout << "testThreads... [ok]" << std::endl;
+}
+
+// ============================================================= //
+
+int main()
+{
+    testPushPop();
+    testThreads();
+    return 0;
+}
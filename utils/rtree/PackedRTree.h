@@ -0,0 +1,217 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_PACKED_RTREE_H
+#define SCRATCH_PACKED_RTREE_H
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace scratch
+{
+    // ============================================================= //
+
+    // PackedRTree
+    // * static R-tree over 2d bounding boxes, bulk loaded
+    //   once with Sort-Tile-Recursive (STR): entries are
+    //   sorted into vertical slices by x, each slice is
+    //   sorted by y and cut into full nodes, and the same
+    //   is done to the nodes until there's one root
+    // * every node except the last of a level is full, so
+    //   the tree is as shallow as it can be and there's
+    //   little overlap between siblings
+    // * boxes are inclusive; boxes that only touch overlap
+    // * Query returns the indices (into the list passed to
+    //   Build) of every box that overlaps, in ascending
+    //   order, so results don't depend on the packing
+    // * the tree can't be changed after it's built, and is
+    //   safe to query from several threads at once
+    template <typename T>
+    class PackedRTree
+    {
+    public:
+        struct Box
+        {
+            T min_x;
+            T min_y;
+            T max_x;
+            T max_y;
+
+            bool Overlaps(Box const &other) const
+            {
+                return !((max_x < other.min_x) || (min_x > other.max_x) ||
+                         (max_y < other.min_y) || (min_y > other.max_y));
+            }
+
+            void Expand(Box const &other)
+            {
+                min_x = std::min(min_x,other.min_x);
+                min_y = std::min(min_y,other.min_y);
+                max_x = std::max(max_x,other.max_x);
+                max_y = std::max(max_y,other.max_y);
+            }
+        };
+
+        explicit PackedRTree(size_t node_size=16) :
+            m_node_size(std::max<size_t>(2,node_size))
+        {}
+
+        void Build(std::vector<Box> const &list_boxes)
+        {
+            m_list_items.resize(list_boxes.size());
+            for(size_t i=0; i < list_boxes.size(); i++) {
+                m_list_items[i].box = list_boxes[i];
+                m_list_items[i].index = i;
+            }
+            m_list_levels.clear();
+            if(m_list_items.empty()) {
+                return;
+            }
+
+            // leaves, then a level of parents at a
+            // time; sorting a level only reorders the
+            // entries, so the child ranges of the nodes
+            // in it stay valid
+            sortTileRecursive(m_list_items);
+            m_list_levels.emplace_back();
+            packLevel(m_list_items,m_list_levels.back());
+
+            while(m_list_levels.back().size() > 1) {
+                sortTileRecursive(m_list_levels.back());
+                std::vector<Node> list_parents;
+                packLevel(m_list_levels.back(),list_parents);
+                m_list_levels.push_back(std::move(list_parents));
+            }
+        }
+
+        // Appends the index of every box that overlaps
+        // query to list_indices, in ascending order
+        void Query(Box const &query, std::vector<size_t> &list_indices) const
+        {
+            if(m_list_levels.empty()) {
+                return;
+            }
+            size_t const first_result = list_indices.size();
+
+            // (level,node) pairs left to visit
+            std::vector<std::pair<size_t,size_t>> list_stack;
+            list_stack.emplace_back(m_list_levels.size()-1,0);
+
+            while(!list_stack.empty()) {
+                size_t const level = list_stack.back().first;
+                Node const &node = m_list_levels[level][list_stack.back().second];
+                list_stack.pop_back();
+
+                if(!node.box.Overlaps(query)) {
+                    continue;
+                }
+
+                if(level == 0) {
+                    for(size_t i=node.begin; i < node.end; i++) {
+                        if(m_list_items[i].box.Overlaps(query)) {
+                            list_indices.push_back(m_list_items[i].index);
+                        }
+                    }
+                }
+                else {
+                    for(size_t i=node.begin; i < node.end; i++) {
+                        list_stack.emplace_back(level-1,i);
+                    }
+                }
+            }
+
+            std::sort(list_indices.begin()+first_result,list_indices.end());
+        }
+
+        size_t GetCount() const
+        {
+            return m_list_items.size();
+        }
+
+        // levels of nodes above the boxes
+        size_t GetDepth() const
+        {
+            return m_list_levels.size();
+        }
+
+    private:
+        struct Item
+        {
+            Box box;
+            size_t index;
+        };
+
+        struct Node
+        {
+            Box box;
+            size_t begin;   // children in the level below
+            size_t end;
+        };
+
+        template <typename Entry>
+        void sortTileRecursive(std::vector<Entry> &list_entries) const
+        {
+            // centers are compared as min+max to
+            // avoid dividing (T may be an integer)
+            size_t const count = list_entries.size();
+            size_t const node_count = (count+m_node_size-1)/m_node_size;
+            size_t const slice_count = size_t(std::ceil(std::sqrt(double(node_count))));
+            size_t const slice_size = slice_count*m_node_size;
+
+            std::sort(list_entries.begin(),list_entries.end(),
+                      [](Entry const &a, Entry const &b) {
+                return (a.box.min_x+a.box.max_x) < (b.box.min_x+b.box.max_x);
+            });
+
+            for(size_t s=0; s < count; s+=slice_size) {
+                std::sort(list_entries.begin()+s,
+                          list_entries.begin()+std::min(s+slice_size,count),
+                          [](Entry const &a, Entry const &b) {
+                    return (a.box.min_y+a.box.max_y) < (b.box.min_y+b.box.max_y);
+                });
+            }
+        }
+
+        template <typename Entry>
+        void packLevel(std::vector<Entry> const &list_entries,
+                       std::vector<Node> &list_nodes) const
+        {
+            list_nodes.clear();
+            list_nodes.reserve((list_entries.size()+m_node_size-1)/m_node_size);
+            for(size_t i=0; i < list_entries.size(); i+=m_node_size) {
+                Node node;
+                node.begin = i;
+                node.end = std::min(i+m_node_size,list_entries.size());
+                node.box = list_entries[i].box;
+                for(size_t j=node.begin+1; j < node.end; j++) {
+                    node.box.Expand(list_entries[j].box);
+                }
+                list_nodes.push_back(node);
+            }
+        }
+
+        size_t const m_node_size;
+        std::vector<Item> m_list_items;                 // leaf entries
+        std::vector<std::vector<Node>> m_list_levels;   // leaves first
+    };
+
+    // ============================================================= //
+}
+
+#endif // SCRATCH_PACKED_RTREE_H
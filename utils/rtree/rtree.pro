@@ -0,0 +1,10 @@
+TEMPLATE    = app
+TARGET      = runme
+CONFIG      -= qt
+
+INCLUDEPATH += $${PWD}
+
+HEADERS += PackedRTree.h
+SOURCES += test_rtree.cpp
+
+QMAKE_CXXFLAGS += -std=c++11
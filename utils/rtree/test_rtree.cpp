@@ -0,0 +1,236 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <cstdint>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cassert>
+
+#include <PackedRTree.h>
+
+using namespace scratch;
+
+typedef PackedRTree<double> RTree;
+typedef RTree::Box Box;
+
+Box makeBox(double min_x, double min_y, double max_x, double max_y)
+{
+    Box box;
+    box.min_x = min_x;
+    box.min_y = min_y;
+    box.max_x = max_x;
+    box.max_y = max_y;
+    return box;
+}
+
+std::vector<size_t> bruteForce(std::vector<Box> const &list_boxes,
+                               Box const &query)
+{
+    std::vector<size_t> list_indices;
+    for(size_t i=0; i < list_boxes.size(); i++) {
+        if(list_boxes[i].Overlaps(query)) {
+            list_indices.push_back(i);
+        }
+    }
+    return list_indices;
+}
+
+std::vector<Box> randomBoxes(size_t count, double max_size, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist_pos(-180.0,180.0);
+    std::uniform_real_distribution<double> dist_size(0.0,max_size);
+
+    std::vector<Box> list_boxes(count);
+    for(size_t i=0; i < count; i++) {
+        double const x = dist_pos(rng);
+        double const y = dist_pos(rng)/2;
+        list_boxes[i] = makeBox(x,y,x+dist_size(rng),y+dist_size(rng));
+    }
+    return list_boxes;
+}
+
+// ============================================================= //
+
+void testQueryEmpty()
+{
+    RTree rtree;
+    rtree.Build(std::vector<Box>());
+    assert(rtree.GetCount() == 0);
+    assert(rtree.GetDepth() == 0);
+
+    std::vector<size_t> list_indices;
+    rtree.Query(makeBox(-1,-1,1,1),list_indices);
+    assert(list_indices.empty());
+
+    std::cout << "testQueryEmpty... [ok]" << std::endl;
+}
+
+void testQueryEdges()
+{
+    std::vector<Box> list_boxes;
+    list_boxes.push_back(makeBox(0,0,1,1));
+    list_boxes.push_back(makeBox(1,0,2,1));     // shares an edge with 0
+    list_boxes.push_back(makeBox(5,5,5,5));     // a point
+    list_boxes.push_back(makeBox(-3,-3,-2,-2));
+
+    RTree rtree(2);
+    rtree.Build(list_boxes);
+    assert(rtree.GetCount() == 4);
+    assert(rtree.GetDepth() == 2);
+
+    // touching counts as overlapping
+    std::vector<size_t> list_indices;
+    rtree.Query(makeBox(1,1,1,1),list_indices);
+    assert((list_indices == std::vector<size_t>{0,1}));
+
+    list_indices.clear();
+    rtree.Query(makeBox(4,4,6,6),list_indices);
+    assert((list_indices == std::vector<size_t>{2}));
+
+    list_indices.clear();
+    rtree.Query(makeBox(2.5,-10,4.5,10),list_indices);
+    assert(list_indices.empty());
+
+    // results are appended
+    list_indices.assign(1,99);
+    rtree.Query(makeBox(-10,-10,10,10),list_indices);
+    assert((list_indices == std::vector<size_t>{99,0,1,2,3}));
+
+    std::cout << "testQueryEdges... [ok]" << std::endl;
+}
+
+void testQueryRandom()
+{
+    // against brute force for several node sizes,
+    // including counts that leave partial nodes
+    size_t const list_counts[] = { 1, 15, 16, 17, 257, 5000 };
+    size_t const list_node_sizes[] = { 2, 4, 16, 64 };
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> dist_pos(-200.0,200.0);
+    std::uniform_real_distribution<double> dist_size(0.0,60.0);
+
+    for(size_t count : list_counts) {
+        std::vector<Box> list_boxes = randomBoxes(count,10.0,unsigned(count));
+        for(size_t node_size : list_node_sizes) {
+            RTree rtree(node_size);
+            rtree.Build(list_boxes);
+            assert(rtree.GetCount() == count);
+
+            for(size_t q=0; q < 200; q++) {
+                double const x = dist_pos(rng);
+                double const y = dist_pos(rng)/2;
+                Box const query = makeBox(x,y,x+dist_size(rng),y+dist_size(rng));
+
+                std::vector<size_t> list_indices;
+                rtree.Query(query,list_indices);
+                assert(list_indices == bruteForce(list_boxes,query));
+            }
+        }
+    }
+
+    // integer coordinates, as the ptk tools use
+    PackedRTree<int64_t> int_rtree;
+    std::vector<PackedRTree<int64_t>::Box> list_int_boxes;
+    for(int64_t y=0; y < 100; y++) {
+        for(int64_t x=0; x < 100; x++) {
+            PackedRTree<int64_t>::Box box;
+            box.min_x = x*10000000000LL;
+            box.min_y = y*10000000000LL;
+            box.max_x = box.min_x+5000000000LL;
+            box.max_y = box.min_y+5000000000LL;
+            list_int_boxes.push_back(box);
+        }
+    }
+    int_rtree.Build(list_int_boxes);
+
+    PackedRTree<int64_t>::Box int_query;
+    int_query.min_x = 10*10000000000LL;
+    int_query.min_y = 20*10000000000LL;
+    int_query.max_x = 12*10000000000LL;
+    int_query.max_y = 20*10000000000LL;
+
+    std::vector<size_t> list_indices;
+    int_rtree.Query(int_query,list_indices);
+    assert((list_indices == std::vector<size_t>{2010,2011,2012}));
+
+    std::cout << "testQueryRandom... [ok]" << std::endl;
+}
+
+// ============================================================= //
+
+void benchQuery()
+{
+    // a grid of 1 degree cells over boxes sized
+    // roughly like land polygons after repair
+    std::vector<Box> list_boxes = randomBoxes(200000,0.5,3);
+
+    std::vector<Box> list_cells;
+    for(int y=-90; y < 90; y++) {
+        for(int x=-180; x < 180; x++) {
+            list_cells.push_back(makeBox(x,y,x+1,y+1));
+        }
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    size_t brute_count = 0;
+    for(size_t i=0; i < list_cells.size(); i+=16) {
+        brute_count += bruteForce(list_boxes,list_cells[i]).size();
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    RTree rtree;
+    rtree.Build(list_boxes);
+
+    auto t2 = std::chrono::steady_clock::now();
+    size_t rtree_count = 0;
+    std::vector<size_t> list_indices;
+    for(size_t i=0; i < list_cells.size(); i+=16) {
+        list_indices.clear();
+        rtree.Query(list_cells[i],list_indices);
+        rtree_count += list_indices.size();
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    assert(brute_count == rtree_count);
+
+    auto ms = [](std::chrono::steady_clock::time_point a,
+                 std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration<double,std::milli>(b-a).count();
+    };
+
+    std::cout << "benchQuery: " << list_boxes.size() << " boxes, "
+              << list_cells.size()/16 << " cells, "
+              << rtree_count << " hits" << std::endl;
+    std::cout << "benchQuery: brute force: " << ms(t0,t1) << "ms" << std::endl;
+    std::cout << "benchQuery: build: " << ms(t1,t2) << "ms" << std::endl;
+    std::cout << "benchQuery: rtree: " << ms(t2,t3) << "ms" << std::endl;
+}
+
+// ============================================================= //
+
+int main()
+{
+    testQueryEmpty();
+    testQueryEdges();
+    testQueryRandom();
+    benchQuery();
+    return 0;
+}
@@ -15,9 +15,67 @@
 */
 
 #include <smlog.h>
+#include <RecordRing.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <thread>
 
 namespace smlog
 {
+    namespace
+    {
+        using scratch::RecordRing;
+
+        uint8_t const k_all_levels = 0x3F;
+
+        uint64_t getTimeNs()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // each thread's rings, keyed by the id of the
+        // Logger they belong to
+        struct ThreadRings
+        {
+            std::vector<std::pair<uint64_t,std::shared_ptr<RecordRing>>> list_rings;
+        };
+
+        thread_local ThreadRings t_rings;
+
+        std::atomic<uint64_t> s_async_logger_id(0);
+    }
+
+    // ============================================================= //
+
+    struct Logger::AsyncState
+    {
+        AsyncOptions options;
+        uint64_t id;
+
+        // rings of all threads that have logged; a ring
+        // whose thread has exited is only held here
+        std::mutex rings_mutex;
+        std::vector<std::shared_ptr<RecordRing>> list_rings;
+        uint64_t dropped_retired; // by rings no longer listed
+
+        // only one thread drains at a time (the drain
+        // thread or a caller of Flush)
+        std::mutex drain_mutex;
+        std::vector<RecordRing::Record> list_records;
+        std::vector<size_t> list_order;
+        uint64_t dropped_reported;
+
+        std::mutex wake_mutex;
+        std::condition_variable wake_cv;
+        bool wake;
+        bool quit;
+
+        std::thread thread;
+    };
+
     // ============================================================= //
 
     FBRunTimeMs::FBRunTimeMs() :
@@ -63,20 +121,23 @@ namespace smlog
         uint_fast8_t const secs_count = secs.count();
         uint_fast16_t const ms_count = ms.count();
 
-        m_time_str[0] = m_list_num_chars[hours_count/10];
-        m_time_str[1] = m_list_num_chars[hours_count%10];
+        // work on a copy so Get can be called from
+        // several threads (ie. in async mode)
+        std::string time_str(m_time_str);
+        time_str[0] = m_list_num_chars[hours_count/10];
+        time_str[1] = m_list_num_chars[hours_count%10];
 
-        m_time_str[3] = m_list_num_chars[mins_count/10];
-        m_time_str[4] = m_list_num_chars[mins_count%10];
+        time_str[3] = m_list_num_chars[mins_count/10];
+        time_str[4] = m_list_num_chars[mins_count%10];
 
-        m_time_str[6] = m_list_num_chars[secs_count/10];
-        m_time_str[7] = m_list_num_chars[secs_count%10];
+        time_str[6] = m_list_num_chars[secs_count/10];
+        time_str[7] = m_list_num_chars[secs_count%10];
 
-        m_time_str[9] = m_list_num_chars[ms_count/100];
-        m_time_str[10] = m_list_num_chars[(ms_count%100)/10];
-        m_time_str[11] = m_list_num_chars[(ms_count%100)%10];
+        time_str[9] = m_list_num_chars[ms_count/100];
+        time_str[10] = m_list_num_chars[(ms_count%100)/10];
+        time_str[11] = m_list_num_chars[(ms_count%100)%10];
 
-        return m_time_str;
+        return time_str;
     }
 
     FBCustomStr::FBCustomStr(std::string const &s) : m_s(s)
@@ -96,22 +157,18 @@ namespace smlog
 
     // ============================================================= //
 
-    Logger::Logger()
+    Logger::Logger() :
+        m_filter(k_all_levels)
     {
         m_mutex.reset(new MutexSTL);
 
         // default filter is all on
-        m_filter.set(static_cast<size_t>(Level::TRACE));
-        m_filter.set(static_cast<size_t>(Level::DEBUG));
-        m_filter.set(static_cast<size_t>(Level::INFO));
-        m_filter.set(static_cast<size_t>(Level::WARN));
-        m_filter.set(static_cast<size_t>(Level::ERROR));
-        m_filter.set(static_cast<size_t>(Level::FATAL));
     }
 
     Logger::Logger(bool thread_safe,
                    std::shared_ptr<Sink> const &sink,
-                   std::array<std::vector<FormatBlock*>,6> && list_fbs)
+                   std::array<std::vector<FormatBlock*>,6> && list_fbs) :
+        m_filter(k_all_levels)
     {
         if(thread_safe) {
             m_mutex.reset(new MutexSTL);
@@ -133,12 +190,19 @@ namespace smlog
         }
 
         // default filter is all on
-        m_filter.set(static_cast<size_t>(Level::TRACE));
-        m_filter.set(static_cast<size_t>(Level::DEBUG));
-        m_filter.set(static_cast<size_t>(Level::INFO));
-        m_filter.set(static_cast<size_t>(Level::WARN));
-        m_filter.set(static_cast<size_t>(Level::ERROR));
-        m_filter.set(static_cast<size_t>(Level::FATAL));
+    }
+
+    Logger::~Logger()
+    {
+        if(m_async) {
+            {
+                std::lock_guard<std::mutex> lock(m_async->wake_mutex);
+                m_async->quit = true;
+            }
+            m_async->wake_cv.notify_one();
+            m_async->thread.join();
+            drainAsync();
+        }
     }
 
     bool Logger::AddSink(std::shared_ptr<Sink> const &new_sink)
@@ -181,16 +245,12 @@ namespace smlog
 
     void Logger::SetLevel(Level level)
     {
-        m_mutex->lock();
-        m_filter.set(static_cast<size_t>(level));
-        m_mutex->unlock();
+        m_filter.fetch_or(uint8_t(1 << static_cast<size_t>(level)));
     }
 
     void Logger::UnsetLevel(Level level)
     {
-        m_mutex->lock();
-        m_filter.reset(static_cast<size_t>(level));
-        m_mutex->unlock();
+        m_filter.fetch_and(uint8_t(~(1 << static_cast<size_t>(level))));
     }
 
     void Logger::AddFormatBlock(std::unique_ptr<FormatBlock> fb,
@@ -202,77 +262,245 @@ namespace smlog
         m_mutex->unlock();
     }
 
-    // logging methods
-    Logger::Line Logger::Trace()
+    void Logger::EnableAsync(AsyncOptions const &options)
     {
-        m_mutex->lock();
+        if(m_async) {
+            return;
+        }
 
-        size_t const level = static_cast<size_t>(Level::TRACE);
+        // the drain thread shares the sinks with AddSink
+        // and RemoveSink, so a real lock is needed
+        m_mutex.reset(new MutexSTL);
 
-        return Line(&m_list_sinks,
-                    &(m_list_fb[level]),
-                    m_mutex.get(),
-                    m_filter[level]);
+        m_async.reset(new AsyncState);
+        m_async->options = options;
+        m_async->id = ++s_async_logger_id;
+        m_async->dropped_retired = 0;
+        m_async->dropped_reported = 0;
+        m_async->wake = false;
+        m_async->quit = false;
+
+        AsyncState * async = m_async.get();
+        m_async->thread = std::thread([this,async]() {
+            std::unique_lock<std::mutex> lock(async->wake_mutex);
+            while(!async->quit) {
+                async->wake_cv.wait_for(lock,async->options.drain_interval,
+                                        [async]{ return async->wake || async->quit; });
+                async->wake = false;
+
+                lock.unlock();
+                drainAsync();
+                lock.lock();
+            }
+        });
     }
 
-    Logger::Line Logger::Debug()
+    void Logger::Flush()
     {
-        m_mutex->lock();
+        if(m_async) {
+            drainAsync();
+        }
+    }
 
-        size_t const level = static_cast<size_t>(Level::DEBUG);
+    uint64_t Logger::GetDroppedCount() const
+    {
+        if(!m_async) {
+            return 0;
+        }
 
-        return Line(&m_list_sinks,
-                    &(m_list_fb[level]),
-                    m_mutex.get(),
-                    m_filter[level]);
+        std::lock_guard<std::mutex> lock(m_async->rings_mutex);
+        uint64_t dropped = m_async->dropped_retired;
+        for(auto const &ring : m_async->list_rings) {
+            dropped += ring->GetDroppedCount();
+        }
+        return dropped;
     }
 
-    Logger::Line Logger::Info()
+    void Logger::pushAsync(uint8_t level, std::string const &line)
     {
-        m_mutex->lock();
+        AsyncState * async = m_async.get();
+
+        // find this thread's ring, creating it on first use
+        RecordRing * ring=nullptr;
+        for(auto const &id_ring : t_rings.list_rings) {
+            if(id_ring.first == async->id) {
+                ring = id_ring.second.get();
+                break;
+            }
+        }
+        if(ring == nullptr) {
+            // forget rings of Loggers that have been destroyed
+            auto &list_rings = t_rings.list_rings;
+            list_rings.erase(
+                        std::remove_if(
+                            list_rings.begin(),
+                            list_rings.end(),
+                            [](std::pair<uint64_t,std::shared_ptr<RecordRing>> const &id_ring) {
+                                return id_ring.second.use_count() == 1;
+                            }),
+                        list_rings.end());
+
+            std::shared_ptr<RecordRing> new_ring =
+                    std::make_shared<RecordRing>(async->options.buffer_size);
+            {
+                std::lock_guard<std::mutex> lock(async->rings_mutex);
+                async->list_rings.push_back(new_ring);
+            }
+            list_rings.emplace_back(async->id,new_ring);
+            ring = new_ring.get();
+        }
 
-        size_t const level = static_cast<size_t>(Level::INFO);
+        bool const fatal = (level == static_cast<uint8_t>(Level::FATAL));
+        bool const block = fatal ||
+                (async->options.overflow == AsyncOptions::Overflow::BLOCK);
 
-        return Line(&m_list_sinks,
-                    &(m_list_fb[level]),
-                    m_mutex.get(),
-                    m_filter[level]);
+        uint64_t const time_ns = getTimeNs();
+        while(!ring->TryPush(time_ns,level,line.data(),line.size())) {
+            if(!block) {
+                ring->AddDropped();
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(async->wake_mutex);
+                async->wake = true;
+            }
+            async->wake_cv.notify_one();
+            std::this_thread::yield();
+        }
+
+        if(fatal) {
+            drainAsync();
+        }
+        else if(ring->GetSize() > ring->GetCapacity()/2) {
+            {
+                std::lock_guard<std::mutex> lock(async->wake_mutex);
+                async->wake = true;
+            }
+            async->wake_cv.notify_one();
+        }
     }
 
-    Logger::Line Logger::Warn()
+    void Logger::drainAsync()
     {
+        AsyncState * async = m_async.get();
+        std::lock_guard<std::mutex> drain_lock(async->drain_mutex);
+
+        std::vector<std::shared_ptr<RecordRing>> list_rings;
+        uint64_t dropped;
+        {
+            std::lock_guard<std::mutex> lock(async->rings_mutex);
+            list_rings = async->list_rings;
+            dropped = async->dropped_retired;
+        }
+
+        size_t record_count=0;
+        for(auto const &ring : list_rings) {
+            ring->PopAll(async->list_records,record_count);
+            dropped += ring->GetDroppedCount();
+        }
+
+        // interleave the threads' lines by time
+        async->list_order.resize(record_count);
+        for(size_t i=0; i < record_count; i++) {
+            async->list_order[i] = i;
+        }
+        auto const &list_records = async->list_records;
+        std::stable_sort(async->list_order.begin(),
+                         async->list_order.end(),
+                         [&list_records](size_t a, size_t b) {
+                             return list_records[a].time_ns < list_records[b].time_ns;
+                         });
+
         m_mutex->lock();
+        for(size_t i : async->list_order) {
+            for(auto &sink : m_list_sinks) {
+                sink->log(list_records[i].data);
+            }
+        }
+        if(dropped > async->dropped_reported) {
+            std::string const line = "smlog: dropped " +
+                    to_string(dropped-async->dropped_reported) +
+                    " log lines";
+            for(auto &sink : m_list_sinks) {
+                sink->log(line);
+            }
+            async->dropped_reported = dropped;
+        }
+        m_mutex->unlock();
 
-        size_t const level = static_cast<size_t>(Level::WARN);
+        // rings only held here belong to threads that have
+        // exited; they were just emptied
+        {
+            std::lock_guard<std::mutex> lock(async->rings_mutex);
+            list_rings.clear();
+            auto &list = async->list_rings;
+            list.erase(std::remove_if(
+                           list.begin(),
+                           list.end(),
+                           [async](std::shared_ptr<RecordRing> const &ring) {
+                               bool const orphaned =
+                                       (ring.use_count() == 1) &&
+                                       (ring->GetSize() == 0);
+                               if(orphaned) {
+                                   async->dropped_retired += ring->GetDroppedCount();
+                               }
+                               return orphaned;
+                           }),
+                       list.end());
+        }
+    }
+
+    // logging methods
+    Logger::Line Logger::createLine(Level level)
+    {
+        size_t const level_idx = static_cast<size_t>(level);
+        bool const line_valid = (m_filter.load(std::memory_order_relaxed) >> level_idx) & 1;
+
+        if(m_async) {
+            return Line(&m_list_sinks,
+                        &(m_list_fb[level_idx]),
+                        m_mutex.get(),
+                        line_valid,
+                        this,
+                        static_cast<uint8_t>(level));
+        }
+
+        m_mutex->lock();
 
         return Line(&m_list_sinks,
-                    &(m_list_fb[level]),
+                    &(m_list_fb[level_idx]),
                     m_mutex.get(),
-                    m_filter[level]);
+                    line_valid);
     }
 
-    Logger::Line Logger::Error()
+    Logger::Line Logger::Trace()
     {
-        m_mutex->lock();
+        return createLine(Level::TRACE);
+    }
 
-        size_t const level = static_cast<size_t>(Level::ERROR);
+    Logger::Line Logger::Debug()
+    {
+        return createLine(Level::DEBUG);
+    }
 
-        return Line(&m_list_sinks,
-                    &(m_list_fb[level]),
-                    m_mutex.get(),
-                    m_filter[level]);
+    Logger::Line Logger::Info()
+    {
+        return createLine(Level::INFO);
     }
 
-    Logger::Line Logger::Fatal()
+    Logger::Line Logger::Warn()
     {
-        m_mutex->lock();
+        return createLine(Level::WARN);
+    }
 
-        size_t const level = static_cast<size_t>(Level::FATAL);
+    Logger::Line Logger::Error()
+    {
+        return createLine(Level::ERROR);
+    }
 
-        return Line(&m_list_sinks,
-                    &(m_list_fb[level]),
-                    m_mutex.get(),
-                    m_filter[level]);
+    Logger::Line Logger::Fatal()
+    {
+        return createLine(Level::FATAL);
     }
 
     // ============================================================= //
@@ -23,8 +23,10 @@
 #include <vector>
 #include <array>
 #include <ctime>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
 #include <mutex>
-#include <bitset>
 #include <iostream>
 #include <sstream>
 
@@ -73,6 +75,7 @@ namespace smlog
     // FBRunTimeMs
     // * format block that provides elapsed time since
     //   its creation in the format (00:00:00.000)
+    // * Get() is safe to call from several threads
     class FBRunTimeMs : public FormatBlock
     {
     public:
@@ -103,8 +106,34 @@ namespace smlog
 
     // ============================================================= //
 
+    // AsyncOptions
+    // * settings for Logger::EnableAsync
+    struct AsyncOptions
+    {
+        enum class Overflow : uint8_t
+        {
+            DROP,   // discard (and count) lines that don't fit
+            BLOCK   // wait for the drain thread to make room
+        };
+
+        // size of each logging thread's ring buffer in bytes,
+        // rounded up to a power of two
+        size_t buffer_size = 64*1024;
+
+        Overflow overflow = Overflow::BLOCK;
+
+        // the drain thread writes out lines at least this
+        // often, and sooner when a buffer gets half full
+        std::chrono::milliseconds drain_interval{20};
+    };
+
+    // ============================================================= //
+
     // Logger
     // * simple logging class with optional thread safety
+    // * in async mode (see EnableAsync) lines are queued
+    //   per thread and written by a background thread
+    //   instead of holding a lock around the sinks
     class Logger
     {
     private:
@@ -151,11 +180,15 @@ namespace smlog
             Line(std::vector<std::shared_ptr<Sink>> const * list_sinks,
                  std::vector<std::unique_ptr<FormatBlock>> const * list_fb,
                  Mutex * mutex,
-                 bool line_valid) :
+                 bool line_valid,
+                 Logger * async_logger=nullptr,
+                 uint8_t level=0) :
                 m_list_sinks(list_sinks),
                 m_list_fb(list_fb),
                 m_mutex(mutex),
-                m_line_valid(line_valid)
+                m_line_valid(line_valid),
+                m_async_logger(async_logger),
+                m_level(level)
             {
                 if(m_line_valid) {
                     // create the prefix
@@ -167,6 +200,14 @@ namespace smlog
 
             ~Line()
             {
+                if(m_async_logger) {
+                    // no lock was taken in async mode
+                    if(m_line_valid) {
+                        m_async_logger->pushAsync(m_level,m_line);
+                    }
+                    return;
+                }
+
                 if(m_line_valid) {
                     for(auto &sink : (*m_list_sinks)) {
                         sink->log(m_line);
@@ -205,10 +246,14 @@ namespace smlog
             std::vector<std::unique_ptr<FormatBlock>> const * m_list_fb;
             Mutex * m_mutex;
             bool const m_line_valid;
+            Logger * const m_async_logger;
+            uint8_t const m_level;
 
             std::string m_line;
         };
 
+        struct AsyncState;
+
     public:
         enum class Level : uint8_t
         {
@@ -241,6 +286,8 @@ namespace smlog
                std::shared_ptr<Sink> const &sink,
                std::array<std::vector<FormatBlock*>,6> && list_fbs);
 
+        ~Logger();
+
         bool AddSink(std::shared_ptr<Sink> const &new_sink);
         bool RemoveSink(std::shared_ptr<Sink> const &sink);
         void SetLevel(Level level);
@@ -248,6 +295,25 @@ namespace smlog
         void AddFormatBlock(std::unique_ptr<FormatBlock> fb,
                             Level level);
 
+        // Switches to async mode: lines are formatted on
+        // the calling thread, queued in a ring buffer owned
+        // by that thread and written to the sinks by a drain
+        // thread. Lines from different threads are written
+        // in time order within each drain.
+        // * Fatal() lines are never dropped and are flushed
+        //   to the sinks before the call returns
+        // * format blocks are read without a lock, so add
+        //   them first and make sure Get() is thread safe
+        // * call before logging from other threads
+        void EnableAsync(AsyncOptions const &options=AsyncOptions());
+
+        // Writes out everything queued so far; a no-op
+        // in sync mode
+        void Flush();
+
+        // Number of lines discarded with Overflow::DROP
+        uint64_t GetDroppedCount() const;
+
         // logging methods
         Line Trace();
         Line Debug();
@@ -257,18 +323,33 @@ namespace smlog
         Line Fatal();
 
     private:
+        Line createLine(Level level);
+        void pushAsync(uint8_t level, std::string const &line);
+        void drainAsync();
+
         template<typename T>
         static std::string to_string(T const &val)
         {
-            std::ostringstream oss;
+            // constructing a stream takes a global locale
+            // lock, so each thread reuses its own; an earlier
+            // val's operator<< may have left it in hex or with
+            // a different precision, so reset that too
+            static thread_local std::ostringstream oss;
+            oss.str(std::string());
+            oss.clear();
+            oss.flags(std::ios::fmtflags());
+            oss.precision(6);
+            oss.width(0);
+            oss.fill(' ');
             oss << val;
             return oss.str();
         }
 
         std::unique_ptr<Mutex> m_mutex;
         std::vector<std::shared_ptr<Sink>> m_list_sinks;
-        std::bitset<6> m_filter;
+        std::atomic<uint8_t> m_filter; // bit per Level
         std::array<std::vector<std::unique_ptr<FormatBlock>>,6> m_list_fb;
+        std::unique_ptr<AsyncState> m_async;
     };
 
 } // Log
@@ -0,0 +1,222 @@
+/*
+   Copyright (C) 2015 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <smlog_mmap.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace smlog
+{
+    namespace
+    {
+        // msync wants a page aligned address, and pages
+        // aren't 4K everywhere (16K/64K on some arm64/ppc64)
+        size_t getPageSize()
+        {
+            static size_t const page_size = []() {
+                long const size = sysconf(_SC_PAGESIZE);
+                return (size > 0) ? size_t(size) : size_t(4096);
+            }();
+            return page_size;
+        }
+
+        std::string getRotatedPath(std::string const &path, size_t index)
+        {
+            return (index == 0) ? path : (path+"."+std::to_string(index));
+        }
+    }
+
+    // ============================================================= //
+
+    SinkToMappedFile::SinkToMappedFile(Options const &options) :
+        m_options(options),
+        m_fd(-1),
+        m_data(nullptr),
+        m_size(0),
+        m_synced_size(0),
+        m_sync_failed(false)
+    {
+        // an earlier run's log is kept as path.1
+        rotateFiles();
+        openFile();
+    }
+
+    SinkToMappedFile::~SinkToMappedFile()
+    {
+        closeFile();
+    }
+
+    bool SinkToMappedFile::IsValid() const
+    {
+        return (m_data != nullptr);
+    }
+
+    void SinkToMappedFile::log(std::string const &line)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_data == nullptr) {
+            return;
+        }
+
+        auto const now = std::chrono::steady_clock::now();
+
+        // line plus newline, cut short if it could never fit
+        size_t const line_size = std::min(line.size(),m_options.file_size-1);
+        bool const expired =
+                (m_options.max_age.count() > 0) &&
+                (now-m_open_time >= m_options.max_age);
+
+        if((m_size+line_size+1 > m_options.file_size) || expired) {
+            closeFile();
+            rotateFiles();
+            if(!openFile()) {
+                return;
+            }
+        }
+
+        std::memcpy(m_data+m_size,line.data(),line_size);
+        m_data[m_size+line_size] = '\n';
+        m_size += line_size+1;
+
+        // hand finished pages to the kernel in batches
+        if((m_size-m_synced_size >= m_options.sync_bytes) ||
+           (now-m_sync_time >= m_options.sync_interval)) {
+            size_t const begin = m_synced_size & ~(getPageSize()-1);
+            if(msync(m_data+begin,m_size-begin,MS_ASYNC) != 0) {
+                // Sync and rotation still write out the whole
+                // file, so just say so once per file
+                if(!m_sync_failed) {
+                    std::cout << "ERROR: SinkToMappedFile: msync failed for "
+                              << m_options.path << ": "
+                              << std::strerror(errno) << std::endl;
+                    m_sync_failed = true;
+                }
+            }
+            m_synced_size = m_size;
+            m_sync_time = now;
+        }
+    }
+
+    bool SinkToMappedFile::Sync()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_data == nullptr) {
+            return false;
+        }
+        if(msync(m_data,m_size,MS_SYNC) != 0) {
+            std::cout << "ERROR: SinkToMappedFile: msync failed for "
+                      << m_options.path << ": "
+                      << std::strerror(errno) << std::endl;
+            return false;
+        }
+        m_synced_size = m_size;
+        m_sync_time = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    bool SinkToMappedFile::openFile()
+    {
+        m_fd = open(m_options.path.c_str(),O_RDWR | O_CREAT | O_TRUNC,0644);
+        if(m_fd < 0) {
+            std::cout << "ERROR: SinkToMappedFile: could not open "
+                      << m_options.path << std::endl;
+            return false;
+        }
+
+        // reserve the blocks up front so writing to the
+        // mapping can't fail with SIGBUS on a full disk
+        // (ftruncate alone leaves a sparse file)
+        int result = posix_fallocate(m_fd,0,off_t(m_options.file_size));
+        if(result != 0) {
+            result = ftruncate(m_fd,off_t(m_options.file_size));
+        }
+
+        // fault the pages in now rather than one at a
+        // time while logging
+        int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+        void * data = (result == 0) ?
+                    mmap(nullptr,m_options.file_size,PROT_READ | PROT_WRITE,
+                         flags,m_fd,0) : MAP_FAILED;
+
+        if(data == MAP_FAILED) {
+            std::cout << "ERROR: SinkToMappedFile: could not map "
+                      << m_options.path << std::endl;
+            close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+
+        m_data = static_cast<char*>(data);
+        m_size = 0;
+        m_synced_size = 0;
+        m_sync_failed = false;
+        m_open_time = std::chrono::steady_clock::now();
+        m_sync_time = m_open_time;
+        return true;
+    }
+
+    void SinkToMappedFile::closeFile()
+    {
+        if(m_data) {
+            if(msync(m_data,m_size,MS_SYNC) != 0) {
+                std::cout << "ERROR: SinkToMappedFile: msync failed for "
+                          << m_options.path << ": "
+                          << std::strerror(errno) << std::endl;
+            }
+            munmap(m_data,m_options.file_size);
+            m_data = nullptr;
+        }
+        if(m_fd >= 0) {
+            // drop the unused zero tail
+            if(ftruncate(m_fd,off_t(m_size)) == 0) {
+                fdatasync(m_fd);
+            }
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    void SinkToMappedFile::rotateFiles()
+    {
+        if(m_options.max_files <= 1) {
+            return; // path is just truncated on open
+        }
+
+        std::string const last =
+                getRotatedPath(m_options.path,m_options.max_files-1);
+        std::remove(last.c_str());
+
+        for(size_t i=m_options.max_files-1; i > 0; i--) {
+            std::string const from = getRotatedPath(m_options.path,i-1);
+            std::string const to = getRotatedPath(m_options.path,i);
+            std::rename(from.c_str(),to.c_str());
+        }
+    }
+
+    // ============================================================= //
+
+} // smlog
@@ -0,0 +1,98 @@
+/*
+   Copyright (C) 2015 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_SMLOG_MMAP_H
+#define SCRATCH_SMLOG_MMAP_H
+
+#include <smlog.h>
+
+namespace smlog
+{
+    // ============================================================= //
+
+    // SinkToMappedFile
+    // * appends lines to a preallocated, memory mapped file
+    //   so logging a line is a memcpy instead of a write()
+    // * the file is rotated when it fills up or gets older
+    //   than max_age: path becomes path.1, path.1 becomes
+    //   path.2 and so on, keeping max_files in total
+    // * the mapped region starts out zero filled, so after
+    //   a crash the log ends at the first NUL; a line the
+    //   crash cut short has no trailing newline. A closed
+    //   file is truncated to the lines it holds
+    // * dirty pages are handed to the kernel with msync
+    //   (MS_ASYNC) every sync_bytes or sync_interval, and
+    //   written out with MS_SYNC on Sync and rotation
+    // * POSIX only
+    class SinkToMappedFile : public Sink
+    {
+    public:
+        struct Options
+        {
+            std::string path;
+
+            // size of each file, preallocated up front
+            size_t file_size = 16*1024*1024;
+
+            // rotate after this long, 0 to only rotate
+            // when the file is full
+            std::chrono::seconds max_age{0};
+
+            // path and up to max_files-1 rotated files
+            size_t max_files = 4;
+
+            size_t sync_bytes = 1024*1024;
+            std::chrono::milliseconds sync_interval{1000};
+        };
+
+        explicit SinkToMappedFile(Options const &options);
+        ~SinkToMappedFile();
+
+        // No copying allowed
+        SinkToMappedFile(SinkToMappedFile const &)              = delete;
+        SinkToMappedFile & operator=(SinkToMappedFile const &)  = delete;
+
+        // false if the file couldn't be created or mapped
+        bool IsValid() const;
+
+        void log(std::string const &line);
+
+        // Blocks until everything logged so far is on
+        // disk; false if it couldn't be written out
+        bool Sync();
+
+    private:
+        bool openFile();
+        void closeFile();
+        void rotateFiles();
+
+        Options const m_options;
+
+        std::mutex m_mutex;
+        int m_fd;
+        char * m_data;
+        size_t m_size;          // bytes of lines in the file
+        size_t m_synced_size;   // bytes handed to msync
+        bool m_sync_failed;     // an async msync failed
+        std::chrono::steady_clock::time_point m_open_time;
+        std::chrono::steady_clock::time_point m_sync_time;
+    };
+
+    // ============================================================= //
+
+} // smlog
+
+#endif // SCRATCH_SMLOG_MMAP_H
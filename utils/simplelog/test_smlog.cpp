@@ -26,9 +26,17 @@
 #include <mutex>
 #include <sstream>
 #include <thread>
+#include <cassert>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <iomanip>
 
 // ilim
 #include <smlog.h>
+#include <smlog_mmap.h>
 
 // android
 #ifdef ANDROID_LOGCAT
@@ -74,6 +82,336 @@ private:
 #endif
 
 
+// SinkToNull
+// * writes lines to /dev/null and flushes each one like
+//   SinkToStdOut does, without filling up the console
+class SinkToNull : public smlog::Sink
+{
+public:
+    SinkToNull() :
+        m_line_count(0),
+        m_file(std::fopen("/dev/null","w"))
+    {
+        // empty
+    }
+
+    ~SinkToNull()
+    {
+        if(m_file) {
+            std::fclose(m_file);
+        }
+    }
+
+    void log(std::string const &line)
+    {
+        if(m_file) {
+            std::fwrite(line.data(),1,line.size(),m_file);
+            std::fputc('\n',m_file);
+            std::fflush(m_file);
+        }
+        m_last_line = line;
+        m_line_count++;
+    }
+
+    std::string m_last_line;
+    std::atomic<uint64_t> m_line_count;
+
+private:
+    std::FILE * m_file;
+};
+
+
+// Logs from thread_count threads at once and reports the
+// time each logging call takes on the calling thread. Each
+// thread does a few microseconds of work per line like a
+// tile worker would
+void benchLogThreads(size_t thread_count,
+                     bool async,
+                     smlog::AsyncOptions::Overflow overflow)
+{
+    size_t const lines_per_thread = 10000;
+
+    std::shared_ptr<SinkToNull> sink = std::make_shared<SinkToNull>();
+    std::vector<uint64_t> list_call_ns(thread_count*lines_per_thread);
+    std::chrono::steady_clock::time_point start,end;
+    uint64_t dropped=0;
+
+    {
+        smlog::Logger log;
+        log.AddSink(sink);
+        log.AddFormatBlock(std::unique_ptr<smlog::FormatBlock>(
+                               new smlog::FBRunTimeMs()),
+                           smlog::Logger::Level::INFO);
+        log.AddFormatBlock(std::unique_ptr<smlog::FormatBlock>(
+                               new smlog::FBCustomStr(" INFO: BENCH: ")),
+                           smlog::Logger::Level::INFO);
+
+        if(async) {
+            smlog::AsyncOptions options;
+            options.overflow = overflow;
+            log.EnableAsync(options);
+        }
+
+        std::vector<std::thread> list_threads;
+        start = std::chrono::steady_clock::now();
+        for(size_t t=0; t < thread_count; t++) {
+            list_threads.emplace_back([&,t]() {
+                uint64_t * call_ns = &(list_call_ns[t*lines_per_thread]);
+                for(size_t i=0; i < lines_per_thread; i++) {
+                    auto const work_end = std::chrono::steady_clock::now()+
+                            std::chrono::microseconds(5);
+                    while(std::chrono::steady_clock::now() < work_end) {
+                        // spin
+                    }
+
+                    auto const call_start = std::chrono::steady_clock::now();
+                    log.Info() << "tile " << t << "/" << i
+                               << " loaded in " << 1.2345 << "ms";
+                    auto const call_end = std::chrono::steady_clock::now();
+                    call_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                call_end-call_start).count();
+                }
+            });
+        }
+        for(auto &thread : list_threads) {
+            thread.join();
+        }
+        end = std::chrono::steady_clock::now();
+
+        log.Flush();
+        dropped = log.GetDroppedCount();
+    }
+
+    std::sort(list_call_ns.begin(),list_call_ns.end());
+    double mean_ns=0;
+    for(uint64_t ns : list_call_ns) {
+        mean_ns += ns;
+    }
+    mean_ns /= list_call_ns.size();
+
+    double const wall_ms =
+            std::chrono::duration<double>(end-start).count()*1000.0;
+
+    std::cout << "benchLogThreads: " << thread_count << " threads, "
+              << (async ? (overflow == smlog::AsyncOptions::Overflow::DROP ?
+                               "async (drop)" : "async (block)") : "sync")
+              << ": " << mean_ns << " ns/record"
+              << ", p99: " << list_call_ns[list_call_ns.size()*99/100] << " ns"
+              << ", wall: " << wall_ms << "ms"
+              << ", written: " << sink->m_line_count
+              << ", dropped: " << dropped << std::endl;
+
+    // nothing gets lost unless dropping is allowed; with
+    // drops the sink also gets a line saying how many
+    if(overflow == smlog::AsyncOptions::Overflow::BLOCK || !async) {
+        assert(sink->m_line_count == list_call_ns.size());
+    }
+    else {
+        assert(sink->m_line_count+dropped >= list_call_ns.size());
+    }
+}
+
+
+void testAsyncFatal()
+{
+    std::shared_ptr<SinkToNull> sink = std::make_shared<SinkToNull>();
+
+    smlog::Logger log;
+    log.AddSink(sink);
+
+    // a buffer this small fills up on the first lines,
+    // but a fatal line is never dropped and is written
+    // out before Fatal() returns
+    smlog::AsyncOptions options;
+    options.buffer_size = 256;
+    options.overflow = smlog::AsyncOptions::Overflow::DROP;
+    options.drain_interval = std::chrono::milliseconds(1000);
+    log.EnableAsync(options);
+
+    for(size_t i=0; i < 100; i++) {
+        log.Info() << "filler line " << i;
+    }
+    log.Fatal() << "fatal line";
+    assert(sink->m_last_line == "fatal line");
+
+    std::cout << "testAsyncFatal... [ok]" << std::endl;
+}
+
+
+// SinkToOfstream
+// * writes lines with std::ofstream; with flush_lines set
+//   each line is flushed (one write() per line) the way
+//   SinkToStdOut does with std::endl
+class SinkToOfstream : public smlog::Sink
+{
+public:
+    SinkToOfstream(std::string const &path, bool flush_lines) :
+        m_file(path.c_str()),
+        m_flush_lines(flush_lines)
+    {
+        // empty
+    }
+
+    void log(std::string const &line)
+    {
+        m_file << line << '\n';
+        if(m_flush_lines) {
+            m_file.flush();
+        }
+    }
+
+private:
+    std::ofstream m_file;
+    bool const m_flush_lines;
+};
+
+
+std::string readFile(std::string const &path)
+{
+    std::ifstream file(path.c_str(),std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+}
+
+
+void testMappedFileSink()
+{
+    std::string const path = "smlog_test_mmap.log";
+
+    smlog::SinkToMappedFile::Options options;
+    options.path = path;
+    options.file_size = 4000;
+    options.max_files = 3;
+    options.sync_bytes = 250; // async msyncs that start mid page
+
+    std::string expected;
+    {
+        smlog::SinkToMappedFile sink(options);
+        assert(sink.IsValid());
+
+        // 40 lines of 100 bytes fill the first file up
+        for(size_t i=0; i < 40; i++) {
+            std::string line = "line " + std::to_string(i) + " ";
+            line.resize(99,'.');
+            sink.log(line);
+            expected += line + "\n";
+        }
+        assert(sink.Sync());
+
+        // the open file is still full size; what a reader
+        // sees after a crash ends at the first NUL
+        std::string const current = readFile(path);
+        assert(current.size() == options.file_size);
+        assert(std::string(current.c_str()) == expected);
+
+        // full, so this goes to a new file
+        sink.log("rotated");
+    }
+
+    // closed files are truncated to their lines
+    assert(readFile(path+".1") == expected);
+    assert(readFile(path) == "rotated\n");
+
+    // a new sink keeps the old log as path.1
+    {
+        smlog::SinkToMappedFile sink(options);
+        sink.log("restarted");
+    }
+    assert(readFile(path) == "restarted\n");
+    assert(readFile(path+".1") == "rotated\n");
+    assert(readFile(path+".2") == expected);
+
+    // max_files is 3, so the oldest is gone after this
+    {
+        smlog::SinkToMappedFile sink(options);
+    }
+    assert(readFile(path+".2") == "rotated\n");
+    assert(readFile(path+".3").empty());
+
+    for(size_t i=0; i < 3; i++) {
+        std::remove((i == 0) ? path.c_str() : (path+"."+std::to_string(i)).c_str());
+    }
+
+    std::cout << "testMappedFileSink... [ok]" << std::endl;
+}
+
+
+// Time to write lines and close the file. Buffered
+// ofstream loses up to a buffer of lines if the process
+// dies; the other two keep every line logged so far
+void benchFileSinks()
+{
+    size_t const line_count = 200000;
+    std::string const path = "smlog_bench.log";
+    std::string const line =
+            "00:00:01.234 INFO: TILES: tile 12/2048/1361 loaded in 1.2345ms";
+
+    for(size_t mode=0; mode < 3; mode++) {
+        char const * name="";
+        std::unique_ptr<smlog::Sink> sink;
+        if(mode == 0) {
+            name = "ofstream (flush per line)";
+            sink.reset(new SinkToOfstream(path,true));
+        }
+        else if(mode == 1) {
+            name = "ofstream (buffered)";
+            sink.reset(new SinkToOfstream(path,false));
+        }
+        else {
+            name = "mapped file";
+            smlog::SinkToMappedFile::Options options;
+            options.path = path;
+            options.max_files = 1;
+            sink.reset(new smlog::SinkToMappedFile(options));
+        }
+
+        auto const start = std::chrono::steady_clock::now();
+        for(size_t i=0; i < line_count; i++) {
+            sink->log(line);
+        }
+        sink.reset(); // include closing the file
+        auto const end = std::chrono::steady_clock::now();
+
+        double const secs = std::chrono::duration<double>(end-start).count();
+        std::cout << "benchFileSinks: " << name << ": "
+                  << secs*1e9/line_count << " ns/line, "
+                  << (line.size()+1)*line_count/secs/(1024*1024) << " MB/s"
+                  << std::endl;
+
+        assert(readFile(path).size() == (line.size()+1)*line_count);
+    }
+
+    std::remove(path.c_str());
+}
+
+
+// leaves the stream it's written to in hex
+struct HexValue
+{
+    int value;
+};
+
+std::ostream & operator << (std::ostream &os, HexValue const &hex_value)
+{
+    return os << std::hex << std::setprecision(2) << hex_value.value;
+}
+
+void testStreamState()
+{
+    std::shared_ptr<SinkToNull> sink = std::make_shared<SinkToNull>();
+    smlog::Logger log;
+    log.AddSink(sink);
+
+    log.Info() << HexValue{255};
+    assert(sink->m_last_line == "ff");
+
+    // the next line starts with the stream in its default state
+    log.Info() << 255 << " " << 1.2345;
+    assert(sink->m_last_line == "255 1.2345");
+
+    std::cout << "testStreamState... [ok]" << std::endl;
+}
+
 void testLog(smlog::Logger &log)
 {
     log.Trace() << "This is a typical trace message, here are some values {"
@@ -147,6 +485,26 @@ int main()
     std::cout << std::endl;
     testLog(log);
 
+    // the same lines through the drain thread
+    log.EnableAsync();
+    std::cout << std::endl;
+    testLog(log);
+    log.Flush();
+
+    std::cout << std::endl;
+    testAsyncFatal();
+    testMappedFileSink();
+    testStreamState();
+    benchFileSinks();
+
+    size_t const max_threads =
+            std::max(4u,std::thread::hardware_concurrency());
+    for(size_t thread_count=1; thread_count <= max_threads; thread_count *= 2) {
+        benchLogThreads(thread_count,false,smlog::AsyncOptions::Overflow::BLOCK);
+        benchLogThreads(thread_count,true,smlog::AsyncOptions::Overflow::BLOCK);
+        benchLogThreads(thread_count,true,smlog::AsyncOptions::Overflow::DROP);
+    }
+
     return 0;
 }
 
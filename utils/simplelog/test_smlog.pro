@@ -4,7 +4,15 @@ CONFIG      -= qt
 
 INCLUDEPATH += $${PWD}
 
-HEADERS += smlog.h
-SOURCES += smlog.cpp test_smlog.cpp
+HEADERS += smlog.h smlog_mmap.h
 
+# recordring
+PATH_RECORDRING = $$PWD/../recordring
+INCLUDEPATH += $${PATH_RECORDRING}
+HEADERS += $${PATH_RECORDRING}/RecordRing.h
+SOURCES += smlog.cpp smlog_mmap.cpp test_smlog.cpp
+
+# need these flags for gcc 4.8.x bug for threads
+QMAKE_LFLAGS += -Wl,--no-as-needed
+LIBS += -lpthread
 QMAKE_CXXFLAGS += -std=c++11
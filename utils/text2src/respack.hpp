@@ -0,0 +1,615 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_RESPACK_H
+#define SCRATCH_RESPACK_H
+
+// sys
+#include <cstdint>
+#include <cstring>
+
+// stl
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RESPACK_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Resource packs
+// * text2src --pack writes a set of files into a single blob
+//   (name.pack) along with a header (name.hpp) that has a
+//   constexpr index of every entry, so assets don't have to
+//   be compiled in as giant string literals
+// * every entry starts on a k_align boundary in the blob, so
+//   uncompressed entries can be used straight from the mapping
+// * entries can be stored LZ4 compressed (the LZ4 block format,
+//   readable by LZ4_decompress_safe); compressed entries have to
+//   be copied out with Pack::read
+// * Pack::open maps the blob read only; the index in the blob
+//   is checked against the generated header with the index hash
+//
+// blob layout, all values little endian:
+//   header  [magic:8][version:4][entry count:4][index hash:8]
+//   entries [name hash:8][offset:8][size:8][raw size:8]
+//           [hash:8][method:4][name offset:4]
+//   names   NUL terminated
+//   data    each entry aligned to k_align
+
+namespace respack
+{
+    enum class Method : uint32_t {
+        NONE = 0,
+        LZ4  = 1
+    };
+
+    struct Entry
+    {
+        char const * name;
+        uint64_t offset;    // from the start of the blob
+        uint64_t size;      // stored size
+        uint64_t raw_size;  // size once decompressed
+        uint64_t hash;      // of the raw data
+        Method method;
+    };
+
+    char const k_magic[8] = {'R','E','S','P','A','C','K','1'};
+    uint32_t const k_version = 1;
+    uint64_t const k_align = 64;
+    uint64_t const k_header_size = 24;
+    uint64_t const k_entry_size = 48;
+
+    // ============================================================= //
+
+    // 64-bit FNV-1a, usable in constant expressions so the
+    // generated index can be searched at compile time
+    constexpr uint64_t k_fnv_basis = 14695981039346656037ULL;
+    constexpr uint64_t k_fnv_prime = 1099511628211ULL;
+
+    constexpr uint64_t calc_hash(char const * str,
+                                 uint64_t hash=k_fnv_basis)
+    {
+        return (*str == 0) ? hash :
+            calc_hash(str+1,(hash^uint8_t(*str))*k_fnv_prime);
+    }
+
+    inline uint64_t calc_hash(uint8_t const * data,
+                              size_t size,
+                              uint64_t hash=k_fnv_basis)
+    {
+        for(size_t i=0; i < size; i++) {
+            hash = (hash^data[i])*k_fnv_prime;
+        }
+        return hash;
+    }
+
+    constexpr bool str_equal(char const * a, char const * b)
+    {
+        return (*a != *b) ? false :
+               (*a == 0) ? true : str_equal(a+1,b+1);
+    }
+
+    // Returns the index of the entry called name,
+    // or count if there isn't one
+    constexpr size_t find_entry(Entry const * list_entries,
+                                size_t count,
+                                char const * name,
+                                size_t index=0)
+    {
+        return (index == count) ? count :
+               str_equal(list_entries[index].name,name) ? index :
+               find_entry(list_entries,count,name,index+1);
+    }
+
+    // ============================================================= //
+
+    namespace respack_detail
+    {
+        inline uint32_t read_u32(uint8_t const * p)
+        {
+            return uint32_t(p[0]) | (uint32_t(p[1]) << 8) |
+                   (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+        }
+
+        inline uint64_t read_u64(uint8_t const * p)
+        {
+            return uint64_t(read_u32(p)) | (uint64_t(read_u32(p+4)) << 32);
+        }
+
+        inline void write_u32(std::vector<uint8_t> &out, uint32_t v)
+        {
+            for(int i=0; i < 4; i++) {
+                out.push_back(uint8_t(v >> (i*8)));
+            }
+        }
+
+        inline void write_u64(std::vector<uint8_t> &out, uint64_t v)
+        {
+            write_u32(out,uint32_t(v));
+            write_u32(out,uint32_t(v >> 32));
+        }
+
+        inline void write_length(std::vector<uint8_t> &out, size_t length)
+        {
+            while(length >= 255) {
+                out.push_back(255);
+                length -= 255;
+            }
+            out.push_back(uint8_t(length));
+        }
+
+        inline void write_sequence(std::vector<uint8_t> &out,
+                                   uint8_t const * literals,
+                                   size_t literal_count,
+                                   size_t offset,
+                                   size_t match_length)
+        {
+            // match_length is 0 for the final, literal only sequence
+            size_t const match_code = (match_length > 0) ? match_length-4 : 0;
+            uint8_t token = uint8_t((std::min<size_t>(literal_count,15) << 4) |
+                                    std::min<size_t>(match_code,15));
+            out.push_back(token);
+            if(literal_count >= 15) {
+                write_length(out,literal_count-15);
+            }
+            out.insert(out.end(),literals,literals+literal_count);
+
+            if(match_length > 0) {
+                out.push_back(uint8_t(offset));
+                out.push_back(uint8_t(offset >> 8));
+                if(match_code >= 15) {
+                    write_length(out,match_code-15);
+                }
+            }
+        }
+    }
+
+    // Compresses data into an LZ4 block (greedy, single hash
+    // probe). Returns false if it came out no smaller, in which
+    // case the entry should just be stored
+    inline bool compress_lz4(uint8_t const * data,
+                             size_t size,
+                             std::vector<uint8_t> &out)
+    {
+        using namespace respack_detail;
+
+        // format limits: the last match starts at least 12 bytes
+        // before the end and the last 5 bytes are literals
+        size_t const k_min_match = 4;
+        size_t const k_match_limit = 12;
+        size_t const k_last_literals = 5;
+        size_t const k_max_offset = 65535;
+        size_t const k_hash_bits = 14;
+
+        out.clear();
+        out.reserve(size);
+
+        std::vector<uint32_t> list_table(size_t(1) << k_hash_bits,0);
+        auto hash_at = [&](size_t i) {
+            uint32_t v;
+            std::memcpy(&v,data+i,4);
+            return (v*2654435761U) >> (32-k_hash_bits);
+        };
+
+        size_t anchor = 0;
+        size_t i = 0;
+        if(size > k_match_limit) {
+            size_t const match_end = size-k_match_limit;
+            while(i < match_end) {
+                uint32_t const h = hash_at(i);
+                size_t const candidate = list_table[h];
+                list_table[h] = uint32_t(i);
+
+                if(candidate >= i || i-candidate > k_max_offset ||
+                   std::memcmp(data+candidate,data+i,k_min_match) != 0) {
+                    i++;
+                    continue;
+                }
+
+                // extend forwards, stopping short of the literal tail
+                size_t length = k_min_match;
+                size_t const length_limit = size-k_last_literals-i;
+                while(length < length_limit &&
+                      data[candidate+length] == data[i+length]) {
+                    length++;
+                }
+
+                write_sequence(out,data+anchor,i-anchor,i-candidate,length);
+                i += length;
+                anchor = i;
+                if(i < match_end) {
+                    list_table[hash_at(i-2)] = uint32_t(i-2);
+                }
+            }
+        }
+
+        write_sequence(out,data+anchor,size-anchor,0,0);
+        return (out.size() < size);
+    }
+
+    // Decodes an LZ4 block that must expand to exactly raw_size
+    // bytes; returns false on malformed input
+    inline bool decompress_lz4(uint8_t const * data,
+                               size_t size,
+                               uint8_t * out,
+                               size_t raw_size)
+    {
+        uint8_t const * in = data;
+        uint8_t const * in_end = data+size;
+        size_t pos = 0;
+
+        auto read_length = [&](size_t &length) {
+            uint8_t b;
+            do {
+                if(in == in_end) {
+                    return false;
+                }
+                b = *in++;
+                length += b;
+            }
+            while(b == 255);
+            return true;
+        };
+
+        while(in < in_end) {
+            uint8_t const token = *in++;
+
+            size_t literal_count = token >> 4;
+            if(literal_count == 15 && !read_length(literal_count)) {
+                return false;
+            }
+            if(size_t(in_end-in) < literal_count ||
+               raw_size-pos < literal_count) {
+                return false;
+            }
+            if(literal_count > 0) {
+                std::memcpy(out+pos,in,literal_count);
+            }
+            in += literal_count;
+            pos += literal_count;
+
+            if(in == in_end) {
+                break; // the last sequence has no match
+            }
+
+            if(in_end-in < 2) {
+                return false;
+            }
+            size_t const offset = size_t(in[0]) | (size_t(in[1]) << 8);
+            in += 2;
+
+            size_t length = token & 15;
+            if(length == 15 && !read_length(length)) {
+                return false;
+            }
+            length += 4;
+
+            if(offset == 0 || offset > pos || raw_size-pos < length) {
+                return false;
+            }
+
+            // matches can overlap the bytes they produce
+            uint8_t const * src = out+pos-offset;
+            for(size_t j=0; j < length; j++) {
+                out[pos+j] = src[j];
+            }
+            pos += length;
+        }
+
+        return (pos == raw_size);
+    }
+
+    // ============================================================= //
+
+    // Pack
+    // * read only view of a blob written by text2src --pack
+    class Pack
+    {
+    public:
+        Pack() :
+            m_data(nullptr),
+            m_size(0),
+            m_mapped(false),
+            m_index_hash(0)
+        {}
+
+        ~Pack()
+        {
+            close();
+        }
+
+        // No copying allowed
+        Pack(Pack const &)              = delete;
+        Pack & operator=(Pack const &)  = delete;
+
+        // Maps the blob at path. If index_hash isn't 0 it has
+        // to match the pack, ie. pass k_index_hash from the
+        // generated header to catch a stale blob
+        bool open(std::string const &path, uint64_t index_hash=0)
+        {
+            close();
+            if(!map_file(path) || !read_index()) {
+                close();
+                return false;
+            }
+            if(index_hash != 0 && index_hash != m_index_hash) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close()
+        {
+#ifdef RESPACK_USE_MMAP
+            if(m_mapped) {
+                munmap(const_cast<uint8_t*>(m_data),m_size);
+            }
+#endif
+            m_data = nullptr;
+            m_size = 0;
+            m_mapped = false;
+            m_index_hash = 0;
+            m_list_entries.clear();
+            m_buffer.clear();
+            m_buffer.shrink_to_fit();
+        }
+
+        bool is_open() const
+        {
+            return (m_data != nullptr);
+        }
+
+        uint64_t get_index_hash() const
+        {
+            return m_index_hash;
+        }
+
+        std::vector<Entry> const & get_entries() const
+        {
+            return m_list_entries;
+        }
+
+        // Returns nullptr if there's no entry called name
+        Entry const * find(char const * name) const
+        {
+            uint64_t const name_hash = calc_hash(name);
+            for(size_t i=0; i < m_list_entries.size(); i++) {
+                if(m_list_name_hashes[i] == name_hash &&
+                   std::strcmp(m_list_entries[i].name,name) == 0) {
+                    return &m_list_entries[i];
+                }
+            }
+            return nullptr;
+        }
+
+        // Stored bytes of an entry, without copying. Only
+        // the raw data for Method::NONE entries
+        uint8_t const * get_data(Entry const &entry) const
+        {
+            if(m_data == nullptr || entry.offset+entry.size > m_size) {
+                return nullptr;
+            }
+            return m_data+entry.offset;
+        }
+
+        // Copies out an entry, decompressing it if needed
+        bool read(Entry const &entry, std::vector<uint8_t> &data) const
+        {
+            uint8_t const * stored = get_data(entry);
+            if(stored == nullptr) {
+                return false;
+            }
+
+            if(entry.method == Method::NONE) {
+                data.assign(stored,stored+entry.size);
+                return true;
+            }
+            if(entry.method == Method::LZ4) {
+                data.resize(entry.raw_size);
+                return decompress_lz4(stored,entry.size,
+                                      data.data(),entry.raw_size);
+            }
+            return false;
+        }
+
+    private:
+        bool map_file(std::string const &path)
+        {
+#ifdef RESPACK_USE_MMAP
+            int fd = ::open(path.c_str(),O_RDONLY);
+            if(fd < 0) {
+                return false;
+            }
+            struct stat info;
+            if(fstat(fd,&info) != 0 || info.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+            void * data = mmap(nullptr,size_t(info.st_size),
+                               PROT_READ,MAP_PRIVATE,fd,0);
+            ::close(fd);    // the mapping keeps the file open
+            if(data == MAP_FAILED) {
+                return false;
+            }
+            m_data = static_cast<uint8_t const*>(data);
+            m_size = size_t(info.st_size);
+            m_mapped = true;
+            return true;
+#else
+            std::ifstream file(path,std::ios::binary);
+            if(!file.is_open()) {
+                return false;
+            }
+            m_buffer.assign(std::istreambuf_iterator<char>(file),
+                            std::istreambuf_iterator<char>());
+            if(m_buffer.empty()) {
+                return false;
+            }
+            m_data = m_buffer.data();
+            m_size = m_buffer.size();
+            return true;
+#endif
+        }
+
+        bool read_index()
+        {
+            using namespace respack_detail;
+
+            if(m_size < k_header_size ||
+               std::memcmp(m_data,k_magic,8) != 0 ||
+               read_u32(m_data+8) != k_version) {
+                return false;
+            }
+
+            uint64_t const count = read_u32(m_data+12);
+            m_index_hash = read_u64(m_data+16);
+
+            uint64_t const names_begin = k_header_size+count*k_entry_size;
+            if(names_begin > m_size) {
+                return false;
+            }
+
+            m_list_entries.resize(size_t(count));
+            m_list_name_hashes.resize(size_t(count));
+            for(size_t i=0; i < count; i++) {
+                uint8_t const * p = m_data+k_header_size+i*k_entry_size;
+                Entry &entry = m_list_entries[i];
+                m_list_name_hashes[i] = read_u64(p);
+                entry.offset   = read_u64(p+8);
+                entry.size     = read_u64(p+16);
+                entry.raw_size = read_u64(p+24);
+                entry.hash     = read_u64(p+32);
+                entry.method   = Method(read_u32(p+40));
+
+                uint64_t const name_offset = names_begin+read_u32(p+44);
+                if(name_offset >= m_size ||
+                   std::memchr(m_data+name_offset,0,m_size-name_offset) == nullptr ||
+                   entry.offset > m_size || entry.size > m_size-entry.offset) {
+                    return false;
+                }
+                entry.name = reinterpret_cast<char const*>(m_data+name_offset);
+            }
+            return true;
+        }
+
+        uint8_t const * m_data;
+        size_t m_size;
+        bool m_mapped;
+        uint64_t m_index_hash;
+        std::vector<Entry> m_list_entries;
+        std::vector<uint64_t> m_list_name_hashes;
+        std::vector<uint8_t> m_buffer;  // without mmap
+    };
+
+    // ============================================================= //
+
+    // Hash over the index fields (not the data) that the
+    // generated header and the blob both record
+    inline uint64_t calc_index_hash(std::vector<Entry> const &list_entries)
+    {
+        using namespace respack_detail;
+        std::vector<uint8_t> index;
+        for(auto const &entry : list_entries) {
+            index.insert(index.end(),entry.name,
+                         entry.name+std::strlen(entry.name)+1);
+            write_u64(index,entry.offset);
+            write_u64(index,entry.size);
+            write_u64(index,entry.raw_size);
+            write_u64(index,entry.hash);
+            write_u32(index,uint32_t(entry.method));
+        }
+        return calc_hash(index.data(),index.size());
+    }
+
+    // Sets up entry for the raw bytes in data. With use_lz4
+    // data is replaced by its compressed form if that's smaller
+    inline void store_entry(std::vector<uint8_t> &data,
+                            bool use_lz4,
+                            Entry &entry)
+    {
+        entry.raw_size = data.size();
+        entry.hash = calc_hash(data.data(),data.size());
+        entry.method = Method::NONE;
+
+        std::vector<uint8_t> compressed;
+        if(use_lz4 && compress_lz4(data.data(),data.size(),compressed)) {
+            entry.method = Method::LZ4;
+            data.swap(compressed);
+        }
+        entry.size = data.size();
+    }
+
+    // Writes the blob for entries set up with store_entry (and
+    // their stored bytes in list_data), filling in their names
+    // and offsets. Names point into list_names. Returns the
+    // index hash
+    inline uint64_t write_blob(std::vector<std::string> const &list_names,
+                               std::vector<std::vector<uint8_t>> const &list_data,
+                               std::vector<Entry> &list_entries,
+                               std::vector<uint8_t> &blob)
+    {
+        using namespace respack_detail;
+
+        std::string names;
+        std::vector<uint32_t> list_name_offsets;
+        for(auto const &name : list_names) {
+            list_name_offsets.push_back(uint32_t(names.size()));
+            names.append(name);
+            names.push_back('\0');
+        }
+
+        uint64_t offset = k_header_size+list_entries.size()*k_entry_size+names.size();
+        for(size_t i=0; i < list_entries.size(); i++) {
+            offset = (offset+k_align-1) & ~(k_align-1);
+            list_entries[i].offset = offset;
+            list_entries[i].name = list_names[i].c_str();
+            offset += list_entries[i].size;
+        }
+
+        uint64_t const index_hash = calc_index_hash(list_entries);
+
+        blob.assign(k_magic,k_magic+8);
+        write_u32(blob,k_version);
+        write_u32(blob,uint32_t(list_entries.size()));
+        write_u64(blob,index_hash);
+        for(size_t i=0; i < list_entries.size(); i++) {
+            Entry const &entry = list_entries[i];
+            write_u64(blob,calc_hash(entry.name));
+            write_u64(blob,entry.offset);
+            write_u64(blob,entry.size);
+            write_u64(blob,entry.raw_size);
+            write_u64(blob,entry.hash);
+            write_u32(blob,uint32_t(entry.method));
+            write_u32(blob,list_name_offsets[i]);
+        }
+        blob.insert(blob.end(),names.begin(),names.end());
+        for(size_t i=0; i < list_entries.size(); i++) {
+            blob.resize(list_entries[i].offset,0);
+            blob.insert(blob.end(),list_data[i].begin(),list_data[i].end());
+        }
+
+        return index_hash;
+    }
+}
+
+#endif // SCRATCH_RESPACK_H
@@ -0,0 +1,325 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <cassert>
+
+#include <respack.hpp>
+
+using namespace respack;
+
+// ============================================================= //
+
+std::vector<uint8_t> make_random(size_t size, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(size);
+    for(auto &b : data) {
+        b = uint8_t(rng());
+    }
+    return data;
+}
+
+// Walks the sequences of an LZ4 block and checks the rules
+// a stricter decoder than ours relies on: the last sequence
+// has no match, the last 5 bytes are literals and the last
+// match starts at least 12 bytes before the end
+bool check_lz4_rules(std::vector<uint8_t> const &block, size_t raw_size)
+{
+    size_t i=0;
+    size_t pos=0;
+    auto read_length = [&](size_t &length) {
+        uint8_t b;
+        do {
+            b = block[i++];
+            length += b;
+        }
+        while(b == 255);
+    };
+
+    while(i < block.size()) {
+        uint8_t const token = block[i++];
+        size_t literal_count = token >> 4;
+        if(literal_count == 15) {
+            read_length(literal_count);
+        }
+        i += literal_count;
+        pos += literal_count;
+        if(i == block.size()) {
+            // final, literal only sequence
+            return (pos == raw_size) &&
+                   (raw_size < 5 || literal_count >= 5);
+        }
+
+        i += 2;
+        size_t length = token & 15;
+        if(length == 15) {
+            read_length(length);
+        }
+        length += 4;
+
+        if(pos+12 > raw_size || pos+length+5 > raw_size) {
+            return false;
+        }
+        pos += length;
+    }
+    return false;
+}
+
+// Compresses and decompresses data; returns false if
+// compress_lz4 said it wasn't worth storing compressed
+bool round_trip(std::vector<uint8_t> const &data)
+{
+    std::vector<uint8_t> compressed;
+    bool const smaller = compress_lz4(data.data(),data.size(),compressed);
+    assert(smaller == (compressed.size() < data.size()));
+    assert(check_lz4_rules(compressed,data.size()));
+
+    std::vector<uint8_t> decompressed(data.size()+1,0xCD);
+    bool const ok = decompress_lz4(compressed.data(),compressed.size(),
+                                   decompressed.data(),data.size());
+    assert(ok);
+    assert(std::equal(data.begin(),data.end(),decompressed.begin()));
+    assert(decompressed.back() == 0xCD); // nothing written past the end
+    (void)ok;
+
+    return smaller;
+}
+
+// ============================================================= //
+
+void testLZ4Empty()
+{
+    std::vector<uint8_t> compressed;
+    assert(!compress_lz4(nullptr,0,compressed));
+    assert(compressed.size() == 1 && compressed[0] == 0);
+    assert(decompress_lz4(compressed.data(),compressed.size(),nullptr,0));
+
+    std::cout << "testLZ4Empty... [ok]" << std::endl;
+}
+
+void testLZ4Random()
+{
+    // small sizes sit around the 12 byte match limit
+    // and the 5 byte literal tail
+    size_t const list_sizes[] = {
+        1,4,5,11,12,13,16,17,64,255,256,270,4096,65535,65536,65537,300000
+    };
+    for(size_t size : list_sizes) {
+        bool const smaller = round_trip(make_random(size,uint32_t(size)));
+        assert(!smaller); // random data doesn't compress
+        (void)smaller;
+    }
+
+    std::cout << "testLZ4Random... [ok]" << std::endl;
+}
+
+void testLZ4Compressible()
+{
+    // runs of one byte: matches overlap their output
+    // and need long length codes
+    for(size_t size : {13,17,18,100,255+19,65536,1000000}) {
+        std::vector<uint8_t> data(size,'a');
+        bool const smaller = round_trip(data);
+        assert(smaller || size < 18);
+        (void)smaller;
+    }
+
+    // text
+    std::string text;
+    while(text.size() < 200000) {
+        text += "<tile x=\"" + std::to_string(text.size()%977) + "\" level=\"14\"/>\n";
+    }
+    std::vector<uint8_t> data(text.begin(),text.end());
+    std::vector<uint8_t> compressed;
+    assert(compress_lz4(data.data(),data.size(),compressed));
+    assert(compressed.size() < data.size()/4);
+    assert(round_trip(data));
+
+    // long literal runs between matches
+    std::vector<uint8_t> mixed;
+    for(int i=0; i < 8; i++) {
+        std::vector<uint8_t> const noise = make_random(300+i*97,uint32_t(i));
+        mixed.insert(mixed.end(),noise.begin(),noise.end());
+        mixed.insert(mixed.end(),noise.begin(),noise.begin()+200);
+    }
+    assert(round_trip(mixed));
+
+    std::cout << "testLZ4Compressible... [ok]" << std::endl;
+}
+
+void testLZ4Window()
+{
+    // a block repeated at distances around the 64KB
+    // match window; only offsets <= 65535 can be used
+    std::vector<uint8_t> const block = make_random(256,1);
+    for(size_t gap : {65535-256-1,65535-256,65535-256+1,70000}) {
+        std::vector<uint8_t> data = block;
+        std::vector<uint8_t> const filler = make_random(gap,2);
+        data.insert(data.end(),filler.begin(),filler.end());
+        data.insert(data.end(),block.begin(),block.end());
+        data.insert(data.end(),filler.begin(),filler.begin()+64);
+
+        std::vector<uint8_t> compressed;
+        compress_lz4(data.data(),data.size(),compressed);
+        round_trip(data);
+
+        // the repeat pays for the long literal runs
+        // around it only if it's within the window
+        bool const in_window = (gap+256 <= 65535);
+        assert((compressed.size() < data.size()) == in_window);
+        (void)in_window;
+    }
+
+    std::cout << "testLZ4Window... [ok]" << std::endl;
+}
+
+void testLZ4Malformed()
+{
+    std::vector<uint8_t> data(1000,'z');
+    std::vector<uint8_t> compressed;
+    compress_lz4(data.data(),data.size(),compressed);
+    std::vector<uint8_t> out(data.size());
+
+    // wrong raw size
+    assert(!decompress_lz4(compressed.data(),compressed.size(),out.data(),999));
+    assert(!decompress_lz4(compressed.data(),compressed.size(),out.data(),out.size()-1));
+
+    // every truncation fails instead of reading past the end
+    for(size_t size=0; size < compressed.size(); size++) {
+        std::vector<uint8_t> truncated(compressed.begin(),compressed.begin()+size);
+        assert(!decompress_lz4(truncated.data(),truncated.size(),out.data(),out.size()));
+    }
+
+    // offset reaching before the start
+    uint8_t const bad_offset[] = { 0x10,'a',0x05,0x00 };
+    assert(!decompress_lz4(bad_offset,sizeof(bad_offset),out.data(),5));
+
+    std::cout << "testLZ4Malformed... [ok]" << std::endl;
+}
+
+// ============================================================= //
+
+// the generated header's index is searched at compile time
+constexpr Entry k_list_test_entries[] = {
+    {"a",64,1,1,0,Method::NONE},
+    {"b/c.txt",128,1,1,0,Method::NONE}
+};
+static_assert(find_entry(k_list_test_entries,2,"b/c.txt") == 1,"find_entry");
+static_assert(find_entry(k_list_test_entries,2,"b") == 2,"find_entry");
+
+void testPack()
+{
+    std::string text;
+    while(text.size() < 50000) {
+        text += "line " + std::to_string(text.size()%113) + "\n";
+    }
+
+    std::vector<std::string> const list_names = {
+        "text.txt", "dir/random.bin", "empty", "short"
+    };
+    std::vector<std::vector<uint8_t>> list_raw = {
+        std::vector<uint8_t>(text.begin(),text.end()),
+        make_random(5000,3),
+        std::vector<uint8_t>(),
+        std::vector<uint8_t>{'h','i'}
+    };
+
+    std::vector<std::vector<uint8_t>> list_data = list_raw;
+    std::vector<Entry> list_entries(list_names.size());
+    for(size_t i=0; i < list_names.size(); i++) {
+        store_entry(list_data[i],true,list_entries[i]);
+    }
+    assert(list_entries[0].method == Method::LZ4);
+    assert(list_entries[1].method == Method::NONE);
+    assert(list_entries[2].method == Method::NONE);
+
+    std::vector<uint8_t> blob;
+    uint64_t const index_hash = write_blob(list_names,list_data,list_entries,blob);
+
+    std::string const path = "test_respack.pack";
+    {
+        std::ofstream file(path,std::ios::binary);
+        file.write(reinterpret_cast<char const*>(blob.data()),
+                   std::streamsize(blob.size()));
+    }
+
+    {
+        Pack pack;
+        assert(!pack.open(path,index_hash+1)); // stale index
+        assert(pack.open(path,index_hash));
+        assert(pack.get_index_hash() == index_hash);
+        assert(pack.get_entries().size() == list_names.size());
+
+        for(size_t i=0; i < list_names.size(); i++) {
+            Entry const * entry = pack.find(list_names[i].c_str());
+            assert(entry != nullptr);
+            assert(entry->offset % k_align == 0);
+            assert(std::string(entry->name) == list_names[i]);
+
+            std::vector<uint8_t> data;
+            assert(pack.read(*entry,data));
+            assert(data == list_raw[i]);
+            assert(calc_hash(data.data(),data.size()) == entry->hash);
+
+            if(entry->method == Method::NONE) {
+                assert(std::equal(list_raw[i].begin(),list_raw[i].end(),
+                                  pack.get_data(*entry)));
+            }
+        }
+
+        // missing names, including prefixes of real ones
+        assert(pack.find("missing") == nullptr);
+        assert(pack.find("dir") == nullptr);
+        assert(pack.find("text.tx") == nullptr);
+        assert(pack.find("") == nullptr);
+    }
+
+    // a blob cut short is rejected
+    {
+        std::ofstream file(path,std::ios::binary);
+        file.write(reinterpret_cast<char const*>(blob.data()),
+                   std::streamsize(k_header_size+k_entry_size));
+    }
+    {
+        Pack pack;
+        assert(!pack.open(path));
+        assert(!pack.is_open());
+    }
+
+    std::remove(path.c_str());
+
+    std::cout << "testPack... [ok]" << std::endl;
+}
+
+// ============================================================= //
+
+int main()
+{
+    testLZ4Empty();
+    testLZ4Random();
+    testLZ4Compressible();
+    testLZ4Window();
+    testLZ4Malformed();
+    testPack();
+    return 0;
+}
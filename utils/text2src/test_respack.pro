@@ -0,0 +1,10 @@
+TEMPLATE    = app
+TARGET      = runme
+CONFIG      -= qt
+
+INCLUDEPATH += $${PWD}
+
+HEADERS += respack.hpp
+SOURCES += test_respack.cpp
+
+QMAKE_CXXFLAGS += -std=c++11
@@ -16,6 +16,7 @@
 
 // sys
 #include <cstdint>
+#include <cctype>
 
 // stl
 #include <string>
@@ -23,35 +24,204 @@
 #include <iostream>
 #include <fstream>
 
-int main(int argc, char **argv)
+// respack
+#include <respack.hpp>
+
+// Usage
+// * text2src file.txt
+//   prints the file as C string literals, one per line
+// * text2src --pack out [--lz4] file|name=file ...
+//   writes the files to out.pack and a constexpr index of
+//   them to out.hpp; see respack.hpp. Entries are named
+//   after the file unless given as name=file, and with
+//   --lz4 each entry is compressed if that makes it smaller
+
+namespace
 {
-    // Expects a single argument with the path of
-    // the text file to be read in
-    if(argc != 2) {
-        std::cout << "ERROR: Incorrect number of args" << std::endl;
-        return -1;
+    int write_text_source(std::string const &file_path)
+    {
+        std::ifstream file(file_path);
+        if(!(file.is_open() && file.good())) {
+            std::cout << "ERROR: Failed to open file: " << file_path << std::endl;
+        }
+
+        std::string line;
+        while(std::getline(file,line)) {
+            for(auto it = line.begin(); it != line.end();)
+            {
+                if(*it == '"') {
+                    it = line.insert(it,'\\');
+                    ++it;
+                }
+                ++it;
+            }
+
+            std::cout << "\"" << line << "\\n\"" <<std::endl;
+        }
+
+        return 0;
     }
 
-    // Read in file
-    std::string const file_path(argv[1]);
-    std::ifstream file(file_path);
-    if(!(file.is_open() && file.good())) {
-        std::cout << "ERROR: Failed to open file: " << file_path << std::endl;
+    std::string get_file_name(std::string const &path)
+    {
+        size_t const slash = path.find_last_of("/\\");
+        return (slash == std::string::npos) ? path : path.substr(slash+1);
     }
 
-    std::string line;
-    while(std::getline(file,line)) {
-        for(auto it = line.begin(); it != line.end();)
-        {
-            if(*it == '"') {
-                it = line.insert(it,'\\');
-                ++it;
+    // turns the output name into a namespace for the index
+    std::string get_identifier(std::string const &name)
+    {
+        std::string ident;
+        for(char c : name) {
+            bool const alnum =
+                    (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                    (c >= '0' && c <= '9');
+            ident.push_back(alnum ? c : '_');
+        }
+        if(ident.empty() || (ident[0] >= '0' && ident[0] <= '9')) {
+            ident.insert(ident.begin(),'_');
+        }
+        return ident;
+    }
+
+    std::string escape_string(std::string const &str)
+    {
+        std::string escaped;
+        for(char c : str) {
+            if(c == '"' || c == '\\') {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(c);
+        }
+        return escaped;
+    }
+
+    int write_pack(std::vector<std::string> const &list_args)
+    {
+        using namespace respack;
+
+        std::string out_path;
+        bool use_lz4 = false;
+        std::vector<std::string> list_names;
+        std::vector<std::string> list_paths;
+
+        for(auto const &arg : list_args) {
+            if(arg == "--lz4") {
+                use_lz4 = true;
+            }
+            else if(out_path.empty()) {
+                out_path = arg;
+            }
+            else {
+                size_t const eq = arg.find('=');
+                list_names.push_back((eq == std::string::npos) ?
+                                     get_file_name(arg) : arg.substr(0,eq));
+                list_paths.push_back((eq == std::string::npos) ?
+                                     arg : arg.substr(eq+1));
+            }
+        }
+
+        if(out_path.empty() || list_paths.empty()) {
+            std::cout << "ERROR: --pack needs an output name and files" << std::endl;
+            return -1;
+        }
+
+        for(size_t i=0; i < list_names.size(); i++) {
+            for(size_t j=0; j < i; j++) {
+                if(list_names[i] == list_names[j]) {
+                    std::cout << "ERROR: Duplicate entry: " << list_names[i] << std::endl;
+                    return -1;
+                }
+            }
+        }
+
+        // read everything in first since the data offsets
+        // depend on the size of the index
+        std::vector<Entry> list_entries(list_paths.size());
+        std::vector<std::vector<uint8_t>> list_data(list_paths.size());
+
+        for(size_t i=0; i < list_paths.size(); i++) {
+            std::ifstream file(list_paths[i],std::ios::binary);
+            if(!file.is_open()) {
+                std::cout << "ERROR: Failed to open file: " << list_paths[i] << std::endl;
+                return -1;
             }
-            ++it;
+            list_data[i].assign(std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>());
+            store_entry(list_data[i],use_lz4,list_entries[i]);
+        }
+
+        std::vector<uint8_t> blob;
+        uint64_t const index_hash =
+                write_blob(list_names,list_data,list_entries,blob);
+
+        std::ofstream blob_file(out_path+".pack",std::ios::binary);
+        blob_file.write(reinterpret_cast<char const*>(blob.data()),
+                        std::streamsize(blob.size()));
+        if(!blob_file.good()) {
+            std::cout << "ERROR: Failed to write " << out_path << ".pack" << std::endl;
+            return -1;
+        }
+
+        // index
+        std::string const ident = get_identifier(get_file_name(out_path));
+        std::string guard = "RESPACK_"+ident+"_HPP";
+        for(char &c : guard) {
+            c = char(std::toupper(c));
+        }
+
+        std::ofstream index_file(out_path+".hpp");
+        index_file << "// generated by text2src --pack, do not edit\n\n"
+                   << "#ifndef " << guard << "\n"
+                   << "#define " << guard << "\n\n"
+                   << "#include <respack.hpp>\n\n"
+                   << "namespace " << ident << "\n{\n"
+                   << "    constexpr respack::Entry k_list_entries[] = {\n";
+
+        for(auto const &entry : list_entries) {
+            index_file << "        {\"" << escape_string(entry.name) << "\","
+                       << entry.offset << "ULL,"
+                       << entry.size << "ULL,"
+                       << entry.raw_size << "ULL,"
+                       << "0x" << std::hex << entry.hash << std::dec << "ULL,"
+                       << ((entry.method == Method::LZ4) ?
+                               "respack::Method::LZ4" : "respack::Method::NONE")
+                       << "},\n";
         }
 
-        std::cout << "\"" << line << "\\n\"" <<std::endl;
+        index_file << "    };\n\n"
+                   << "    constexpr size_t k_entry_count = " << list_entries.size() << ";\n"
+                   << "    constexpr uint64_t k_index_hash = 0x"
+                   << std::hex << index_hash << std::dec << "ULL;\n\n"
+                   << "    // index of the entry called name, or k_entry_count\n"
+                   << "    constexpr size_t find(char const * name)\n"
+                   << "    {\n"
+                   << "        return respack::find_entry(k_list_entries,k_entry_count,name);\n"
+                   << "    }\n"
+                   << "}\n\n"
+                   << "#endif // " << guard << "\n";
+
+        if(!index_file.good()) {
+            std::cout << "ERROR: Failed to write " << out_path << ".hpp" << std::endl;
+            return -1;
+        }
+
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if(argc > 1 && std::string(argv[1]) == "--pack") {
+        return write_pack(std::vector<std::string>(argv+2,argv+argc));
+    }
+
+    // Expects a single argument with the path of
+    // the text file to be read in
+    if(argc != 2) {
+        std::cout << "ERROR: Incorrect number of args" << std::endl;
+        return -1;
     }
 
-    return 0;
+    return write_text_source(argv[1]);
 }
@@ -4,6 +4,8 @@ CONFIG      -= qt
 
 INCLUDEPATH += $${PWD}
 
+HEADERS += respack.hpp
+
 SOURCES += text2src.cpp
 
 # need these flags for gcc 4.8.x bug for threads
@@ -0,0 +1,192 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <Job.h>
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace scratch
+{
+    namespace
+    {
+        // Number of Jobs allocated at once when the
+        // shared free list runs out
+        size_t const k_chunk_size = 256;
+
+        // Jobs moved between a thread cache and the
+        // shared free list at once
+        size_t const k_batch_size = 64;
+
+        // A thread cache holding more than this returns
+        // a batch to the shared free list
+        size_t const k_cache_max = 2*k_batch_size;
+
+        struct SharedFreeList
+        {
+            std::mutex mutex;
+            Job * head = nullptr;
+            std::vector<std::unique_ptr<Job[]>> list_chunks;
+
+            // Adds a chunk of Jobs if the list is empty,
+            // the mutex should be held
+            void grow()
+            {
+                if(head) {
+                    return;
+                }
+                std::unique_ptr<Job[]> chunk(new Job[k_chunk_size]);
+                for(size_t i=0; i < k_chunk_size; i++) {
+                    chunk[i].next = (i+1 < k_chunk_size) ?
+                                &(chunk[i+1]) : nullptr;
+                }
+                head = &(chunk[0]);
+                list_chunks.push_back(std::move(chunk));
+            }
+        };
+
+        SharedFreeList & getSharedFreeList()
+        {
+            // Never destroyed; thread caches may still
+            // return Jobs during static destruction
+            static SharedFreeList * free_list = new SharedFreeList;
+            return *free_list;
+        }
+
+        // Set when this thread's cache is destroyed. Thread
+        // locals are destroyed before statics on the main
+        // thread, so a static ThreadPool discarding its Jobs
+        // at exit would otherwise use a dead cache. This is
+        // trivially destructible so it's readable until the
+        // thread is gone
+        thread_local bool tl_cache_destroyed = false;
+
+        struct ThreadCache
+        {
+            ~ThreadCache()
+            {
+                // give everything back when the thread exits
+                if(head) {
+                    giveBatch(count);
+                }
+                tl_cache_destroyed = true;
+            }
+
+            void giveBatch(size_t batch_count)
+            {
+                Job * first = head;
+                Job * last = head;
+                for(size_t i=1; i < batch_count; i++) {
+                    last = last->next;
+                }
+                head = last->next;
+                count -= batch_count;
+
+                SharedFreeList & shared = getSharedFreeList();
+                std::lock_guard<std::mutex> lock(shared.mutex);
+                last->next = shared.head;
+                shared.head = first;
+            }
+
+            void takeBatch()
+            {
+                SharedFreeList & shared = getSharedFreeList();
+                std::lock_guard<std::mutex> lock(shared.mutex);
+                shared.grow();
+
+                for(size_t i=0; i < k_batch_size && shared.head; i++) {
+                    Job * job = shared.head;
+                    shared.head = job->next;
+                    job->next = head;
+                    head = job;
+                    count++;
+                }
+            }
+
+            Job * head = nullptr;
+            size_t count = 0;
+        };
+
+        thread_local ThreadCache tl_cache;
+    }
+
+    // ============================================================= //
+
+    void Job::Release()
+    {
+        if(ref_count.fetch_sub(1,std::memory_order_acq_rel) == 1) {
+            JobAllocator::Release(this);
+        }
+    }
+
+    // ============================================================= //
+
+    Job * JobAllocator::Acquire()
+    {
+        if(tl_cache_destroyed) {
+            // use the shared free list directly
+            SharedFreeList & shared = getSharedFreeList();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.grow();
+            Job * job = shared.head;
+            shared.head = job->next;
+            return job;
+        }
+
+        if(tl_cache.head == nullptr) {
+            tl_cache.takeBatch();
+        }
+
+        Job * job = tl_cache.head;
+        tl_cache.head = job->next;
+        tl_cache.count--;
+
+        return job;
+    }
+
+    void JobAllocator::Release(Job * job)
+    {
+        if(tl_cache_destroyed) {
+            SharedFreeList & shared = getSharedFreeList();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            job->next = shared.head;
+            shared.head = job;
+            return;
+        }
+
+        job->next = tl_cache.head;
+        tl_cache.head = job;
+        tl_cache.count++;
+
+        if(tl_cache.count > k_cache_max) {
+            tl_cache.giveBatch(k_batch_size);
+        }
+    }
+
+    // ============================================================= //
+
+    void JobHandle::Wait() const
+    {
+        while(!IsFinished()) {
+            std::this_thread::yield();
+        }
+    }
+
+    // ============================================================= //
+
+} // scratch
@@ -0,0 +1,238 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_JOB_H
+#define SCRATCH_JOB_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifdef SCRATCH_THREADPOOL_STATS
+#include <typeinfo>
+#endif
+
+namespace scratch
+{
+    // Job
+    // * the control block for one unit of work queued in a
+    //   ThreadPool; holds a callable in inline storage
+    // * Jobs come from JobAllocator's free lists so queueing
+    //   work doesn't touch the heap. Callables that don't fit
+    //   in k_inline_size bytes fall back to a heap allocation
+    // * ref_count is 1 for the pool plus 1 for a JobHandle
+    //   if there is one; the job goes back to the allocator
+    //   when it reaches 0
+    struct Job
+    {
+        static size_t const k_inline_size = 48;
+
+        template<typename F>
+        static Job * Create(F && fn, uint32_t ref_count);
+
+        // Runs and then destroys the callable
+        void Run()
+        {
+            invoke(this);
+        }
+
+        // Destroys the callable without running it
+        void Discard()
+        {
+            destroy(this);
+        }
+
+        void AddRef()
+        {
+            ref_count.fetch_add(1,std::memory_order_relaxed);
+        }
+
+        void Release();
+
+        // Used by Create to place @fn inline or on the heap
+        template<typename F>
+        void store(F && fn, std::true_type);
+
+        template<typename F>
+        void store(F && fn, std::false_type);
+
+        typename std::aligned_storage<
+            k_inline_size,
+            alignof(std::max_align_t)
+            >::type storage;
+
+        void (*invoke)(Job *);
+        void (*destroy)(Job *);
+
+        std::atomic<uint32_t> ref_count;
+        std::atomic<bool> finished;
+
+        // free list link, only used by JobAllocator
+        Job * next;
+
+#ifdef SCRATCH_THREADPOOL_STATS
+        // type of the callable (or Task) for run time
+        // stats and the time the job was queued
+        std::type_info const * type;
+        uint64_t push_time_ns;
+#endif
+    };
+
+    // ============================================================= //
+
+    // JobAllocator
+    // * process wide pool of Jobs allocated in chunks
+    // * each thread keeps a small cache of free Jobs and only
+    //   takes the shared lock to move batches in or out
+    class JobAllocator
+    {
+    public:
+        static Job * Acquire();
+        static void Release(Job * job);
+    };
+
+    // ============================================================= //
+
+    // JobHandle
+    // * returned by ThreadPool::Submit to check on or wait
+    //   for a job without a promise/future pair
+    // * Wait() spins (yielding) so it suits short jobs; it
+    //   must not be called from a worker of a pool with one
+    //   thread since nothing else could run the job
+    class JobHandle
+    {
+    public:
+        JobHandle() :
+            m_job(nullptr)
+        {
+            // empty
+        }
+
+        explicit JobHandle(Job * job) :
+            m_job(job)
+        {
+            // empty
+        }
+
+        ~JobHandle()
+        {
+            if(m_job) {
+                m_job->Release();
+            }
+        }
+
+        JobHandle(JobHandle && other) :
+            m_job(other.m_job)
+        {
+            other.m_job = nullptr;
+        }
+
+        JobHandle & operator=(JobHandle && other)
+        {
+            if(this != &other) {
+                if(m_job) {
+                    m_job->Release();
+                }
+                m_job = other.m_job;
+                other.m_job = nullptr;
+            }
+            return *this;
+        }
+
+        // No copying allowed
+        JobHandle(JobHandle const &)              = delete;
+        JobHandle & operator=(JobHandle const &)  = delete;
+
+        bool IsValid() const
+        {
+            return (m_job != nullptr);
+        }
+
+        bool IsFinished() const
+        {
+            return m_job->finished.load(std::memory_order_acquire);
+        }
+
+        void Wait() const;
+
+    private:
+        Job * m_job;
+    };
+
+    // ============================================================= //
+
+    template<typename F>
+    Job * Job::Create(F && fn, uint32_t ref_count)
+    {
+        using Fn = typename std::decay<F>::type;
+        using FitsInline = std::integral_constant<
+            bool,
+            (sizeof(Fn) <= k_inline_size) &&
+            (alignof(Fn) <= alignof(std::max_align_t))>;
+
+        Job * job = JobAllocator::Acquire();
+        job->ref_count.store(ref_count,std::memory_order_relaxed);
+        job->finished.store(false,std::memory_order_relaxed);
+        job->store(std::forward<F>(fn),FitsInline());
+
+#ifdef SCRATCH_THREADPOOL_STATS
+        job->type = &typeid(Fn);
+#endif
+
+        return job;
+    }
+
+    template<typename F>
+    void Job::store(F && fn, std::true_type /*fits_inline*/)
+    {
+        using Fn = typename std::decay<F>::type;
+
+        new (&storage) Fn(std::forward<F>(fn));
+
+        invoke = [](Job * j) {
+            Fn * f = reinterpret_cast<Fn*>(&j->storage);
+            (*f)();
+            f->~Fn();
+        };
+        destroy = [](Job * j) {
+            reinterpret_cast<Fn*>(&j->storage)->~Fn();
+        };
+    }
+
+    template<typename F>
+    void Job::store(F && fn, std::false_type /*fits_inline*/)
+    {
+        using Fn = typename std::decay<F>::type;
+
+        // too big, keep a pointer to it instead
+        new (&storage) Fn*(new Fn(std::forward<F>(fn)));
+
+        invoke = [](Job * j) {
+            Fn * f = *reinterpret_cast<Fn**>(&j->storage);
+            (*f)();
+            delete f;
+        };
+        destroy = [](Job * j) {
+            delete *reinterpret_cast<Fn**>(&j->storage);
+        };
+    }
+
+} // scratch
+
+#endif // SCRATCH_JOB_H
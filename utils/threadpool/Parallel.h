@@ -0,0 +1,317 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_PARALLEL_H
+#define SCRATCH_PARALLEL_H
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include <ThreadPool.h>
+
+// Data parallel helpers built on ThreadPool
+// * a range is split into chunks that workers (and the
+//   calling thread) claim one at a time, so uneven chunks
+//   balance themselves out
+// * the calling thread always helps and only waits for
+//   chunks that are already running, so these can be
+//   called from inside a pool task without deadlocking
+// * grain is the minimum number of items per chunk; pass 0
+//   to size chunks from the range size and thread count
+
+namespace scratch
+{
+    namespace parallel_detail
+    {
+        // Chunks per thread when the grain is picked
+        // automatically; more chunks balance better
+        // but cost more to claim
+        size_t const k_chunks_per_thread = 8;
+
+        // Max chunks used by ParallelReduce when the grain
+        // is picked automatically. Fixed so the reduction
+        // order doesn't depend on the thread count
+        size_t const k_reduce_chunk_count = 256;
+
+        // Ranges smaller than this are sorted serially
+        size_t const k_sort_serial_threshold = 4096;
+
+        inline size_t CalcChunkCount(size_t item_count,
+                                     size_t grain,
+                                     size_t max_chunk_count)
+        {
+            if(item_count == 0) {
+                return 0;
+            }
+
+            size_t chunk_count = std::min(item_count,max_chunk_count);
+            if(grain > 0) {
+                chunk_count = std::min(chunk_count,
+                                       (item_count+grain-1)/grain);
+            }
+
+            return std::max<size_t>(chunk_count,1);
+        }
+
+        // [begin,end) of @chunk when @item_count items are
+        // split as evenly as possible into @chunk_count chunks
+        inline void GetChunkRange(size_t item_count,
+                                  size_t chunk_count,
+                                  size_t chunk,
+                                  size_t &begin,
+                                  size_t &end)
+        {
+            size_t const base = item_count/chunk_count;
+            size_t const extra = item_count%chunk_count;
+            begin = chunk*base + std::min(chunk,extra);
+            end = begin + base + ((chunk < extra) ? 1 : 0);
+        }
+
+        template<typename F>
+        struct ChunkState
+        {
+            ChunkState(F * fn, size_t chunk_count) :
+                fn(fn),
+                chunk_count(chunk_count),
+                next_chunk(0),
+                done_count(0)
+            {
+                // empty
+            }
+
+            // Claims and runs chunks until there are none left.
+            // @fn is only touched for claimed chunks, and the
+            // caller of RunChunks doesn't return until every
+            // chunk is done, so late helpers never see a
+            // dangling @fn
+            void Work()
+            {
+                while(true) {
+                    size_t const chunk = next_chunk.fetch_add(1);
+                    if(chunk >= chunk_count) {
+                        return;
+                    }
+                    (*fn)(chunk);
+                    done_count.fetch_add(1,std::memory_order_release);
+                }
+            }
+
+            F * fn;
+            size_t const chunk_count;
+            std::atomic<size_t> next_chunk;
+            std::atomic<size_t> done_count;
+        };
+
+        // Calls fn(chunk) for each chunk in [0,chunk_count)
+        template<typename F>
+        void RunChunks(ThreadPool & thread_pool,
+                       size_t chunk_count,
+                       F & fn)
+        {
+            if(chunk_count == 0) {
+                return;
+            }
+            if(chunk_count == 1) {
+                fn(size_t(0));
+                return;
+            }
+
+            auto state = std::make_shared<ChunkState<F>>(&fn,chunk_count);
+
+            size_t const helper_count =
+                    std::min(thread_pool.GetThreadCount(),chunk_count-1);
+
+            for(size_t i=0; i < helper_count; i++) {
+                thread_pool.Run([state]() { state->Work(); });
+            }
+
+            state->Work();
+
+            while(state->done_count.load(std::memory_order_acquire) <
+                  chunk_count) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // ============================================================= //
+
+    // Calls fn(range_begin,range_end) for consecutive
+    // subranges that together cover [begin,end)
+    template<typename F>
+    void ParallelForRange(ThreadPool & thread_pool,
+                          size_t begin,
+                          size_t end,
+                          F && fn,
+                          size_t grain=0)
+    {
+        size_t const item_count = (end > begin) ? (end-begin) : 0;
+        size_t const chunk_count =
+                parallel_detail::CalcChunkCount(
+                    item_count,
+                    grain,
+                    std::max<size_t>(thread_pool.GetThreadCount(),1)*
+                    parallel_detail::k_chunks_per_thread);
+
+        auto run_chunk = [&](size_t chunk) {
+            size_t chunk_begin,chunk_end;
+            parallel_detail::GetChunkRange(
+                        item_count,chunk_count,chunk,
+                        chunk_begin,chunk_end);
+            fn(begin+chunk_begin,begin+chunk_end);
+        };
+
+        parallel_detail::RunChunks(thread_pool,chunk_count,run_chunk);
+    }
+
+    // Calls fn(i) for each i in [begin,end)
+    template<typename F>
+    void ParallelFor(ThreadPool & thread_pool,
+                     size_t begin,
+                     size_t end,
+                     F && fn,
+                     size_t grain=0)
+    {
+        ParallelForRange(
+                    thread_pool,begin,end,
+                    [&fn](size_t range_begin, size_t range_end) {
+                        for(size_t i=range_begin; i < range_end; i++) {
+                            fn(i);
+                        }
+                    },
+                    grain);
+    }
+
+    // Returns identity reduced with map_fn(i) for each i
+    // in [begin,end), ie. reduce_fn(reduce_fn(identity,
+    // map_fn(begin)),map_fn(begin+1))...
+    // * chunk boundaries depend only on the range size and
+    //   grain, and chunk results are combined in order, so
+    //   the result (including floating point rounding) is
+    //   the same for any thread count
+    // * reduce_fn must be associative; identity must be
+    //   its identity value
+    template<typename T, typename MapFn, typename ReduceFn>
+    T ParallelReduce(ThreadPool & thread_pool,
+                     size_t begin,
+                     size_t end,
+                     T const &identity,
+                     MapFn && map_fn,
+                     ReduceFn && reduce_fn,
+                     size_t grain=0)
+    {
+        size_t const item_count = (end > begin) ? (end-begin) : 0;
+        size_t const chunk_count =
+                parallel_detail::CalcChunkCount(
+                    item_count,
+                    grain,
+                    (grain > 0) ?
+                        item_count :
+                        parallel_detail::k_reduce_chunk_count);
+
+        std::vector<T> list_chunk_results(chunk_count,identity);
+
+        auto run_chunk = [&](size_t chunk) {
+            size_t chunk_begin,chunk_end;
+            parallel_detail::GetChunkRange(
+                        item_count,chunk_count,chunk,
+                        chunk_begin,chunk_end);
+
+            T result = identity;
+            for(size_t i=begin+chunk_begin; i < begin+chunk_end; i++) {
+                result = reduce_fn(result,map_fn(i));
+            }
+            list_chunk_results[chunk] = std::move(result);
+        };
+
+        parallel_detail::RunChunks(thread_pool,chunk_count,run_chunk);
+
+        T result = identity;
+        for(auto &chunk_result : list_chunk_results) {
+            result = reduce_fn(result,chunk_result);
+        }
+
+        return result;
+    }
+
+    // Sorts [first,last) by sorting equal sized pieces in
+    // parallel and then merging neighbouring pieces in
+    // parallel rounds. Not stable, like std::sort
+    template<typename RandomIt, typename Compare>
+    void ParallelSort(ThreadPool & thread_pool,
+                      RandomIt first,
+                      RandomIt last,
+                      Compare comp)
+    {
+        size_t const item_count = std::distance(first,last);
+        size_t const thread_count =
+                std::max<size_t>(thread_pool.GetThreadCount(),1);
+
+        if((item_count < parallel_detail::k_sort_serial_threshold) ||
+           (thread_count == 1)) {
+            std::sort(first,last,comp);
+            return;
+        }
+
+        // power of two pieces so every merge round pairs up evenly
+        size_t piece_count = 1;
+        while((piece_count < 2*thread_count) &&
+              (item_count/(piece_count*2) >=
+               parallel_detail::k_sort_serial_threshold/2)) {
+            piece_count *= 2;
+        }
+
+        auto get_piece_begin = [&](size_t piece) {
+            if(piece >= piece_count) {
+                return last;
+            }
+            size_t begin,end;
+            parallel_detail::GetChunkRange(
+                        item_count,piece_count,piece,begin,end);
+            return first+begin;
+        };
+
+        ParallelFor(thread_pool,0,piece_count,[&](size_t piece) {
+            std::sort(get_piece_begin(piece),
+                      get_piece_begin(piece+1),
+                      comp);
+        },1);
+
+        for(size_t width=1; width < piece_count; width *= 2) {
+            size_t const merge_count = piece_count/(2*width);
+            ParallelFor(thread_pool,0,merge_count,[&](size_t merge) {
+                size_t const piece = merge*2*width;
+                std::inplace_merge(get_piece_begin(piece),
+                                   get_piece_begin(piece+width),
+                                   get_piece_begin(piece+2*width),
+                                   comp);
+            },1);
+        }
+    }
+
+    template<typename RandomIt>
+    void ParallelSort(ThreadPool & thread_pool,
+                      RandomIt first,
+                      RandomIt last)
+    {
+        using T = typename std::iterator_traits<RandomIt>::value_type;
+        ParallelSort(thread_pool,first,last,std::less<T>());
+    }
+
+} // scratch
+
+#endif // SCRATCH_PARALLEL_H
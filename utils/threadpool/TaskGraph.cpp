@@ -0,0 +1,141 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <TaskGraph.h>
+
+namespace scratch
+{
+    // ============================================================= //
+
+    TaskGraph::TaskGraph() :
+        m_ran(false)
+    {
+        // empty
+    }
+
+    TaskGraph::~TaskGraph()
+    {
+        // empty
+    }
+
+    size_t TaskGraph::GetTaskCount() const
+    {
+        return m_list_nodes.size();
+    }
+
+    std::shared_ptr<ThreadPool::Task> const &
+    TaskGraph::GetTask(NodeId node) const
+    {
+        return m_list_nodes[node].task;
+    }
+
+    TaskGraph::NodeId TaskGraph::AddTask(std::shared_ptr<ThreadPool::Task> task)
+    {
+        Node node;
+        node.task = std::move(task);
+        m_list_nodes.push_back(std::move(node));
+
+        return m_list_nodes.size()-1;
+    }
+
+    void TaskGraph::AddDependency(NodeId before, NodeId after)
+    {
+        m_list_nodes[after].list_before.push_back(before);
+    }
+
+    bool TaskGraph::Run(ThreadPool & thread_pool)
+    {
+        if(m_ran || !isAcyclic()) {
+            return false;
+        }
+        m_ran = true;
+
+        // Register continuations for every dependent task
+        // before pushing any roots so a root can't end
+        // before its dependents are wired up
+        std::vector<std::shared_ptr<ThreadPool::Task>> list_roots;
+        for(auto const &node : m_list_nodes) {
+            if(node.list_before.empty()) {
+                list_roots.push_back(node.task);
+                continue;
+            }
+
+            std::vector<std::shared_ptr<ThreadPool::Task>> list_before;
+            list_before.reserve(node.list_before.size());
+            for(auto before : node.list_before) {
+                list_before.push_back(m_list_nodes[before].task);
+            }
+
+            thread_pool.WhenAll(list_before,node.task);
+        }
+
+        for(auto const &task : list_roots) {
+            thread_pool.Push(task);
+        }
+
+        return true;
+    }
+
+    void TaskGraph::Cancel()
+    {
+        for(auto const &node : m_list_nodes) {
+            node.task->Cancel();
+        }
+    }
+
+    void TaskGraph::Wait()
+    {
+        for(auto const &node : m_list_nodes) {
+            node.task->Wait();
+        }
+    }
+
+    bool TaskGraph::isAcyclic() const
+    {
+        // Kahn's algorithm: the graph is acyclic if
+        // every node can be visited in topological order
+        size_t const node_count = m_list_nodes.size();
+
+        std::vector<size_t> list_in_degree(node_count,0);
+        std::vector<std::vector<NodeId>> list_after(node_count);
+        for(NodeId i=0; i < node_count; i++) {
+            list_in_degree[i] = m_list_nodes[i].list_before.size();
+            for(auto before : m_list_nodes[i].list_before) {
+                list_after[before].push_back(i);
+            }
+        }
+
+        std::vector<NodeId> queue_ready;
+        for(NodeId i=0; i < node_count; i++) {
+            if(list_in_degree[i] == 0) {
+                queue_ready.push_back(i);
+            }
+        }
+
+        for(size_t i=0; i < queue_ready.size(); i++) {
+            for(auto after : list_after[queue_ready[i]]) {
+                if(--list_in_degree[after] == 0) {
+                    queue_ready.push_back(after);
+                }
+            }
+        }
+
+        return (queue_ready.size() == node_count);
+    }
+
+    // ============================================================= //
+
+} // scratch
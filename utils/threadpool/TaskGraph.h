@@ -0,0 +1,89 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_TASK_GRAPH_H
+#define SCRATCH_TASK_GRAPH_H
+
+#include <ThreadPool.h>
+
+namespace scratch
+{
+    // TaskGraph
+    // * a DAG of ThreadPool tasks; each task is pushed to
+    //   the pool once all of the tasks it depends on have
+    //   ended (see ThreadPool::WhenAll)
+    // * tasks without dependencies are pushed by Run(), every
+    //   other push happens on the worker that ended the last
+    //   dependency so no thread sits in Wait() between stages
+    //
+    // TaskGraph graph;
+    // auto load   = graph.AddTask(task_load);
+    // auto decode = graph.AddTask(task_decode);
+    // auto mipmap = graph.AddTask(task_mipmap);
+    // graph.AddDependency(load,decode);
+    // graph.AddDependency(decode,mipmap);
+    // graph.Run(thread_pool);
+    // graph.Wait();
+    class TaskGraph
+    {
+    public:
+        typedef size_t NodeId;
+
+        TaskGraph();
+        ~TaskGraph();
+
+        // No copying allowed
+        TaskGraph(TaskGraph const &)              = delete;
+        TaskGraph & operator=(TaskGraph const &)  = delete;
+
+        size_t GetTaskCount() const;
+
+        std::shared_ptr<ThreadPool::Task> const & GetTask(NodeId node) const;
+
+        NodeId AddTask(std::shared_ptr<ThreadPool::Task> task);
+
+        // @after won't be pushed until @before has ended
+        void AddDependency(NodeId before, NodeId after);
+
+        // Returns false without pushing anything if the
+        // graph has a cycle or has already been run
+        bool Run(ThreadPool & thread_pool);
+
+        // Calls Cancel() on every task; tasks that have
+        // already been pushed still end (as canceled) so
+        // their dependents are released
+        void Cancel();
+
+        // Waits for every task in the graph to end, must
+        // only be called after a successful Run()
+        void Wait();
+
+    private:
+        struct Node
+        {
+            std::shared_ptr<ThreadPool::Task> task;
+            std::vector<NodeId> list_before;
+        };
+
+        bool isAcyclic() const;
+
+        std::vector<Node> m_list_nodes;
+        bool m_ran;
+    };
+
+} // scratch
+
+#endif // SCRATCH_TASK_GRAPH_H
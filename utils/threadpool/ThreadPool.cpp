@@ -17,9 +17,45 @@
 #include <ThreadPool.h>
 
 #include <iostream>
+#include <algorithm>
+
+#ifdef SCRATCH_THREADPOOL_STATS
+#ifdef __GNUG__
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+#endif
 
 namespace scratch
 {
+    namespace
+    {
+        // Lets Push() find the calling worker's own deque
+        thread_local ThreadPool * tl_pool = nullptr;
+        thread_local size_t tl_worker_index = 0;
+
+        // Max number of tasks a worker moves from the shared
+        // injection queue into its own deque at once
+        size_t const k_inject_batch_max = 32;
+
+#ifdef SCRATCH_THREADPOOL_STATS
+        std::string getTypeName(std::type_info const * type)
+        {
+            std::string name = type->name();
+#ifdef __GNUG__
+            int status=0;
+            char * demangled =
+                    abi::__cxa_demangle(name.c_str(),nullptr,nullptr,&status);
+            if(status == 0 && demangled) {
+                name = demangled;
+            }
+            std::free(demangled);
+#endif
+            return name;
+        }
+#endif
+    }
+
     // ============================================================= //
 
     ThreadPool::Task::Task() :
@@ -27,7 +63,8 @@ namespace scratch
         m_running(false),
         m_canceled(false),
         m_finished(false),
-        m_future(m_promise.get_future())
+        m_future(m_promise.get_future()),
+        m_ended(false)
     {
         // empty
     }
@@ -72,41 +109,175 @@ namespace scratch
     {
         m_running = false;
         m_finished = true;
-        m_promise.set_value();
+        onEnded();
     }
 
     void ThreadPool::Task::onCanceled()
     {
         m_running = false;
         m_canceled = true;
+        onEnded();
+    }
+
+    void ThreadPool::Task::onEnded()
+    {
+        std::vector<std::function<void()>> list_continuations;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex_continuations);
+            m_ended = true;
+            std::swap(list_continuations,m_list_continuations);
+        }
+
+        // Schedule continuations before waking anyone in
+        // Wait() so a waiter can rely on them being queued
+        for(auto & continuation : list_continuations) {
+            continuation();
+        }
+
         m_promise.set_value();
     }
 
+    void ThreadPool::Task::addContinuation(std::function<void()> continuation)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex_continuations);
+            if(!m_ended) {
+                m_list_continuations.push_back(std::move(continuation));
+                return;
+            }
+        }
+
+        continuation();
+    }
+
     // ============================================================= //
 
-    ThreadPool::ThreadPool(size_t thread_count) :
+    ThreadPool::ThreadPool(size_t thread_count,
+                           Scheduler scheduler) :
         m_thread_count(thread_count),
+        m_scheduler(scheduler),
+        m_pending_count(0),
+        m_sleeping_count(0),
         m_running(false)
+#ifdef SCRATCH_THREADPOOL_STATS
+        ,
+        m_push_count(0),
+        m_canceled_count(0),
+        m_queue_depth_max(0)
+#endif
     {
+#ifdef SCRATCH_THREADPOOL_STATS
+        for(size_t i=0; i < m_thread_count; i++) {
+            m_list_worker_stats.emplace_back(new WorkerStats());
+        }
+#endif
+
+        if(m_scheduler == Scheduler::WorkStealing) {
+            for(size_t i=0; i < m_thread_count; i++) {
+                m_list_worker_queues.emplace_back(
+                            new WorkStealingQueue<Job*>());
+            }
+        }
+
         this->Resume();
     }
 
     ThreadPool::~ThreadPool()
     {
         this->Stop();
+
+        // Free any jobs that were never taken
+        for(auto job : m_queue_tasks) {
+            discardJob(job);
+        }
+        for(auto job : m_queue_inject) {
+            discardJob(job);
+        }
+        for(auto & queue : m_list_worker_queues) {
+            while(Job * job = queue->Pop()) {
+                discardJob(job);
+            }
+        }
+    }
+
+    ThreadPool::Scheduler ThreadPool::GetScheduler() const
+    {
+        return m_scheduler;
+    }
+
+    size_t ThreadPool::GetThreadCount() const
+    {
+        return m_thread_count;
     }
 
     size_t ThreadPool::GetTaskCount() const
     {
+        if(m_scheduler == Scheduler::WorkStealing) {
+            return m_pending_count;
+        }
+
         std::lock_guard<std::mutex> lock(m_mutex);
         return m_queue_tasks.size();
     }
 
+    ThreadPoolStats ThreadPool::GetStats() const
+    {
+        ThreadPoolStats stats;
+
+#ifdef SCRATCH_THREADPOOL_STATS
+        stats.enabled = true;
+        stats.push_count = m_push_count;
+        stats.canceled_count = m_canceled_count;
+        stats.queue_depth_max = m_queue_depth_max;
+
+        for(auto const &worker_stats : m_list_worker_stats) {
+            std::lock_guard<std::mutex> lock(worker_stats->mutex);
+            stats.queue_latency.Merge(worker_stats->queue_latency);
+            for(auto const &type_histogram : worker_stats->lkup_run_time_by_type) {
+                stats.run_time_by_type[getTypeName(type_histogram.first)].Merge(
+                            type_histogram.second);
+            }
+            stats.list_workers.push_back(worker_stats->worker);
+        }
+#endif
+
+        return stats;
+    }
+
     void ThreadPool::Push(std::shared_ptr<Task> const &task)
     {
+#ifdef SCRATCH_THREADPOOL_STATS
+        Job * job = Job::Create([this,task]() {
+            task->Process();
+            if(task->IsCanceled()) {
+                m_canceled_count++;
+            }
+        },1);
+        job->type = &typeid(*task);
+        pushJob(job);
+#else
+        pushJob(Job::Create([task]() { task->Process(); },1));
+#endif
+    }
+
+    void ThreadPool::pushJob(Job * job)
+    {
+#ifdef SCRATCH_THREADPOOL_STATS
+        job->push_time_ns = GetStatsTimeNs();
+        m_push_count++;
+#endif
+
+        if(m_scheduler == Scheduler::WorkStealing) {
+            pushWorkStealing(job);
+            return;
+        }
+
         std::lock_guard<std::mutex> lock(m_mutex);
         // Add work to shared queue
-        m_queue_tasks.push_back(task);
+        m_queue_tasks.push_back(job);
+#ifdef SCRATCH_THREADPOOL_STATS
+        recordQueueDepth(m_queue_tasks.size());
+#endif
 
         // Wake one thread from the pool
         m_wait_cond.notify_one();
@@ -115,7 +286,13 @@ namespace scratch
     void ThreadPool::Stop()
     {
         if(m_running) {
-            m_running = false;
+            {
+                // set the flag with the lock held so a worker
+                // can't miss the wake up between checking
+                // m_running and waiting
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running = false;
+            }
             m_wait_cond.notify_all();
 
             for(auto & thread : m_list_threads) {
@@ -130,39 +307,251 @@ namespace scratch
         if(!m_running) {
             m_running = true;
             for(size_t i=0; i < m_thread_count; i++) {
-                m_list_threads.emplace_back(&ThreadPool::loop,this);
+                if(m_scheduler == Scheduler::WorkStealing) {
+                    m_list_threads.emplace_back(
+                                &ThreadPool::loopWorkStealing,this,i);
+                }
+                else {
+                    m_list_threads.emplace_back(&ThreadPool::loop,this,i);
+                }
             }
         }
     }
 
-    void ThreadPool::loop()
+    void ThreadPool::Then(std::shared_ptr<Task> const &before,
+                          std::shared_ptr<Task> const &after)
+    {
+        before->addContinuation([this,after]() {
+            this->Push(after);
+        });
+    }
+
+    void ThreadPool::WhenAll(std::vector<std::shared_ptr<Task>> const &list_before,
+                             std::shared_ptr<Task> const &after)
     {
+        if(list_before.empty()) {
+            this->Push(after);
+            return;
+        }
+
+        auto remaining_count =
+                std::make_shared<std::atomic<size_t>>(list_before.size());
+
+        for(auto const &before : list_before) {
+            before->addContinuation([this,after,remaining_count]() {
+                if(--(*remaining_count) == 0) {
+                    this->Push(after);
+                }
+            });
+        }
+    }
+
+    void ThreadPool::loop(size_t worker_index)
+    {
+        (void)worker_index;
+
         while(m_running)
         {
             // acquire lock
             std::unique_lock<std::mutex> lock(m_mutex);
 
+#ifdef SCRATCH_THREADPOOL_STATS
+            uint64_t const idle_start_ns = GetStatsTimeNs();
+#endif
             while(m_running && m_queue_tasks.empty()) {
                 // wait while there are no tasks to process
                 m_wait_cond.wait(lock);
             }
             // wake-up automatically reacquires lock
+#ifdef SCRATCH_THREADPOOL_STATS
+            recordIdle(worker_index,idle_start_ns);
+#endif
 
             if(!m_running) {
                 return;
             }
 
             // Take a task to process
-            std::shared_ptr<Task> task = std::move(m_queue_tasks.front());
+            Job * job = m_queue_tasks.front();
             m_queue_tasks.pop_front();
 
             lock.unlock(); // release lock
 
             // Process task
-            task->Process();
+            runJob(job,worker_index);
+        }
+    }
+
+    void ThreadPool::runJob(Job * job, size_t worker_index)
+    {
+        (void)worker_index;
+
+#ifdef SCRATCH_THREADPOOL_STATS
+        std::type_info const * type = job->type;
+        uint64_t const start_ns = GetStatsTimeNs();
+        uint64_t const push_time_ns = job->push_time_ns;
+#endif
+
+        job->Run();
+
+#ifdef SCRATCH_THREADPOOL_STATS
+        uint64_t const end_ns = GetStatsTimeNs();
+#endif
+
+        job->finished.store(true,std::memory_order_release);
+        job->Release();
+
+#ifdef SCRATCH_THREADPOOL_STATS
+        WorkerStats & worker_stats = *(m_list_worker_stats[worker_index]);
+        std::lock_guard<std::mutex> lock(worker_stats.mutex);
+        worker_stats.queue_latency.Add(start_ns-push_time_ns);
+        worker_stats.lkup_run_time_by_type[type].Add(end_ns-start_ns);
+        worker_stats.worker.busy_ns += (end_ns-start_ns);
+        worker_stats.worker.run_count++;
+#endif
+    }
+
+#ifdef SCRATCH_THREADPOOL_STATS
+    void ThreadPool::recordQueueDepth(size_t depth)
+    {
+        uint64_t depth_max = m_queue_depth_max;
+        while(depth > depth_max &&
+              !m_queue_depth_max.compare_exchange_weak(depth_max,depth)) {
+            // depth_max was updated, try again
         }
     }
 
+    void ThreadPool::recordIdle(size_t worker_index, uint64_t start_ns)
+    {
+        uint64_t const idle_ns = GetStatsTimeNs()-start_ns;
+        WorkerStats & worker_stats = *(m_list_worker_stats[worker_index]);
+        std::lock_guard<std::mutex> lock(worker_stats.mutex);
+        worker_stats.worker.idle_ns += idle_ns;
+    }
+#endif
+
+    void ThreadPool::discardJob(Job * job)
+    {
+        job->Discard();
+        job->finished.store(true,std::memory_order_release);
+        job->Release();
+    }
+
+    void ThreadPool::pushWorkStealing(Job * job)
+    {
+        // count the task before it becomes visible so that
+        // m_pending_count never underflows
+        size_t const pending_count = ++m_pending_count;
+        (void)pending_count;
+#ifdef SCRATCH_THREADPOOL_STATS
+        recordQueueDepth(pending_count);
+#endif
+
+        if(tl_pool == this) {
+            // Fast path: a worker pushing onto its own deque
+            m_list_worker_queues[tl_worker_index]->Push(job);
+            wakeWorker();
+        }
+        else {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue_inject.push_back(job);
+            if(m_sleeping_count > 0) {
+                m_wait_cond.notify_one();
+            }
+        }
+    }
+
+    Job * ThreadPool::takeWorkStealing(size_t worker_index)
+    {
+        // Own deque first (LIFO)
+        auto & local_queue = *(m_list_worker_queues[worker_index]);
+        if(Job * job = local_queue.Pop()) {
+            return job;
+        }
+
+        // Shared injection queue; take one task to run and move
+        // a share of the rest into our deque where other idle
+        // workers can steal them without touching the mutex
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(!m_queue_inject.empty()) {
+                Job * job = m_queue_inject.front();
+                m_queue_inject.pop_front();
+
+                size_t const batch_count =
+                        std::min(m_queue_inject.size()/m_thread_count,
+                                 k_inject_batch_max);
+
+                for(size_t i=0; i < batch_count; i++) {
+                    local_queue.Push(m_queue_inject.front());
+                    m_queue_inject.pop_front();
+                }
+                return job;
+            }
+        }
+
+        // Steal from the other workers (FIFO)
+        for(size_t i=1; i < m_thread_count; i++) {
+            size_t const victim = (worker_index+i)%m_thread_count;
+            if(Job * job = m_list_worker_queues[victim]->Steal()) {
+                return job;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void ThreadPool::wakeWorker()
+    {
+        if(m_sleeping_count > 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_wait_cond.notify_one();
+        }
+    }
+
+    void ThreadPool::loopWorkStealing(size_t worker_index)
+    {
+        tl_pool = this;
+        tl_worker_index = worker_index;
+
+        while(m_running)
+        {
+            Job * job = takeWorkStealing(worker_index);
+            if(job) {
+                m_pending_count--;
+
+                // Process task
+                runJob(job,worker_index);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if(m_pending_count > 0) {
+                // there's work but we lost a steal race or the
+                // task isn't visible yet, so try again
+                lock.unlock();
+                std::this_thread::yield();
+                continue;
+            }
+
+            m_sleeping_count++;
+#ifdef SCRATCH_THREADPOOL_STATS
+            uint64_t const idle_start_ns = GetStatsTimeNs();
+#endif
+            while(m_running && m_pending_count == 0) {
+                // wait while there are no tasks to process
+                m_wait_cond.wait(lock);
+            }
+            m_sleeping_count--;
+#ifdef SCRATCH_THREADPOOL_STATS
+            lock.unlock();
+            recordIdle(worker_index,idle_start_ns);
+#endif
+        }
+
+        tl_pool = nullptr;
+    }
+
     // ============================================================= //
 
 } // scratch
@@ -24,6 +24,15 @@
 #include <mutex>
 #include <condition_variable>
 #include <future>
+#include <functional>
+
+#include <Job.h>
+#include <ThreadPoolStats.h>
+#include <WorkStealingQueue.h>
+
+#ifdef SCRATCH_THREADPOOL_STATS
+#include <unordered_map>
+#endif
 
 namespace scratch
 {
@@ -35,6 +44,8 @@ namespace scratch
 
         class Task
         {
+            friend class ThreadPool;
+
         public:
             Task();
             virtual ~Task();
@@ -60,6 +71,11 @@ namespace scratch
             void onCanceled();
 
         private:
+            // Runs @continuation once this task has finished
+            // or been canceled, or right away if it already has
+            void addContinuation(std::function<void()> continuation);
+            void onEnded();
+
             std::atomic<bool> m_started;
             std::atomic<bool> m_running;
             std::atomic<bool> m_canceled;
@@ -67,33 +83,144 @@ namespace scratch
 
             std::promise<void> m_promise;
             std::future<void>  m_future;
+
+            std::mutex m_mutex_continuations;
+            bool m_ended;
+            std::vector<std::function<void()>> m_list_continuations;
         };
 
         // ============================================================= //
 
-        ThreadPool(size_t thread_count);
+        // Scheduler
+        // * SharedQueue: all workers take tasks from a single
+        //   mutex guarded FIFO queue
+        // * WorkStealing: each worker owns a lock-free deque;
+        //   tasks pushed from a worker go to its own deque and
+        //   are popped LIFO, idle workers steal FIFO from the
+        //   others. Tasks pushed from outside the pool go to
+        //   a shared injection queue that workers drain in
+        //   batches into their own deques
+        enum class Scheduler
+        {
+            SharedQueue,
+            WorkStealing
+        };
+
+        ThreadPool(size_t thread_count,
+                   Scheduler scheduler=Scheduler::SharedQueue);
         ~ThreadPool();
 
         // No copying allowed
         ThreadPool(ThreadPool const &)              = delete;
         ThreadPool & operator=(ThreadPool const &)  = delete;
 
+        Scheduler GetScheduler() const;
+        size_t GetThreadCount() const;
         size_t GetTaskCount() const;
+
+        // Snapshot of queue latency, run time, worker busy/idle
+        // time, queue depth and cancellation counters. Empty
+        // (enabled == false) unless built with
+        // SCRATCH_THREADPOOL_STATS, see ThreadPoolStats.h
+        ThreadPoolStats GetStats() const;
+
         void Push(std::shared_ptr<Task> const &task);
         void Stop();
         void Resume();
+
+        // Lightweight submission
+        // * queues a callable directly instead of a Task; the
+        //   callable is stored inline in a pooled Job so there
+        //   is no per call heap allocation (unless it's bigger
+        //   than Job::k_inline_size) and no promise/future
+        // * Run is fire-and-forget; Submit returns a JobHandle
+        //   that can be polled or waited on
+        // * jobs still queued when the pool is destroyed are
+        //   discarded without running and marked finished
+        template<typename F>
+        void Run(F && fn)
+        {
+            pushJob(Job::Create(std::forward<F>(fn),1));
+        }
+
+        template<typename F>
+        JobHandle Submit(F && fn)
+        {
+            // one ref for the pool and one for the handle
+            Job * job = Job::Create(std::forward<F>(fn),2);
+            pushJob(job);
+            return JobHandle(job);
+        }
+
+        // Continuations
+        // * @after is pushed to this pool once @before (or
+        //   every task in @list_before) has finished or been
+        //   canceled; it's pushed right away if they already have
+        // * the push happens on the thread that ended the last
+        //   dependency, usually a worker, so nothing has to wait
+        // * @after runs even if a dependency was canceled, it
+        //   can check IsCanceled() on its inputs
+        // * dependencies must call onFinished() or onCanceled()
+        //   or @after is never pushed
+        // * the pool must outlive any pending continuations
+        void Then(std::shared_ptr<Task> const &before,
+                  std::shared_ptr<Task> const &after);
+
+        void WhenAll(std::vector<std::shared_ptr<Task>> const &list_before,
+                     std::shared_ptr<Task> const &after);
 		
     private:
-        void loop();
+        // Everything is queued as a Job; Tasks are wrapped in
+        // a Job that holds the shared_ptr and calls Process()
+        void pushJob(Job * job);
+        void runJob(Job * job, size_t worker_index);
+        void discardJob(Job * job);
+
+        void loop(size_t worker_index);
+        void loopWorkStealing(size_t worker_index);
+
+        void pushWorkStealing(Job * job);
+        Job * takeWorkStealing(size_t worker_index);
+        void wakeWorker();
 
         size_t m_thread_count;
+        Scheduler const m_scheduler;
         std::vector<std::thread> m_list_threads;
-        std::deque<std::shared_ptr<Task>> m_queue_tasks;
+        std::deque<Job*> m_queue_tasks;
+
+        // WorkStealing
+        std::vector<std::unique_ptr<WorkStealingQueue<Job*>>> m_list_worker_queues;
+        std::deque<Job*> m_queue_inject;
+        std::atomic<size_t> m_pending_count;
+        std::atomic<size_t> m_sleeping_count;
 
         std::atomic<bool> m_running;
         mutable std::mutex m_mutex;
         std::condition_variable m_wait_cond;
 
+#ifdef SCRATCH_THREADPOOL_STATS
+        // Each worker records into its own WorkerStats so the
+        // lock is only contended while GetStats() copies it
+        struct WorkerStats
+        {
+            std::mutex mutex;
+            StatsHistogram queue_latency;
+            std::unordered_map<
+                std::type_info const *,
+                StatsHistogram
+                > lkup_run_time_by_type;
+            ThreadPoolStats::Worker worker;
+        };
+
+        void recordQueueDepth(size_t depth);
+        void recordIdle(size_t worker_index, uint64_t start_ns);
+
+        std::vector<std::unique_ptr<WorkerStats>> m_list_worker_stats;
+        std::atomic<uint64_t> m_push_count;
+        std::atomic<uint64_t> m_canceled_count;
+        std::atomic<uint64_t> m_queue_depth_max;
+#endif
+
         // ============================================================= //
 	};
 
@@ -0,0 +1,228 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ThreadPoolStats.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace scratch
+{
+    namespace
+    {
+        std::string escapeJson(std::string const &str)
+        {
+            std::string escaped;
+            escaped.reserve(str.size());
+            for(char c : str) {
+                if(c == '"' || c == '\\') {
+                    escaped.push_back('\\');
+                }
+                escaped.push_back(c);
+            }
+            return escaped;
+        }
+
+        void writeHistogramText(std::ostringstream &ss,
+                                StatsHistogram const &histogram)
+        {
+            ss << "count: " << histogram.GetCount()
+               << ", mean: " << histogram.GetMeanNs()/1000.0 << "us"
+               << ", p50: <" << histogram.GetPercentileNs(0.5)/1000.0 << "us"
+               << ", p99: <" << histogram.GetPercentileNs(0.99)/1000.0 << "us"
+               << ", max: " << histogram.GetMaxNs()/1000.0 << "us";
+        }
+
+        void writeHistogramJson(std::ostringstream &ss,
+                                StatsHistogram const &histogram)
+        {
+            ss << "{\"count\":" << histogram.GetCount()
+               << ",\"total_ns\":" << histogram.GetTotalNs()
+               << ",\"max_ns\":" << histogram.GetMaxNs()
+               << ",\"p50_ns\":" << histogram.GetPercentileNs(0.5)
+               << ",\"p99_ns\":" << histogram.GetPercentileNs(0.99)
+               << ",\"buckets\":[";
+
+            // trailing empty buckets are left out
+            auto const &list_buckets = histogram.GetBuckets();
+            size_t bucket_count = list_buckets.size();
+            while(bucket_count > 0 && list_buckets[bucket_count-1] == 0) {
+                bucket_count--;
+            }
+            for(size_t i=0; i < bucket_count; i++) {
+                ss << ((i > 0) ? "," : "") << list_buckets[i];
+            }
+            ss << "]}";
+        }
+    }
+
+    // ============================================================= //
+
+    StatsHistogram::StatsHistogram() :
+        m_count(0),
+        m_total_ns(0),
+        m_max_ns(0)
+    {
+        m_list_buckets.fill(0);
+    }
+
+    void StatsHistogram::Add(uint64_t ns)
+    {
+        size_t bucket=0;
+        while(ns >> bucket) {
+            bucket++;
+        }
+        bucket = std::min(bucket,k_bucket_count-1);
+
+        m_list_buckets[bucket]++;
+        m_count++;
+        m_total_ns += ns;
+        m_max_ns = std::max(m_max_ns,ns);
+    }
+
+    void StatsHistogram::Merge(StatsHistogram const &other)
+    {
+        for(size_t i=0; i < k_bucket_count; i++) {
+            m_list_buckets[i] += other.m_list_buckets[i];
+        }
+        m_count += other.m_count;
+        m_total_ns += other.m_total_ns;
+        m_max_ns = std::max(m_max_ns,other.m_max_ns);
+    }
+
+    uint64_t StatsHistogram::GetCount() const
+    {
+        return m_count;
+    }
+
+    uint64_t StatsHistogram::GetTotalNs() const
+    {
+        return m_total_ns;
+    }
+
+    uint64_t StatsHistogram::GetMaxNs() const
+    {
+        return m_max_ns;
+    }
+
+    double StatsHistogram::GetMeanNs() const
+    {
+        return (m_count > 0) ? (double(m_total_ns)/m_count) : 0.0;
+    }
+
+    uint64_t StatsHistogram::GetPercentileNs(double percentile) const
+    {
+        if(m_count == 0) {
+            return 0;
+        }
+
+        uint64_t const target =
+                std::max<uint64_t>(1,uint64_t(percentile*m_count+0.5));
+
+        uint64_t sum=0;
+        for(size_t i=0; i < k_bucket_count; i++) {
+            sum += m_list_buckets[i];
+            if(sum >= target) {
+                return std::min(m_max_ns,(uint64_t(1) << i));
+            }
+        }
+
+        return m_max_ns;
+    }
+
+    std::array<uint64_t,StatsHistogram::k_bucket_count> const &
+    StatsHistogram::GetBuckets() const
+    {
+        return m_list_buckets;
+    }
+
+    // ============================================================= //
+
+    std::string ThreadPoolStats::ToText() const
+    {
+        std::ostringstream ss;
+        if(!enabled) {
+            ss << "ThreadPool stats disabled "
+                  "(build with SCRATCH_THREADPOOL_STATS)\n";
+            return ss.str();
+        }
+
+        ss << "pushed: " << push_count
+           << ", canceled: " << canceled_count
+           << ", queue depth max: " << queue_depth_max << "\n";
+
+        ss << "queue latency: ";
+        writeHistogramText(ss,queue_latency);
+        ss << "\n";
+
+        for(auto const &type_histogram : run_time_by_type) {
+            ss << "run time [" << type_histogram.first << "]: ";
+            writeHistogramText(ss,type_histogram.second);
+            ss << "\n";
+        }
+
+        for(size_t i=0; i < list_workers.size(); i++) {
+            Worker const &worker = list_workers[i];
+            ss << "worker " << i
+               << ": ran " << worker.run_count
+               << ", busy " << worker.busy_ns/1000000.0 << "ms"
+               << ", idle " << worker.idle_ns/1000000.0 << "ms\n";
+        }
+
+        return ss.str();
+    }
+
+    std::string ThreadPoolStats::ToJson() const
+    {
+        std::ostringstream ss;
+        ss << "{\"enabled\":" << (enabled ? "true" : "false");
+        if(!enabled) {
+            ss << "}";
+            return ss.str();
+        }
+
+        ss << ",\"push_count\":" << push_count
+           << ",\"canceled_count\":" << canceled_count
+           << ",\"queue_depth_max\":" << queue_depth_max
+           << ",\"queue_latency\":";
+        writeHistogramJson(ss,queue_latency);
+
+        ss << ",\"run_time_by_type\":{";
+        bool first=true;
+        for(auto const &type_histogram : run_time_by_type) {
+            ss << (first ? "" : ",")
+               << "\"" << escapeJson(type_histogram.first) << "\":";
+            writeHistogramJson(ss,type_histogram.second);
+            first = false;
+        }
+        ss << "}";
+
+        ss << ",\"workers\":[";
+        for(size_t i=0; i < list_workers.size(); i++) {
+            Worker const &worker = list_workers[i];
+            ss << ((i > 0) ? "," : "")
+               << "{\"run_count\":" << worker.run_count
+               << ",\"busy_ns\":" << worker.busy_ns
+               << ",\"idle_ns\":" << worker.idle_ns << "}";
+        }
+        ss << "]}";
+
+        return ss.str();
+    }
+
+    // ============================================================= //
+
+} // scratch
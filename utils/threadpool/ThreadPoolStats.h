@@ -0,0 +1,133 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_THREAD_POOL_STATS_H
+#define SCRATCH_THREAD_POOL_STATS_H
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+
+// ThreadPool only collects stats when built with
+// SCRATCH_THREADPOOL_STATS defined (DEFINES += SCRATCH_THREADPOOL_STATS
+// in qmake). Every file that includes ThreadPool.h must
+// agree on it since it changes the layout of Job.
+// Without it ThreadPool::GetStats() returns an empty
+// snapshot with enabled == false and nothing is recorded.
+
+namespace scratch
+{
+    // StatsHistogram
+    // * durations in nanoseconds, bucketed by power of two:
+    //   bucket i holds values in [2^(i-1),2^i), bucket 0
+    //   holds 0
+    // * not thread safe
+    class StatsHistogram
+    {
+    public:
+        static size_t const k_bucket_count = 48;
+
+        StatsHistogram();
+
+        void Add(uint64_t ns);
+        void Merge(StatsHistogram const &other);
+
+        uint64_t GetCount() const;
+        uint64_t GetTotalNs() const;
+        uint64_t GetMaxNs() const;
+        double GetMeanNs() const;
+
+        // Upper bound of the bucket holding the
+        // @percentile'th value, percentile in [0,1]
+        uint64_t GetPercentileNs(double percentile) const;
+
+        std::array<uint64_t,k_bucket_count> const & GetBuckets() const;
+
+    private:
+        std::array<uint64_t,k_bucket_count> m_list_buckets;
+        uint64_t m_count;
+        uint64_t m_total_ns;
+        uint64_t m_max_ns;
+    };
+
+    // ThreadPoolStats
+    // * a snapshot of the counters a ThreadPool has
+    //   collected since it was created
+    struct ThreadPoolStats
+    {
+        struct Worker
+        {
+            Worker() :
+                busy_ns(0),
+                idle_ns(0),
+                run_count(0)
+            {
+                // empty
+            }
+
+            // time spent running jobs
+            uint64_t busy_ns;
+
+            // time spent asleep waiting for work
+            uint64_t idle_ns;
+
+            uint64_t run_count;
+        };
+
+        ThreadPoolStats() :
+            enabled(false),
+            push_count(0),
+            canceled_count(0),
+            queue_depth_max(0)
+        {
+            // empty
+        }
+
+        std::string ToText() const;
+        std::string ToJson() const;
+
+        bool enabled;
+
+        // time from Push/Run/Submit until a worker starts the job
+        StatsHistogram queue_latency;
+
+        // time to run, keyed by the (demangled) Task subclass
+        // or callable type name
+        std::map<std::string,StatsHistogram> run_time_by_type;
+
+        std::vector<Worker> list_workers;
+
+        uint64_t push_count;
+
+        // Tasks that ended with onCanceled()
+        uint64_t canceled_count;
+
+        // high water mark of queued (not yet started) jobs
+        uint64_t queue_depth_max;
+    };
+
+    inline uint64_t GetStatsTimeNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+} // scratch
+
+#endif // SCRATCH_THREAD_POOL_STATS_H
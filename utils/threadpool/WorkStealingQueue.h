@@ -0,0 +1,192 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_WORK_STEALING_QUEUE_H
+#define SCRATCH_WORK_STEALING_QUEUE_H
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace scratch
+{
+    // WorkStealingQueue
+    // * Chase-Lev deque (see "Correct and Efficient Work-Stealing
+    //   for Weak Memory Models", Le et al. 2013)
+    // * only the owning thread may call Push() and Pop(); any
+    //   thread may call Steal()
+    // * Pop() takes from the bottom (LIFO), Steal() takes from
+    //   the top (FIFO)
+    // * T must be a pointer type; nullptr is used to signal that
+    //   nothing was taken
+    template<typename T>
+    class WorkStealingQueue
+    {
+    public:
+        WorkStealingQueue(int64_t capacity=256) :
+            m_top(0),
+            m_bottom(0),
+            m_array(new Array(capacity))
+        {
+            // empty
+        }
+
+        ~WorkStealingQueue()
+        {
+            delete m_array.load(std::memory_order_relaxed);
+            for(auto array : m_list_retired) {
+                delete array;
+            }
+        }
+
+        // No copying allowed
+        WorkStealingQueue(WorkStealingQueue const &)             = delete;
+        WorkStealingQueue & operator=(WorkStealingQueue const &) = delete;
+
+        // Approximate, may be stale by the time it returns
+        size_t GetSize() const
+        {
+            int64_t const b = m_bottom.load(std::memory_order_relaxed);
+            int64_t const t = m_top.load(std::memory_order_relaxed);
+            return (b > t) ? static_cast<size_t>(b-t) : 0;
+        }
+
+        bool IsEmpty() const
+        {
+            return (GetSize() == 0);
+        }
+
+        // owner only
+        void Push(T item)
+        {
+            int64_t const b = m_bottom.load(std::memory_order_relaxed);
+            int64_t const t = m_top.load(std::memory_order_acquire);
+            Array * array = m_array.load(std::memory_order_relaxed);
+
+            if(b-t > array->size-1) {
+                array = grow(array,t,b);
+            }
+
+            array->Put(b,item);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(b+1,std::memory_order_relaxed);
+        }
+
+        // owner only
+        T Pop()
+        {
+            int64_t const b = m_bottom.load(std::memory_order_relaxed)-1;
+            Array * array = m_array.load(std::memory_order_relaxed);
+            m_bottom.store(b,std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = m_top.load(std::memory_order_relaxed);
+
+            T item = nullptr;
+            if(t <= b) {
+                item = array->Get(b);
+                if(t == b) {
+                    // last item, race against thieves
+                    if(!m_top.compare_exchange_strong(
+                                t,t+1,
+                                std::memory_order_seq_cst,
+                                std::memory_order_relaxed)) {
+                        item = nullptr;
+                    }
+                    m_bottom.store(b+1,std::memory_order_relaxed);
+                }
+            }
+            else {
+                // was empty
+                m_bottom.store(b+1,std::memory_order_relaxed);
+            }
+
+            return item;
+        }
+
+        // any thread; may return nullptr if it loses
+        // a race even when the queue isn't empty
+        T Steal()
+        {
+            int64_t t = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t const b = m_bottom.load(std::memory_order_acquire);
+
+            T item = nullptr;
+            if(t < b) {
+                Array * array = m_array.load(std::memory_order_acquire);
+                item = array->Get(t);
+                if(!m_top.compare_exchange_strong(
+                            t,t+1,
+                            std::memory_order_seq_cst,
+                            std::memory_order_relaxed)) {
+                    return nullptr;
+                }
+            }
+
+            return item;
+        }
+
+    private:
+        struct Array
+        {
+            Array(int64_t size) :
+                size(size),
+                mask(size-1),
+                list_items(new std::atomic<T>[size])
+            {
+                // empty
+            }
+
+            void Put(int64_t i, T item)
+            {
+                list_items[i & mask].store(item,std::memory_order_relaxed);
+            }
+
+            T Get(int64_t i) const
+            {
+                return list_items[i & mask].load(std::memory_order_relaxed);
+            }
+
+            int64_t const size;
+            int64_t const mask;
+            std::unique_ptr<std::atomic<T>[]> list_items;
+        };
+
+        Array * grow(Array * array, int64_t t, int64_t b)
+        {
+            Array * new_array = new Array(array->size*2);
+            for(int64_t i=t; i < b; i++) {
+                new_array->Put(i,array->Get(i));
+            }
+
+            // thieves may still be reading the old array so
+            // it can only be freed once the queue is destroyed
+            m_list_retired.push_back(array);
+            m_array.store(new_array,std::memory_order_release);
+
+            return new_array;
+        }
+
+        std::atomic<int64_t> m_top;
+        std::atomic<int64_t> m_bottom;
+        std::atomic<Array*> m_array;
+        std::vector<Array*> m_list_retired;
+    };
+
+} // scratch
+
+#endif // SCRATCH_WORK_STEALING_QUEUE_H
@@ -1,7 +1,12 @@
 #include <iostream>
 #include <chrono>
+#include <string>
+#include <algorithm>
+#include <array>
 
 #include<ThreadPool.h>
+#include<TaskGraph.h>
+#include<Parallel.h>
 
 namespace scratch
 {
@@ -123,13 +128,92 @@ namespace scratch
         std::atomic<bool> m_cancel;
         size_t const m_ms;
     };
+
+    // TaskRecordOrder
+    // * appends its id to a shared list when processed
+    //   so tests can check the order tasks ran in
+    class TaskRecordOrder : public ThreadPool::Task
+    {
+    public:
+        TaskRecordOrder(size_t id,
+                        std::mutex * mutex,
+                        std::vector<size_t> * list_order) :
+            m_cancel(false),
+            m_id(id),
+            m_mutex(mutex),
+            m_list_order(list_order)
+        {
+            // empty
+        }
+
+        void Process()
+        {
+            this->onStarted();
+            if(m_cancel) {
+                this->onCanceled();
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(*m_mutex);
+                m_list_order->push_back(m_id);
+            }
+            this->onFinished();
+        }
+
+        void Cancel()
+        {
+            m_cancel = true;
+        }
+
+    private:
+        std::atomic<bool> m_cancel;
+        size_t const m_id;
+        std::mutex * m_mutex;
+        std::vector<size_t> * m_list_order;
+    };
+
+    // TaskIncrement
+    // * minimal task for measuring submission overhead
+    class TaskIncrement : public ThreadPool::Task
+    {
+    public:
+        TaskIncrement(std::atomic<size_t> * counter) :
+            m_counter(counter)
+        {
+            // empty
+        }
+
+        void Process()
+        {
+            this->onStarted();
+            (*m_counter)++;
+            this->onFinished();
+        }
+
+        void Cancel()
+        {
+            // empty
+        }
+
+    private:
+        std::atomic<size_t> * m_counter;
+    };
 }
 
-void Test_PushTasksAndWait()
+using Scheduler = scratch::ThreadPool::Scheduler;
+
+std::string GetSchedulerName(Scheduler scheduler)
+{
+    return (scheduler == Scheduler::WorkStealing) ?
+                "WorkStealing" : "SharedQueue";
+}
+
+void Test_PushTasksAndWait(Scheduler scheduler)
 {
-    std::cout << "Test_PushTasksAndWait... " << std::endl;
+    std::cout << "Test_PushTasksAndWait ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
 
-    scratch::ThreadPool thread_pool(4);
+    scratch::ThreadPool thread_pool(4,scheduler);
     std::vector<std::shared_ptr<scratch::TaskIsPrime>> list_tasks;
 
     for(size_t i=0; i < 100; i++) {
@@ -160,11 +244,12 @@ void Test_PushTasksAndWait()
     std::cout << std::endl;
 }
 
-void Test_PushTasksAndCancel()
+void Test_PushTasksAndCancel(Scheduler scheduler)
 {
-    std::cout << "Test_PushTasksAndCancel... " << std::endl;
+    std::cout << "Test_PushTasksAndCancel ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
 
-    scratch::ThreadPool thread_pool(4);
+    scratch::ThreadPool thread_pool(4,scheduler);
     std::vector<std::shared_ptr<scratch::TaskTimeSlice>> list_tasks;
 
     for(size_t i=0; i < 100; i++) {
@@ -203,11 +288,12 @@ void Test_PushTasksAndCancel()
     std::cout << std::endl;
 }
 
-void Test_PushTasksStopAndResume()
+void Test_PushTasksStopAndResume(Scheduler scheduler)
 {
-    std::cout << "Test_PushTasksStopAndResume... " << std::endl;
+    std::cout << "Test_PushTasksStopAndResume ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
 
-    scratch::ThreadPool thread_pool(4);
+    scratch::ThreadPool thread_pool(4,scheduler);
     std::vector<std::shared_ptr<scratch::TaskTimeSlice>> list_tasks;
 
     for(size_t i=0; i < 100; i++) {
@@ -246,11 +332,442 @@ void Test_PushTasksStopAndResume()
     std::cout << std::endl;
 }
 
+void Test_StaticPoolAtExit(Scheduler scheduler)
+{
+    std::cout << "Test_StaticPoolAtExit ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
+
+    // The pool is destroyed after main returns, once the
+    // main thread's Job cache is gone; the jobs queued while
+    // it's stopped are never run and are freed then
+    static scratch::ThreadPool thread_pool(2,scheduler);
+    thread_pool.Stop();
+    for(size_t i=0; i < 1000; i++) {
+        thread_pool.Run([](){});
+    }
+
+    std::cout << ": task queue size at exit: "
+              << thread_pool.GetTaskCount() << std::endl;
+    std::cout << std::endl;
+}
+
+void Test_ThenAndWhenAll(Scheduler scheduler)
+{
+    std::cout << "Test_ThenAndWhenAll ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
+
+    scratch::ThreadPool thread_pool(4,scheduler);
+    std::mutex mutex;
+    std::vector<size_t> list_order;
+
+    // 0 -> 1 -> {2,3,4} -> 5
+    std::vector<std::shared_ptr<scratch::TaskRecordOrder>> list_tasks;
+    for(size_t i=0; i < 6; i++) {
+        list_tasks.emplace_back(
+                    std::make_shared<scratch::TaskRecordOrder>(
+                        i,&mutex,&list_order));
+    }
+
+    thread_pool.Then(list_tasks[0],list_tasks[1]);
+    for(size_t i=2; i < 5; i++) {
+        thread_pool.Then(list_tasks[1],list_tasks[i]);
+    }
+    thread_pool.WhenAll({list_tasks[2],list_tasks[3],list_tasks[4]},
+                        list_tasks[5]);
+
+    thread_pool.Push(list_tasks[0]);
+    list_tasks[5]->Wait();
+
+    bool ok = (list_order.size() == 6) &&
+              (list_order[0] == 0) &&
+              (list_order[1] == 1) &&
+              (list_order[5] == 5);
+
+    if(ok) {
+        std::cout << ": [OK]" << std::endl;
+    }
+    else {
+        std::cout << ": [ERR]" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void Test_TaskGraph(Scheduler scheduler)
+{
+    std::cout << "Test_TaskGraph ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
+
+    scratch::ThreadPool thread_pool(4,scheduler);
+    std::mutex mutex;
+    std::vector<size_t> list_order;
+
+    // 100 independent load -> decode -> mipmap -> pack chains
+    size_t const chain_count = 100;
+    size_t const stage_count = 4;
+
+    scratch::TaskGraph graph;
+    for(size_t i=0; i < chain_count; i++) {
+        for(size_t j=0; j < stage_count; j++) {
+            auto node = graph.AddTask(
+                        std::make_shared<scratch::TaskRecordOrder>(
+                            i*stage_count+j,&mutex,&list_order));
+            if(j > 0) {
+                graph.AddDependency(node-1,node);
+            }
+        }
+    }
+
+    // a cycle must be rejected
+    scratch::TaskGraph graph_cycle;
+    auto a = graph_cycle.AddTask(
+                std::make_shared<scratch::TaskRecordOrder>(
+                    0,&mutex,&list_order));
+    auto b = graph_cycle.AddTask(
+                std::make_shared<scratch::TaskRecordOrder>(
+                    1,&mutex,&list_order));
+    graph_cycle.AddDependency(a,b);
+    graph_cycle.AddDependency(b,a);
+
+    bool ok = !graph_cycle.Run(thread_pool);
+
+    ok = ok && graph.Run(thread_pool);
+    graph.Wait();
+
+    // every stage must come after the previous
+    // stage of its chain
+    std::vector<size_t> list_pos(chain_count*stage_count,0);
+    for(size_t i=0; i < list_order.size(); i++) {
+        list_pos[list_order[i]] = i;
+    }
+    ok = ok && (list_order.size() == chain_count*stage_count);
+    for(size_t i=0; i < chain_count && ok; i++) {
+        for(size_t j=1; j < stage_count; j++) {
+            if(list_pos[i*stage_count+j] < list_pos[i*stage_count+j-1]) {
+                ok = false;
+            }
+        }
+    }
+
+    if(ok) {
+        std::cout << ": [OK]" << std::endl;
+    }
+    else {
+        std::cout << ": [ERR]" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void Test_RunAndSubmit(Scheduler scheduler)
+{
+    std::cout << "Test_RunAndSubmit ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
+
+    scratch::ThreadPool thread_pool(4,scheduler);
+    std::atomic<size_t> counter(0);
+
+    // fire-and-forget
+    for(size_t i=0; i < 1000; i++) {
+        thread_pool.Run([&counter]() { counter++; });
+    }
+
+    // waitable, including a callable too big
+    // for the inline storage
+    std::vector<scratch::JobHandle> list_handles;
+    std::array<size_t,32> list_big;
+    list_big.fill(1);
+    for(size_t i=0; i < 1000; i++) {
+        list_handles.push_back(
+                    thread_pool.Submit([&counter]() { counter++; }));
+        list_handles.push_back(
+                    thread_pool.Submit([&counter,list_big]() {
+                        counter += list_big[0];
+                    }));
+    }
+
+    size_t num_finished=0;
+    for(auto & handle : list_handles) {
+        handle.Wait();
+        if(handle.IsFinished()) {
+            num_finished++;
+        }
+    }
+    while(counter < 3000) {
+        std::this_thread::yield();
+    }
+
+    if(num_finished == list_handles.size()) {
+        std::cout << ": [OK]" << std::endl;
+    }
+    else {
+        std::cout << ": [ERR]" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void Test_ParallelForReduceSort(Scheduler scheduler)
+{
+    std::cout << "Test_ParallelForReduceSort ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
+
+    scratch::ThreadPool thread_pool(4,scheduler);
+    scratch::ThreadPool thread_pool_single(1,scheduler);
+
+    size_t const count = 100000;
+    bool ok = true;
+
+    // every index visited exactly once
+    std::vector<std::atomic<uint8_t>> list_visits(count);
+    for(auto & visits : list_visits) {
+        visits = 0;
+    }
+    scratch::ParallelFor(thread_pool,0,count,[&](size_t i) {
+        list_visits[i]++;
+    });
+    for(auto & visits : list_visits) {
+        ok = ok && (visits == 1);
+    }
+
+    // same floating point result regardless of thread count
+    auto map_fn = [](size_t i) { return 1.0/double(i+1); };
+    auto reduce_fn = [](double a, double b) { return a+b; };
+    double const sum_a =
+            scratch::ParallelReduce(thread_pool,0,count,0.0,
+                                    map_fn,reduce_fn);
+    double const sum_b =
+            scratch::ParallelReduce(thread_pool_single,0,count,0.0,
+                                    map_fn,reduce_fn);
+    ok = ok && (sum_a == sum_b);
+
+    // matches std::sort
+    std::vector<uint32_t> list_values(count);
+    uint32_t x = 12345;
+    for(auto & value : list_values) {
+        x = x*1103515245u + 12345u;
+        value = x;
+    }
+    std::vector<uint32_t> list_sorted = list_values;
+    std::sort(list_sorted.begin(),list_sorted.end());
+    scratch::ParallelSort(thread_pool,list_values.begin(),list_values.end());
+    ok = ok && (list_values == list_sorted);
+
+    // nested inside a task on a single thread pool
+    auto handle = thread_pool_single.Submit([&]() {
+        scratch::ParallelFor(thread_pool_single,0,count,[&](size_t i) {
+            list_visits[i]++;
+        });
+    });
+    handle.Wait();
+    for(auto & visits : list_visits) {
+        ok = ok && (visits == 2);
+    }
+
+    if(ok) {
+        std::cout << ": [OK]" << std::endl;
+    }
+    else {
+        std::cout << ": [ERR]" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void Test_Stats(Scheduler scheduler)
+{
+    std::cout << "Test_Stats ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
+
+    bool ok = true;
+    {
+        scratch::ThreadPool thread_pool(2,scheduler);
+
+        size_t const task_count = 100;
+        std::atomic<size_t> counter(0);
+        std::vector<std::shared_ptr<scratch::TaskIncrement>> list_tasks;
+        for(size_t i=0; i < task_count; i++) {
+            list_tasks.push_back(
+                        std::make_shared<scratch::TaskIncrement>(&counter));
+            thread_pool.Push(list_tasks.back());
+        }
+        for(auto & task : list_tasks) {
+            task->Wait();
+        }
+
+        std::vector<scratch::JobHandle> list_handles;
+        for(size_t i=0; i < task_count; i++) {
+            list_handles.push_back(
+                        thread_pool.Submit([&counter]() { counter++; }));
+        }
+        for(auto & handle : list_handles) {
+            handle.Wait();
+        }
+
+        scratch::ThreadPoolStats const stats = thread_pool.GetStats();
+
+#ifdef SCRATCH_THREADPOOL_STATS
+        uint64_t run_count=0;
+        for(auto const &worker : stats.list_workers) {
+            run_count += worker.run_count;
+        }
+
+        ok = ok && stats.enabled;
+        ok = ok && (stats.push_count == 2*task_count);
+        ok = ok && (run_count == 2*task_count);
+        ok = ok && (stats.queue_latency.GetCount() == 2*task_count);
+        ok = ok && (stats.list_workers.size() == 2);
+        ok = ok && (stats.queue_depth_max > 0);
+        ok = ok && (stats.run_time_by_type.size() == 2);
+#else
+        ok = ok && !stats.enabled;
+#endif
+        std::cout << stats.ToText();
+        std::cout << stats.ToJson() << std::endl;
+    }
+
+    if(ok) {
+        std::cout << ": [OK]" << std::endl;
+    }
+    else {
+        std::cout << ": [ERR]" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void Bench_SubmitThroughput(Scheduler scheduler)
+{
+    std::cout << "Bench_SubmitThroughput ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
+
+    size_t const task_count = 1000000;
+    size_t const thread_count =
+            std::max(1u,std::thread::hardware_concurrency());
+
+    auto print_result = [&](std::string const &desc,
+                            std::chrono::steady_clock::time_point start) {
+        double const ms =
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now()-start).count()/1000.0;
+
+        std::cout << ": " << desc << ": " << ms << " ms, "
+                  << (task_count/ms*1000.0) << " tasks/s" << std::endl;
+    };
+
+    scratch::ThreadPool thread_pool(thread_count,scheduler);
+
+    // shared_ptr<Task> with a promise/future
+    {
+        std::atomic<size_t> counter(0);
+        auto const start = std::chrono::steady_clock::now();
+        for(size_t i=0; i < task_count; i++) {
+            thread_pool.Push(
+                        std::make_shared<scratch::TaskIncrement>(&counter));
+        }
+        while(counter < task_count) {
+            std::this_thread::yield();
+        }
+        print_result("Push(Task)",start);
+    }
+
+    // fire-and-forget
+    {
+        std::atomic<size_t> counter(0);
+        auto const start = std::chrono::steady_clock::now();
+        for(size_t i=0; i < task_count; i++) {
+            thread_pool.Run([&counter]() { counter++; });
+        }
+        while(counter < task_count) {
+            std::this_thread::yield();
+        }
+        print_result("Run(fn)",start);
+    }
+
+    // waitable
+    {
+        std::atomic<size_t> counter(0);
+        std::vector<scratch::JobHandle> list_handles;
+        list_handles.reserve(task_count);
+
+        auto const start = std::chrono::steady_clock::now();
+        for(size_t i=0; i < task_count; i++) {
+            list_handles.push_back(
+                        thread_pool.Submit([&counter]() { counter++; }));
+        }
+        for(auto & handle : list_handles) {
+            handle.Wait();
+        }
+        print_result("Submit(fn)",start);
+    }
+
+    std::cout << std::endl;
+}
+
+void Bench_TaskIsPrimeScaling(Scheduler scheduler)
+{
+    std::cout << "Bench_TaskIsPrimeScaling ("
+              << GetSchedulerName(scheduler) << ")... " << std::endl;
+
+    size_t const task_count = 100000;
+    size_t const max_thread_count =
+            std::max(1u,std::thread::hardware_concurrency());
+
+    for(size_t thread_count=1; ; thread_count *= 2)
+    {
+        thread_count = std::min(thread_count,max_thread_count);
+
+        std::vector<std::shared_ptr<scratch::TaskIsPrime>> list_tasks;
+        list_tasks.reserve(task_count);
+        for(size_t i=0; i < task_count; i++) {
+            list_tasks.emplace_back(
+                        std::make_shared<scratch::TaskIsPrime>(i+1));
+        }
+
+        auto const start = std::chrono::steady_clock::now();
+        {
+            scratch::ThreadPool thread_pool(thread_count,scheduler);
+            for(auto & task : list_tasks) {
+                thread_pool.Push(task);
+            }
+            for(auto & task : list_tasks) {
+                task->Wait();
+            }
+        }
+        auto const end = std::chrono::steady_clock::now();
+
+        double const ms =
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    end-start).count()/1000.0;
+
+        std::cout << ": " << thread_count << " threads: "
+                  << ms << " ms, "
+                  << (task_count/ms*1000.0) << " tasks/s" << std::endl;
+
+        if(thread_count == max_thread_count) {
+            break;
+        }
+    }
+    std::cout << std::endl;
+}
+
 int main()
 {
-    Test_PushTasksAndWait();
-    Test_PushTasksAndCancel();
-    Test_PushTasksStopAndResume();
+    for(auto scheduler : { Scheduler::SharedQueue,
+                           Scheduler::WorkStealing })
+    {
+        Test_PushTasksAndWait(scheduler);
+        Test_PushTasksAndCancel(scheduler);
+        Test_PushTasksStopAndResume(scheduler);
+        Test_ThenAndWhenAll(scheduler);
+        Test_TaskGraph(scheduler);
+        Test_RunAndSubmit(scheduler);
+        Test_ParallelForReduceSort(scheduler);
+        Test_Stats(scheduler);
+    }
+
+    Bench_TaskIsPrimeScaling(Scheduler::SharedQueue);
+    Bench_TaskIsPrimeScaling(Scheduler::WorkStealing);
+
+    Bench_SubmitThroughput(Scheduler::SharedQueue);
+    Bench_SubmitThroughput(Scheduler::WorkStealing);
+
+    Test_StaticPoolAtExit(Scheduler::WorkStealing);
 
     std::cout << "exiting..." << std::endl;
 
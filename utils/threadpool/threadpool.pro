@@ -3,13 +3,25 @@ TARGET      = runme
 CONFIG      -= qt
 
 HEADERS += \
-    ThreadPool.h
+    Job.h \
+    WorkStealingQueue.h \
+    ThreadPool.h \
+    ThreadPoolStats.h \
+    TaskGraph.h \
+    Parallel.h
 
 SOURCES += \
-    ThreadPool.cpp
+    Job.cpp \
+    ThreadPool.cpp \
+    ThreadPoolStats.cpp \
+    TaskGraph.cpp
 
 SOURCES += main.cpp
 
+# collect queue latency, run time and worker
+# utilization stats, see ThreadPoolStats.h
+DEFINES += SCRATCH_THREADPOOL_STATS
+
 
 # need these flags for gcc 4.8.x bug for threads
 QMAKE_LFLAGS += -Wl,--no-as-needed
@@ -0,0 +1,236 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_VERTEX_WELDER_H
+#define SCRATCH_VERTEX_WELDER_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <limits>
+
+namespace scratch
+{
+    namespace vertex_welder_detail
+    {
+        uint32_t const k_empty = std::numeric_limits<uint32_t>::max();
+    }
+
+    // ============================================================= //
+
+    // VertexWelder
+    // * gives every distinct vertex passed to Weld an index;
+    //   indices are handed out in the order vertices are first
+    //   seen, so they're stable for a given input
+    // * with an epsilon of 0, vertices weld only if their
+    //   coordinates are equal (+0 and -0 are the same)
+    // * with an epsilon > 0, a vertex welds to the earliest
+    //   kept vertex within epsilon on every axis. Coordinates
+    //   are quantized into cells 2*epsilon wide, and the cell
+    //   next to a vertex on each axis (the one nearer to it)
+    //   is checked too, so points either side of a cell
+    //   boundary still weld
+    // * vertices are kept in an open addressing hash table
+    //   keyed on the quantized coordinates, so welding n
+    //   vertices is O(n)
+    class VertexWelder
+    {
+    public:
+        explicit VertexWelder(double epsilon=0.0,
+                              size_t expected_count=0) :
+            m_epsilon(epsilon),
+            m_inv_cell((epsilon > 0.0) ? (0.5/epsilon) : 0.0),
+            m_count(0)
+        {
+            size_t capacity = 64;
+            while(capacity < expected_count*2) {
+                capacity *= 2;
+            }
+            m_list_slots.assign(capacity,vertex_welder_detail::k_empty);
+            m_list_vx.reserve(expected_count*3);
+            m_list_keys.reserve(expected_count);
+        }
+
+        // Returns the index of (x,y,z); is_new is set
+        // if it didn't weld to an earlier vertex
+        uint32_t Weld(double x, double y, double z, bool * is_new=nullptr)
+        {
+            double const vx[3] = { x+0.0, y+0.0, z+0.0 };  // -0 to +0
+            Key const key = calcKey(vx);
+
+            uint32_t index = (m_epsilon > 0.0) ?
+                        findNearby(vx,key) : findExact(vx,key);
+
+            if(is_new) {
+                *is_new = (index == k_empty);
+            }
+            if(index != k_empty) {
+                return index;
+            }
+
+            index = m_count++;
+            m_list_vx.insert(m_list_vx.end(),vx,vx+3);
+            m_list_keys.push_back(key);
+
+            if(m_count*2 > m_list_slots.size()) {
+                rehash(m_list_slots.size()*2);
+            }
+            else {
+                insertSlot(key,index);
+            }
+            return index;
+        }
+
+        uint32_t GetCount() const
+        {
+            return m_count;
+        }
+
+        // x,y,z of each welded vertex, by index
+        std::vector<double> const & GetVertices() const
+        {
+            return m_list_vx;
+        }
+
+    private:
+        static uint32_t const k_empty = vertex_welder_detail::k_empty;
+
+        struct Key
+        {
+            int64_t k[3];
+
+            bool operator == (Key const &other) const
+            {
+                return (k[0] == other.k[0]) &&
+                       (k[1] == other.k[1]) &&
+                       (k[2] == other.k[2]);
+            }
+        };
+
+        Key calcKey(double const * vx) const
+        {
+            Key key;
+            for(int i=0; i < 3; i++) {
+                if(m_epsilon > 0.0) {
+                    key.k[i] = int64_t(std::floor(vx[i]*m_inv_cell));
+                }
+                else {
+                    std::memcpy(&key.k[i],&vx[i],sizeof(double));
+                }
+            }
+            return key;
+        }
+
+        static size_t calcHash(Key const &key)
+        {
+            uint64_t h = 0x9E3779B97F4A7C15ULL;
+            for(int i=0; i < 3; i++) {
+                h ^= uint64_t(key.k[i]);
+                h *= 0xBF58476D1CE4E5B9ULL;
+                h ^= (h >> 31);
+            }
+            return size_t(h);
+        }
+
+        uint32_t findExact(double const * vx, Key const &key) const
+        {
+            size_t const mask = m_list_slots.size()-1;
+            for(size_t s=calcHash(key) & mask; ; s=(s+1) & mask) {
+                uint32_t const index = m_list_slots[s];
+                if(index == k_empty) {
+                    return k_empty;
+                }
+                double const * other = &m_list_vx[size_t(index)*3];
+                if(other[0] == vx[0] && other[1] == vx[1] && other[2] == vx[2]) {
+                    return index;
+                }
+            }
+        }
+
+        uint32_t findNearby(double const * vx, Key const &key) const
+        {
+            // the earliest match wins so the result doesn't
+            // depend on the order cells are checked in
+            uint32_t best = k_empty;
+            size_t const mask = m_list_slots.size()-1;
+
+            // anything within epsilon is in this cell or the
+            // neighbouring one on the side the vertex is nearer
+            int64_t list_side[3];
+            for(int i=0; i < 3; i++) {
+                double const f = vx[i]*m_inv_cell-double(key.k[i]);
+                list_side[i] = (f < 0.5) ? -1 : 1;
+            }
+
+            Key cell;
+            for(int n=0; n < 8; n++) {
+                for(int i=0; i < 3; i++) {
+                    cell.k[i] = key.k[i] + (((n >> i) & 1) ? list_side[i] : 0);
+                }
+
+                for(size_t s=calcHash(cell) & mask; ; s=(s+1) & mask) {
+                    uint32_t const index = m_list_slots[s];
+                    if(index == k_empty) {
+                        break;
+                    }
+                    if(index < best &&
+                       m_list_keys[index] == cell &&
+                       isNear(&m_list_vx[size_t(index)*3],vx)) {
+                        best = index;
+                    }
+                }
+            }
+            return best;
+        }
+
+        bool isNear(double const * a, double const * b) const
+        {
+            return (std::fabs(a[0]-b[0]) <= m_epsilon) &&
+                   (std::fabs(a[1]-b[1]) <= m_epsilon) &&
+                   (std::fabs(a[2]-b[2]) <= m_epsilon);
+        }
+
+        void insertSlot(Key const &key, uint32_t index)
+        {
+            size_t const mask = m_list_slots.size()-1;
+            size_t s = calcHash(key) & mask;
+            while(m_list_slots[s] != k_empty) {
+                s = (s+1) & mask;
+            }
+            m_list_slots[s] = index;
+        }
+
+        void rehash(size_t capacity)
+        {
+            m_list_slots.assign(capacity,vertex_welder_detail::k_empty);
+            for(uint32_t i=0; i < m_count; i++) {
+                insertSlot(m_list_keys[i],i);
+            }
+        }
+
+        double const m_epsilon;
+        double const m_inv_cell;
+        uint32_t m_count;
+        std::vector<uint32_t> m_list_slots;   // vertex index or k_empty
+        std::vector<double> m_list_vx;
+        std::vector<Key> m_list_keys;
+    };
+
+    // ============================================================= //
+}
+
+#endif // SCRATCH_VERTEX_WELDER_H
@@ -0,0 +1,190 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cassert>
+
+#include <VertexWelder.h>
+
+using namespace scratch;
+
+// ============================================================= //
+
+void testWeldExact()
+{
+    VertexWelder welder;
+    bool is_new;
+
+    assert(welder.Weld(1,2,3,&is_new) == 0 && is_new);
+    assert(welder.Weld(4,5,6,&is_new) == 1 && is_new);
+    assert(welder.Weld(1,2,3,&is_new) == 0 && !is_new);
+
+    // +0 and -0 weld, nearby points don't
+    assert(welder.Weld(0,0,0) == 2);
+    assert(welder.Weld(-0.0,0,-0.0) == 2);
+    assert(welder.Weld(1,2,3+1E-12,&is_new) == 3 && is_new);
+
+    assert(welder.GetCount() == 4);
+    std::vector<double> const &list_vx = welder.GetVertices();
+    assert(list_vx.size() == 12);
+    assert(list_vx[3] == 4 && list_vx[4] == 5 && list_vx[5] == 6);
+
+    std::cout << "testWeldExact... [ok]" << std::endl;
+}
+
+void testWeldEpsilon()
+{
+    double const eps = 0.01;
+    VertexWelder welder(eps);
+
+    assert(welder.Weld(1.0,1.0,0) == 0);
+
+    // within eps on each axis, either side
+    // of a cell boundary
+    assert(welder.Weld(1.009,0.991,0) == 0);
+    assert(welder.Weld(0.9999,1.0001,0) == 0);
+
+    // more than eps away on one axis
+    assert(welder.Weld(1.015,1.0,0) == 1);
+
+    // near both, the earlier vertex wins
+    assert(welder.Weld(1.0075,1.0,0) == 0);
+
+    // against the brute force result for a
+    // random cloud, in and out of order
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> dist(-1.0,1.0);
+    std::vector<double> list_pts;
+    for(size_t i=0; i < 4000; i++) {
+        list_pts.push_back(dist(rng));
+        list_pts.push_back(dist(rng));
+        list_pts.push_back(0.0);
+    }
+
+    VertexWelder cloud_welder(0.02);
+    std::vector<double> list_kept;
+    for(size_t i=0; i < list_pts.size(); i+=3) {
+        double const * p = &list_pts[i];
+
+        uint32_t expect = uint32_t(list_kept.size()/3);
+        for(size_t j=0; j < list_kept.size(); j+=3) {
+            if(std::fabs(list_kept[j+0]-p[0]) <= 0.02 &&
+               std::fabs(list_kept[j+1]-p[1]) <= 0.02 &&
+               std::fabs(list_kept[j+2]-p[2]) <= 0.02) {
+                expect = uint32_t(j/3);
+                break;
+            }
+        }
+        if(expect == list_kept.size()/3) {
+            list_kept.insert(list_kept.end(),p,p+3);
+        }
+
+        assert(cloud_welder.Weld(p[0],p[1],p[2]) == expect);
+    }
+    assert(cloud_welder.GetVertices() == list_kept);
+
+    std::cout << "testWeldEpsilon... [ok]" << std::endl;
+}
+
+// ============================================================= //
+
+std::string vxToString(double const * vx)
+{
+    std::stringstream ss;
+    ss.precision(12);
+    ss << vx[0] << "," << vx[1] << "," << vx[2] << std::endl;
+    return ss.str();
+}
+
+void benchWeld()
+{
+    // a triangle soup where each vertex is shared by ~6
+    // triangles, like a triangulated polygon
+    size_t const k_side = 700;
+    std::vector<double> list_soup;
+    for(size_t y=0; y+1 < k_side; y++) {
+        for(size_t x=0; x+1 < k_side; x++) {
+            double const x0 = -180.0+x*0.001, x1 = -180.0+(x+1)*0.001;
+            double const y0 = 40.0+y*0.001, y1 = 40.0+(y+1)*0.001;
+            double const tris[18] = {
+                x0,y0,0, x1,y0,0, x1,y1,0,
+                x0,y0,0, x1,y1,0, x0,y1,0
+            };
+            list_soup.insert(list_soup.end(),tris,tris+18);
+        }
+    }
+    size_t const vx_count = list_soup.size()/3;
+
+    // sorted strings, as the ptk tools did
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::string> list_strs(vx_count);
+    for(size_t i=0; i < vx_count; i++) {
+        list_strs[i] = vxToString(&list_soup[i*3]);
+    }
+    std::sort(list_strs.begin(),list_strs.end());
+    list_strs.erase(std::unique(list_strs.begin(),list_strs.end()),list_strs.end());
+    std::vector<uint32_t> list_str_ix(vx_count);
+    for(size_t i=0; i < vx_count; i++) {
+        list_str_ix[i] = uint32_t(std::lower_bound(
+                    list_strs.begin(),list_strs.end(),
+                    vxToString(&list_soup[i*3]))-list_strs.begin());
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    VertexWelder welder(0.0,vx_count/4);
+    std::vector<uint32_t> list_ix(vx_count);
+    for(size_t i=0; i < vx_count; i++) {
+        list_ix[i] = welder.Weld(list_soup[i*3],list_soup[i*3+1],list_soup[i*3+2]);
+    }
+
+    auto t2 = std::chrono::steady_clock::now();
+    VertexWelder eps_welder(1E-9,vx_count/4);
+    for(size_t i=0; i < vx_count; i++) {
+        eps_welder.Weld(list_soup[i*3],list_soup[i*3+1],list_soup[i*3+2]);
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    assert(welder.GetCount() == list_strs.size());
+    assert(eps_welder.GetCount() == list_strs.size());
+
+    auto ms = [](std::chrono::steady_clock::time_point a,
+                 std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration<double,std::milli>(b-a).count();
+    };
+
+    std::cout << "benchWeld: " << vx_count << " vertices, "
+              << welder.GetCount() << " unique" << std::endl;
+    std::cout << "benchWeld: sorted strings: " << ms(t0,t1) << "ms" << std::endl;
+    std::cout << "benchWeld: exact: " << ms(t1,t2) << "ms" << std::endl;
+    std::cout << "benchWeld: epsilon: " << ms(t2,t3) << "ms" << std::endl;
+}
+
+// ============================================================= //
+
+int main()
+{
+    testWeldExact();
+    testWeldEpsilon();
+    benchWeld();
+    return 0;
+}
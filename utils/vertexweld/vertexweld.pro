@@ -0,0 +1,10 @@
+TEMPLATE    = app
+TARGET      = runme
+CONFIG      -= qt
+
+INCLUDEPATH += $${PWD}
+
+HEADERS += VertexWelder.h
+SOURCES += test_vertexweld.cpp
+
+QMAKE_CXXFLAGS += -std=c++11
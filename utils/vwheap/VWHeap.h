@@ -0,0 +1,164 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SCRATCH_VW_HEAP_H
+#define SCRATCH_VW_HEAP_H
+
+#include <cstdint>
+#include <vector>
+
+namespace scratch
+{
+    // ============================================================= //
+
+    // VWHeap
+    // * indexed binary min heap of polyline points keyed on
+    //   their effective area, for Visvalingam-Whyatt
+    //   simplification
+    // * the heap slot of each point is tracked so its area
+    //   can be changed in place once a neighbour is removed
+    // * equal areas come out in the order they were set
+    //   (earliest first), so results don't depend on how
+    //   the heap happens to be laid out
+    // * Index is the point index type; a 32 bit type keeps
+    //   the heap smaller when rings have < 2^32 points
+    template<typename Index>
+    class VWHeap
+    {
+    public:
+        explicit VWHeap(size_t point_count=0)
+        {
+            Reset(point_count);
+        }
+
+        // Empties the heap and makes room for point_count
+        // points; keeps the memory already allocated
+        void Reset(size_t point_count)
+        {
+            m_list_heap.clear();
+            m_list_heap.reserve(point_count);
+            m_list_slots.assign(point_count,0);
+            m_list_areas.assign(point_count,0);
+            m_list_seqs.assign(point_count,0);
+            m_next_seq = 0;
+        }
+
+        size_t GetSize() const
+        {
+            return m_list_heap.size();
+        }
+
+        // Point with the smallest area; the heap
+        // shouldn't be empty
+        Index GetTop() const
+        {
+            return m_list_heap[0];
+        }
+
+        double GetArea(Index idx) const
+        {
+            return m_list_areas[idx];
+        }
+
+        void Push(Index idx, double area)
+        {
+            m_list_areas[idx] = area;
+            m_list_seqs[idx] = m_next_seq++;
+            m_list_heap.push_back(idx);
+            siftUp(m_list_heap.size()-1);
+        }
+
+        // Removes the top point
+        void Pop()
+        {
+            Index const last = m_list_heap.back();
+            m_list_heap.pop_back();
+            if(!m_list_heap.empty()) {
+                place(0,last);
+                siftDown(0);
+            }
+        }
+
+        // Changes the area of a point in the heap
+        void Update(Index idx, double area)
+        {
+            // a new seq can move an equal area point down
+            m_list_areas[idx] = area;
+            m_list_seqs[idx] = m_next_seq++;
+            siftUp(m_list_slots[idx]);
+            siftDown(m_list_slots[idx]);
+        }
+
+    private:
+        bool less(Index a, Index b) const
+        {
+            return (m_list_areas[a] < m_list_areas[b]) ||
+                   ((m_list_areas[a] == m_list_areas[b]) &&
+                    (m_list_seqs[a] < m_list_seqs[b]));
+        }
+
+        void place(size_t slot, Index idx)
+        {
+            m_list_heap[slot] = idx;
+            m_list_slots[idx] = Index(slot);
+        }
+
+        void siftUp(size_t slot)
+        {
+            Index const idx = m_list_heap[slot];
+            while(slot > 0) {
+                size_t const parent = (slot-1)/2;
+                if(!less(idx,m_list_heap[parent])) {
+                    break;
+                }
+                place(slot,m_list_heap[parent]);
+                slot = parent;
+            }
+            place(slot,idx);
+        }
+
+        void siftDown(size_t slot)
+        {
+            Index const idx = m_list_heap[slot];
+            size_t const count = m_list_heap.size();
+            while(true) {
+                size_t child = slot*2+1;
+                if(child >= count) {
+                    break;
+                }
+                if(child+1 < count && less(m_list_heap[child+1],m_list_heap[child])) {
+                    child++;
+                }
+                if(!less(m_list_heap[child],idx)) {
+                    break;
+                }
+                place(slot,m_list_heap[child]);
+                slot = child;
+            }
+            place(slot,idx);
+        }
+
+        std::vector<Index> m_list_heap;     // point indices
+        std::vector<Index> m_list_slots;    // heap slot of each point
+        std::vector<double> m_list_areas;
+        std::vector<uint64_t> m_list_seqs;  // when the area was set
+        uint64_t m_next_seq;
+    };
+
+    // ============================================================= //
+}
+
+#endif // SCRATCH_VW_HEAP_H
@@ -0,0 +1,123 @@
+/*
+   Copyright (C) 2014 Preet Desai (preet.desai@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <random>
+#include <cassert>
+
+#include <VWHeap.h>
+
+using namespace scratch;
+
+// ============================================================= //
+
+void testOrder()
+{
+    VWHeap<uint32_t> heap(5);
+    heap.Push(0,3.0);
+    heap.Push(1,1.0);
+    heap.Push(2,2.0);
+    heap.Push(3,1.0);
+    heap.Push(4,5.0);
+    assert(heap.GetSize() == 5);
+
+    // equal areas in the order they were set
+    assert(heap.GetTop() == 1);
+    heap.Pop();
+    assert(heap.GetTop() == 3);
+
+    // moving a point down and up
+    heap.Update(3,4.0);
+    assert(heap.GetTop() == 2);
+    heap.Update(4,0.5);
+    assert(heap.GetTop() == 4 && heap.GetArea(4) == 0.5);
+
+    uint32_t const list_expect[] = { 4,2,0,3 };
+    for(uint32_t idx : list_expect) {
+        assert(heap.GetTop() == idx);
+        heap.Pop();
+        (void)idx;
+    }
+    assert(heap.GetSize() == 0);
+
+    // Reset empties the heap for reuse
+    heap.Reset(2);
+    heap.Push(1,1.0);
+    heap.Push(0,1.0);
+    assert(heap.GetSize() == 2 && heap.GetTop() == 1);
+
+    std::cout << "testOrder... [ok]" << std::endl;
+}
+
+// Compares against a multimap keyed on (area,seq),
+// which is what the heap replaced
+template<typename Index>
+void testRandom()
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> dist_area(0.0,100.0);
+
+    size_t const count = 2000;
+    VWHeap<Index> heap(count);
+
+    std::map<std::pair<double,uint64_t>,Index> lkup_ref;
+    std::vector<std::pair<double,uint64_t>> list_keys(count);
+    uint64_t seq=0;
+
+    for(size_t i=0; i < count; i++) {
+        // coarse areas so there are plenty of ties
+        double const area = double(int(dist_area(rng)));
+        heap.Push(Index(i),area);
+        list_keys[i] = std::make_pair(area,seq++);
+        lkup_ref[list_keys[i]] = Index(i);
+    }
+
+    while(heap.GetSize() > 0) {
+        auto const it_top = lkup_ref.begin();
+        assert(heap.GetTop() == it_top->second);
+        lkup_ref.erase(it_top);
+        heap.Pop();
+
+        // change a couple of the remaining areas
+        for(int n=0; n < 2 && !lkup_ref.empty(); n++) {
+            auto it = lkup_ref.begin();
+            std::advance(it,rng() % lkup_ref.size());
+            Index const idx = it->second;
+            lkup_ref.erase(it);
+
+            double const area = double(int(dist_area(rng)));
+            heap.Update(idx,area);
+            list_keys[idx] = std::make_pair(area,seq++);
+            lkup_ref[list_keys[idx]] = idx;
+        }
+    }
+    assert(lkup_ref.empty());
+
+    std::cout << "testRandom (" << sizeof(Index)*8 << " bit)... [ok]" << std::endl;
+}
+
+// ============================================================= //
+
+int main()
+{
+    testOrder();
+    testRandom<uint32_t>();
+    testRandom<size_t>();
+    return 0;
+}
@@ -0,0 +1,10 @@
+TEMPLATE    = app
+TARGET      = runme
+CONFIG      -= qt
+
+INCLUDEPATH += $${PWD}
+
+HEADERS += VWHeap.h
+SOURCES += test_vwheap.cpp
+
+QMAKE_CXXFLAGS += -std=c++11